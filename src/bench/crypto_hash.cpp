@@ -7,9 +7,11 @@
 #include <bench/bench.h>
 #include <bloom.h>
 #include <hash.h>
+#include <primitives/block.h>
 #include <random.h>
 #include <uint256.h>
 #include <util/time.h>
+#include <crypto/quark.h>
 #include <crypto/ripemd160.h>
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
@@ -61,6 +63,45 @@ static void SHA256D64_1024(benchmark::State& state)
     }
 }
 
+static void Quark_80b(benchmark::State& state)
+{
+    std::vector<uint8_t> in(QUARK_HEADER_SIZE, 0);
+    while (state.KeepRunning()) {
+        QuarkHash(in.data(), in.data(), in.size());
+    }
+}
+
+static void Quark80_1024(benchmark::State& state)
+{
+    std::vector<uint8_t> in(QUARK_HEADER_SIZE * 1024, 0);
+    for (size_t i = 0; i < in.size(); ++i)
+        in[i] = i;
+    std::vector<uint8_t> out(32 * 1024);
+    while (state.KeepRunning()) {
+        QuarkHash80(out.data(), in.data(), 1024);
+    }
+}
+
+static void BlockHeaderHash(benchmark::State& state)
+{
+    CBlockHeader header;
+    header.nBits = 0x1e0ffff0;
+    while (state.KeepRunning()) {
+        ++header.nNonce;
+        header.GetHash();
+    }
+}
+
+static void BlockHeaderHash_Cached(benchmark::State& state)
+{
+    CBlockHeader header;
+    header.nBits = 0x1e0ffff0;
+    header.CacheHash();
+    while (state.KeepRunning()) {
+        header.GetHash();
+    }
+}
+
 static void SHA512(benchmark::State& state)
 {
     uint8_t hash[CSHA512::OUTPUT_SIZE];
@@ -102,5 +143,9 @@ BENCHMARK(SHA512, 330);
 BENCHMARK(SHA256_32b, 4700 * 1000);
 BENCHMARK(SipHash_32b, 40 * 1000 * 1000);
 BENCHMARK(SHA256D64_1024, 7400);
+BENCHMARK(Quark_80b, 200 * 1000);
+BENCHMARK(Quark80_1024, 200);
+BENCHMARK(BlockHeaderHash, 200 * 1000);
+BENCHMARK(BlockHeaderHash_Cached, 20 * 1000 * 1000);
 BENCHMARK(FastRandom_32bit, 110 * 1000 * 1000);
 BENCHMARK(FastRandom_1bit, 440 * 1000 * 1000);
@@ -0,0 +1,64 @@
+// Copyright (c) 2020 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <servicenode/servicenodemgr.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <set>
+
+// Exposes the servicenode manager's duplicate packet check
+class BenchServiceNodeMgr : public sn::ServiceNodeMgr {
+public:
+    using sn::ServiceNodeMgr::seenPacket;
+};
+
+// Previous implementation: ordered set that is cleared when it reaches capacity
+class SeenPacketsSet {
+public:
+    bool seenPacket(const uint256 & hash) {
+        LOCK(mu);
+        if (seenPackets.count(hash))
+            return true;
+        if (seenPackets.size() > sn::ServiceNodeMgr::SEEN_PACKETS_MAX)
+            seenPackets.clear();
+        seenPackets.insert(hash);
+        return false;
+    }
+private:
+    Mutex mu;
+    std::set<uint256> seenPackets;
+};
+
+// Each new packet is followed by a duplicate of a recently seen packet, similar
+// to the same snode ping arriving from multiple peers.
+template <typename T>
+static void SeenPackets(benchmark::State& state, T & filter)
+{
+    uint256 hash;
+    uint32_t count = 0;
+    while (state.KeepRunning()) {
+        ++count;
+        WriteLE32(hash.begin(), count);
+        filter.seenPacket(hash);
+        WriteLE32(hash.begin(), count > 1000 ? count - 1000 : count);
+        filter.seenPacket(hash);
+    }
+}
+
+static void SeenPacketsStdSet(benchmark::State& state)
+{
+    SeenPacketsSet filter;
+    SeenPackets(state, filter);
+}
+
+static void SeenPacketsRollingBloom(benchmark::State& state)
+{
+    BenchServiceNodeMgr filter;
+    SeenPackets(state, filter);
+}
+
+BENCHMARK(SeenPacketsStdSet, 1000 * 1000);
+BENCHMARK(SeenPacketsRollingBloom, 1000 * 1000);
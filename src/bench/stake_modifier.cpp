@@ -0,0 +1,61 @@
+// Copyright (c) 2020 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <kernel.h>
+#include <random.h>
+
+#include <deque>
+
+static constexpr int HEADER_CHAIN_LENGTH = 10000;
+
+// Computes the stake modifiers of a long synthetic header chain in order, like
+// AddToBlockIndex does during header sync.
+static void StakeModifierHeaderSync(benchmark::State& state, bool fSlidingWindow)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    FastRandomContext rng(true);
+    std::deque<CBlockIndex> headers(HEADER_CHAIN_LENGTH);
+    std::vector<uint256> hashes(HEADER_CHAIN_LENGTH);
+    int64_t nTime = Params().GetConsensus().stakingV05UpgradeTime;
+    for (int i = 0; i < HEADER_CHAIN_LENGTH; ++i) {
+        hashes[i] = rng.rand256();
+        CBlockIndex& header = headers[i];
+        header.phashBlock = &hashes[i];
+        header.pprev = i > 0 ? &headers[i - 1] : nullptr;
+        header.nHeight = i;
+        header.nTime = nTime;
+        header.hashProofOfStake = rng.rand256();
+        header.SetStakeEntropyBit(rng.randbool());
+        nTime += 30 + rng.randrange(60);
+    }
+
+    while (state.KeepRunning()) {
+        ResetStakeModifierCandidates();
+        for (auto& header : headers) {
+            if (!fSlidingWindow)
+                ResetStakeModifierCandidates();
+            uint64_t nStakeModifier = 0;
+            bool fGenerated = false;
+            ComputeNextStakeModifier(header.pprev, nStakeModifier, fGenerated, Params().GetConsensus());
+            header.SetStakeModifier(nStakeModifier, fGenerated);
+        }
+    }
+    ResetStakeModifierCandidates();
+}
+
+static void StakeModifierFullWindow(benchmark::State& state)
+{
+    StakeModifierHeaderSync(state, false);
+}
+
+static void StakeModifierSlidingWindow(benchmark::State& state)
+{
+    StakeModifierHeaderSync(state, true);
+}
+
+BENCHMARK(StakeModifierFullWindow, 10);
+BENCHMARK(StakeModifierSlidingWindow, 10);
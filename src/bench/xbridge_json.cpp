@@ -0,0 +1,96 @@
+// Copyright (c) 2020 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <xbridge/util/xutil.h>
+
+#include <json/json_spirit_reader_template.h>
+#include <json/json_spirit_utils.h>
+#include <json/json_spirit_writer_template.h>
+
+#include <cassert>
+
+// Order book with 5000 bids and asks, similar to a detailed dxGetOrderBook reply
+static json_spirit::Object OrderBook()
+{
+    json_spirit::Array bids, asks;
+    for (int i = 0; i < 5000; ++i) {
+        json_spirit::Object bid;
+        bid.emplace_back("price", 0.00012345 + i * 0.00000001);
+        bid.emplace_back("size", 1.5 + i);
+        bid.emplace_back("order_id", "4c2a0f0e4d0a1b7e8f6d5c4b3a2918070605040302010f0e0d0c0b0a09080706");
+        bids.push_back(bid);
+        asks.push_back(bid);
+    }
+    json_spirit::Object o;
+    o.emplace_back("detail", 3);
+    o.emplace_back("maker", "BLOCK");
+    o.emplace_back("taker", "LTC");
+    o.emplace_back("bids", bids);
+    o.emplace_back("asks", asks);
+    return o;
+}
+
+// Json-rpc reply of a wallet with a large result, e.g. a verbose getblock
+static std::string LargeReply()
+{
+    json_spirit::Array txs;
+    for (int i = 0; i < 10000; ++i)
+        txs.push_back("4c2a0f0e4d0a1b7e8f6d5c4b3a2918070605040302010f0e0d0c0b0a09080706");
+    json_spirit::Object block;
+    block.emplace_back("hash", "000000000000000000050b9a7eba8d4b94d3e3e1c7d8d6f1e5a7bd2b5f8a1c3e");
+    block.emplace_back("height", 812345);
+    block.emplace_back("tx", txs);
+    json_spirit::Object reply;
+    reply.emplace_back("result", block);
+    reply.emplace_back("error", json_spirit::Value());
+    reply.emplace_back("id", 1);
+    return json_spirit::write_string(json_spirit::Value(reply), false);
+}
+
+// Previous RPC path: serialize with json_spirit and parse the string into UniValue
+static void JsonSpiritToUniValueRoundTrip(benchmark::State& state)
+{
+    const auto book = OrderBook();
+    while (state.KeepRunning()) {
+        UniValue uv;
+        uv.read(json_spirit::write_string(json_spirit::Value(book), json_spirit::none, 8));
+        assert(uv.isObject());
+    }
+}
+
+static void JsonSpiritToUniValueDirect(benchmark::State& state)
+{
+    const auto book = OrderBook();
+    while (state.KeepRunning()) {
+        const auto uv = xbridge::toUniValue(book);
+        assert(uv.isObject());
+    }
+}
+
+// Previous connector path: parse the whole reply to check the error member
+static void JsonReplyFullParse(benchmark::State& state)
+{
+    const auto reply = LargeReply();
+    while (state.KeepRunning()) {
+        json_spirit::Value v;
+        json_spirit::read_string(reply, v);
+        const auto & error = json_spirit::find_value(v.get_obj(), "error");
+        assert(error.type() == json_spirit::null_type);
+    }
+}
+
+static void JsonReplyReaderScan(benchmark::State& state)
+{
+    const auto reply = LargeReply();
+    while (state.KeepRunning()) {
+        xbridge::JsonReplyReader reader(reply);
+        assert(reader.isNull("error"));
+    }
+}
+
+BENCHMARK(JsonSpiritToUniValueRoundTrip, 20);
+BENCHMARK(JsonSpiritToUniValueDirect, 20);
+BENCHMARK(JsonReplyFullParse, 20);
+BENCHMARK(JsonReplyReaderScan, 20);
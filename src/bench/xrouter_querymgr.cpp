@@ -0,0 +1,73 @@
+// Copyright (c) 2020 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <xrouter/xrouterquerymgr.h>
+
+#include <cassert>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const int QUERIES = 2000;
+static const int NODES_PER_QUERY = 3;
+static const int THREADS = 4;
+static const std::string SERVICE = "xr::BLOCK::xrGetBlockCount";
+
+// Client threads send queries to 3 of 50 nodes and wait for consensus while other threads
+// deliver the node replies, similar to a busy xrouter client or a wallet backend.
+static void XRouterQueryMgrConcurrent(benchmark::State& state)
+{
+    std::vector<std::string> ids;
+    std::vector<xrouter::NodeAddr> nodes;
+    for (int i = 0; i < QUERIES; ++i)
+        ids.push_back("3b2c9a1e-5f7d-4e8a-9c6b-" + std::to_string(100000000000 + i));
+    for (int i = 0; i < 50; ++i)
+        nodes.push_back("10.0.0." + std::to_string(i) + ":41412");
+    auto node = [&nodes](int query, int n) -> const xrouter::NodeAddr & {
+        return nodes[(query * 7 + n * 13) % nodes.size()];
+    };
+
+    while (state.KeepRunning()) {
+        xrouter::QueryMgr qm;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < THREADS; ++t) {
+            threads.emplace_back([&, t]() { // client
+                for (int i = t; i < QUERIES; i += THREADS) {
+                    for (int n = 0; n < NODES_PER_QUERY; ++n) {
+                        qm.getScore(node(i, n));
+                        qm.rateLimitExceeded(node(i, n), SERVICE, qm.getLastRequest(node(i, n), SERVICE), 100);
+                        qm.addQuery(ids[i], node(i, n), SERVICE);
+                        qm.updateSentRequest(node(i, n), SERVICE);
+                    }
+                }
+                for (int i = t; i < QUERIES; i += THREADS) {
+                    for (int n = 0; n < NODES_PER_QUERY; ++n) {
+                        while (!qm.hasReply(ids[i], node(i, n)))
+                            std::this_thread::yield();
+                    }
+                    std::string reply;
+                    assert(qm.mostCommonReply(ids[i], reply) == NODES_PER_QUERY);
+                    qm.purge(ids[i]);
+                    for (int n = 0; n < NODES_PER_QUERY; ++n)
+                        qm.updateScore(node(i, n), 2);
+                }
+            });
+            threads.emplace_back([&, t]() { // replies
+                const std::string reply = R"({"result":1500000,"error":null,"id":null})";
+                for (int i = QUERIES - 1 - t; i >= 0; i -= THREADS) {
+                    for (int n = 0; n < NODES_PER_QUERY; ++n) {
+                        while (!qm.addReply(ids[i], node(i, n), reply))
+                            std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (auto & th : threads)
+            th.join();
+    }
+}
+
+BENCHMARK(XRouterQueryMgrConcurrent, 5);
@@ -144,11 +144,22 @@ protected:
 
 public:
     CBlockHeader header;
+    // PoS block signature, only on the wire in the PoS-aware encoding (compact block version 3)
+    std::vector<unsigned char> vchBlockSig;
+
+    // memory only, selects the PoS-aware encoding
+    bool fBlockSig{false};
 
     // Dummy for deserialization
     CBlockHeaderAndShortTxIDs() {}
+    explicit CBlockHeaderAndShortTxIDs(bool fBlockSigIn) : fBlockSig(fBlockSigIn) {}
 
-    CBlockHeaderAndShortTxIDs(const CBlock& block, bool fUseWTXID);
+    /**
+     * Build the compact encoding of a block. With fBlockSigIn set the PoS-aware encoding is used: the
+     * coinstake is prefilled next to the coinbase (it is never in a mempool) and the block signature is
+     * carried along so that the block can be reconstructed in full.
+     */
+    CBlockHeaderAndShortTxIDs(const CBlock& block, bool fUseWTXID, bool fBlockSigIn = false);
 
     uint64_t GetShortID(const uint256& txhash) const;
 
@@ -186,6 +197,9 @@ public:
 
         READWRITE(prefilledtxn);
 
+        if (fBlockSig)
+            READWRITE(vchBlockSig);
+
         if (BlockTxCount() > std::numeric_limits<uint16_t>::max())
             throw std::ios_base::failure("indexes overflowed 16 bits");
 
@@ -198,6 +212,7 @@ class PartiallyDownloadedBlock {
 protected:
     std::vector<CTransactionRef> txn_available;
     size_t prefilled_count = 0, mempool_count = 0, extra_count = 0;
+    std::vector<unsigned char> vchBlockSig;
     CTxMemPool* pool;
 public:
     CBlockHeader header;
@@ -190,6 +190,12 @@ public:
             /* dTxRate  */ 0.03353379319107036
         };
 
+        assumeutxoData = {
+            // Data from rpc: dumptxoutset <path> (snapshot_hash, base_height)
+            {
+            }
+        };
+
         /* enable fallback fee on mainnet */
         m_fallback_fee_enabled = true;
         consensus.defaultFallbackFee = CFeeRate(2000);
@@ -347,6 +353,12 @@ public:
             /* dTxRate  */ 0.03318975611066963
         };
 
+        assumeutxoData = {
+            // Data from rpc: dumptxoutset <path> (snapshot_hash, base_height)
+            {
+            }
+        };
+
         /* enable fallback fee on testnet */
         m_fallback_fee_enabled = true;
         consensus.defaultFallbackFee = CFeeRate(2000);
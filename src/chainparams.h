@@ -25,6 +25,16 @@ struct CCheckpointData {
     MapCheckpoints mapCheckpoints;
 };
 
+typedef std::map<int, uint256> MapAssumeutxo;
+
+/**
+ * Hashes of the utxo snapshots (see dumptxoutset) that loadtxoutset accepts, keyed by the
+ * height of the snapshot base block.
+ */
+struct CAssumeutxoData {
+    MapAssumeutxo mapSnapshotHashes;
+};
+
 /**
  * Holds various statistics on transactions within a chain. Used to estimate
  * verification progress during chain sync.
@@ -84,6 +94,7 @@ public:
     const std::vector<SeedSpec6>& FixedSeeds() const { return vFixedSeeds; }
     const CCheckpointData& Checkpoints() const { return checkpointData; }
     const ChainTxData& TxData() const { return chainTxData; }
+    const CAssumeutxoData& AssumeutxoData() const { return assumeutxoData; }
 protected:
     CChainParams() {}
 
@@ -104,6 +115,7 @@ protected:
     bool fMineBlocksOnDemand;
     CCheckpointData checkpointData;
     ChainTxData chainTxData;
+    CAssumeutxoData assumeutxoData;
     bool m_fallback_fee_enabled;
 };
 
@@ -0,0 +1,173 @@
+// Copyright (c) 2020 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// Groestl-512 of single 64 byte blocks using AES-NI for SubBytes, as needed by the Quark hash.
+
+#ifdef ENABLE_AESNI
+
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+
+namespace groestl_aesni {
+namespace {
+
+/* The 1024-bit state is kept as 8 row registers, byte j of register i being column j of row i. */
+
+/** Multiply each byte by x (i.e. 2) in GF(2^8) using the AES polynomial. */
+inline __m128i Mul2(__m128i x)
+{
+    const __m128i msb = _mm_cmpgt_epi8(_mm_setzero_si128(), x);
+    return _mm_xor_si128(_mm_add_epi8(x, x), _mm_and_si128(msb, _mm_set1_epi8(0x1b)));
+}
+
+inline __m128i Xor(__m128i a, __m128i b) { return _mm_xor_si128(a, b); }
+
+/**
+ * MixBytes, multiplying each column by circ(02,02,03,04,05,03,05,07). Splitting the
+ * coefficients into their 1, 2 and 4 multiples gives for row i (offsets relative to i):
+ *   1: a2^a4^a5^a6^a7 = a2^t4^t6
+ *   2: a0^a1^a2^a5^a7 = t0^a2^a5^a7
+ *   4: a3^a4^a6^a7    = t3^t6
+ * with t_i = a_i ^ a_i+1.
+ */
+inline void MixBytes(__m128i a[8])
+{
+    __m128i t[8];
+    for (int i = 0; i < 8; ++i)
+        t[i] = Xor(a[i], a[(i + 1) & 7]);
+    __m128i b[8];
+    for (int i = 0; i < 8; ++i) {
+        const __m128i x1 = Xor(a[(i + 2) & 7], Xor(t[(i + 4) & 7], t[(i + 6) & 7]));
+        const __m128i x2 = Xor(Xor(t[i], a[(i + 2) & 7]), Xor(a[(i + 5) & 7], a[(i + 7) & 7]));
+        const __m128i x4 = Xor(t[(i + 3) & 7], t[(i + 6) & 7]);
+        b[i] = Xor(x1, Mul2(Xor(x2, Mul2(x4))));
+    }
+    for (int i = 0; i < 8; ++i)
+        a[i] = b[i];
+}
+
+/*
+ * Byte shuffles rotating row i left by the ShiftBytes offset and undoing the AES ShiftRows
+ * applied by aesenclast, so that aesenclast with a zero key only adds SubBytes. Byte k of the
+ * mask is ((r + 4 * ((c - r) & 3)) + shift) & 15 with r = k & 3, c = k >> 2.
+ */
+#define GROESTL_MASK(s) _mm_set_epi8((3+(s))&15, (6+(s))&15, (9+(s))&15, (12+(s))&15, (15+(s))&15, (2+(s))&15, (5+(s))&15, (8+(s))&15, \
+                                     (11+(s))&15, (14+(s))&15, (1+(s))&15, (4+(s))&15, (7+(s))&15, (10+(s))&15, (13+(s))&15, (0+(s))&15)
+
+template <bool Q>
+inline void Round(__m128i a[8], int r)
+{
+    if (!Q) {
+        const __m128i pc = _mm_set_epi8(0xf0, 0xe0, 0xd0, 0xc0, 0xb0, 0xa0, 0x90, 0x80, 0x70, 0x60, 0x50, 0x40, 0x30, 0x20, 0x10, 0x00);
+        a[0] = Xor(a[0], Xor(pc, _mm_set1_epi8(r)));
+    } else {
+        const __m128i ones = _mm_set1_epi8(0xff);
+        const __m128i qc = _mm_set_epi8(0x0f, 0x1f, 0x2f, 0x3f, 0x4f, 0x5f, 0x6f, 0x7f, 0x8f, 0x9f, 0xaf, 0xbf, 0xcf, 0xdf, 0xef, 0xff);
+        for (int i = 0; i < 7; ++i)
+            a[i] = Xor(a[i], ones);
+        a[7] = Xor(a[7], Xor(qc, _mm_set1_epi8(r)));
+    }
+    const __m128i zero = _mm_setzero_si128();
+    a[0] = _mm_aesenclast_si128(_mm_shuffle_epi8(a[0], Q ? GROESTL_MASK(1) : GROESTL_MASK(0)), zero);
+    a[1] = _mm_aesenclast_si128(_mm_shuffle_epi8(a[1], Q ? GROESTL_MASK(3) : GROESTL_MASK(1)), zero);
+    a[2] = _mm_aesenclast_si128(_mm_shuffle_epi8(a[2], Q ? GROESTL_MASK(5) : GROESTL_MASK(2)), zero);
+    a[3] = _mm_aesenclast_si128(_mm_shuffle_epi8(a[3], Q ? GROESTL_MASK(11) : GROESTL_MASK(3)), zero);
+    a[4] = _mm_aesenclast_si128(_mm_shuffle_epi8(a[4], Q ? GROESTL_MASK(0) : GROESTL_MASK(4)), zero);
+    a[5] = _mm_aesenclast_si128(_mm_shuffle_epi8(a[5], Q ? GROESTL_MASK(2) : GROESTL_MASK(5)), zero);
+    a[6] = _mm_aesenclast_si128(_mm_shuffle_epi8(a[6], Q ? GROESTL_MASK(4) : GROESTL_MASK(6)), zero);
+    a[7] = _mm_aesenclast_si128(_mm_shuffle_epi8(a[7], Q ? GROESTL_MASK(6) : GROESTL_MASK(11)), zero);
+    MixBytes(a);
+}
+
+/** Run the permutations of two independent states side by side. */
+template <bool Q0, bool Q1>
+inline void Perm2(__m128i a[8], __m128i b[8])
+{
+    for (int r = 0; r < 14; ++r) {
+        Round<Q0>(a, r);
+        Round<Q1>(b, r);
+    }
+}
+
+/** Load a 64 byte message as padded block rows: message, 0x80, zeros, 64-bit big endian block count of 1. */
+inline void LoadBlock(__m128i m[8], const unsigned char* in)
+{
+    alignas(16) uint8_t rows[8][16] = {};
+    for (int c = 0; c < 8; ++c)
+        for (int r = 0; r < 8; ++r)
+            rows[r][c] = in[8 * c + r];
+    rows[0][8] = 0x80;
+    rows[7][15] = 0x01;
+    for (int r = 0; r < 8; ++r)
+        m[r] = _mm_load_si128((const __m128i*)rows[r]);
+}
+
+/** Store the truncated output (columns 8 to 15) in column-major order. */
+inline void StoreOutput(unsigned char* out, const __m128i x[8])
+{
+    alignas(16) uint8_t rows[8][16];
+    for (int i = 0; i < 8; ++i)
+        _mm_store_si128((__m128i*)rows[i], x[i]);
+    for (int c = 8; c < 16; ++c)
+        for (int r = 0; r < 8; ++r)
+            out[8 * (c - 8) + r] = rows[r][c];
+}
+
+/** Compression of the single message block with the IV: h = P(iv ^ m) ^ Q(m) ^ iv. */
+inline void Compress(__m128i h[8], __m128i m[8])
+{
+    __m128i p[8];
+    for (int i = 0; i < 8; ++i)
+        p[i] = m[i];
+    const __m128i iv = _mm_insert_epi8(_mm_setzero_si128(), 0x02, 15); // output size 512 in row 6 of the last column
+    p[6] = Xor(p[6], iv);
+    Perm2<false, true>(p, m);
+    for (int i = 0; i < 8; ++i)
+        h[i] = Xor(p[i], m[i]);
+    h[6] = Xor(h[6], iv);
+}
+
+} // namespace
+
+/** Groestl-512 of a 64 byte message. */
+void Hash512_64(unsigned char* out, const unsigned char* in)
+{
+    __m128i m[8], h[8], p[8];
+    LoadBlock(m, in);
+    Compress(h, m);
+    // Output transformation: trunc512(P(h) ^ h)
+    for (int i = 0; i < 8; ++i)
+        p[i] = h[i];
+    for (int r = 0; r < 14; ++r)
+        Round<false>(p, r);
+    for (int i = 0; i < 8; ++i)
+        p[i] = Xor(p[i], h[i]);
+    StoreOutput(out, p);
+}
+
+/** Groestl-512 of two independent 64 byte messages (in and in + 64), interleaved. */
+void Hash512_64_2way(unsigned char* out, const unsigned char* in)
+{
+    __m128i m0[8], m1[8], h0[8], h1[8], p0[8], p1[8];
+    LoadBlock(m0, in);
+    LoadBlock(m1, in + 64);
+    Compress(h0, m0);
+    Compress(h1, m1);
+    for (int i = 0; i < 8; ++i) {
+        p0[i] = h0[i];
+        p1[i] = h1[i];
+    }
+    Perm2<false, false>(p0, p1);
+    for (int i = 0; i < 8; ++i) {
+        p0[i] = Xor(p0[i], h0[i]);
+        p1[i] = Xor(p1[i], h1[i]);
+    }
+    StoreOutput(out, p0);
+    StoreOutput(out + 64, p1);
+}
+
+}
+
+#endif
@@ -0,0 +1,307 @@
+// Copyright (c) 2020 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <crypto/quark.h>
+#include <crypto/common.h>
+
+#include <crypto/sph_blake.h>
+#include <crypto/sph_bmw.h>
+#include <crypto/sph_groestl.h>
+#include <crypto/sph_jh.h>
+#include <crypto/sph_keccak.h>
+#include <crypto/sph_skein.h>
+
+#include <assert.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__amd64__) || defined(__i386__)
+#if defined(USE_ASM)
+#include <cpuid.h>
+#endif
+#endif
+
+namespace groestl_aesni
+{
+void Hash512_64(unsigned char* out, const unsigned char* in);
+void Hash512_64_2way(unsigned char* out, const unsigned char* in);
+}
+
+namespace jh_avx2
+{
+void Hash512_64_4way(unsigned char* out, const unsigned char* in);
+}
+
+namespace {
+
+/** Number of headers hashed side by side in QuarkHash80. */
+static const size_t LANES = 4;
+
+void Blake512(unsigned char* out, const unsigned char* in, size_t len)
+{
+    sph_blake512_context ctx;
+    sph_blake512_init(&ctx);
+    sph_blake512(&ctx, in, len);
+    sph_blake512_close(&ctx, out);
+}
+
+void Bmw512(unsigned char* out, const unsigned char* in)
+{
+    sph_bmw512_context ctx;
+    sph_bmw512_init(&ctx);
+    sph_bmw512(&ctx, in, 64);
+    sph_bmw512_close(&ctx, out);
+}
+
+void Groestl512(unsigned char* out, const unsigned char* in)
+{
+    sph_groestl512_context ctx;
+    sph_groestl512_init(&ctx);
+    sph_groestl512(&ctx, in, 64);
+    sph_groestl512_close(&ctx, out);
+}
+
+void JH512(unsigned char* out, const unsigned char* in)
+{
+    sph_jh512_context ctx;
+    sph_jh512_init(&ctx);
+    sph_jh512(&ctx, in, 64);
+    sph_jh512_close(&ctx, out);
+}
+
+void Keccak512(unsigned char* out, const unsigned char* in)
+{
+    sph_keccak512_context ctx;
+    sph_keccak512_init(&ctx);
+    sph_keccak512(&ctx, in, 64);
+    sph_keccak512_close(&ctx, out);
+}
+
+void Skein512(unsigned char* out, const unsigned char* in)
+{
+    sph_skein512_context ctx;
+    sph_skein512_init(&ctx);
+    sph_skein512(&ctx, in, 64);
+    sph_skein512_close(&ctx, out);
+}
+
+typedef void (*Hash512Fn)(unsigned char* out, const unsigned char* in);
+
+template <Hash512Fn fn, size_t n>
+void HashWrapper(unsigned char* out, const unsigned char* in)
+{
+    for (size_t i = 0; i < n; ++i)
+        fn(out + 64 * i, in + 64 * i);
+}
+
+Hash512Fn Groestl = Groestl512;
+Hash512Fn Groestl_2way = HashWrapper<Groestl512, 2>;
+Hash512Fn JH_4way = HashWrapper<JH512, 4>;
+
+/** The Quark branch selector, bit 3 of the previous 512-bit result. */
+inline bool Select(const unsigned char* h) { return h[0] & 8; }
+
+/** Groestl-512 of n consecutive 64 byte blocks. */
+void GroestlBlocks(unsigned char* out, const unsigned char* in, size_t n)
+{
+    for (; n >= 2; n -= 2, out += 128, in += 128)
+        Groestl_2way(out, in);
+    if (n)
+        Groestl(out, in);
+}
+
+/** Quark of up to LANES 80 byte headers, the 64 byte per lane stages run on the multi-way implementations. */
+void QuarkHash80Lanes(unsigned char* output, const unsigned char* input, size_t n)
+{
+    unsigned char a[LANES * 64] = {}, b[LANES * 64] = {};
+    unsigned char tin[LANES * 64], tout[LANES * 64];
+    size_t idx[LANES];
+    size_t m;
+
+    for (size_t i = 0; i < n; ++i) {
+        Blake512(a + 64 * i, input + QUARK_HEADER_SIZE * i, QUARK_HEADER_SIZE);
+        Bmw512(b + 64 * i, a + 64 * i);
+    }
+
+    // Groestl or Skein, lanes taking the Groestl branch are packed to run two at a time
+    m = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (Select(b + 64 * i)) {
+            memcpy(tin + 64 * m, b + 64 * i, 64);
+            idx[m++] = i;
+        } else {
+            Skein512(a + 64 * i, b + 64 * i);
+        }
+    }
+    GroestlBlocks(tout, tin, m);
+    for (size_t k = 0; k < m; ++k)
+        memcpy(a + 64 * idx[k], tout + 64 * k, 64);
+
+    GroestlBlocks(b, a, n);
+    JH_4way(a, b);
+
+    for (size_t i = 0; i < n; ++i) {
+        if (Select(a + 64 * i))
+            Blake512(b + 64 * i, a + 64 * i, 64);
+        else
+            Bmw512(b + 64 * i, a + 64 * i);
+        Keccak512(a + 64 * i, b + 64 * i);
+        Skein512(b + 64 * i, a + 64 * i);
+    }
+
+    // Keccak or JH, JH runs on all lanes at once if any lane needs it
+    bool jh = false;
+    for (size_t i = 0; i < n; ++i)
+        jh |= !Select(b + 64 * i);
+    if (jh)
+        JH_4way(tout, b);
+    for (size_t i = 0; i < n; ++i) {
+        if (Select(b + 64 * i))
+            Keccak512(a + 64 * i, b + 64 * i);
+        else
+            memcpy(a + 64 * i, tout + 64 * i, 64);
+        memcpy(output + 32 * i, a + 64 * i, 32);
+    }
+}
+
+/** Quark of a single input with the given Groestl-512 implementation. */
+void QuarkHashWith(Hash512Fn groestl, unsigned char* output, const unsigned char* input, size_t len)
+{
+    unsigned char a[64], b[64];
+
+    Blake512(a, input, len);
+    Bmw512(b, a);
+    if (Select(b))
+        groestl(a, b);
+    else
+        Skein512(a, b);
+    groestl(b, a);
+    JH512(a, b);
+    if (Select(a))
+        Blake512(b, a, 64);
+    else
+        Bmw512(b, a);
+    Keccak512(a, b);
+    Skein512(b, a);
+    if (Select(b))
+        Keccak512(a, b);
+    else
+        JH512(a, b);
+
+    memcpy(output, a, 32);
+}
+
+bool SelfTest()
+{
+    // Compare the full output of every dispatched implementation and lane with the portable sph code.
+    unsigned char in[(LANES + 1) * QUARK_HEADER_SIZE];
+    for (size_t i = 0; i < sizeof(in); ++i)
+        in[i] = (unsigned char)(i * 7 + 3);
+
+    unsigned char expected[(LANES + 1) * 64], out[(LANES + 1) * 64];
+    for (size_t i = 0; i < LANES; ++i)
+        Groestl512(expected + 64 * i, in + 64 * i);
+    for (size_t i = 0; i < LANES; ++i)
+        Groestl(out + 64 * i, in + 64 * i);
+    if (memcmp(out, expected, LANES * 64)) return false;
+    for (size_t i = 0; i < LANES; i += 2)
+        Groestl_2way(out + 64 * i, in + 64 * i);
+    if (memcmp(out, expected, LANES * 64)) return false;
+
+    for (size_t i = 0; i < LANES; ++i)
+        JH512(expected + 64 * i, in + 64 * i);
+    JH_4way(out, in);
+    if (memcmp(out, expected, LANES * 64)) return false;
+
+    for (size_t i = 0; i <= LANES; ++i)
+        QuarkHashWith(Groestl512, expected + 32 * i, in + QUARK_HEADER_SIZE * i, QUARK_HEADER_SIZE);
+    for (size_t i = 0; i <= LANES; ++i)
+        QuarkHash(out + 32 * i, in + QUARK_HEADER_SIZE * i, QUARK_HEADER_SIZE);
+    if (memcmp(out, expected, (LANES + 1) * 32)) return false;
+    for (size_t n = 1; n <= LANES; ++n) {
+        QuarkHash80Lanes(out, in, n);
+        if (memcmp(out, expected, n * 32)) return false;
+    }
+    QuarkHash80(out, in, LANES + 1);
+    if (memcmp(out, expected, (LANES + 1) * 32)) return false;
+    return true;
+}
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__)) && \
+    (defined(ENABLE_AESNI) || defined(ENABLE_AVX2)) && !defined(BUILD_BITCOIN_INTERNAL)
+#define QUARK_DETECT 1
+
+void inline cpuid(uint32_t leaf, uint32_t subleaf, uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d)
+{
+#ifdef __GNUC__
+    __cpuid_count(leaf, subleaf, a, b, c, d);
+#else
+  __asm__ ("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "0"(leaf), "2"(subleaf));
+#endif
+}
+
+#if defined(ENABLE_AVX2)
+/** Check whether the OS has enabled AVX registers. */
+bool AVXEnabled()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
+#endif
+} // namespace
+
+std::string QuarkAutoDetect()
+{
+    std::string ret = "standard";
+#if defined(QUARK_DETECT)
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, 0, eax, ebx, ecx, edx);
+    const bool have_sse4 = (ecx >> 19) & 1;
+
+#if defined(ENABLE_AESNI)
+    const bool have_aesni = (ecx >> 25) & 1;
+    if (have_sse4 && have_aesni) {
+        Groestl = groestl_aesni::Hash512_64;
+        Groestl_2way = groestl_aesni::Hash512_64_2way;
+        ret = "aesni(groestl 1way,2way)";
+    }
+#endif
+
+#if defined(ENABLE_AVX2)
+    const bool have_avx = (ecx >> 28) & 1;
+    const bool enabled_avx = ((ecx >> 27) & 1) && have_avx && AVXEnabled();
+    bool have_avx2 = false;
+    if (have_sse4) {
+        cpuid(7, 0, eax, ebx, ecx, edx);
+        have_avx2 = (ebx >> 5) & 1;
+    }
+    if (have_avx2 && enabled_avx) {
+        JH_4way = jh_avx2::Hash512_64_4way;
+        ret = (ret == "standard" ? "" : ret + ",") + "avx2(jh 4way)";
+    }
+#endif
+#endif
+
+    assert(SelfTest());
+    return ret;
+}
+
+void QuarkHash(unsigned char* output, const unsigned char* input, size_t len)
+{
+    QuarkHashWith(Groestl, output, input, len);
+}
+
+void QuarkHash80(unsigned char* output, const unsigned char* input, size_t blocks)
+{
+    while (blocks >= 2) {
+        const size_t n = blocks < LANES ? blocks : LANES;
+        QuarkHash80Lanes(output, input, n);
+        output += 32 * n;
+        input += QUARK_HEADER_SIZE * n;
+        blocks -= n;
+    }
+    if (blocks)
+        QuarkHash(output, input, QUARK_HEADER_SIZE);
+}
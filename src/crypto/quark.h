@@ -0,0 +1,34 @@
+// Copyright (c) 2020 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_QUARK_H
+#define BITCOIN_CRYPTO_QUARK_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+
+/** Size of the serialized block header preimage hashed by Quark. */
+static const size_t QUARK_HEADER_SIZE = 80;
+
+/** Autodetect the best available Quark implementation.
+ *  Returns the name of the implementation.
+ */
+std::string QuarkAutoDetect();
+
+/** Compute the Quark hash of a byte range.
+ *  output:  pointer to a 32 byte output buffer
+ *  input:   pointer to the data
+ *  len:     size of the data in bytes
+ */
+void QuarkHash(unsigned char* output, const unsigned char* input, size_t len);
+
+/** Compute multiple Quark hashes of 80-byte block headers.
+ *  output:  pointer to a blocks*32 byte output buffer
+ *  input:   pointer to a blocks*80 byte input buffer
+ *  blocks:  the number of hashes to compute.
+ */
+void QuarkHash80(unsigned char* output, const unsigned char* input, size_t blocks);
+
+#endif // BITCOIN_CRYPTO_QUARK_H
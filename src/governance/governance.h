@@ -25,6 +25,7 @@
 #include <validation.h>
 #include <validationinterface.h>
 
+#include <functional>
 #include <regex>
 #include <string>
 #include <utility>
@@ -46,6 +47,25 @@ constexpr char DB_PROPOSAL = 'p';
 constexpr char DB_VOTE = 'v';
 constexpr char DB_SPENT_UTXO = 's';
 
+/**
+ * Raw bytes of a governance db key or value. Used to copy the db into and out of utxo snapshots
+ * without decoding the records.
+ */
+struct CRawDBRecord {
+    std::vector<unsigned char> data;
+
+    template<typename Stream>
+    void Serialize(Stream & s) const {
+        s.write(reinterpret_cast<const char*>(data.data()), data.size());
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream & s) {
+        data.resize(s.size());
+        s.read(reinterpret_cast<char*>(data.data()), data.size());
+    }
+};
+
 class GovernanceDB : public CValidationInterface {
 public:
     explicit GovernanceDB(size_t n_cache_size, bool f_memory, bool f_wipe);
@@ -179,6 +199,90 @@ static bool ValidateVoteUTXO(const COutPoint & utxo, CTransactionRef & tx, CKeyI
     return true;
 }
 
+/**
+ * Vote utxo data resolved by ResolveVoteUTXOs.
+ */
+struct VoteUTXO {
+    CTxOut out;
+    int height{-1}; // block height of the utxo, -1 if it isn't in a main chain block
+    bool unspent{false}; // utxo was found in the coins view
+};
+typedef std::map<COutPoint, VoteUTXO> VoteUTXOMap;
+
+/**
+ * Resolves the specified vote utxos in one pass against the coins view under a
+ * single cs_main lock. Utxos that are no longer in the coins view (spent) are read
+ * from the transaction index, each transaction is read once and the block index
+ * lookups for all of them share a second cs_main lock. Utxos that can't be found
+ * or aren't in the main chain are left unresolved (height -1).
+ * @param outpoints
+ * @param utxos
+ */
+static void ResolveVoteUTXOs(const std::set<COutPoint> & outpoints, VoteUTXOMap & utxos) {
+    std::vector<COutPoint> missing;
+    {
+        LOCK(cs_main);
+        for (const auto & outpoint : outpoints) {
+            Coin coin;
+            if (!pcoinsTip->GetCoin(outpoint, coin)) {
+                missing.push_back(outpoint);
+                continue;
+            }
+            auto & utxo = utxos[outpoint];
+            utxo.out = coin.out;
+            utxo.height = static_cast<int>(coin.nHeight);
+            utxo.unspent = true;
+        }
+    }
+    if (missing.empty())
+        return;
+
+    std::map<uint256, std::pair<CTransactionRef, uint256>> txs; // map<txhash, pair<tx, blockhash>>
+    for (const auto & outpoint : missing) {
+        if (txs.count(outpoint.hash))
+            continue;
+        CTransactionRef tx;
+        uint256 hashBlock;
+        if (GetTransaction(outpoint.hash, tx, Params().GetConsensus(), hashBlock))
+            txs[outpoint.hash] = std::make_pair(tx, hashBlock);
+    }
+
+    LOCK(cs_main);
+    for (const auto & outpoint : missing) {
+        auto & utxo = utxos[outpoint];
+        const auto it = txs.find(outpoint.hash);
+        if (it == txs.end() || outpoint.n >= it->second.first->vout.size())
+            continue;
+        const auto pindex = LookupBlockIndex(it->second.second);
+        if (!pindex || !chainActive.Contains(pindex))
+            continue; // fail on utxo not in main chain
+        utxo.out = it->second.first->vout[outpoint.n];
+        utxo.height = pindex->nHeight;
+    }
+}
+
+/**
+ * Validates a vote utxo resolved by ResolveVoteUTXOs, see ValidateVoteUTXO.
+ * @param utxo
+ * @param keyid Voting utxo public key id
+ * @param blockNumber Voting utxo must be in a block prior to the specified block height
+ * @return
+ */
+static bool ValidateVoteUTXO(const VoteUTXO & utxo, CKeyID & keyid, const int blockNumber) {
+    if (utxo.height < 0                                              // fail on unresolved utxo
+        || utxo.height < Params().GetConsensus().governanceBlock    // fail on utxo prior to governance start
+        || (blockNumber > 0 && utxo.height > blockNumber))           // fail on utxo in the future
+        return false;
+    CTxDestination dest;
+    if (!ExtractDestination(utxo.out.scriptPubKey, dest))
+        return false;
+    const auto id = boost::get<CKeyID>(&dest);
+    if (!id)
+        return false;
+    keyid = *id;
+    return true;
+}
+
 /**
  * Returns the next superblock from the most recent chain tip by default.
  * If fromBlock is specified the superblock immediately after fromBlock
@@ -568,6 +672,21 @@ public:
         return false;
     }
 
+    /**
+     * Initialize the keyid and amount from the vote's utxo resolved by ResolveVoteUTXOs.
+     * @param utxos
+     */
+    bool loadVoteUTXO(const VoteUTXOMap & utxos) {
+        const auto it = utxos.find(utxo);
+        if (it == utxos.end())
+            return loadVoteUTXO();
+        if (ValidateVoteUTXO(it->second, keyid, blockNumber)) {
+            amount = it->second.out.nValue;
+            return true;
+        }
+        return false;
+    }
+
     /**
      * Sign the vote with the specified private key.
      * @param key
@@ -807,6 +926,17 @@ static bool IsVoteSpent(const Vote & vote, const int & currentBlock, const int &
     return false;
 }
 
+/**
+ * Check that a utxo resolved by ResolveVoteUTXOs isn't already spent, see IsVoteSpent.
+ * @param utxo
+ * @param currentBlock If utxo is confirmed after this block number it is marked spent
+ * @param governanceStart Block at which the governance system starts
+ * @return
+ */
+static bool IsVoteSpent(const VoteUTXO & utxo, const int & currentBlock, const int & governanceStart) {
+    return !utxo.unspent || utxo.height < governanceStart || utxo.height > currentBlock;
+}
+
 /**
  * ProposalVote associates a proposal with a specific vote.
  */
@@ -1128,6 +1258,74 @@ public:
         return true;
     }
 
+    /**
+     * Passes every governance db record except the best block locator to the specified
+     * function, used to write utxo snapshots. The governance index must be in sync with
+     * the snapshot base block. Requires the chain lock.
+     * @param pindex Snapshot base block
+     * @param consensus
+     * @param fn
+     * @param failReasonRet
+     * @return
+     */
+    bool snapshotRecords(const CBlockIndex *pindex, const Consensus::Params & consensus,
+                         const std::function<void(const std::vector<unsigned char> & key,
+                                                  const std::vector<unsigned char> & value)> & fn,
+                         std::string & failReasonRet)
+    {
+        if (pindex->nHeight >= consensus.governanceBlock && db->BestBlockIndex() != pindex) {
+            failReasonRet = "governance data is not in sync with the chain tip";
+            return false;
+        }
+        LOCK(mu);
+        std::unique_ptr<CDBIterator> pcursor(db->GetDB().NewIterator());
+        for (pcursor->SeekToFirst(); pcursor->Valid(); pcursor->Next()) {
+            CRawDBRecord key, value;
+            if (!pcursor->GetKey(key) || !pcursor->GetValue(value)) {
+                failReasonRet = "failed to read governance db record";
+                return false;
+            }
+            if (key.data.size() == 1 && key.data[0] == DB_BEST_BLOCK)
+                continue;
+            fn(key.data, value.data);
+        }
+        return true;
+    }
+
+    /**
+     * Writes governance db records read from a utxo snapshot. The governance state must
+     * have been reset first, loadSnapshot() makes the records available once they are all
+     * written.
+     * @param records
+     * @return
+     */
+    bool writeSnapshotRecords(const std::vector<std::pair<std::vector<unsigned char>, std::vector<unsigned char>>> & records) {
+        CDBBatch batch(db->GetDB());
+        for (const auto & record : records)
+            batch.Write(CRawDBRecord{record.first}, CRawDBRecord{record.second});
+        return db->GetDB().WriteBatch(batch);
+    }
+
+    /**
+     * Loads the governance data written by writeSnapshotRecords(). The chain tip must be the
+     * snapshot base block. Requires the chain lock.
+     * @param chain
+     * @param chainMutex
+     * @param consensus
+     * @param failReasonRet
+     * @return
+     */
+    bool loadSnapshot(const CChain & chain, CCriticalSection & chainMutex, const Consensus::Params & consensus,
+                      std::string & failReasonRet)
+    {
+        AssertLockHeld(chainMutex);
+        if (chain.Height() >= consensus.governanceBlock && !db->WriteBestBlock(chain.Tip(), chain, chainMutex)) {
+            failReasonRet = "failed to write the governance best block";
+            return false;
+        }
+        return loadGovernanceData(chain, chainMutex, consensus, failReasonRet);
+    }
+
     /**
      * Loads the governance data from the blockchain ledger. It's possible to optimize
      * this further by creating a separate leveldb for goverance data. Currently, this
@@ -1757,7 +1955,9 @@ public:
         }
         // Insert votes after proposals in case votes depend on proposals in
         // the same block.
-        for (auto vote : vs) {
+        std::vector<Vote> candidates;
+        std::set<COutPoint> outpoints;
+        for (const auto & vote : vs) {
             // If we are processing the chain tip we want to perform a proposal
             // check here. Check that the vote is associated with a valid proposal.
             if (processingChainTip) {
@@ -1774,11 +1974,20 @@ public:
                         continue;
                 }
             }
+            candidates.push_back(vote);
+            outpoints.insert(vote.getUtxo());
+        }
 
+        // Resolve all the vote utxos at once instead of locking cs_main
+        // and reading the tx from disk for each vote.
+        VoteUTXOMap utxos;
+        ResolveVoteUTXOs(outpoints, utxos);
+
+        for (auto & vote : candidates) {
             const auto voteHash = vote.getHash();
 
-            // Load the vote utxo (performs cs_main lock)
-            if (!vote.loadVoteUTXO())
+            // Load the vote utxo
+            if (!vote.loadVoteUTXO(utxos))
                 continue;
             const auto vhash = vh.find(voteHash);
             if (vhash == vh.end() || !vote.isValid(vhash->second, params))
@@ -1803,7 +2012,7 @@ public:
             // we're currently processing the chain tip.
             bool spent{false};
             if (processingChainTip)
-                spent = IsVoteSpent(vote, blockHeight, params.governanceBlock, false); // check that utxo is unspent
+                spent = IsVoteSpent(utxos[vote.getUtxo()], blockHeight, params.governanceBlock); // check that utxo is unspent
             if (spent)
                 continue;
             if (vsRet.count(vote))
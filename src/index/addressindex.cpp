@@ -0,0 +1,307 @@
+// Copyright (c) 2020 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/addressindex.h>
+
+#include <chainparams.h>
+#include <crypto/sha256.h>
+#include <dbwrapper.h>
+#include <undo.h>
+#include <util/system.h>
+#include <validation.h>
+
+/* The index database stores two kinds of records per script hash:
+ *
+ * - History records keyed by [DB_ADDRESS_HISTORY, script hash, height (BE), txid, index (BE),
+ *   spending] with the signed amount as value. Big-endian heights keep a script's history ordered
+ *   by height so that range queries are a single forward iteration.
+ * - Unspent records keyed by [DB_ADDRESS_UNSPENT, script hash, txid, index (BE)] with the amount,
+ *   script and height of the output as value.
+ */
+constexpr char DB_ADDRESS_HISTORY = 'a';
+constexpr char DB_ADDRESS_UNSPENT = 'u';
+
+std::unique_ptr<AddressIndex> g_addressindex;
+
+uint256 AddressIndexScriptHash(const CScript& script)
+{
+    uint256 hash;
+    CSHA256().Write(script.data(), script.size()).Finalize(hash.begin());
+    return hash;
+}
+
+namespace {
+
+struct DBHistoryKey {
+    uint256 script_hash;
+    int height;
+    uint256 txhash;
+    uint32_t index;
+    bool spending;
+
+    DBHistoryKey() : height(0), index(0), spending(false) {}
+    DBHistoryKey(const uint256& script_hash_in, int height_in, const uint256& txhash_in,
+                 uint32_t index_in, bool spending_in)
+        : script_hash(script_hash_in), height(height_in), txhash(txhash_in), index(index_in),
+          spending(spending_in) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_ADDRESS_HISTORY);
+        s << script_hash;
+        ser_writedata32be(s, height);
+        s << txhash;
+        ser_writedata32be(s, index);
+        ser_writedata8(s, spending);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        char prefix = ser_readdata8(s);
+        if (prefix != DB_ADDRESS_HISTORY) {
+            throw std::ios_base::failure("Invalid format for address index DB history key");
+        }
+        s >> script_hash;
+        height = ser_readdata32be(s);
+        s >> txhash;
+        index = ser_readdata32be(s);
+        spending = ser_readdata8(s) != 0;
+    }
+};
+
+struct DBUnspentKey {
+    uint256 script_hash;
+    uint256 txhash;
+    uint32_t index;
+
+    DBUnspentKey() : index(0) {}
+    DBUnspentKey(const uint256& script_hash_in, const COutPoint& outpoint)
+        : script_hash(script_hash_in), txhash(outpoint.hash), index(outpoint.n) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_ADDRESS_UNSPENT);
+        s << script_hash;
+        s << txhash;
+        ser_writedata32be(s, index);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        char prefix = ser_readdata8(s);
+        if (prefix != DB_ADDRESS_UNSPENT) {
+            throw std::ios_base::failure("Invalid format for address index DB unspent key");
+        }
+        s >> script_hash;
+        s >> txhash;
+        index = ser_readdata32be(s);
+    }
+};
+
+struct DBUnspentValue {
+    CAmount amount;
+    CScript script;
+    int height;
+
+    DBUnspentValue() : amount(0), height(0) {}
+    DBUnspentValue(CAmount amount_in, const CScript& script_in, int height_in)
+        : amount(amount_in), script(script_in), height(height_in) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(amount);
+        READWRITE(script);
+        READWRITE(height);
+    }
+};
+
+/** Outputs that can never be spent carry no balance and are left out of the index. */
+bool IsIndexed(const CTxOut& out)
+{
+    return !out.scriptPubKey.empty() && !out.scriptPubKey.IsUnspendable();
+}
+
+} // namespace
+
+AddressIndex::AddressIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<BaseIndex::DB>(GetDataDir() / "indexes" / "addressindex", n_cache_size, f_memory, f_wipe))
+{}
+
+bool AddressIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    // The genesis outputs are not spendable
+    if (pindex->nHeight == 0) return true;
+
+    // A block that does not extend the current best block is the first block of a reorg (or of a
+    // sync that resumed past a fork), roll the stale blocks back first.
+    const CBlockIndex* best_block_index = m_best_block_index.load();
+    if (best_block_index && best_block_index != pindex->pprev &&
+        !Rewind(best_block_index, pindex->pprev)) {
+        return false;
+    }
+
+    CBlockUndo block_undo;
+    if (!UndoReadFromDisk(block_undo, pindex)) {
+        return error("%s: Failed to read undo data for block %s", __func__, pindex->GetBlockHash().ToString());
+    }
+
+    // Records are written in block order so that an output created and spent in the same block
+    // ends up spent.
+    CDBBatch batch(*m_db);
+    for (size_t i = 0; i < block.vtx.size(); ++i) {
+        const CTransaction& tx = *block.vtx[i];
+        const uint256& txhash = tx.GetHash();
+
+        if (!tx.IsCoinBase()) {
+            const CTxUndo& tx_undo = block_undo.vtxundo[i - 1];
+            for (size_t k = 0; k < tx.vin.size(); ++k) {
+                const CTxOut& prev = tx_undo.vprevout[k].out;
+                if (!IsIndexed(prev)) continue;
+                const uint256 script_hash = AddressIndexScriptHash(prev.scriptPubKey);
+                batch.Write(DBHistoryKey(script_hash, pindex->nHeight, txhash, k, true), -prev.nValue);
+                batch.Erase(DBUnspentKey(script_hash, tx.vin[k].prevout));
+            }
+        }
+
+        for (size_t j = 0; j < tx.vout.size(); ++j) {
+            const CTxOut& out = tx.vout[j];
+            if (!IsIndexed(out)) continue;
+            const uint256 script_hash = AddressIndexScriptHash(out.scriptPubKey);
+            batch.Write(DBHistoryKey(script_hash, pindex->nHeight, txhash, j, false), out.nValue);
+            batch.Write(DBUnspentKey(script_hash, COutPoint(txhash, j)),
+                        DBUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight));
+        }
+    }
+    return m_db->WriteBatch(batch);
+}
+
+bool AddressIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    if (current_tip->GetAncestor(new_tip->nHeight) != new_tip) {
+        return error("%s: block %s is not an ancestor of the %s tip %s", __func__,
+                     new_tip->GetBlockHash().ToString(), GetName(), current_tip->GetBlockHash().ToString());
+    }
+
+    // Undo the blocks from the tip down, and each block in reverse transaction order, which is the
+    // exact inverse of WriteBlock.
+    CDBBatch batch(*m_db);
+    for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+            return error("%s: Failed to read block %s from disk", __func__, pindex->GetBlockHash().ToString());
+        }
+        CBlockUndo block_undo;
+        if (!UndoReadFromDisk(block_undo, pindex)) {
+            return error("%s: Failed to read undo data for block %s", __func__, pindex->GetBlockHash().ToString());
+        }
+
+        for (size_t i = block.vtx.size(); i-- > 0;) {
+            const CTransaction& tx = *block.vtx[i];
+            const uint256& txhash = tx.GetHash();
+
+            for (size_t j = 0; j < tx.vout.size(); ++j) {
+                const CTxOut& out = tx.vout[j];
+                if (!IsIndexed(out)) continue;
+                const uint256 script_hash = AddressIndexScriptHash(out.scriptPubKey);
+                batch.Erase(DBHistoryKey(script_hash, pindex->nHeight, txhash, j, false));
+                batch.Erase(DBUnspentKey(script_hash, COutPoint(txhash, j)));
+            }
+
+            if (tx.IsCoinBase()) continue;
+            const CTxUndo& tx_undo = block_undo.vtxundo[i - 1];
+            for (size_t k = 0; k < tx.vin.size(); ++k) {
+                const Coin& coin = tx_undo.vprevout[k];
+                if (!IsIndexed(coin.out)) continue;
+                const uint256 script_hash = AddressIndexScriptHash(coin.out.scriptPubKey);
+                batch.Erase(DBHistoryKey(script_hash, pindex->nHeight, txhash, k, true));
+                batch.Write(DBUnspentKey(script_hash, tx.vin[k].prevout),
+                            DBUnspentValue(coin.out.nValue, coin.out.scriptPubKey, coin.nHeight));
+            }
+        }
+    }
+
+    if (!m_db->WriteBatch(batch)) return false;
+
+    m_best_block_index = new_tip;
+    return true;
+}
+
+bool AddressIndex::GetBalance(const uint256& script_hash, CAmount& balance, CAmount& received) const
+{
+    balance = 0;
+    received = 0;
+
+    std::vector<CAddressUnspentEntry> unspent;
+    if (!GetUnspent(script_hash, unspent)) return false;
+    for (const auto& entry : unspent) balance += entry.amount;
+
+    std::vector<CAddressIndexEntry> history;
+    if (!GetHistory(script_hash, history)) return false;
+    for (const auto& entry : history) {
+        if (entry.amount > 0) received += entry.amount;
+    }
+    return true;
+}
+
+bool AddressIndex::GetUnspent(const uint256& script_hash, std::vector<CAddressUnspentEntry>& entries) const
+{
+    entries.clear();
+
+    std::unique_ptr<CDBIterator> db_it(m_db->NewIterator());
+    db_it->Seek(DBUnspentKey(script_hash, COutPoint(uint256(), 0)));
+    for (; db_it->Valid(); db_it->Next()) {
+        DBUnspentKey key;
+        if (!db_it->GetKey(key) || key.script_hash != script_hash) break;
+
+        DBUnspentValue value;
+        if (!db_it->GetValue(value)) {
+            return error("%s: unable to read value in %s at key (%s, %s:%u)", __func__, GetName(),
+                         script_hash.ToString(), key.txhash.ToString(), key.index);
+        }
+
+        CAddressUnspentEntry entry;
+        entry.outpoint = COutPoint(key.txhash, key.index);
+        entry.amount = value.amount;
+        entry.script = std::move(value.script);
+        entry.height = value.height;
+        entries.push_back(std::move(entry));
+    }
+    return true;
+}
+
+bool AddressIndex::GetHistory(const uint256& script_hash, std::vector<CAddressIndexEntry>& entries,
+                              int start, int end) const
+{
+    entries.clear();
+    if (start < 0) start = 0;
+
+    std::unique_ptr<CDBIterator> db_it(m_db->NewIterator());
+    db_it->Seek(DBHistoryKey(script_hash, start, uint256(), 0, false));
+    for (; db_it->Valid(); db_it->Next()) {
+        DBHistoryKey key;
+        if (!db_it->GetKey(key) || key.script_hash != script_hash) break;
+        if (end >= 0 && key.height > end) break;
+
+        CAmount amount;
+        if (!db_it->GetValue(amount)) {
+            return error("%s: unable to read value in %s at key (%s, %d, %s)", __func__, GetName(),
+                         script_hash.ToString(), key.height, key.txhash.ToString());
+        }
+
+        CAddressIndexEntry entry;
+        entry.txhash = key.txhash;
+        entry.height = key.height;
+        entry.index = key.index;
+        entry.spending = key.spending;
+        entry.amount = amount;
+        entries.push_back(std::move(entry));
+    }
+    return true;
+}
@@ -0,0 +1,83 @@
+// Copyright (c) 2020 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_ADDRESSINDEX_H
+#define BITCOIN_INDEX_ADDRESSINDEX_H
+
+#include <amount.h>
+#include <chain.h>
+#include <index/base.h>
+#include <primitives/transaction.h>
+#include <script/script.h>
+#include <uint256.h>
+
+/** Default for -addressindex */
+static const bool DEFAULT_ADDRESSINDEX = false;
+
+/** Returns the key the address and spent indexes file outputs under, the SHA256 of the script. */
+uint256 AddressIndexScriptHash(const CScript& script);
+
+/** A credit (output) or debit (spent input) of a script in the active chain. */
+struct CAddressIndexEntry {
+    uint256 txhash;
+    int height{0};
+    /// Output index for credits, input index for debits
+    uint32_t index{0};
+    bool spending{false};
+    /// Positive for credits, negative for debits
+    CAmount amount{0};
+};
+
+/** An unspent output of a script in the active chain. */
+struct CAddressUnspentEntry {
+    COutPoint outpoint;
+    CAmount amount{0};
+    CScript script;
+    int height{0};
+};
+
+/**
+ * AddressIndex records every output and every spend of the active chain by the hash of the
+ * output script, together with the current set of unspent outputs of each script. This allows
+ * balance, utxo and history queries for arbitrary addresses without a wallet.
+ *
+ * Spends are resolved from the block undo data, so disconnected blocks are rolled back by
+ * replaying their undo data in reverse when the next block that does not extend the index tip is
+ * written.
+ */
+class AddressIndex final : public BaseIndex
+{
+private:
+    const std::unique_ptr<BaseIndex::DB> m_db;
+
+    /// Remove the records of the blocks above the fork point and restore the outputs they spent.
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip);
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    BaseIndex::DB& GetDB() const override { return *m_db; }
+
+    const char* GetName() const override { return "addressindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit AddressIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    /// Sum of the unspent outputs (balance) and of all outputs ever received by a script.
+    bool GetBalance(const uint256& script_hash, CAmount& balance, CAmount& received) const;
+
+    /// All unspent outputs of a script, ordered by outpoint.
+    bool GetUnspent(const uint256& script_hash, std::vector<CAddressUnspentEntry>& entries) const;
+
+    /// Credits and debits of a script between two heights (inclusive), ordered by height.
+    /// An end height of -1 selects everything from start onwards.
+    bool GetHistory(const uint256& script_hash, std::vector<CAddressIndexEntry>& entries,
+                    int start = 0, int end = -1) const;
+};
+
+/// The global address index, used in the getaddress* RPCs. May be null.
+extern std::unique_ptr<AddressIndex> g_addressindex;
+
+#endif // BITCOIN_INDEX_ADDRESSINDEX_H
@@ -233,6 +233,7 @@ bool BaseIndex::BlockUntilSyncedToCurrentChain()
     }
 
     LogPrintf("%s: %s is catching up on block notifications\n", __func__, GetName());
+    SyncWithValidationInterfaceQueue();
     return true;
 }
 
@@ -245,6 +246,7 @@ void BaseIndex::Start()
 {
     // Need to register this ValidationInterface before running Init(), so that
     // callbacks are not missed if Init sets m_synced to true.
+    RegisterValidationInterface(this, GetName());
     if (!Init()) {
         FatalError("%s: %s failed to initialize", __func__, GetName());
         return;
@@ -256,6 +258,8 @@ void BaseIndex::Start()
 
 void BaseIndex::Stop()
 {
+    UnregisterValidationInterface(this);
+
     if (m_thread_sync.joinable()) {
         m_thread_sync.join();
     }
@@ -0,0 +1,105 @@
+// Copyright (c) 2020 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/spentindex.h>
+
+#include <chainparams.h>
+#include <dbwrapper.h>
+#include <index/addressindex.h>
+#include <undo.h>
+#include <util/system.h>
+#include <validation.h>
+
+/* Keys have the type [DB_SPENT, txid, index (BE)] and map to a CSpentIndexValue. */
+constexpr char DB_SPENT = 'p';
+
+std::unique_ptr<SpentIndex> g_spentindex;
+
+namespace {
+
+struct DBSpentKey {
+    uint256 txhash;
+    uint32_t index;
+
+    explicit DBSpentKey(const COutPoint& outpoint) : txhash(outpoint.hash), index(outpoint.n) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_SPENT);
+        s << txhash;
+        ser_writedata32be(s, index);
+    }
+};
+
+} // namespace
+
+SpentIndex::SpentIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<BaseIndex::DB>(GetDataDir() / "indexes" / "spentindex", n_cache_size, f_memory, f_wipe))
+{}
+
+bool SpentIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    if (pindex->nHeight == 0) return true;
+
+    const CBlockIndex* best_block_index = m_best_block_index.load();
+    if (best_block_index && best_block_index != pindex->pprev &&
+        !Rewind(best_block_index, pindex->pprev)) {
+        return false;
+    }
+
+    CBlockUndo block_undo;
+    if (!UndoReadFromDisk(block_undo, pindex)) {
+        return error("%s: Failed to read undo data for block %s", __func__, pindex->GetBlockHash().ToString());
+    }
+
+    CDBBatch batch(*m_db);
+    for (size_t i = 1; i < block.vtx.size(); ++i) {
+        const CTransaction& tx = *block.vtx[i];
+        const CTxUndo& tx_undo = block_undo.vtxundo[i - 1];
+        for (size_t k = 0; k < tx.vin.size(); ++k) {
+            const CTxOut& prev = tx_undo.vprevout[k].out;
+            CSpentIndexValue value;
+            value.txid = tx.GetHash();
+            value.input_index = k;
+            value.height = pindex->nHeight;
+            value.amount = prev.nValue;
+            value.script_hash = AddressIndexScriptHash(prev.scriptPubKey);
+            batch.Write(DBSpentKey(tx.vin[k].prevout), value);
+        }
+    }
+    return m_db->WriteBatch(batch);
+}
+
+bool SpentIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    if (current_tip->GetAncestor(new_tip->nHeight) != new_tip) {
+        return error("%s: block %s is not an ancestor of the %s tip %s", __func__,
+                     new_tip->GetBlockHash().ToString(), GetName(), current_tip->GetBlockHash().ToString());
+    }
+
+    // Spends are keyed by the outpoint only, the undo data is not needed to find them.
+    CDBBatch batch(*m_db);
+    for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+            return error("%s: Failed to read block %s from disk", __func__, pindex->GetBlockHash().ToString());
+        }
+        for (size_t i = 1; i < block.vtx.size(); ++i) {
+            for (const CTxIn& txin : block.vtx[i]->vin) {
+                batch.Erase(DBSpentKey(txin.prevout));
+            }
+        }
+    }
+
+    if (!m_db->WriteBatch(batch)) return false;
+
+    m_best_block_index = new_tip;
+    return true;
+}
+
+bool SpentIndex::GetSpentInfo(const COutPoint& outpoint, CSpentIndexValue& value) const
+{
+    return m_db->Read(DBSpentKey(outpoint), value);
+}
@@ -0,0 +1,71 @@
+// Copyright (c) 2020 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_SPENTINDEX_H
+#define BITCOIN_INDEX_SPENTINDEX_H
+
+#include <amount.h>
+#include <chain.h>
+#include <index/base.h>
+#include <primitives/transaction.h>
+#include <serialize.h>
+#include <uint256.h>
+
+/** Default for -spentindex */
+static const bool DEFAULT_SPENTINDEX = false;
+
+/** Where and how an output was spent in the active chain. */
+struct CSpentIndexValue {
+    /// The spending transaction and its input index
+    uint256 txid;
+    uint32_t input_index{0};
+    int height{0};
+    /// Value and script hash (see AddressIndexScriptHash) of the spent output
+    CAmount amount{0};
+    uint256 script_hash;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(txid);
+        READWRITE(input_index);
+        READWRITE(height);
+        READWRITE(amount);
+        READWRITE(script_hash);
+    }
+};
+
+/**
+ * SpentIndex maps every outpoint spent in the active chain to the input spending it. Like the
+ * address index it reads the spent outputs from the block undo data and rolls disconnected blocks
+ * back when the next block that does not extend the index tip is written.
+ */
+class SpentIndex final : public BaseIndex
+{
+private:
+    const std::unique_ptr<BaseIndex::DB> m_db;
+
+    /// Remove the spends recorded by the blocks above the fork point.
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip);
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    BaseIndex::DB& GetDB() const override { return *m_db; }
+
+    const char* GetName() const override { return "spentindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit SpentIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    /// Look up the spend of an outpoint. Returns false if the outpoint is unspent or unknown.
+    bool GetSpentInfo(const COutPoint& outpoint, CSpentIndexValue& value) const;
+};
+
+/// The global spent index, used in the getspentinfo RPC. May be null.
+extern std::unique_ptr<SpentIndex> g_spentindex;
+
+#endif // BITCOIN_INDEX_SPENTINDEX_H
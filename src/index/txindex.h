@@ -94,6 +94,14 @@ public:
         return m_best_block_index;
     }
 
+    /// Move the index to the base block of a loaded utxo snapshot. The blocks below it are not
+    /// available, so transactions confirmed before the snapshot base can not be looked up.
+    void SnapshotBlockConnected(const CBlockIndex* pindex) {
+        WriteBestBlock(pindex);
+        m_best_block_index = pindex;
+        m_synced = true;
+    }
+
 private:
     void writeBestBlock(const int height);
 };
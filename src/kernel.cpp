@@ -9,6 +9,8 @@
 #include <util/system.h>
 #include <validation.h>
 
+#include <deque>
+
 #include <boost/assign/list_of.hpp>
 #include <boost/foreach.hpp>
 #include <boost/lexical_cast.hpp>
@@ -51,66 +53,121 @@ int64_t GetStakeModifierSelectionInterval() {
     return nSelectionInterval;
 }
 
+namespace {
+
+// Sort candidate blocks by timestamp. Need to handle a side effect in the staking
+// protocol, where selection of modifier breaks a tie based on hash instead of block
+// number.
+struct CandidateTimestampComparator {
+    bool operator()(const CBlockIndex* a, const CBlockIndex* b) const {
+        if (a->GetBlockTime() == b->GetBlockTime())
+            return UintToArith256(a->GetBlockHash()) < UintToArith256(b->GetBlockHash());
+        return a->GetBlockTime() < b->GetBlockTime();
+    }
+};
+
+// Candidate blocks of the last stake modifier computation. Consecutive headers share
+// most of their selection interval, the next computation only adds the blocks on top
+// of the window and drops the blocks that left the interval instead of walking back
+// over the whole interval and sorting the candidates again.
+struct StakeModifierCandidates {
+    // Candidates by height, the last one is the block the window was built for
+    std::deque<const CBlockIndex*> vByHeight;
+    // The same candidates sorted by CandidateTimestampComparator
+    std::vector<const CBlockIndex*> vSortedByTimestamp;
+};
+
+Mutex csStakeModifierCandidates;
+StakeModifierCandidates stakeModifierCandidates GUARDED_BY(csStakeModifierCandidates);
+
+} // namespace
+
+void ResetStakeModifierCandidates() {
+    LOCK(csStakeModifierCandidates);
+    stakeModifierCandidates.vByHeight.clear();
+    stakeModifierCandidates.vSortedByTimestamp.clear();
+}
+
+// Move the candidate window to the blocks from pindexPrev back to the first block
+// (walking back) that is older than nSelectionIntervalStart.
+static void UpdateStakeModifierCandidates(StakeModifierCandidates& candidates, const CBlockIndex* pindexPrev,
+        const int64_t nSelectionIntervalStart)
+{
+    auto & vByHeight = candidates.vByHeight;
+    auto & vSorted = candidates.vSortedByTimestamp;
+    const CBlockIndex* pindexWindow = vByHeight.empty() ? nullptr : vByHeight.back();
+
+    // Blocks on top of the window
+    std::vector<const CBlockIndex*> vAdded;
+    const CBlockIndex* pindex = pindexPrev;
+    while (pindex && pindex->GetBlockTime() >= nSelectionIntervalStart
+                  && (!pindexWindow || pindex->nHeight > pindexWindow->nHeight)) {
+        vAdded.push_back(pindex);
+        pindex = pindex->pprev;
+    }
+    // All blocks that join the window
+    std::vector<const CBlockIndex*> vNew;
+
+    if (!pindex || pindex->GetBlockTime() < nSelectionIntervalStart || pindex != pindexWindow) {
+        // The interval ends above the window or pindexPrev is on another branch, start over
+        vByHeight.clear();
+        vSorted.clear();
+        while (pindex && pindex->GetBlockTime() >= nSelectionIntervalStart) {
+            vAdded.push_back(pindex);
+            pindex = pindex->pprev;
+        }
+    } else {
+        // Drop the candidates below the first block (walking back) that is older than the interval
+        auto it = std::find_if(vByHeight.rbegin(), vByHeight.rend(), [nSelectionIntervalStart](const CBlockIndex* p) {
+            return p->GetBlockTime() < nSelectionIntervalStart;
+        });
+        if (it != vByHeight.rend()) {
+            const int nHeightFirst = (*it)->nHeight + 1;
+            vByHeight.erase(vByHeight.begin(), it.base());
+            vSorted.erase(std::remove_if(vSorted.begin(), vSorted.end(), [nHeightFirst](const CBlockIndex* p) {
+                return p->nHeight < nHeightFirst;
+            }), vSorted.end());
+        } else {
+            // The interval starts below the window
+            for (pindex = vByHeight.front()->pprev; pindex && pindex->GetBlockTime() >= nSelectionIntervalStart; pindex = pindex->pprev) {
+                vByHeight.push_front(pindex);
+                vNew.push_back(pindex);
+            }
+        }
+    }
+
+    // vAdded is ordered by descending height
+    vByHeight.insert(vByHeight.end(), vAdded.rbegin(), vAdded.rend());
+    vNew.insert(vNew.end(), vAdded.begin(), vAdded.end());
+    std::sort(vNew.begin(), vNew.end(), CandidateTimestampComparator());
+    const auto nSorted = vSorted.size();
+    vSorted.insert(vSorted.end(), vNew.begin(), vNew.end());
+    std::inplace_merge(vSorted.begin(), vSorted.begin() + nSorted, vSorted.end(), CandidateTimestampComparator());
+}
+
 // select a block from the candidate blocks in vSortedByTimestamp, excluding
-// already selected blocks in vSelectedBlocks, and with timestamp up to
-// nSelectionIntervalStop.
-static bool SelectBlockFromCandidates( vector<pair<int64_t, uint256> >& vSortedByTimestamp, map<uint256,
-        const CBlockIndex*>& mapSelectedBlocks, int64_t nSelectionIntervalStop, uint64_t nStakeModifierPrev,
-        const CBlockIndex** pindexSelected)
+// already selected blocks in vSelected, and with timestamp up to
+// nSelectionIntervalStop. The selection hashes of the candidates only depend
+// on the previous stake modifier and are computed once for all rounds.
+static bool SelectBlockFromCandidates(const vector<const CBlockIndex*>& vSortedByTimestamp,
+        const vector<arith_uint256>& vSelectionHash, const vector<bool>& vSelected, int64_t nSelectionIntervalStop,
+        size_t& nSelected)
 {
-    bool fModifierV2 = false;
-    bool fModifierV3 = false;
-    bool fFirstRun = true;
     bool fSelected = false;
     arith_uint256 hashBest = 0;
-    *pindexSelected = (const CBlockIndex*)0;
-    BOOST_FOREACH (const auto & item, vSortedByTimestamp) {
-        const CBlockIndex* pindex = nullptr;
-        {
-            LOCK(cs_main);
-            pindex = LookupBlockIndex(item.second);
-        }
-        if (!pindex)
-            return error("SelectBlockFromCandidates: failed to find block index for candidate block %s", item.second.ToString().c_str());
-        if (fSelected && pindex->GetBlockTime() > nSelectionIntervalStop)
+    for (size_t i = 0; i < vSortedByTimestamp.size(); ++i) {
+        if (fSelected && vSortedByTimestamp[i]->GetBlockTime() > nSelectionIntervalStop)
             break;
-
-        //if the lowest block height (vSortedByTimestamp[0]) is >= switch height, use new modifier calc
-        if (fFirstRun) {
-            fModifierV2 = pindex->nHeight >= Params().GetConsensus().stakingModiferV2Block;
-            fModifierV3 = IsProtocolV05(pindex->GetBlockTime());
-            fFirstRun = false;
-        }
-
-        if (mapSelectedBlocks.count(pindex->GetBlockHash()) > 0)
+        if (vSelected[i])
             continue;
 
-        // compute the selection hash by hashing an input that is unique to that block
-        uint256 hashProof;
-        if (fModifierV3)
-            hashProof = pindex->hashProofOfStake;
-        else if (fModifierV2)
-            hashProof = pindex->GetBlockHash();
-        else
-            hashProof = IsProofOfStake(pindex->nHeight) ? ArithToUint256(0) : pindex->GetBlockHash();
-
-        CDataStream ss(SER_GETHASH, 0);
-        ss << hashProof << nStakeModifierPrev;
-        arith_uint256 hashSelection = UintToArith256(Hash(ss.begin(), ss.end()));
-
-        // the selection hash is divided by 2**32 so that proof-of-stake block
-        // is always favored over proof-of-work block. this is to preserve
-        // the energy efficiency property
-        if (IsProofOfStake(pindex->nHeight))
-            hashSelection >>= 32;
-
-        if (fSelected && hashSelection < hashBest) {
-            hashBest = hashSelection;
-            *pindexSelected = (const CBlockIndex*)pindex;
+        if (fSelected && vSelectionHash[i] < hashBest) {
+            hashBest = vSelectionHash[i];
+            nSelected = i;
         } else if (!fSelected) {
             fSelected = true;
-            hashBest = hashSelection;
-            *pindexSelected = (const CBlockIndex*)pindex;
+            hashBest = vSelectionHash[i];
+            nSelected = i;
         }
     }
     if (gArgs.GetBoolArg("-printstakemodifier", false))
@@ -161,41 +218,54 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeMod
     if (nModifierTime / getInterval() >= pindexPrev->GetBlockTime() / getInterval())
         return true;
 
-    // Sort candidate blocks by timestamp
-    vector<pair<int64_t, uint256> > vSortedByTimestamp;
-    vSortedByTimestamp.reserve(64 * getInterval() / consensus.nPowTargetSpacing);
     int64_t nSelectionInterval = GetStakeModifierSelectionInterval();
     int64_t nSelectionIntervalStart = (pindexPrev->GetBlockTime() / getInterval()) * getInterval() - nSelectionInterval;
-    const CBlockIndex* pindex = pindexPrev;
 
-    while (pindex && pindex->GetBlockTime() >= nSelectionIntervalStart) {
-        vSortedByTimestamp.push_back(make_pair(pindex->GetBlockTime(), pindex->GetBlockHash()));
-        pindex = pindex->pprev;
-    }
+    LOCK(csStakeModifierCandidates);
+    UpdateStakeModifierCandidates(stakeModifierCandidates, pindexPrev, nSelectionIntervalStart);
+    const auto & vSortedByTimestamp = stakeModifierCandidates.vSortedByTimestamp;
+    const int nHeightFirstCandidate = stakeModifierCandidates.vByHeight.front()->nHeight;
+
+    // compute the selection hash of each candidate by hashing an input that is unique
+    // to that block, the lowest candidate by timestamp decides the modifier version
+    const bool fModifierV2 = vSortedByTimestamp.front()->nHeight >= Params().GetConsensus().stakingModiferV2Block;
+    const bool fModifierV3 = IsProtocolV05(vSortedByTimestamp.front()->GetBlockTime());
+    vector<arith_uint256> vSelectionHash;
+    vSelectionHash.reserve(vSortedByTimestamp.size());
+    for (const CBlockIndex* pindex : vSortedByTimestamp) {
+        uint256 hashProof;
+        if (fModifierV3)
+            hashProof = pindex->hashProofOfStake;
+        else if (fModifierV2)
+            hashProof = pindex->GetBlockHash();
+        else
+            hashProof = IsProofOfStake(pindex->nHeight) ? ArithToUint256(0) : pindex->GetBlockHash();
 
-    int nHeightFirstCandidate = pindex ? (pindex->nHeight + 1) : 0;
-    reverse(vSortedByTimestamp.begin(), vSortedByTimestamp.end());
-    // Need to handle a side effect in the staking protocol, where selection of modifier
-    // breaks a tie based on hash instead of block number, see comparator below checking
-    // for this case.
-    sort(vSortedByTimestamp.begin(), vSortedByTimestamp.end(),
-            [](const pair<int64_t, uint256> & a, const pair<int64_t, uint256> & b) -> bool {
-                if (a.first == b.first)
-                    return UintToArith256(a.second) < UintToArith256(b.second);
-                return a.first < b.first;
-            });
+        CDataStream ss(SER_GETHASH, 0);
+        ss << hashProof << nStakeModifier;
+        arith_uint256 hashSelection = UintToArith256(Hash(ss.begin(), ss.end()));
+
+        // the selection hash is divided by 2**32 so that proof-of-stake block
+        // is always favored over proof-of-work block. this is to preserve
+        // the energy efficiency property
+        if (IsProofOfStake(pindex->nHeight))
+            hashSelection >>= 32;
+        vSelectionHash.push_back(hashSelection);
+    }
 
     // Select 64 blocks from candidate blocks to generate stake modifier
     uint64_t nStakeModifierNew = 0;
     int64_t nSelectionIntervalStop = nSelectionIntervalStart;
-    map<uint256, const CBlockIndex*> mapSelectedBlocks;
+    vector<bool> vSelected(vSortedByTimestamp.size(), false);
     for (int nRound = 0; nRound < min(64, (int)vSortedByTimestamp.size()); nRound++) {
         // add an interval section to the current selection round
         nSelectionIntervalStop += GetStakeModifierSelectionIntervalSection(nRound);
 
         // select a block from the candidates of current round
-        if (!SelectBlockFromCandidates(vSortedByTimestamp, mapSelectedBlocks, nSelectionIntervalStop, nStakeModifier, &pindex))
+        size_t nSelected = 0;
+        if (!SelectBlockFromCandidates(vSortedByTimestamp, vSelectionHash, vSelected, nSelectionIntervalStop, nSelected))
             return error("ComputeNextStakeModifier: unable to select block at round %d", nRound);
+        const CBlockIndex* pindex = vSortedByTimestamp[nSelected];
 
         // write the entropy bit of the selected block
         const auto ebit = pindex->GetStakeEntropyBit();
@@ -205,7 +275,7 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeMod
             nStakeModifierNew &= ~(1ULL << nRound);
 
         // add the selected block from candidates to selected list
-        mapSelectedBlocks.insert(make_pair(pindex->GetBlockHash(), pindex));
+        vSelected[nSelected] = true;
         if (printModifier)
             LogPrintf("ComputeNextStakeModifier: selected round %d stop=%s height=%d bit=%d\n",
                 nRound, DateTimeStrFormat("%Y-%m-%d %H:%M:%S", nSelectionIntervalStop).c_str(), pindex->nHeight, ebit);
@@ -216,17 +286,20 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeMod
         string strSelectionMap;
         // '-' indicates proof-of-work blocks not selected
         strSelectionMap.insert(0, pindexPrev->nHeight - nHeightFirstCandidate + 1, '-');
-        pindex = pindexPrev;
+        const CBlockIndex* pindex = pindexPrev;
         while (pindex && pindex->nHeight >= nHeightFirstCandidate) {
             // '=' indicates proof-of-stake blocks not selected
             if (IsProofOfStake(pindex->nHeight))
                 strSelectionMap.replace(pindex->nHeight - nHeightFirstCandidate, 1, "=");
             pindex = pindex->pprev;
         }
-        for (const auto & item : mapSelectedBlocks) {
+        for (size_t i = 0; i < vSortedByTimestamp.size(); ++i) {
+            if (!vSelected[i])
+                continue;
             // 'S' indicates selected proof-of-stake blocks
             // 'W' indicates selected proof-of-work blocks
-            strSelectionMap.replace(item.second->nHeight - nHeightFirstCandidate, 1, IsProofOfStake(item.second->nHeight) ? "S" : "W");
+            const int nHeight = vSortedByTimestamp[i]->nHeight;
+            strSelectionMap.replace(nHeight - nHeightFirstCandidate, 1, IsProofOfStake(nHeight) ? "S" : "W");
         }
         LogPrintf("ComputeNextStakeModifier: selection height [%d, %d] map %s\n", nHeightFirstCandidate, pindexPrev->nHeight, strSelectionMap.c_str());
         LogPrintf("ComputeNextStakeModifier: new modifier=%s time=%s\n", boost::lexical_cast<std::string>(nStakeModifierNew).c_str(), DateTimeStrFormat("%Y-%m-%d %H:%M:%S", pindexPrev->GetBlockTime()).c_str());
@@ -295,22 +368,17 @@ bool GetKernelStakeModifierV03(const CBlockIndex *pindexStake, uint64_t & nStake
     nStakeModifierHeight = pindexStake->nHeight;
     nStakeModifierTime = pindexStake->GetBlockTime();
     int64_t nStakeModifierSelectionInterval = GetStakeModifierSelectionInterval();
-    CBlockIndex* pindex = nullptr;
-    CBlockIndex* pindexNext = nullptr;
-    {
-        LOCK(cs_main);
-        pindex = chainActive[pindexStake->nHeight];
-        if (chainActive.Height() >= pindexStake->nHeight + 1)
-            pindexNext = chainActive[pindexStake->nHeight + 1];
-    }
-    auto slowSearch = [](std::map<int, CBlockIndex*> & mbi, const int blockNumber) -> CBlockIndex* {
-        LOCK(cs_main);
-        if (mbi.count(blockNumber))
-            return mbi[blockNumber];
+    LOCK(cs_main);
+    // Blocks from the active chain, or the last header seen at that height for blocks past its tip
+    auto nextIndex = [](const int nHeight) -> CBlockIndex* {
+        if (chainActive.Height() >= nHeight)
+            return chainActive[nHeight];
+        if (nHeight >= 0 && nHeight < static_cast<int>(vHeaderIndex.size()))
+            return vHeaderIndex[nHeight];
         return nullptr;
     };
-    if (!pindexNext) // slow search
-        pindexNext = slowSearch(mapHeaderIndex, pindexStake->nHeight + 1);
+    CBlockIndex* pindex = chainActive[pindexStake->nHeight];
+    CBlockIndex* pindexNext = nextIndex(pindexStake->nHeight + 1);
 
     // loop to find the stake modifier later by a selection interval
     while (nStakeModifierTime < pindexStake->GetBlockTime() + nStakeModifierSelectionInterval) {
@@ -319,15 +387,8 @@ bool GetKernelStakeModifierV03(const CBlockIndex *pindexStake, uint64_t & nStake
             return error("Null pindexNext\n");
         }
 
-        const int nextBlock = pindexNext->nHeight + 1;
         pindex = pindexNext;
-
-        if (chainActive.Height() >= nextBlock)
-            pindexNext = chainActive[nextBlock];
-        else pindexNext = nullptr;
-
-        if (!pindexNext) // slow search
-            pindexNext = slowSearch(mapHeaderIndex, nextBlock);
+        pindexNext = nextIndex(pindexNext->nHeight + 1);
         if (pindex->GeneratedStakeModifier()) {
             nStakeModifierHeight = pindex->nHeight;
             nStakeModifierTime = pindex->GetBlockTime();
@@ -14,6 +14,9 @@
 // Compute the hash modifier for proof-of-stake
 bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeModifier, bool& fGeneratedStakeModifier,
                               const Consensus::Params & consensus);
+// Forget the candidate blocks kept for the next stake modifier computation, needed
+// when the block index is unloaded
+void ResetStakeModifierCandidates();
 // Stake modifier selection interval
 int64_t GetStakeModifierSelectionInterval();
 
@@ -209,10 +209,191 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     return std::move(pblocktemplate);
 }
 
+void BlockAssembler::InitBlockContext(const CBlockIndex *pindexPrev)
+{
+    nHeight = pindexPrev->nHeight + 1;
+
+    pblock->nVersion = ComputeBlockVersion(pindexPrev, chainparams.GetConsensus());
+    // -regtest only: allow overriding block.nVersion with
+    // -blockversion=N to test forking scenarios
+    if (chainparams.MineBlocksOnDemand())
+        pblock->nVersion = gArgs.GetArg("-blockversion", pblock->nVersion);
+
+    pblock->nTime = GetAdjustedTime();
+    const int64_t nMedianTimePast = pindexPrev->GetMedianTimePast();
+
+    nLockTimeCutoff = (STANDARD_LOCKTIME_VERIFY_FLAGS & LOCKTIME_MEDIAN_TIME_PAST)
+                       ? nMedianTimePast
+                       : pblock->GetBlockTime();
+
+    // Decide whether to include witness transactions
+    // This is only needed in case the witness softfork activation is reverted
+    // (which would require a very deep reorganization).
+    // Note that the mempool would accept transactions with witness data before
+    // IsWitnessEnabled, but we would only ever mine blocks after IsWitnessEnabled
+    // unless there is a massive block reorganization with the witness softfork
+    // not activated.
+    // TODO: replace this with a call to main to assess validity of a mempool
+    // transaction (which in most cases can be a no-op).
+    fIncludeWitness = IsWitnessEnabled(pindexPrev, chainparams.GetConsensus());
+}
+
+BlockTxSelectionRef BlockAssembler::SelectBlockTxs()
+{
+    int64_t nTimeStart = GetTimeMicros();
+
+    resetBlock();
+
+    pblocktemplate.reset(new CBlockTemplate());
+    pblock = &pblocktemplate->block; // pointer for convenience
+    pblock->vtx.resize(2); // Leave room for the coinbase and coinstake txs
+
+    auto selection = std::make_shared<BlockTxSelection>();
+    int nPackagesSelected = 0;
+    int nDescendantsUpdated = 0;
+
+    {
+        LOCK2(cs_main, mempool.cs);
+        const CBlockIndex *pindexPrev = chainActive.Tip();
+        assert(pindexPrev != nullptr);
+        InitBlockContext(pindexPrev);
+        selection->hashPrevBlock = pindexPrev->GetBlockHash();
+        selection->nTransactionsUpdated = mempool.GetTransactionsUpdated();
+        addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+    }
+
+    // The lock time cutoff is the tip's median time past, so the selection
+    // stays valid for as long as the tip does.
+    selection->nTimeSelected = GetTime();
+    selection->nHeight = nHeight;
+    selection->nLockTimeCutoff = nLockTimeCutoff;
+    selection->fIncludeWitness = fIncludeWitness;
+    selection->vtx.assign(pblock->vtx.begin() + 2, pblock->vtx.end());
+    for (const auto& tx : selection->vtx)
+        selection->txids.insert(tx->GetHash());
+    selection->vTxFees = std::move(pblocktemplate->vTxFees);
+    selection->vTxSigOpsCost = std::move(pblocktemplate->vTxSigOpsCost);
+    selection->nBlockWeight = nBlockWeight;
+    selection->nBlockSigOpsCost = nBlockSigOpsCost;
+    selection->nFees = nFees;
+
+    LogPrint(BCLog::BENCH, "SelectBlockTxs() packages: %.2fms (%d packages, %d updated descendants, %u txs)\n",
+             0.001 * (GetTimeMicros() - nTimeStart), nPackagesSelected, nDescendantsUpdated, nBlockTx);
+
+    return selection;
+}
+
+BlockTxSelectionRef BlockAssembler::AppendBlockTx(const BlockTxSelectionRef& selection, CTxMemPool::txiter iter)
+{
+    // Same checks addPackageTxs makes on a package of one transaction
+    if (iter->GetModifiedFee() < blockMinFeeRate.GetFee(iter->GetTxSize()))
+        return nullptr;
+
+    nBlockWeight = selection->nBlockWeight;
+    nBlockSigOpsCost = selection->nBlockSigOpsCost;
+    if (!TestPackage(iter->GetTxSize(), iter->GetSigOpCost()))
+        return nullptr;
+
+    nHeight = selection->nHeight;
+    nLockTimeCutoff = selection->nLockTimeCutoff;
+    fIncludeWitness = selection->fIncludeWitness;
+    CTxMemPool::setEntries package;
+    package.insert(iter);
+    if (!TestPackageTransactions(package))
+        return nullptr;
+
+    // Parents have to come first in the block
+    for (CTxMemPool::txiter parent : mempool.GetMemPoolParents(iter)) {
+        if (!selection->txids.count(parent->GetTx().GetHash()))
+            return nullptr;
+    }
+
+    auto appended = std::make_shared<BlockTxSelection>(*selection);
+    appended->nTransactionsUpdated = mempool.GetTransactionsUpdated();
+    appended->vtx.emplace_back(iter->GetSharedTx());
+    appended->txids.insert(iter->GetTx().GetHash());
+    appended->vTxFees.push_back(iter->GetFee());
+    appended->vTxSigOpsCost.push_back(iter->GetSigOpCost());
+    appended->nBlockWeight += iter->GetTxWeight();
+    appended->nBlockSigOpsCost += iter->GetSigOpCost();
+    appended->nFees += iter->GetFee();
+    return appended;
+}
+
+std::unique_ptr<BlockTxPreselector> g_blocktxpreselector;
+
+BlockTxSelectionRef BlockTxPreselector::Get() const
+{
+    LOCK(cs);
+    return selection;
+}
+
+void BlockTxPreselector::Reselect()
+{
+    {
+        LOCK(cs_main);
+        if (!chainActive.Tip())
+            return;
+    }
+    auto reselected = BlockAssembler(chainparams).SelectBlockTxs();
+    LOCK(cs);
+    selection = reselected;
+    nLastReselect = GetTimeMillis();
+}
+
+void BlockTxPreselector::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    if (fInitialDownload) {
+        // CreateNewBlockPoS selects the transactions itself without a selection on the tip
+        LOCK(cs);
+        selection = nullptr;
+        return;
+    }
+    Reselect();
+}
+
+void BlockTxPreselector::TransactionAddedToMempool(const CTransactionRef& ptx)
+{
+    const auto current = Get();
+    if (!current)
+        return;
+    bool fHasParents{false};
+    {
+        LOCK(mempool.cs);
+        auto it = mempool.mapTx.find(ptx->GetHash());
+        if (it == mempool.mapTx.end() || current->txids.count(ptx->GetHash()))
+            return;
+        if (auto appended = BlockAssembler(chainparams).AppendBlockTx(current, it)) {
+            LOCK(cs);
+            if (selection == current) // not reselected meanwhile
+                selection = appended;
+            return;
+        }
+        fHasParents = !mempool.GetMemPoolParents(it).empty();
+    }
+    // A child can pay for parents that were left out, which only a full reselection picks up
+    if (!fHasParents)
+        return;
+    {
+        LOCK(cs);
+        if (GetTimeMillis() - nLastReselect < RESELECT_INTERVAL_MS)
+            return;
+    }
+    Reselect();
+}
+
+void BlockTxPreselector::TransactionRemovedFromMempool(const CTransactionRef& ptx)
+{
+    const auto current = Get();
+    if (current && current->txids.count(ptx->GetHash()))
+        Reselect();
+}
+
 #ifdef ENABLE_WALLET
 std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlockPoS(const CInputCoin & stakeInput, const uint256 & stakeBlockHash,
                                                                   const int64_t & stakeTime, const int64_t & blockTime,
-                                                                  CWallet *keystore, const bool & disableValidationChecks)
+                                                                  CWallet *keystore, const bool & disableValidationChecks,
+                                                                  const BlockTxSelectionRef & selection)
 {
     int64_t nTimeStart = GetTimeMicros();
 
@@ -229,41 +410,32 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlockPoS(const CInputCo
     pblocktemplate->vTxSigOpsCost.push_back(-1); // updated at end
 
     CBlockIndex* pindexPrev = nullptr;
-    int64_t nMedianTimePast;
     int nPackagesSelected = 0;
     int nDescendantsUpdated = 0;
+    bool fPreselected = false;
 
     {
-        LOCK2(cs_main, mempool.cs);
+        LOCK(cs_main);
         pindexPrev = chainActive.Tip();
         assert(pindexPrev != nullptr);
-        nHeight = pindexPrev->nHeight + 1;
-
-        pblock->nVersion = ComputeBlockVersion(pindexPrev, chainparams.GetConsensus());
-        // -regtest only: allow overriding block.nVersion with
-        // -blockversion=N to test forking scenarios
-        if (chainparams.MineBlocksOnDemand())
-            pblock->nVersion = gArgs.GetArg("-blockversion", pblock->nVersion);
-
-        pblock->nTime = GetAdjustedTime();
-        nMedianTimePast = pindexPrev->GetMedianTimePast();
-
-        nLockTimeCutoff = (STANDARD_LOCKTIME_VERIFY_FLAGS & LOCKTIME_MEDIAN_TIME_PAST)
-                           ? nMedianTimePast
-                           : pblock->GetBlockTime();
-
-        // Decide whether to include witness transactions
-        // This is only needed in case the witness softfork activation is reverted
-        // (which would require a very deep reorganization).
-        // Note that the mempool would accept transactions with witness data before
-        // IsWitnessEnabled, but we would only ever mine blocks after IsWitnessEnabled
-        // unless there is a massive block reorganization with the witness softfork
-        // not activated.
-        // TODO: replace this with a call to main to assess validity of a mempool
-        // transaction (which in most cases can be a no-op).
-        fIncludeWitness = IsWitnessEnabled(pindexPrev, chainparams.GetConsensus());
-
-        addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+        InitBlockContext(pindexPrev);
+
+        if (selection && selection->hashPrevBlock == pindexPrev->GetBlockHash()
+                      && selection->fIncludeWitness == fIncludeWitness)
+        {
+            // Transactions were selected ahead of time on this tip, skip package selection
+            pblock->vtx.insert(pblock->vtx.end(), selection->vtx.begin(), selection->vtx.end());
+            pblocktemplate->vTxFees.insert(pblocktemplate->vTxFees.end(), selection->vTxFees.begin(), selection->vTxFees.end());
+            pblocktemplate->vTxSigOpsCost.insert(pblocktemplate->vTxSigOpsCost.end(), selection->vTxSigOpsCost.begin(), selection->vTxSigOpsCost.end());
+            nBlockWeight = selection->nBlockWeight;
+            nBlockSigOpsCost = selection->nBlockSigOpsCost;
+            nBlockTx = selection->vtx.size();
+            nFees = selection->nFees;
+            fPreselected = true;
+        } else {
+            LOCK(mempool.cs);
+            addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+        }
     }
 
     int64_t nTime1 = GetTimeMicros();
@@ -413,7 +585,7 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlockPoS(const CInputCo
     }
     int64_t nTime2 = GetTimeMicros();
 
-    LogPrint(BCLog::BENCH, "Staking - packages: %.2fms (%d packages, %d updated descendants), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nPackagesSelected, nDescendantsUpdated, 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
+    LogPrint(BCLog::BENCH, "Staking - packages: %.2fms (%s, %d packages, %d updated descendants), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), fPreselected ? "preselected" : "selected", nPackagesSelected, nDescendantsUpdated, 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
 
     return std::move(pblocktemplate);
 }
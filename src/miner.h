@@ -9,8 +9,10 @@
 #include <keystore.h>
 #include <optional.h>
 #include <primitives/block.h>
+#include <sync.h>
 #include <txmempool.h>
 #include <validation.h>
+#include <validationinterface.h>
 #include <wallet/coinselection.h>
 
 #include <memory>
@@ -39,6 +41,27 @@ struct CBlockTemplate
     std::vector<unsigned char> vchCoinbaseCommitment;
 };
 
+/** Mempool transactions selected ahead of time for the block on top of hashPrevBlock.
+ *  The staker keeps one of these current so that a winning stake only has to add the
+ *  coinbase and coinstake, compute the merkle root and sign. */
+struct BlockTxSelection
+{
+    uint256 hashPrevBlock;
+    unsigned int nTransactionsUpdated{0}; // mempool update counter at selection time
+    int64_t nTimeSelected{0};
+    int nHeight{0};
+    int64_t nLockTimeCutoff{0};
+    bool fIncludeWitness{false};
+    std::vector<CTransactionRef> vtx; // excludes coinbase and coinstake
+    std::set<uint256> txids; // hashes of vtx
+    std::vector<CAmount> vTxFees;
+    std::vector<int64_t> vTxSigOpsCost;
+    uint64_t nBlockWeight{0};
+    uint64_t nBlockSigOpsCost{0};
+    CAmount nFees{0};
+};
+typedef std::shared_ptr<const BlockTxSelection> BlockTxSelectionRef;
+
 // Container for tracking updates to ancestor feerate as we include (parent)
 // transactions in a block
 struct CTxMemPoolModifiedEntry {
@@ -166,11 +189,18 @@ public:
 
     /** Construct a new block template with coinbase to scriptPubKeyIn */
     std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn);
+    /** Select the mempool transactions for a PoS block on top of the current tip */
+    BlockTxSelectionRef SelectBlockTxs();
+    /** Returns a copy of the selection with the mempool transaction added at the end, or
+     *  nullptr if it does not fit or has in-mempool parents that are not selected. */
+    BlockTxSelectionRef AppendBlockTx(const BlockTxSelectionRef& selection, CTxMemPool::txiter iter) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
 #ifdef ENABLE_WALLET
-    /** Construct new PoS block */
+    /** Construct new PoS block. A selection made by SelectBlockTxs on the current tip is used
+     *  as is, otherwise the mempool transactions are selected here. */
     std::unique_ptr<CBlockTemplate> CreateNewBlockPoS(const CInputCoin & stakeInput, const uint256 & stakeBlockHash,
                                                       const int64_t & stakeTime, const int64_t & blockTime,
-                                                      CWallet *keystore, const bool & disableValidationChecks = false);
+                                                      CWallet *keystore, const bool & disableValidationChecks = false,
+                                                      const BlockTxSelectionRef & selection = nullptr);
 #endif // ENABLE_WALLET
 
     static Optional<int64_t> m_last_block_num_txs;
@@ -182,6 +212,8 @@ private:
     void resetBlock();
     /** Add a tx to the block */
     void AddToBlock(CTxMemPool::txiter iter);
+    /** Set the chain context for a block on top of pindexPrev */
+    void InitBlockContext(const CBlockIndex *pindexPrev) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     // Methods for how to add transactions to a block.
     /** Add transactions based on feerate including unconfirmed ancestors
@@ -210,6 +242,37 @@ private:
     int UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set &mapModifiedTx) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
 };
 
+/** Keeps the mempool transactions for the next PoS block selected ahead of time on the
+ *  validation interface queue, off the staker thread. Transactions entering the mempool are
+ *  appended to the current selection, the selection is redone when the tip changes or when
+ *  a selected transaction leaves the mempool. */
+class BlockTxPreselector final : public CValidationInterface
+{
+public:
+    /** Minimum time between reselections caused by transactions entering the mempool */
+    static const int64_t RESELECT_INTERVAL_MS = 1000;
+
+    explicit BlockTxPreselector(const CChainParams& params) : chainparams(params) {}
+
+    /** The current selection, nullptr if none was made on the tip yet */
+    BlockTxSelectionRef Get() const;
+    /** Select the mempool transactions on the current tip */
+    void Reselect();
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+    void TransactionAddedToMempool(const CTransactionRef& ptx) override;
+    void TransactionRemovedFromMempool(const CTransactionRef& ptx) override;
+
+private:
+    const CChainParams& chainparams;
+    mutable Mutex cs;
+    BlockTxSelectionRef selection GUARDED_BY(cs);
+    int64_t nLastReselect GUARDED_BY(cs){0};
+};
+
+extern std::unique_ptr<BlockTxPreselector> g_blocktxpreselector;
+
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
@@ -722,6 +722,10 @@ public:
     // There is no final sorting before sending, as they are always sent immediately
     // and in the order requested.
     std::vector<uint256> vInventoryBlockToSend GUARDED_BY(cs_inventory);
+    // Service Node and XBridge packets we still have to announce, sent immediately in order.
+    std::vector<CInv> vInventorySnodeToSend GUARDED_BY(cs_inventory);
+    // Whether the peer wants Service Node and XBridge packets announced via inv ("snsendinv")
+    std::atomic<bool> fSnodeInvRelay{false};
     CCriticalSection cs_inventory;
     std::set<uint256> setAskFor;
     std::multimap<int64_t, CInv> mapAskFor;
@@ -866,6 +870,10 @@ public:
             }
         } else if (inv.type == MSG_BLOCK) {
             vInventoryBlockToSend.push_back(inv.hash);
+        } else if (inv.type == MSG_SNREGISTER || inv.type == MSG_SNPING || inv.type == MSG_XBRIDGE) {
+            if (!filterInventoryKnown.contains(inv.hash)) {
+                vInventorySnodeToSend.push_back(inv);
+            }
         }
     }
 
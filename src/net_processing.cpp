@@ -12,6 +12,7 @@
 #include <chainparams.h>
 #include <consensus/validation.h>
 #include <hash.h>
+#include <index/blockfilterindex.h>
 #include <validation.h>
 #include <merkleblock.h>
 #include <netmessagemaker.h>
@@ -68,6 +69,10 @@ static constexpr int STALE_RELAY_AGE_LIMIT = 30 * 24 * 60 * 60;
 /// Age after which a block is considered historical for purposes of rate
 /// limiting block relay. Set to one week, denominated in seconds.
 static constexpr int HISTORICAL_BLOCK_AGE = 7 * 24 * 60 * 60;
+/** Maximum number of compact filters that may be requested with one getcfilters. See BIP 157. */
+static constexpr uint32_t MAX_GETCFILTERS_SIZE = 100;
+/** Maximum number of cf hashes that may be requested with one getcfheaders. See BIP 157. */
+static constexpr uint32_t MAX_GETCFHEADERS_SIZE = 2000;
 
 struct COrphanTx {
     // When modifying, adapt the copy of this definition in tests/DoS_tests.
@@ -154,6 +159,13 @@ namespace {
     /** Expiration-time ordered list of (expire time, relay map entry) pairs. */
     std::deque<std::pair<int64_t, MapRelay::iterator>> vRelayExpiration GUARDED_BY(cs_main);
 
+    /** Relay memory for Service Node and XBridge packets announced via inv, keyed by inv hash. */
+    CCriticalSection cs_snodeRelay;
+    typedef std::map<uint256, std::pair<CInv, std::vector<unsigned char>>> MapSnodeRelay;
+    MapSnodeRelay mapSnodeRelay GUARDED_BY(cs_snodeRelay);
+    /** Expiration-time ordered list of (expire time, snode relay map entry) pairs. */
+    std::deque<std::pair<int64_t, MapSnodeRelay::iterator>> vSnodeRelayExpiration GUARDED_BY(cs_snodeRelay);
+
     std::atomic<int64_t> nTimeBestReceived(0); // Used only to inform the wallet of when we last received a block
 
     struct IteratorComparator
@@ -312,6 +324,14 @@ static void UpdateBlockAvailability(NodeId nodeid, const uint256 &hash) EXCLUSIV
     }
 }
 
+/** The compact block version we announce to a peer, the PoS-aware version if the peer supports it. */
+static uint64_t CompactBlockVersion(CNode* pnode) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    if (!(pnode->GetLocalServices() & NODE_WITNESS))
+        return 1;
+    return State(pnode->GetId())->fProvidesCmpctBlockSig ? CMPCTBLOCKS_VERSION_POS : 2;
+}
+
 /**
  * When a peer sends us a valid block, instruct it to announce blocks to us
  * using CMPCTBLOCK if possible by adding its nodeid to the end of
@@ -336,18 +356,17 @@ static void MaybeSetPeerAsAnnouncingHeaderAndIDs(NodeId nodeid, CConnman* connma
         }
         connman->ForNode(nodeid, [connman](CNode* pfrom){
             AssertLockHeld(cs_main);
-            uint64_t nCMPCTBLOCKVersion = (pfrom->GetLocalServices() & NODE_WITNESS) ? 2 : 1;
             if (lNodesAnnouncingHeaderAndIDs.size() >= 3) {
                 // As per BIP152, we only get 3 of our peers to announce
                 // blocks using compact encodings.
-                connman->ForNode(lNodesAnnouncingHeaderAndIDs.front(), [connman, nCMPCTBLOCKVersion](CNode* pnodeStop){
+                connman->ForNode(lNodesAnnouncingHeaderAndIDs.front(), [connman](CNode* pnodeStop){
                     AssertLockHeld(cs_main);
-                    connman->PushMessage(pnodeStop, CNetMsgMaker(pnodeStop->GetSendVersion()).Make(NetMsgType::SENDCMPCT, /*fAnnounceUsingCMPCTBLOCK=*/false, nCMPCTBLOCKVersion));
+                    connman->PushMessage(pnodeStop, CNetMsgMaker(pnodeStop->GetSendVersion()).Make(NetMsgType::SENDCMPCT, /*fAnnounceUsingCMPCTBLOCK=*/false, CompactBlockVersion(pnodeStop)));
                     return true;
                 });
                 lNodesAnnouncingHeaderAndIDs.pop_front();
             }
-            connman->PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(NetMsgType::SENDCMPCT, /*fAnnounceUsingCMPCTBLOCK=*/true, nCMPCTBLOCKVersion));
+            connman->PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(NetMsgType::SENDCMPCT, /*fAnnounceUsingCMPCTBLOCK=*/true, CompactBlockVersion(pfrom)));
             lNodesAnnouncingHeaderAndIDs.push_back(pfrom->GetId());
             return true;
         });
@@ -781,6 +800,7 @@ void PeerLogicValidation::BlockConnected(const std::shared_ptr<const CBlock>& pb
 static CCriticalSection cs_most_recent_block;
 static std::shared_ptr<const CBlock> most_recent_block GUARDED_BY(cs_most_recent_block);
 static std::shared_ptr<const CBlockHeaderAndShortTxIDs> most_recent_compact_block GUARDED_BY(cs_most_recent_block);
+static std::shared_ptr<const CBlockHeaderAndShortTxIDs> most_recent_compact_block_sig GUARDED_BY(cs_most_recent_block); // PoS-aware encoding
 static uint256 most_recent_block_hash GUARDED_BY(cs_most_recent_block);
 static bool fWitnessesPresentInMostRecentCompactBlock GUARDED_BY(cs_most_recent_block);
 
@@ -790,6 +810,7 @@ static bool fWitnessesPresentInMostRecentCompactBlock GUARDED_BY(cs_most_recent_
  */
 void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock) {
     std::shared_ptr<const CBlockHeaderAndShortTxIDs> pcmpctblock = std::make_shared<const CBlockHeaderAndShortTxIDs> (*pblock, true);
+    std::shared_ptr<const CBlockHeaderAndShortTxIDs> pcmpctblocksig = std::make_shared<const CBlockHeaderAndShortTxIDs> (*pblock, true, true);
     const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
 
     LOCK(cs_main);
@@ -807,10 +828,11 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
         most_recent_block_hash = hashBlock;
         most_recent_block = pblock;
         most_recent_compact_block = pcmpctblock;
+        most_recent_compact_block_sig = pcmpctblocksig;
         fWitnessesPresentInMostRecentCompactBlock = fWitnessEnabled;
     }
 
-    connman->ForEachNode([this, &pcmpctblock, &pblock, pindex, &msgMaker, fWitnessEnabled, &hashBlock](CNode* pnode) {
+    connman->ForEachNode([this, &pcmpctblock, &pcmpctblocksig, &pblock, pindex, &msgMaker, fWitnessEnabled, &hashBlock](CNode* pnode) {
         AssertLockHeld(cs_main);
 
         // TODO: Avoid the repeated-serialization here
@@ -825,7 +847,7 @@ void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std:
 
             LogPrint(BCLog::NET, "%s sending header-and-ids %s to peer=%d\n", "PeerLogicValidation::NewPoWValidBlock",
                     hashBlock.ToString(), pnode->GetId());
-            connman->PushMessage(pnode, msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock));
+            connman->PushMessage(pnode, msgMaker.Make(NetMsgType::CMPCTBLOCK, state.fWantsCmpctBlockSig ? *pcmpctblocksig : *pcmpctblock));
             state.pindexBestHeaderSent = pindex;
         }
     });
@@ -941,11 +963,56 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
     case MSG_BLOCK:
     case MSG_WITNESS_BLOCK:
         return LookupBlockIndex(inv.hash) != nullptr;
+    case MSG_SNREGISTER:
+    case MSG_SNPING:
+    case MSG_XBRIDGE:
+        return sn::ServiceNodeMgr::instance().hasSeenPacket(inv.hash);
     }
     // Don't know what it is, just say we already got one
     return true;
 }
 
+static bool IsServiceNodeInv(const CInv& inv)
+{
+    return inv.type == MSG_SNREGISTER || inv.type == MSG_SNPING || inv.type == MSG_XBRIDGE;
+}
+
+void RelayServiceNodePayload(const CInv& inv, std::vector<unsigned char> payload, CConnman* connman, NodeId nFrom)
+{
+    if (!connman)
+        return;
+
+    {
+        LOCK(cs_snodeRelay);
+        const int64_t nNow = GetTime();
+        // Expire old relay messages
+        while (!vSnodeRelayExpiration.empty() && vSnodeRelayExpiration.front().first < nNow) {
+            mapSnodeRelay.erase(vSnodeRelayExpiration.front().second);
+            vSnodeRelayExpiration.pop_front();
+        }
+        auto ret = mapSnodeRelay.insert(std::make_pair(inv.hash, std::make_pair(inv, payload)));
+        if (ret.second)
+            vSnodeRelayExpiration.push_back(std::make_pair(nNow + SNODE_RELAY_EXPIRY, ret.first));
+    }
+
+    const std::string command = inv.GetCommand();
+    connman->ForEachNode([&](CNode* pnode) {
+        if (pnode->GetId() == nFrom || !pnode->fSuccessfullyConnected || pnode->fDisconnect)
+            return;
+        if (inv.type == MSG_XBRIDGE && pnode->fXRouter) // do not relay xbridge packets to xrouter nodes
+            return;
+        if (pnode->fSnodeInvRelay) {
+            pnode->PushInventory(inv);
+            return;
+        }
+        // Legacy peer, send the full message
+        CSerializedNetMsg msg;
+        msg.command = command;
+        msg.data = payload;
+        connman->PushMessage(pnode, std::move(msg));
+    });
+}
+
 static void RelayTransaction(const CTransaction& tx, CConnman* connman)
 {
     CInv inv(MSG_TX, tx.GetHash());
@@ -996,12 +1063,14 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
     bool send = false;
     std::shared_ptr<const CBlock> a_recent_block;
     std::shared_ptr<const CBlockHeaderAndShortTxIDs> a_recent_compact_block;
+    std::shared_ptr<const CBlockHeaderAndShortTxIDs> a_recent_compact_block_sig;
     bool fWitnessesPresentInARecentCompactBlock;
     const Consensus::Params& consensusParams = chainparams.GetConsensus();
     {
         LOCK(cs_most_recent_block);
         a_recent_block = most_recent_block;
         a_recent_compact_block = most_recent_compact_block;
+        a_recent_compact_block_sig = most_recent_compact_block_sig;
         fWitnessesPresentInARecentCompactBlock = fWitnessesPresentInMostRecentCompactBlock;
     }
 
@@ -1122,12 +1191,15 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
                 // and we don't feel like constructing the object for them, so
                 // instead we respond with the full, non-compact block.
                 bool fPeerWantsWitness = State(pfrom->GetId())->fWantsCmpctWitness;
+                bool fPeerWantsBlockSig = State(pfrom->GetId())->fWantsCmpctBlockSig;
                 int nSendFlags = fPeerWantsWitness ? 0 : SERIALIZE_TRANSACTION_NO_WITNESS;
+                if (fPeerWantsBlockSig)
+                    a_recent_compact_block = a_recent_compact_block_sig;
                 if (CanDirectFetch(consensusParams) && pindex->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH) {
                     if ((fPeerWantsWitness || !fWitnessesPresentInARecentCompactBlock) && a_recent_compact_block && a_recent_compact_block->header.GetHash() == pindex->GetBlockHash()) {
                         connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, *a_recent_compact_block));
                     } else {
-                        CBlockHeaderAndShortTxIDs cmpctblock(*pblock, fPeerWantsWitness);
+                        CBlockHeaderAndShortTxIDs cmpctblock(*pblock, fPeerWantsWitness, fPeerWantsBlockSig);
                         connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, cmpctblock));
                     }
                 } else {
@@ -1157,6 +1229,32 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
     std::deque<CInv>::iterator it = pfrom->vRecvGetData.begin();
     std::vector<CInv> vNotFound;
     const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+
+    // Service Node and XBridge packets are served from their own relay memory
+    while (it != pfrom->vRecvGetData.end() && IsServiceNodeInv(*it)) {
+        if (interruptMsgProc)
+            return;
+        if (pfrom->fPauseSend)
+            break;
+
+        const CInv &inv = *it;
+        it++;
+
+        CSerializedNetMsg msg;
+        {
+            LOCK(cs_snodeRelay);
+            auto mi = mapSnodeRelay.find(inv.hash);
+            if (mi != mapSnodeRelay.end() && mi->second.first.type == inv.type) {
+                msg.command = inv.GetCommand();
+                msg.data = mi->second.second;
+            }
+        }
+        if (!msg.command.empty())
+            connman->PushMessage(pfrom, std::move(msg));
+        else
+            vNotFound.push_back(inv);
+    }
+
     {
         LOCK(cs_main);
 
@@ -1520,6 +1618,159 @@ void static ProcessOrphanTx(CConnman* connman, std::set<uint256>& orphan_work_se
     }
 }
 
+/**
+ * Validation logic for compact filters request handling.
+ *
+ * May disconnect from the peer in the case of a bad request.
+ *
+ * @param[in]   pfrom           The peer that we received the request from
+ * @param[in]   chainparams     Chain parameters
+ * @param[in]   filter_type     The filter type the request is for. Must be basic filters.
+ * @param[in]   start_height    The start height for the request
+ * @param[in]   stop_hash       The stop_hash for the request
+ * @param[in]   max_height_diff The maximum number of items permitted to request, as specified in BIP 157
+ * @param[out]  stop_index      The CBlockIndex for the stop_hash block, if the request can be serviced.
+ * @param[out]  filter_index    The filter index, if the request can be serviced.
+ * @return                      True if the request can be serviced.
+ */
+static bool PrepareBlockFilterRequest(CNode* pfrom, const CChainParams& chainparams,
+                                      BlockFilterType filter_type, uint32_t start_height,
+                                      const uint256& stop_hash, uint32_t max_height_diff,
+                                      const CBlockIndex*& stop_index,
+                                      BlockFilterIndex*& filter_index)
+{
+    const bool supported_filter_type =
+        (filter_type == BlockFilterType::BASIC &&
+         (pfrom->GetLocalServices() & NODE_COMPACT_FILTERS));
+    if (!supported_filter_type) {
+        LogPrint(BCLog::NET, "peer %d requested unsupported block filter type: %d\n",
+                 pfrom->GetId(), static_cast<uint8_t>(filter_type));
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    {
+        LOCK(cs_main);
+        stop_index = LookupBlockIndex(stop_hash);
+
+        // Check that the stop block exists and the peer would be allowed to fetch it.
+        if (!stop_index || !BlockRequestAllowed(stop_index, chainparams.GetConsensus())) {
+            LogPrint(BCLog::NET, "peer %d requested invalid block hash: %s\n",
+                     pfrom->GetId(), stop_hash.ToString());
+            pfrom->fDisconnect = true;
+            return false;
+        }
+    }
+
+    uint32_t stop_height = stop_index->nHeight;
+    if (start_height > stop_height) {
+        LogPrint(BCLog::NET, "peer %d sent invalid getcfilters/getcfheaders with " /* Continued */
+                 "start height %d and stop height %d\n",
+                 pfrom->GetId(), start_height, stop_height);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    if (stop_height - start_height >= max_height_diff) {
+        LogPrint(BCLog::NET, "peer %d requested too many cfilters/cfheaders: %d / %d\n",
+                 pfrom->GetId(), stop_height - start_height + 1, max_height_diff);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    filter_index = GetBlockFilterIndex(filter_type);
+    if (!filter_index) {
+        LogPrint(BCLog::NET, "Filter index for supported type %s not found\n", BlockFilterTypeName(filter_type));
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Handle a cfilters request.
+ *
+ * May disconnect from the peer in the case of a bad request.
+ */
+static void ProcessGetCFilters(CNode* pfrom, CDataStream& vRecv, const CChainParams& chainparams,
+                               CConnman* connman)
+{
+    uint8_t filter_type_ser;
+    uint32_t start_height;
+    uint256 stop_hash;
+
+    vRecv >> filter_type_ser >> start_height >> stop_hash;
+
+    const BlockFilterType filter_type = static_cast<BlockFilterType>(filter_type_ser);
+
+    const CBlockIndex* stop_index;
+    BlockFilterIndex* filter_index;
+    if (!PrepareBlockFilterRequest(pfrom, chainparams, filter_type, start_height, stop_hash,
+                                   MAX_GETCFILTERS_SIZE, stop_index, filter_index)) {
+        return;
+    }
+
+    std::vector<BlockFilter> filters;
+    if (!filter_index->LookupFilterRange(start_height, stop_index, filters)) {
+        LogPrint(BCLog::NET, "Failed to find block filter in index: filter_type=%s, start_height=%d, stop_hash=%s\n",
+                 BlockFilterTypeName(filter_type), start_height, stop_hash.ToString());
+        return;
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    for (const auto& filter : filters) {
+        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFILTER, filter));
+    }
+}
+
+/**
+ * Handle a cfheaders request.
+ *
+ * May disconnect from the peer in the case of a bad request.
+ */
+static void ProcessGetCFHeaders(CNode* pfrom, CDataStream& vRecv, const CChainParams& chainparams,
+                                CConnman* connman)
+{
+    uint8_t filter_type_ser;
+    uint32_t start_height;
+    uint256 stop_hash;
+
+    vRecv >> filter_type_ser >> start_height >> stop_hash;
+
+    const BlockFilterType filter_type = static_cast<BlockFilterType>(filter_type_ser);
+
+    const CBlockIndex* stop_index;
+    BlockFilterIndex* filter_index;
+    if (!PrepareBlockFilterRequest(pfrom, chainparams, filter_type, start_height, stop_hash,
+                                   MAX_GETCFHEADERS_SIZE, stop_index, filter_index)) {
+        return;
+    }
+
+    uint256 prev_header;
+    if (start_height > 0) {
+        const CBlockIndex* const prev_block =
+            stop_index->GetAncestor(static_cast<int>(start_height - 1));
+        if (!filter_index->LookupFilterHeader(prev_block, prev_header)) {
+            LogPrint(BCLog::NET, "Failed to find block filter header in index: filter_type=%s, block_hash=%s\n",
+                     BlockFilterTypeName(filter_type), prev_block->GetBlockHash().ToString());
+            return;
+        }
+    }
+
+    std::vector<uint256> filter_hashes;
+    if (!filter_index->LookupFilterHashRange(start_height, stop_index, filter_hashes)) {
+        LogPrint(BCLog::NET, "Failed to find block filter hashes in index: filter_type=%s, start_height=%d, stop_hash=%s\n",
+                 BlockFilterTypeName(filter_type), start_height, stop_hash.ToString());
+        return;
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFHEADERS,
+                                              filter_type_ser,
+                                              stop_index->GetBlockHash(),
+                                              prev_header,
+                                              filter_hashes));
+}
+
 bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams, CConnman* connman, const std::atomic<bool>& interruptMsgProc, bool enable_bip61)
 {
     LogPrint(BCLog::NET, "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->GetId());
@@ -1784,18 +2035,25 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDHEADERS));
         }
         if (pfrom->nVersion >= SHORT_IDS_BLOCKS_VERSION) {
-            // Tell our peer we are willing to provide version 1 or 2 cmpctblocks
+            // Tell our peer we are willing to provide version 1, 2 or 3 cmpctblocks,
+            // in order of preference as the peer locks in the first one it supports
             // However, we do not request new block announcements using
             // cmpctblock messages.
             // We send this to non-NODE NETWORK peers as well, because
             // they may wish to request compact blocks from us
             bool fAnnounceUsingCMPCTBLOCK = false;
-            uint64_t nCMPCTBLOCKVersion = 2;
+            uint64_t nCMPCTBLOCKVersion = CMPCTBLOCKS_VERSION_POS;
+            if (pfrom->GetLocalServices() & NODE_WITNESS)
+                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDCMPCT, fAnnounceUsingCMPCTBLOCK, nCMPCTBLOCKVersion));
+            nCMPCTBLOCKVersion = 2;
             if (pfrom->GetLocalServices() & NODE_WITNESS)
                 connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDCMPCT, fAnnounceUsingCMPCTBLOCK, nCMPCTBLOCKVersion));
             nCMPCTBLOCKVersion = 1;
             connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDCMPCT, fAnnounceUsingCMPCTBLOCK, nCMPCTBLOCKVersion));
         }
+        // Tell our peer we prefer inv announcements for servicenode and xbridge packets.
+        // Peers that don't know this message ignore it and keep sending full packets.
+        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SNSENDINV));
         pfrom->fSuccessfullyConnected = true;
 
         // Used for logging purposes, update the mean block height across connected nodes
@@ -1872,22 +2130,33 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         return true;
     }
 
+    if (strCommand == NetMsgType::SNSENDINV) {
+        pfrom->fSnodeInvRelay = true;
+        return true;
+    }
+
     if (strCommand == NetMsgType::SENDCMPCT) {
         bool fAnnounceUsingCMPCTBLOCK = false;
         uint64_t nCMPCTBLOCKVersion = 0;
         vRecv >> fAnnounceUsingCMPCTBLOCK >> nCMPCTBLOCKVersion;
-        if (nCMPCTBLOCKVersion == 1 || ((pfrom->GetLocalServices() & NODE_WITNESS) && nCMPCTBLOCKVersion == 2)) {
+        if (nCMPCTBLOCKVersion == 1 || ((pfrom->GetLocalServices() & NODE_WITNESS) && (nCMPCTBLOCKVersion == 2 || nCMPCTBLOCKVersion == CMPCTBLOCKS_VERSION_POS))) {
             LOCK(cs_main);
-            // fProvidesHeaderAndIDs is used to "lock in" version of compact blocks we send (fWantsCmpctWitness)
+            // fProvidesHeaderAndIDs is used to "lock in" version of compact blocks we send (fWantsCmpctWitness, fWantsCmpctBlockSig)
             if (!State(pfrom->GetId())->fProvidesHeaderAndIDs) {
                 State(pfrom->GetId())->fProvidesHeaderAndIDs = true;
-                State(pfrom->GetId())->fWantsCmpctWitness = nCMPCTBLOCKVersion == 2;
+                State(pfrom->GetId())->fWantsCmpctWitness = nCMPCTBLOCKVersion >= 2;
+                State(pfrom->GetId())->fWantsCmpctBlockSig = nCMPCTBLOCKVersion == CMPCTBLOCKS_VERSION_POS;
             }
-            if (State(pfrom->GetId())->fWantsCmpctWitness == (nCMPCTBLOCKVersion == 2)) // ignore later version announces
+            // The peer locks in the first version we announced that it supports, it will send us the
+            // PoS-aware encoding if it knows about it
+            if (nCMPCTBLOCKVersion == CMPCTBLOCKS_VERSION_POS)
+                State(pfrom->GetId())->fProvidesCmpctBlockSig = true;
+            if (State(pfrom->GetId())->fWantsCmpctWitness == (nCMPCTBLOCKVersion >= 2) &&
+                    State(pfrom->GetId())->fWantsCmpctBlockSig == (nCMPCTBLOCKVersion == CMPCTBLOCKS_VERSION_POS)) // ignore later version announces
                 State(pfrom->GetId())->fPreferHeaderAndIDs = fAnnounceUsingCMPCTBLOCK;
             if (!State(pfrom->GetId())->fSupportsDesiredCmpctVersion) {
                 if (pfrom->GetLocalServices() & NODE_WITNESS)
-                    State(pfrom->GetId())->fSupportsDesiredCmpctVersion = (nCMPCTBLOCKVersion == 2);
+                    State(pfrom->GetId())->fSupportsDesiredCmpctVersion = (nCMPCTBLOCKVersion >= 2);
                 else
                     State(pfrom->GetId())->fSupportsDesiredCmpctVersion = (nCMPCTBLOCKVersion == 1);
             }
@@ -1939,6 +2208,13 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                     LogPrint(BCLog::NET, "getheaders (%d) %s to peer=%d\n", pindexBestHeader->nHeight, inv.hash.ToString(), pfrom->GetId());
                 }
             }
+            else if (IsServiceNodeInv(inv))
+            {
+                // Servicenode and xbridge packets are not subject to blocksonly or initial download
+                pfrom->AddInventoryKnown(inv);
+                if (!fAlreadyHave)
+                    pfrom->AskFor(inv);
+            }
             else
             {
                 pfrom->AddInventoryKnown(inv);
@@ -2309,7 +2585,12 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     if (strCommand == NetMsgType::CMPCTBLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
     {
         CBlockHeaderAndShortTxIDs cmpctblock;
+        {
+            LOCK(cs_main);
+            cmpctblock.fBlockSig = State(pfrom->GetId())->fProvidesCmpctBlockSig;
+        }
         vRecv >> cmpctblock;
+        cmpctblock.header.CacheHash();
 
         bool received_new_header = false;
 
@@ -2618,6 +2899,8 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             vRecv >> headers[n];
             ReadCompactSize(vRecv); // ignore tx count; assume it is 0.
         }
+        // Hash the batch at once, the headers are looked up by hash repeatedly during processing
+        CacheBlockHeaderHashes(headers);
 
         // Headers received via a HEADERS message should be valid, and reflect
         // the chain the peer is on. If we receive a known-invalid header,
@@ -2855,6 +3138,16 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         return true;
     }
 
+    if (strCommand == NetMsgType::GETCFILTERS) {
+        ProcessGetCFilters(pfrom, vRecv, chainparams, connman);
+        return true;
+    }
+
+    if (strCommand == NetMsgType::GETCFHEADERS) {
+        ProcessGetCFHeaders(pfrom, vRecv, chainparams, connman);
+        return true;
+    }
+
     if (strCommand == NetMsgType::NOTFOUND) {
         // We do not care about the NOTFOUND message, but logging an Unknown Command
         // message would be undesirable as we transmit it ourselves.
@@ -2870,6 +3163,14 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         vRecv >> raw;
         auto rawcopy = raw;
 
+        const CInv inv(MSG_XBRIDGE, Hash(raw.begin(), raw.end()));
+        pfrom->AddInventoryKnown(inv);
+        pfrom->setAskFor.erase(inv.hash);
+        {
+            LOCK(cs_main);
+            mapAlreadyAskedFor.erase(inv.hash);
+        }
+
         // Top-level validation checks
         if (raw.size() < (20 + sizeof(time_t))) {
             // bad packet, small penalty (don't relay)
@@ -2917,13 +3218,8 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         }
 
         // Relay xbridge packets only if state is good
-        if (dos <= 0) {
-            connman->ForEachNode([&](CNode *pnode) {
-                if (!pnode->fSuccessfullyConnected)
-                    return;
-                connman->PushMessage(pnode, msgMaker.Make(NetMsgType::XBRIDGE, rawcopy));
-            });
-        }
+        if (dos <= 0)
+            RelayServiceNodePacket(inv, rawcopy, connman, pfrom->GetId());
 
         return true;
     }
@@ -2931,8 +3227,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     if (strCommand == NetMsgType::SNREGISTER) { // handle snode registrations
         sn::ServiceNode snode;
         try {
-            if (!smgr.processRegistration(vRecv, snode))
-                return true;
+            vRecv >> snode;
         } catch (std::exception & e) {
             LOCK(cs_main);
             LogPrint(BCLog::NET, "servicenode packet from peer=%d %s processed with error: %s\n",
@@ -2942,28 +3237,50 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             return true;
         }
 
-        // Send the ping out if we are a snode waiting for registration
-        if (smgr.hasActiveSn() && smgr.getActiveSn().keyId() == snode.getSnodePubKey().GetID()) {
-            sn::ServiceNodeMgr::writeSnRegistration(snode);
-            if (!smgr.sendPing(XROUTER_PROTOCOL_VERSION, xapp.myServicesJSON(), connman))
-                LogPrintf("Service node ping failed after registration for %s\n", smgr.getActiveSn().alias);
+        const CInv inv(MSG_SNREGISTER, snode.getHash());
+        pfrom->AddInventoryKnown(inv);
+        pfrom->setAskFor.erase(inv.hash);
+        {
+            LOCK(cs_main);
+            mapAlreadyAskedFor.erase(inv.hash);
         }
 
-        // Relay packets
-        connman->ForEachNode([&](CNode* pnode) {
-            if (pfrom == pnode)
+        // Signatures and collateral are verified on the servicenode verification queue
+        const NodeId from = pfrom->GetId();
+        smgr.queueRegistration(snode, [inv, from, connman](const sn::ServiceNodeVerifyEntry & entry, const sn::ServiceNodeConstPtr & snodePtr) {
+            if (!snodePtr) {
+                if (entry.badSignature) {
+                    LOCK(cs_main);
+                    LogPrint(BCLog::NET, "servicenode registration from peer=%d has an invalid signature\n", from);
+                    // bad signature, small penalty
+                    Misbehaving(from, 10);
+                }
                 return;
-            connman->PushMessage(pnode, msgMaker.Make(NetMsgType::SNREGISTER, snode));
+            }
+            auto & smgr = sn::ServiceNodeMgr::instance();
+            // Send the ping out if we are a snode waiting for registration
+            if (smgr.hasActiveSn() && smgr.getActiveSn().keyId() == snodePtr->getSnodePubKey().GetID()) {
+                sn::ServiceNodeMgr::writeSnRegistration(*snodePtr);
+                if (!smgr.sendPing(XROUTER_PROTOCOL_VERSION, xbridge::App::instance().myServicesJSON(), connman))
+                    LogPrintf("Service node ping failed after registration for %s\n", smgr.getActiveSn().alias);
+            }
+            // Relay packets
+            RelayServiceNodePacket(inv, entry.snode, connman, from);
         });
 
         return true;
     }
 
     if (strCommand == NetMsgType::SNPING || strCommand == NetMsgType::SNLISTPING) { // handle snode pings
+        // Drop duplicate full packets from legacy peers before deserializing them. The ping hash
+        // covers the serialized fields in order so it matches the hash of the payload, it is
+        // only recorded when the ping is queued.
+        if (smgr.hasSeenPacket(Hash(vRecv.begin(), vRecv.end())))
+            return true;
+
         sn::ServiceNodePing ping;
         try {
-            if (!smgr.processPing(vRecv, ping))
-                return true;
+            vRecv >> ping;
         } catch (std::exception & e) {
             LOCK(cs_main);
             LogPrint(BCLog::NET, "servicenode packet from peer=%d %s processed with error: %s\n",
@@ -2973,30 +3290,57 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             return true;
         }
 
-        // Relay packets only on SNPING (not SNLISTPING)
-        if (strCommand == NetMsgType::SNPING) {
-            connman->ForEachNode([&](CNode* pnode) {
-                if (pfrom == pnode)
-                    return;
-                connman->PushMessage(pnode, msgMaker.Make(NetMsgType::SNPING, ping));
-            });
+        const CInv inv(MSG_SNPING, ping.getHash());
+        pfrom->AddInventoryKnown(inv);
+        pfrom->setAskFor.erase(inv.hash);
+        {
+            LOCK(cs_main);
+            mapAlreadyAskedFor.erase(inv.hash);
         }
 
-        bool isReady = xrouter::App::isEnabled() && xrouter::App::instance().isReady();
-        if (isReady)
-            xrouter::App::instance().processConfigMessage(ping.getSnode());
+        // Signatures and collateral are verified on the servicenode verification queue.
+        // Relay packets only on SNPING (not SNLISTPING).
+        const NodeId from = pfrom->GetId();
+        const bool relay = strCommand == NetMsgType::SNPING;
+        smgr.queuePing(ping, [inv, from, relay, connman](const sn::ServiceNodeVerifyEntry & entry, const sn::ServiceNodeConstPtr & snodePtr) {
+            if (!snodePtr) {
+                if (entry.badSignature) {
+                    LOCK(cs_main);
+                    LogPrint(BCLog::NET, "servicenode ping from peer=%d has an invalid signature\n", from);
+                    // bad signature, small penalty
+                    Misbehaving(from, 10);
+                }
+                return;
+            }
+            if (relay)
+                RelayServiceNodePacket(inv, entry.ping, connman, from);
+            bool isReady = xrouter::App::isEnabled() && xrouter::App::instance().isReady();
+            if (isReady)
+                xrouter::App::instance().processConfigMessage(entry.ping.getSnode());
+        });
 
         return true;
     }
 
     if (strCommand == NetMsgType::SNLIST) { // handle snode list requests
-        const auto & snlist = smgr.list();
-        for (const auto & snode : snlist) {
-            const auto & ping = smgr.getPing(snode.getSnodePubKey());
-            if (!ping.isNull())
-                connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SNLISTPING, ping));
+        // Newer peers append a digest of the pings they already have, only send them the
+        // missing or stale ones. Requests without a digest receive the full list.
+        sn::ServiceNodeListDigest digest;
+        digest.version = 0;
+        if (!vRecv.empty()) {
+            try {
+                vRecv >> digest;
+            } catch (std::exception & e) {
+                LogPrint(BCLog::NET, "bad snlist digest from peer=%d: %s\n", pfrom->GetId(), e.what());
+                digest = sn::ServiceNodeListDigest{};
+                digest.version = 0;
+            }
         }
 
+        const auto pings = smgr.getPingsNotIn(digest);
+        for (const auto & ping : pings)
+            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SNLISTPING, ping));
+
         return true;
     }
 
@@ -3545,9 +3889,9 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
                         LOCK(cs_most_recent_block);
                         if (most_recent_block_hash == pBestIndex->GetBlockHash()) {
                             if (state.fWantsCmpctWitness || !fWitnessesPresentInMostRecentCompactBlock)
-                                connman->PushMessage(pto, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, *most_recent_compact_block));
+                                connman->PushMessage(pto, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, state.fWantsCmpctBlockSig ? *most_recent_compact_block_sig : *most_recent_compact_block));
                             else {
-                                CBlockHeaderAndShortTxIDs cmpctblock(*most_recent_block, state.fWantsCmpctWitness);
+                                CBlockHeaderAndShortTxIDs cmpctblock(*most_recent_block, state.fWantsCmpctWitness, state.fWantsCmpctBlockSig);
                                 connman->PushMessage(pto, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, cmpctblock));
                             }
                             fGotBlockFromCache = true;
@@ -3557,7 +3901,7 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
                         CBlock block;
                         bool ret = ReadBlockFromDisk(block, pBestIndex, consensusParams);
                         assert(ret);
-                        CBlockHeaderAndShortTxIDs cmpctblock(block, state.fWantsCmpctWitness);
+                        CBlockHeaderAndShortTxIDs cmpctblock(block, state.fWantsCmpctWitness, state.fWantsCmpctBlockSig);
                         connman->PushMessage(pto, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, cmpctblock));
                     }
                     state.pindexBestHeaderSent = pBestIndex;
@@ -3622,6 +3966,19 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
             }
             pto->vInventoryBlockToSend.clear();
 
+            // Add servicenode and xbridge packets
+            for (const CInv& inv : pto->vInventorySnodeToSend) {
+                if (pto->filterInventoryKnown.contains(inv.hash))
+                    continue;
+                pto->filterInventoryKnown.insert(inv.hash);
+                vInv.push_back(inv);
+                if (vInv.size() == MAX_INV_SZ) {
+                    connman->PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
+                    vInv.clear();
+                }
+            }
+            pto->vInventorySnodeToSend.clear();
+
             // Check whether periodic sends should happen
             bool fSendTrickle = pto->fWhitelisted;
             if (pto->nNextInvSend < nNow) {
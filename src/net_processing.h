@@ -24,6 +24,8 @@ static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS = 100;
 static const unsigned int DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN = 100;
 /** Default for BIP61 (sending reject messages) */
 static constexpr bool DEFAULT_ENABLE_BIP61{true};
+/** Compact block version of the PoS-aware encoding, version 2 plus the prefilled coinstake and the block signature */
+static const uint64_t CMPCTBLOCKS_VERSION_POS = 3;
 
 class PeerLogicValidation final : public CValidationInterface, public NetEventsInterface {
 private:
@@ -169,6 +171,10 @@ struct CNodeState {
      * otherwise: whether this peer sends non-witnesses in cmpctblocks/blocktxns.
      */
     bool fSupportsDesiredCmpctVersion;
+    //! Whether this peer wants the PoS-aware cmpctblocks carrying the block signature (compact block version 3)
+    bool fWantsCmpctBlockSig;
+    //! Whether this peer announced compact block version 3, in which case the cmpctblocks it sends us carry the block signature
+    bool fProvidesCmpctBlockSig;
 
     /** State used to enforce CHAIN_SYNC_TIMEOUT
       * Only in effect for outbound, non-manual connections, with
@@ -222,6 +228,8 @@ struct CNodeState {
         fHaveWitness = false;
         fWantsCmpctWitness = false;
         fSupportsDesiredCmpctVersion = false;
+        fWantsCmpctBlockSig = false;
+        fProvidesCmpctBlockSig = false;
         m_chain_sync = { 0, nullptr, false, false };
         m_last_block_announcement = 0;
     }
@@ -231,4 +239,24 @@ struct CNodeState {
 /** Get statistics from node state */
 bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats);
 
+/** How long Service Node and XBridge packets are kept in relay memory to answer getdata */
+static const int64_t SNODE_RELAY_EXPIRY = 5 * 60;
+
+/**
+ * Relay an already serialized Service Node registration, ping or XBridge packet (inv type
+ * MSG_SNREGISTER, MSG_SNPING or MSG_XBRIDGE). Peers that sent "snsendinv" receive an inv and
+ * fetch the packet with getdata, other peers receive the full message. The packet is never
+ * sent back to the peer it came from (nFrom).
+ */
+void RelayServiceNodePayload(const CInv& inv, std::vector<unsigned char> payload, CConnman* connman, NodeId nFrom = -1);
+
+/** Serialize and relay a Service Node or XBridge packet, see RelayServiceNodePayload. */
+template <typename T>
+void RelayServiceNodePacket(const CInv& inv, const T& packet, CConnman* connman, NodeId nFrom = -1)
+{
+    std::vector<unsigned char> payload;
+    CVectorWriter{SER_NETWORK, PROTOCOL_VERSION, payload, 0, packet};
+    RelayServiceNodePayload(inv, std::move(payload), connman, nFrom);
+}
+
 #endif // BITCOIN_NET_PROCESSING_H
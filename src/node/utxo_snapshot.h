@@ -0,0 +1,90 @@
+// Copyright (c) 2020 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_UTXO_SNAPSHOT_H
+#define BITCOIN_NODE_UTXO_SNAPSHOT_H
+
+#include <amount.h>
+#include <chain.h>
+#include <protocol.h>
+#include <serialize.h>
+#include <uint256.h>
+
+#include <string.h>
+
+/** Version of the utxo snapshot file format written by DumpUTXOSnapshot. */
+static const uint32_t UTXO_SNAPSHOT_VERSION = 1;
+
+/**
+ * Metadata at the start of a utxo snapshot file. A snapshot consists of the metadata followed by
+ * one SnapshotBlockData record for every block from height 1 to the base block, the raw
+ * governance db records, the coins of the utxo set at the base block and finally the snapshot
+ * hash (see UTXOSnapshotHash).
+ *
+ * All fields have a fixed size so that the record counts can be filled in once the snapshot
+ * has been written.
+ */
+class SnapshotMetadata
+{
+public:
+    CMessageHeader::MessageStartChars m_message_start{};
+    uint32_t m_version{UTXO_SNAPSHOT_VERSION};
+    uint256 m_base_blockhash;
+    int32_t m_base_height{0};
+    uint64_t m_governance_count{0};
+    uint64_t m_coins_count{0};
+
+    SnapshotMetadata() = default;
+    SnapshotMetadata(const CMessageHeader::MessageStartChars& message_start, const uint256& base_blockhash,
+                     int32_t base_height)
+        : m_base_blockhash(base_blockhash), m_base_height(base_height)
+    {
+        memcpy(m_message_start, message_start, sizeof(m_message_start));
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(m_message_start);
+        READWRITE(m_version);
+        READWRITE(m_base_blockhash);
+        READWRITE(m_base_height);
+        READWRITE(m_governance_count);
+        READWRITE(m_coins_count);
+    }
+};
+
+/**
+ * The block index fields a snapshot carries for every block below its base. The PoS fields are
+ * derived from the headers and only checked on load, the transaction count and money supply are
+ * only known once a block is connected.
+ */
+struct SnapshotBlockData {
+    unsigned int nTx{0};
+    unsigned int nFlags{0};
+    uint64_t nStakeModifier{0};
+    uint256 hashProofOfStake;
+    CAmount nMint{0};
+    CAmount nMoneySupply{0};
+
+    SnapshotBlockData() = default;
+    explicit SnapshotBlockData(const CBlockIndex* pindex)
+        : nTx(pindex->nTx), nFlags(pindex->nFlags), nStakeModifier(pindex->nStakeModifier),
+          hashProofOfStake(pindex->hashProofOfStake), nMint(pindex->nMint), nMoneySupply(pindex->nMoneySupply) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nTx);
+        READWRITE(nFlags);
+        READWRITE(nStakeModifier);
+        READWRITE(hashProofOfStake);
+        READWRITE(nMint);
+        READWRITE(nMoneySupply);
+    }
+};
+
+#endif // BITCOIN_NODE_UTXO_SNAPSHOT_H
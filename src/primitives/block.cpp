@@ -11,11 +11,41 @@
 #include <util/strencodings.h>
 #include <crypto/common.h>
 
+#include <stddef.h>
+#include <string.h>
+
+static_assert(offsetof(CBlockHeader, nNonce) + sizeof(uint32_t) - offsetof(CBlockHeader, nVersion) == QUARK_HEADER_SIZE,
+              "quark hashes the 80 contiguous bytes from nVersion to nNonce");
+
 uint256 CBlockHeader::GetHash() const
 {
+    if (fHashCached && memcmp(hashPreimage, &nVersion, QUARK_HEADER_SIZE) == 0)
+        return hashCached;
     return HashQuark((char*)&(nVersion), (char*)&((&(nNonce))[1])); // Blocknet PoS requires quark
 }
 
+void CBlockHeader::CacheHash()
+{
+    memcpy(hashPreimage, &nVersion, QUARK_HEADER_SIZE);
+    QuarkHash(hashCached.begin(), hashPreimage, QUARK_HEADER_SIZE);
+    fHashCached = true;
+}
+
+void CacheBlockHeaderHashes(std::vector<CBlockHeader>& headers)
+{
+    std::vector<unsigned char> preimages(headers.size() * QUARK_HEADER_SIZE);
+    std::vector<unsigned char> hashes(headers.size() * 32);
+    for (size_t i = 0; i < headers.size(); ++i)
+        memcpy(&preimages[i * QUARK_HEADER_SIZE], &headers[i].nVersion, QUARK_HEADER_SIZE);
+    QuarkHash80(hashes.data(), preimages.data(), headers.size());
+    for (size_t i = 0; i < headers.size(); ++i) {
+        auto & header = headers[i];
+        memcpy(header.hashPreimage, &preimages[i * QUARK_HEADER_SIZE], QUARK_HEADER_SIZE);
+        memcpy(header.hashCached.begin(), &hashes[i * 32], 32);
+        header.fHashCached = true;
+    }
+}
+
 std::string CBlock::ToString() const
 {
     std::stringstream s;
@@ -6,6 +6,7 @@
 #ifndef BITCOIN_PRIMITIVES_BLOCK_H
 #define BITCOIN_PRIMITIVES_BLOCK_H
 
+#include <crypto/quark.h>
 #include <primitives/transaction.h>
 #include <serialize.h>
 #include <uint256.h>
@@ -32,6 +33,11 @@ public:
     int64_t nStakeAmount;
     uint256 hashStakeBlock;
 
+    // memory only, see CacheHash()
+    unsigned char hashPreimage[QUARK_HEADER_SIZE];
+    uint256 hashCached;
+    bool fHashCached;
+
     CBlockHeader()
     {
         SetNull();
@@ -65,6 +71,7 @@ public:
         nStakeIndex = 0;
         nStakeAmount = 0;
         hashStakeBlock.SetNull();
+        fHashCached = false;
     }
 
     bool IsNull() const
@@ -72,14 +79,24 @@ public:
         return (nBits == 0);
     }
 
+    /**
+     * Returns the quark hash of the header. The hash memoized by CacheHash() is returned
+     * as long as the hashed fields have not been modified since.
+     */
     uint256 GetHash() const;
 
+    /** Compute the header hash once and memoize it for subsequent GetHash() calls. */
+    void CacheHash();
+
     int64_t GetBlockTime() const
     {
         return (int64_t)nTime;
     }
 };
 
+/** Memoize the hashes of many headers at once using the multi-lane quark implementation. */
+void CacheBlockHeaderHashes(std::vector<CBlockHeader>& headers);
+
 
 class CBlock : public CBlockHeader
 {
@@ -110,6 +127,8 @@ public:
         READWRITE(vtx);
         if (vtx.size() > 1 && vtx[1]->IsCoinStake())
             READWRITE(vchBlockSig);
+        if (ser_action.ForRead())
+            CacheHash();
     }
 
     void SetNull()
@@ -133,6 +152,9 @@ public:
         block.nStakeIndex    = nStakeIndex;
         block.nStakeAmount   = nStakeAmount;
         block.hashStakeBlock = hashStakeBlock;
+        memcpy(block.hashPreimage, hashPreimage, sizeof(hashPreimage));
+        block.hashCached     = hashCached;
+        block.fHashCached    = fHashCached;
         return block;
     }
 
@@ -48,6 +48,11 @@ const char *SNPING="snp";
 const char *SNLIST="snl";
 const char *SNLISTPING="snlp";
 const char *XROUTER="xrouter";
+const char *SNSENDINV="snsendinv";
+const char *GETCFILTERS="getcfilters";
+const char *CFILTER="cfilter";
+const char *GETCFHEADERS="getcfheaders";
+const char *CFHEADERS="cfheaders";
 } // namespace NetMsgType
 
 /** All known message types. Keep this in the same order as the list of
@@ -86,6 +91,11 @@ const static std::string allNetMessageTypes[] = {
     NetMsgType::SNLIST,
     NetMsgType::SNLISTPING,
     NetMsgType::XROUTER,
+    NetMsgType::SNSENDINV,
+    NetMsgType::GETCFILTERS,
+    NetMsgType::CFILTER,
+    NetMsgType::GETCFHEADERS,
+    NetMsgType::CFHEADERS,
 };
 const static std::vector<std::string> allNetMessageTypesVec(allNetMessageTypes, allNetMessageTypes+ARRAYLEN(allNetMessageTypes));
 
@@ -198,6 +208,9 @@ std::string CInv::GetCommand() const
     case MSG_BLOCK:          return cmd.append(NetMsgType::BLOCK);
     case MSG_FILTERED_BLOCK: return cmd.append(NetMsgType::MERKLEBLOCK);
     case MSG_CMPCT_BLOCK:    return cmd.append(NetMsgType::CMPCTBLOCK);
+    case MSG_SNREGISTER:     return cmd.append(NetMsgType::SNREGISTER);
+    case MSG_SNPING:         return cmd.append(NetMsgType::SNPING);
+    case MSG_XBRIDGE:        return cmd.append(NetMsgType::XBRIDGE);
     default:
         throw std::out_of_range(strprintf("CInv::GetCommand(): type=%d unknown type", type));
     }
@@ -14,8 +14,12 @@
 #include <consensus/validation.h>
 #include <core_io.h>
 #include <hash.h>
+#include <index/addressindex.h>
+#include <index/blockfilterindex.h>
+#include <index/spentindex.h>
 #include <index/txindex.h>
 #include <key_io.h>
+#include <node/utxo_snapshot.h>
 #include <policy/feerate.h>
 #include <policy/policy.h>
 #include <policy/rbf.h>
@@ -2061,6 +2065,506 @@ static UniValue savemempool(const JSONRPCRequest& request)
     return NullUniValue;
 }
 
+static UniValue getvalidationqueueinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0) {
+        throw std::runtime_error(
+            RPCHelpMan{"getvalidationqueueinfo",
+                "\nReturns the validation notification queue state and callback timings per subscriber.\n",
+                {},
+                RPCResult{
+            "{\n"
+            "  \"parallel\": true|false,     (boolean) True if each subscriber has its own queue (-parallelsignals)\n"
+            "  \"pending\": n,               (numeric) Callbacks waiting on all queues\n"
+            "  \"subscribers\": [\n"
+            "    {\n"
+            "      \"name\": \"xxxx\",        (string) Subscriber name\n"
+            "      \"pending\": n,           (numeric) Callbacks waiting on the subscriber's queue\n"
+            "      \"callbacks\": n,         (numeric) Number of callbacks run\n"
+            "      \"totaltime\": n,         (numeric) Total time spent in callbacks in milliseconds\n"
+            "      \"avgtime\": n,           (numeric) Average callback time in milliseconds\n"
+            "      \"maxtime\": n,           (numeric) Slowest callback in milliseconds\n"
+            "      \"lasttime\": n,          (numeric) Time of the last callback in milliseconds\n"
+            "    }\n"
+            "    ,...\n"
+            "  ]\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getvalidationqueueinfo", "")
+            + HelpExampleRpc("getvalidationqueueinfo", "")
+                },
+            }.ToString());
+    }
+
+    UniValue subscribers(UniValue::VARR);
+    for (const auto& stats : GetMainSignals().CallbackStats()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("name", stats.name);
+        obj.pushKV("pending", static_cast<uint64_t>(stats.pending));
+        obj.pushKV("callbacks", stats.callbacks);
+        obj.pushKV("totaltime", stats.totalTime * 0.001);
+        obj.pushKV("avgtime", stats.callbacks > 0 ? stats.totalTime * 0.001 / stats.callbacks : 0.0);
+        obj.pushKV("maxtime", stats.maxTime * 0.001);
+        obj.pushKV("lasttime", stats.lastTime * 0.001);
+        subscribers.push_back(obj);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("parallel", GetMainSignals().ParallelCallbacks());
+    ret.pushKV("pending", static_cast<uint64_t>(GetMainSignals().CallbacksPending()));
+    ret.pushKV("subscribers", subscribers);
+    return ret;
+}
+
+static UniValue getblockfilter(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2) {
+        throw std::runtime_error(
+            RPCHelpMan{"getblockfilter",
+                "\nRetrieve a BIP 157 content filter for a particular block.\n",
+                {
+                    {"blockhash", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The hash of the block"},
+                    {"filtertype", RPCArg::Type::STR, /* default */ "basic", "The type name of the filter"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"filter\" : (string) the hex-encoded filter data\n"
+            "  \"header\" : (string) the hex-encoded filter header\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\" \"basic\"")
+            + HelpExampleRpc("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\", \"basic\"")
+                },
+            }.ToString());
+    }
+
+    uint256 block_hash = ParseHashV(request.params[0], "blockhash");
+    std::string filtertype_name = "basic";
+    if (!request.params[1].isNull()) {
+        filtertype_name = request.params[1].get_str();
+    }
+
+    BlockFilterType filtertype;
+    if (!BlockFilterTypeByName(filtertype_name, filtertype)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown filtertype");
+    }
+
+    BlockFilterIndex* index = GetBlockFilterIndex(filtertype);
+    if (!index) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Index is not enabled for filtertype " + filtertype_name);
+    }
+
+    const CBlockIndex* block_index;
+    bool block_was_connected;
+    {
+        LOCK(cs_main);
+        block_index = LookupBlockIndex(block_hash);
+        if (!block_index) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        }
+        block_was_connected = block_index->IsValid(BLOCK_VALID_SCRIPTS);
+    }
+
+    bool index_ready = index->BlockUntilSyncedToCurrentChain();
+
+    BlockFilter filter;
+    uint256 filter_header;
+    if (!index->LookupFilter(block_index, filter) ||
+        !index->LookupFilterHeader(block_index, filter_header)) {
+        int err_code;
+        std::string errmsg = "Filter not found.";
+
+        if (!block_was_connected) {
+            err_code = RPC_INVALID_ADDRESS_OR_KEY;
+            errmsg += " Block was not connected to active chain.";
+        } else if (!index_ready) {
+            err_code = RPC_MISC_ERROR;
+            errmsg += " Block filters are still in the process of being indexed.";
+        } else {
+            err_code = RPC_INTERNAL_ERROR;
+            errmsg += " This error is unexpected and indicates index corruption.";
+        }
+
+        throw JSONRPCError(err_code, errmsg);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("filter", HexStr(filter.GetEncodedFilter()));
+    ret.pushKV("header", filter_header.GetHex());
+    return ret;
+}
+
+/** Resolve the addresses of an address index request, either a single address or {"addresses": [...]}. */
+static std::vector<std::pair<std::string, uint256>> ParseAddressIndexRequest(const UniValue& param)
+{
+    std::vector<std::string> addresses;
+    if (param.isStr()) {
+        addresses.push_back(param.get_str());
+    } else if (param.isObject()) {
+        const UniValue& values = find_value(param, "addresses");
+        if (!values.isArray())
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Addresses is expected to be an array");
+        for (const UniValue& value : values.getValues())
+            addresses.push_back(value.get_str());
+    } else {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Expected an address or an object with addresses");
+    }
+
+    std::vector<std::pair<std::string, uint256>> result;
+    for (const std::string& address : addresses) {
+        CTxDestination dest = DecodeDestination(address);
+        if (!IsValidDestination(dest))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address: " + address);
+        result.emplace_back(address, AddressIndexScriptHash(GetScriptForDestination(dest)));
+    }
+    return result;
+}
+
+static AddressIndex& RequireAddressIndex()
+{
+    if (!g_addressindex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Address index not enabled, restart with -addressindex");
+    g_addressindex->BlockUntilSyncedToCurrentChain();
+    return *g_addressindex;
+}
+
+static const RPCArg AddressIndexRequestArg{"addresses", RPCArg::Type::OBJ, RPCArg::Optional::NO, "An address or a json object with the addresses",
+    {
+        {"addresses", RPCArg::Type::ARR, RPCArg::Optional::NO, "The base58check encoded addresses",
+            {
+                {"address", RPCArg::Type::STR, RPCArg::Optional::OMITTED, "The base58check encoded address"},
+            },
+        },
+    },
+};
+
+static UniValue getaddressbalance(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1) {
+        throw std::runtime_error(
+            RPCHelpMan{"getaddressbalance",
+                "\nReturns the balance of addresses. Requires -addressindex.\n",
+                {
+                    AddressIndexRequestArg,
+                },
+                RPCResult{
+            "{\n"
+            "  \"balance\"  : n,   (numeric) the current balance in satoshis\n"
+            "  \"received\" : n,   (numeric) the total number of satoshis received (including change)\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getaddressbalance", "'{\"addresses\": [\"BXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX\"]}'")
+            + HelpExampleRpc("getaddressbalance", "{\"addresses\": [\"BXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX\"]}")
+                },
+            }.ToString());
+    }
+
+    const auto addresses = ParseAddressIndexRequest(request.params[0]);
+    AddressIndex& index = RequireAddressIndex();
+
+    CAmount balance = 0, received = 0;
+    for (const auto& address : addresses) {
+        CAmount address_balance, address_received;
+        if (!index.GetBalance(address.second, address_balance, address_received))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read the address index for " + address.first);
+        balance += address_balance;
+        received += address_received;
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("balance", balance);
+    ret.pushKV("received", received);
+    return ret;
+}
+
+static UniValue getaddressutxos(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1) {
+        throw std::runtime_error(
+            RPCHelpMan{"getaddressutxos",
+                "\nReturns all unspent outputs of addresses. Requires -addressindex.\n",
+                {
+                    AddressIndexRequestArg,
+                },
+                RPCResult{
+            "[\n"
+            "  {\n"
+            "    \"address\"     : \"address\",  (string) the address\n"
+            "    \"txid\"        : \"hash\",     (string) the output txid\n"
+            "    \"outputIndex\" : n,          (numeric) the output index\n"
+            "    \"script\"      : \"hex\",      (string) the script hex encoded\n"
+            "    \"satoshis\"    : n,          (numeric) the number of satoshis of the output\n"
+            "    \"height\"      : n,          (numeric) the block height of the output\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"BXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX\"]}'")
+            + HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"BXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX\"]}")
+                },
+            }.ToString());
+    }
+
+    const auto addresses = ParseAddressIndexRequest(request.params[0]);
+    AddressIndex& index = RequireAddressIndex();
+
+    std::vector<std::pair<const std::string*, CAddressUnspentEntry>> utxos;
+    for (const auto& address : addresses) {
+        std::vector<CAddressUnspentEntry> entries;
+        if (!index.GetUnspent(address.second, entries))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read the address index for " + address.first);
+        for (auto& entry : entries)
+            utxos.emplace_back(&address.first, std::move(entry));
+    }
+    std::stable_sort(utxos.begin(), utxos.end(), [](const std::pair<const std::string*, CAddressUnspentEntry>& a,
+                                                    const std::pair<const std::string*, CAddressUnspentEntry>& b) {
+        return a.second.height < b.second.height;
+    });
+
+    UniValue ret(UniValue::VARR);
+    for (const auto& utxo : utxos) {
+        UniValue output(UniValue::VOBJ);
+        output.pushKV("address", *utxo.first);
+        output.pushKV("txid", utxo.second.outpoint.hash.GetHex());
+        output.pushKV("outputIndex", (int)utxo.second.outpoint.n);
+        output.pushKV("script", HexStr(utxo.second.script.begin(), utxo.second.script.end()));
+        output.pushKV("satoshis", utxo.second.amount);
+        output.pushKV("height", utxo.second.height);
+        ret.push_back(output);
+    }
+    return ret;
+}
+
+static UniValue getaddresstxids(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1) {
+        throw std::runtime_error(
+            RPCHelpMan{"getaddresstxids",
+                "\nReturns the txids of all transactions crediting or debiting addresses, ordered by height. Requires -addressindex.\n",
+                {
+                    {"addresses", RPCArg::Type::OBJ, RPCArg::Optional::NO, "An address or a json object with the addresses",
+                        {
+                            {"addresses", RPCArg::Type::ARR, RPCArg::Optional::NO, "The base58check encoded addresses",
+                                {
+                                    {"address", RPCArg::Type::STR, RPCArg::Optional::OMITTED, "The base58check encoded address"},
+                                },
+                            },
+                            {"start", RPCArg::Type::NUM, /* default */ "0", "The start block height"},
+                            {"end", RPCArg::Type::NUM, /* default */ "tip", "The end block height"},
+                        },
+                    },
+                },
+                RPCResult{
+            "[\n"
+            "  \"transactionid\"  (string) The transaction id\n"
+            "  ,...\n"
+            "]\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"BXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX\"], \"start\": 1000}'")
+            + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"BXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX\"], \"start\": 1000}")
+                },
+            }.ToString());
+    }
+
+    const auto addresses = ParseAddressIndexRequest(request.params[0]);
+    int start = 0, end = -1;
+    if (request.params[0].isObject()) {
+        const UniValue& start_value = find_value(request.params[0], "start");
+        const UniValue& end_value = find_value(request.params[0], "end");
+        if (!start_value.isNull()) start = start_value.get_int();
+        if (!end_value.isNull()) end = end_value.get_int();
+        if (start < 0 || (end >= 0 && end < start))
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid start or end height");
+    }
+    AddressIndex& index = RequireAddressIndex();
+
+    std::vector<std::pair<int, uint256>> txs;
+    for (const auto& address : addresses) {
+        std::vector<CAddressIndexEntry> entries;
+        if (!index.GetHistory(address.second, entries, start, end))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read the address index for " + address.first);
+        for (const auto& entry : entries)
+            txs.emplace_back(entry.height, entry.txhash);
+    }
+    std::sort(txs.begin(), txs.end());
+
+    UniValue ret(UniValue::VARR);
+    std::set<uint256> seen;
+    for (const auto& tx : txs) {
+        if (seen.insert(tx.second).second)
+            ret.push_back(tx.second.GetHex());
+    }
+    return ret;
+}
+
+static UniValue getspentinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1) {
+        throw std::runtime_error(
+            RPCHelpMan{"getspentinfo",
+                "\nReturns the input spending an output. Requires -spentindex.\n",
+                {
+                    {"outpoint", RPCArg::Type::OBJ, RPCArg::Optional::NO, "The output",
+                        {
+                            {"txid", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The transaction id"},
+                            {"index", RPCArg::Type::NUM, RPCArg::Optional::NO, "The output index"},
+                        },
+                    },
+                },
+                RPCResult{
+            "{\n"
+            "  \"txid\"   : \"hash\",  (string) the spending transaction id\n"
+            "  \"index\"  : n,       (numeric) the spending input index\n"
+            "  \"height\" : n,       (numeric) the block height of the spending transaction\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getspentinfo", "'{\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 0}'")
+            + HelpExampleRpc("getspentinfo", "{\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 0}")
+                },
+            }.ToString());
+    }
+
+    RPCTypeCheckObj(request.params[0].get_obj(), {
+        {"txid", UniValueType(UniValue::VSTR)},
+        {"index", UniValueType(UniValue::VNUM)},
+    });
+    const uint256 txid = ParseHashO(request.params[0], "txid");
+    const int n = find_value(request.params[0], "index").get_int();
+    if (n < 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid index");
+
+    if (!g_spentindex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Spent index not enabled, restart with -spentindex");
+    g_spentindex->BlockUntilSyncedToCurrentChain();
+
+    CSpentIndexValue value;
+    if (!g_spentindex->GetSpentInfo(COutPoint(txid, n), value))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unable to get spent info");
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("txid", value.txid.GetHex());
+    ret.pushKV("index", (int)value.input_index);
+    ret.pushKV("height", value.height);
+    return ret;
+}
+
+static UniValue dumptxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1) {
+        throw std::runtime_error(
+            RPCHelpMan{"dumptxoutset",
+                "\nWrites a snapshot of the utxo set, the block index data and the governance state at the chain tip to disk.\n"
+                "The snapshot can be loaded with loadtxoutset on a new node once its hash is added to the chain parameters.\n",
+                {
+                    {"path", RPCArg::Type::STR, RPCArg::Optional::NO, "Path to the output file. If relative, will be prefixed by datadir."},
+                },
+                RPCResult{
+            "{\n"
+            "  \"coins_written\" : n,              (numeric) the number of coins in the snapshot\n"
+            "  \"governance_records\" : n,         (numeric) the number of governance records in the snapshot\n"
+            "  \"base_hash\" : \"hash\",             (string) the hash of the snapshot base block\n"
+            "  \"base_height\" : n,                (numeric) the height of the snapshot base block\n"
+            "  \"snapshot_hash\" : \"hash\",         (string) the hash of the snapshot\n"
+            "  \"path\" : \"path\",                  (string) the absolute path of the snapshot\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("dumptxoutset", "utxo.dat")
+            + HelpExampleRpc("dumptxoutset", "\"utxo.dat\"")
+                },
+            }.ToString());
+    }
+
+    const fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    if (fs::exists(path)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists. If you are sure this is what you want, move it out of the way first");
+    }
+
+    // The governance records are written as of the chain tip, let the governance index catch up first
+    SyncWithValidationInterfaceQueue();
+
+    SnapshotMetadata metadata;
+    uint256 hash;
+    std::string error;
+    if (!DumpUTXOSnapshot(path, metadata, hash, error))
+        throw JSONRPCError(RPC_MISC_ERROR, error);
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("coins_written", metadata.m_coins_count);
+    ret.pushKV("governance_records", metadata.m_governance_count);
+    ret.pushKV("base_hash", metadata.m_base_blockhash.GetHex());
+    ret.pushKV("base_height", metadata.m_base_height);
+    ret.pushKV("snapshot_hash", hash.GetHex());
+    ret.pushKV("path", path.string());
+    return ret;
+}
+
+static UniValue loadtxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1) {
+        throw std::runtime_error(
+            RPCHelpMan{"loadtxoutset",
+                "\nLoads a utxo snapshot written by dumptxoutset on a node that has synced the headers but no blocks yet.\n"
+                "The snapshot hash must match the one in the chain parameters. The blocks below the snapshot base are treated\n"
+                "as pruned and the node continues to sync from the snapshot base. Requires -addressindex, -spentindex and\n"
+                "-blockfilterindex to be disabled.\n",
+                {
+                    {"path", RPCArg::Type::STR, RPCArg::Optional::NO, "Path to the snapshot file. If relative, will be prefixed by datadir."},
+                },
+                RPCResult{
+            "{\n"
+            "  \"coins_loaded\" : n,               (numeric) the number of coins loaded\n"
+            "  \"governance_records\" : n,         (numeric) the number of governance records loaded\n"
+            "  \"base_hash\" : \"hash\",             (string) the hash of the snapshot base block, the new chain tip\n"
+            "  \"base_height\" : n,                (numeric) the height of the snapshot base block\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("loadtxoutset", "utxo.dat")
+            + HelpExampleRpc("loadtxoutset", "\"utxo.dat\"")
+                },
+            }.ToString());
+    }
+
+    // The optional indexes are built from the full block history, which a snapshot node does not have
+    bool filterIndex{false};
+    ForEachBlockFilterIndex([&filterIndex](BlockFilterIndex&) { filterIndex = true; });
+    if (g_addressindex || g_spentindex || filterIndex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Restart without -addressindex, -spentindex and -blockfilterindex to load a utxo snapshot");
+
+    const fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    SnapshotMetadata metadata;
+    std::string error;
+    if (!ReadUTXOSnapshotMetadata(path, metadata, error))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, error);
+
+    const auto& hashes = Params().AssumeutxoData().mapSnapshotHashes;
+    const auto it = hashes.find(metadata.m_base_height);
+    if (it == hashes.end())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("No utxo snapshot hash is known for height %d", metadata.m_base_height));
+
+    if (!LoadUTXOSnapshot(path, it->second, metadata, error))
+        throw JSONRPCError(RPC_MISC_ERROR, error);
+
+    // Connect the blocks that were already downloaded on top of the snapshot base
+    CValidationState state;
+    if (!ActivateBestChain(state, Params()))
+        throw JSONRPCError(RPC_DATABASE_ERROR, FormatStateMessage(state));
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("coins_loaded", metadata.m_coins_count);
+    ret.pushKV("governance_records", metadata.m_governance_count);
+    ret.pushKV("base_hash", metadata.m_base_blockhash.GetHex());
+    ret.pushKV("base_height", metadata.m_base_height);
+    return ret;
+}
+
 //! Search for a given set of pubkey scripts
 bool FindScriptPubKey(std::atomic<int>& scan_progress, const std::atomic<bool>& should_abort, int64_t& count, CCoinsViewCursor* cursor, const std::set<CScript>& needles, std::map<COutPoint, Coin>& out_results) {
     scan_progress = 0;
@@ -2312,10 +2816,18 @@ static const CRPCCommand commands[] =
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        {"height"} },
     { "blockchain",         "savemempool",            &savemempool,            {} },
+    { "blockchain",         "getvalidationqueueinfo", &getvalidationqueueinfo, {} },
     { "blockchain",         "verifychain",            &verifychain,            {"checklevel","nblocks"} },
 
     { "blockchain",         "preciousblock",          &preciousblock,          {"blockhash"} },
     { "blockchain",         "scantxoutset",           &scantxoutset,           {"action", "scanobjects"} },
+    { "blockchain",         "getblockfilter",         &getblockfilter,         {"blockhash", "filtertype"} },
+    { "blockchain",         "getaddressbalance",      &getaddressbalance,      {"addresses"} },
+    { "blockchain",         "getaddressutxos",        &getaddressutxos,        {"addresses"} },
+    { "blockchain",         "getaddresstxids",        &getaddresstxids,        {"addresses"} },
+    { "blockchain",         "getspentinfo",           &getspentinfo,           {"outpoint"} },
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           {"path"} },
+    { "blockchain",         "loadtxoutset",           &loadtxoutset,           {"path"} },
 
     /* Not shown in help */
     { "hidden",             "invalidateblock",        &invalidateblock,        {"blockhash"} },
@@ -71,6 +71,10 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "sendmany", 6 , "conf_target" },
     { "deriveaddresses", 1, "range" },
     { "scantxoutset", 1, "scanobjects" },
+    { "getaddressbalance", 0, "addresses" },
+    { "getaddressutxos", 0, "addresses" },
+    { "getaddresstxids", 0, "addresses" },
+    { "getspentinfo", 0, "outpoint" },
     { "addmultisigaddress", 0, "nrequired" },
     { "addmultisigaddress", 1, "keys" },
     { "createmultisig", 0, "nrequired" },
@@ -200,6 +204,9 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "xrGetBlockHash", 2, "arg2" },
     { "xrGetBlock", 2, "arg2" },
     { "xrGetBlocks", 2, "arg2" },
+    { "xrGetBlockFilters", 1, "arg1" },
+    { "xrGetBlockFilters", 2, "arg2" },
+    { "xrGetBlockFilters", 3, "arg3" },
     { "xrGetTransaction", 2, "arg2" },
     { "xrGetTransactions", 2, "arg2" },
     { "xrDecodeRawTransaction", 2, "arg2" },
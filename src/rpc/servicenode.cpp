@@ -831,6 +831,42 @@ static UniValue servicenodecount(const JSONRPCRequest& request)
     return obj;
 }
 
+static UniValue servicenodeverifyqueue(const JSONRPCRequest& request)
+{
+    if (request.fHelp || !request.params.empty())
+        throw std::runtime_error(
+            RPCHelpMan{"servicenodeverifyqueue",
+                "\nReturns metrics of the queue verifying service node pings and registrations from the network.\n",
+                {},
+                RPCResult{
+                "{\n"
+                "  \"pending\": n,          (numeric) Packets waiting to be verified\n"
+                "  \"maxpending\": n,       (numeric) Largest number of packets waiting to be verified\n"
+                "  \"batches\": n,          (numeric) Number of verified batches\n"
+                "  \"accepted\": n,         (numeric) Number of accepted packets\n"
+                "  \"rejected\": n,         (numeric) Number of rejected packets\n"
+                "  \"verifytime\": n,       (numeric) Total time spent verifying in milliseconds\n"
+                "  \"lastbatchtime\": n,    (numeric) Time spent verifying the last batch in milliseconds\n"
+                "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("servicenodeverifyqueue", "")
+                  + HelpExampleRpc("servicenodeverifyqueue", "")
+                },
+            }.ToString());
+
+    const auto stats = sn::ServiceNodeMgr::instance().verifyStats();
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("pending", static_cast<uint64_t>(stats.pending));
+    obj.pushKV("maxpending", static_cast<uint64_t>(stats.maxPending));
+    obj.pushKV("batches", stats.batches);
+    obj.pushKV("accepted", stats.accepted);
+    obj.pushKV("rejected", stats.rejected);
+    obj.pushKV("verifytime", stats.verifyTime * 0.001);
+    obj.pushKV("lastbatchtime", stats.lastBatchTime * 0.001);
+    return obj;
+}
+
 static UniValue servicenodelegacy(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -914,6 +950,7 @@ static const CRPCCommand commands[] =
     { "servicenode",        "servicenodesendping",     &servicenodesendping,     {} },
     { "servicenode",        "servicenoderemove",       &servicenoderemove,       {"alias"} },
     { "servicenode",        "servicenodecount",        &servicenodecount,        {} },
+    { "servicenode",        "servicenodeverifyqueue",  &servicenodeverifyqueue,  {} },
     { "servicenode",        "servicenode",             &servicenodelegacy,       {"command"} },
 };
 // clang-format on
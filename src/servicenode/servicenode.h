@@ -385,6 +385,19 @@ public:
         return ss.GetHash();
     }
 
+    /**
+     * Returns true if the signature can be recovered from the sighash. Open tier snodes
+     * must also be signed by the snode key. Unlike isValid() this doesn't check the chain
+     * or the collateral, a failure here means the packet was malformed or forged.
+     * @return
+     */
+    bool isSignatureValid() const {
+        CPubKey pubkey;
+        if (!pubkey.RecoverCompact(sigHash(), signature))
+            return false;
+        return tier != Tier::OPEN || pubkey.GetID() == snodePubKey.GetID();
+    }
+
     /**
      * Returns true if the Servicenode is valid. The stale check defaults to true, by default this adds additional
      * measures to verify a Servicenode. The Servicenode ping will change this state periodically, therefore it may
@@ -643,6 +656,7 @@ protected: // in-memory only
 };
 
 typedef std::shared_ptr<ServiceNode> ServiceNodePtr;
+typedef std::shared_ptr<const ServiceNode> ServiceNodeConstPtr;
 
 /**
  * The Servicenode ping is responsible for notifying peers of the latest servicenode details. The ping
@@ -770,6 +784,18 @@ public:
         return key.SignCompact(sigHash(), signature);
     }
 
+    /**
+     * Returns true if the ping was signed by the snode key and the snode's signature can be
+     * recovered. Unlike isValid() this doesn't check the chain or the collateral.
+     * @return
+     */
+    bool isSignatureValid() const {
+        CPubKey pubkey;
+        if (!pubkey.RecoverCompact(sigHash(), signature) || pubkey.GetID() != snodePubKey.GetID())
+            return false;
+        return snode.isSignatureValid();
+    }
+
     /**
      * Returns true if this servicenode ping is valid. Service node pubkey and associated signatures are checked for
      * validity. The ping is signed by the snode privkey while the registration is signed by the snode collateral
@@ -4,8 +4,15 @@
 
 #include <servicenode/servicenodemgr.h>
 
+#include <checkqueue.h>
+#include <util/time.h>
+
+#include <boost/thread/thread.hpp>
+
 namespace sn {
 
+static CCheckQueue<ServiceNodeCheck> snodecheckqueue(128);
+
 CTxDestination ServiceNodePaymentAddress(const std::string & snode) {
     // default payment address is snode vin address
     auto s = sn::ServiceNodeMgr::instance().getSn(snode);
@@ -14,4 +21,82 @@ CTxDestination ServiceNodePaymentAddress(const std::string & snode) {
     return CNoDestination{};
 }
 
+void ThreadServiceNodeCheck() {
+    RenameThread("blocknet-snodecheck");
+    snodecheckqueue.Thread();
+}
+
+void ThreadServiceNodeVerify() {
+    RenameThread("blocknet-snodeverify");
+    ServiceNodeMgr::instance().runVerifyQueue();
+}
+
+void ServiceNodeMgr::verifyEntries(std::vector<ServiceNodeVerifyEntry> & entries) {
+    if (entries.empty())
+        return;
+
+    // Verify in parallel, this thread joins the check queue workers until all checks are done
+    const int64_t nStart = GetTimeMicros();
+    std::vector<char> results(entries.size(), ServiceNodeCheck::REJECTED);
+    {
+        std::vector<ServiceNodeCheck> checks;
+        checks.reserve(entries.size());
+        for (size_t i = 0; i < entries.size(); ++i)
+            checks.emplace_back(&entries[i], &results[i]);
+        CCheckQueueControl<ServiceNodeCheck> control(&snodecheckqueue);
+        control.Add(checks);
+        control.Wait();
+    }
+    const int64_t nTime = GetTimeMicros() - nStart;
+
+    // Apply in the order the packets were received
+    uint64_t accepted{0};
+    for (size_t i = 0; i < entries.size(); ++i) {
+        auto & entry = entries[i];
+        entry.badSignature = results[i] == ServiceNodeCheck::BAD_SIGNATURE;
+        ServiceNodeConstPtr snode = results[i] == ServiceNodeCheck::VALID ? applyEntry(entry) : nullptr;
+        if (snode)
+            ++accepted;
+        if (entry.handler)
+            entry.handler(entry, snode);
+    }
+
+    {
+        boost::unique_lock<boost::mutex> lock(verifyMu);
+        ++verifyStatsData.batches;
+        verifyStatsData.accepted += accepted;
+        verifyStatsData.rejected += entries.size() - accepted;
+        verifyStatsData.verifyTime += nTime;
+        verifyStatsData.lastBatchTime = nTime;
+    }
+
+    LogPrint(BCLog::SNODE, "Verified %u servicenode packets in %.2fms (%u rejected)\n", entries.size(),
+             nTime * 0.001, entries.size() - accepted);
+}
+
+void ServiceNodeMgr::runVerifyQueue() {
+    verifyRunning = true;
+    try {
+        while (true) {
+            std::vector<ServiceNodeVerifyEntry> entries;
+            {
+                boost::unique_lock<boost::mutex> lock(verifyMu);
+                while (verifyQueue.empty())
+                    verifyCond.wait(lock); // interruption point
+                const auto n = std::min<size_t>(verifyQueue.size(), MAX_VERIFY_BATCH);
+                entries.reserve(n);
+                for (size_t i = 0; i < n; ++i) {
+                    entries.push_back(std::move(verifyQueue.front()));
+                    verifyQueue.pop_front();
+                }
+            }
+            verifyEntries(entries);
+            boost::this_thread::interruption_point();
+        }
+    } catch (...) {
+        verifyRunning = false;
+        throw;
+    }
+}
+
 }
@@ -6,8 +6,10 @@
 #define BLOCKNET_SERVICENODE_SERVICENODEMGR_H
 
 #include <amount.h>
+#include <bloom.h>
 #include <key_io.h>
 #include <net.h>
+#include <net_processing.h>
 #include <netmessagemaker.h>
 #include <servicenode/servicenode.h>
 #include <script/standard.h>
@@ -21,13 +23,22 @@
 #include <wallet/wallet.h>
 #endif // ENABLE_WALLET
 
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <numeric>
 #include <set>
+#include <unordered_map>
 #include <utility>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
 
 /**
  * Servicenode namepsace
@@ -70,13 +81,146 @@ struct ServiceNodeConfigEntry {
     }
 };
 
+/**
+ * Immutable view of the servicenode list. A new snapshot is published every time the list
+ * changes (registration, ping, removal, runtime state) and readers load it without taking
+ * the manager lock. Published snodes are never modified, the manager replaces a snode with
+ * an updated copy instead (copy-on-write), i.e. readers holding an older snapshot keep
+ * seeing the state at the time it was published.
+ */
+struct ServiceNodeSnapshot {
+    /** All known servicenodes, ordered by snode pubkey. */
+    std::vector<ServiceNodeConstPtr> snodes;
+    /** Index of service name (e.g. "BLOCK", "xr::BLOCK", "xrs::plugin") to snodes supporting it. */
+    std::unordered_map<std::string, std::vector<ServiceNodeConstPtr>> services;
+    /** Index of host:port to snode, first snode (by pubkey order) wins on duplicates. */
+    std::unordered_map<std::string, ServiceNodeConstPtr> hosts;
+};
+typedef std::shared_ptr<const ServiceNodeSnapshot> ServiceNodeSnapshotPtr;
+
+/**
+ * Compact summary of the servicenode pings a node already has, appended to snlist requests.
+ * Each snode with a ping is listed by a short id derived from its pubkey along with the time
+ * of its latest ping. The responder only sends the pings that are missing from the digest or
+ * newer than the requester's. Peers that don't know the digest ignore it and reply with the
+ * full list.
+ */
+struct ServiceNodeListDigest {
+    static const uint8_t CURRENT_VERSION = 2;
+
+    uint8_t version{CURRENT_VERSION};
+    /** Latest pings as (snode id, ping time), ordered by snode id. */
+    std::vector<std::pair<uint64_t, uint32_t>> pings;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(version);
+        READWRITE(pings);
+    }
+
+    /**
+     * Returns the digest id of the snode pubkey, the first 8 bytes of its x coordinate.
+     * @param snodePubKey
+     * @return
+     */
+    static uint64_t snodeId(const CPubKey & snodePubKey) {
+        return snodePubKey.size() > 8 ? ReadLE64(snodePubKey.begin() + 1) : 0;
+    }
+};
+
+/**
+ * Servicenode ping or registration from the network waiting on the verification queue.
+ */
+struct ServiceNodeVerifyEntry {
+    /** Called after the entry was processed, snode is nullptr if the entry was rejected. */
+    typedef std::function<void(const ServiceNodeVerifyEntry & entry, const ServiceNodeConstPtr & snode)> Handler;
+
+    ServiceNodePing ping; // set on pings
+    ServiceNode snode; // set on registrations
+    Handler handler;
+    bool badSignature{false}; // set if the entry was rejected for an invalid signature
+
+    bool isPing() const {
+        return !ping.isNull();
+    }
+};
+
+/**
+ * Verifies the signatures and collateral of a queued ping or registration on the servicenode
+ * check queue. The outcome is written to the result slot, the check itself always succeeds
+ * so that one bad packet doesn't stop the other checks in the batch.
+ */
+class ServiceNodeCheck {
+public:
+    enum Result : char {
+        REJECTED = 0,
+        VALID = 1,
+        BAD_SIGNATURE = 2, // rejected, the sender should be penalized
+    };
+
+    ServiceNodeCheck() = default;
+    ServiceNodeCheck(const ServiceNodeVerifyEntry *entry, char *result) : entry(entry), result(result) {}
+
+    bool operator()() {
+        const bool valid = entry->isPing() ? entry->ping.isValid(GetTxFunc, IsServiceNodeBlockValidFunc)
+                                           : entry->snode.isValid(GetTxFunc, IsServiceNodeBlockValidFunc);
+        if (valid)
+            *result = VALID;
+        else if (entry->isPing() ? !entry->ping.isSignatureValid() : !entry->snode.isSignatureValid())
+            *result = BAD_SIGNATURE;
+        else
+            *result = REJECTED;
+        return true;
+    }
+
+    void swap(ServiceNodeCheck & check) {
+        std::swap(entry, check.entry);
+        std::swap(result, check.result);
+    }
+
+private:
+    const ServiceNodeVerifyEntry *entry{nullptr};
+    char *result{nullptr};
+};
+
+/**
+ * Servicenode verification queue metrics.
+ */
+struct ServiceNodeVerifyStats {
+    size_t pending{0}; // entries waiting to be verified
+    size_t maxPending{0}; // largest queue depth seen
+    uint64_t batches{0};
+    uint64_t accepted{0};
+    uint64_t rejected{0};
+    int64_t verifyTime{0}; // total time spent verifying batches (microseconds)
+    int64_t lastBatchTime{0}; // time spent verifying the last batch (microseconds)
+};
+
+/** Runs a worker of the servicenode check queue. */
+void ThreadServiceNodeCheck();
+/** Verifies and applies queued servicenode pings and registrations until interrupted. */
+void ThreadServiceNodeVerify();
+
 /**
  * Manages related servicenode functions including handling network messages and storing an active list
  * of valid servicenodes.
  */
 class ServiceNodeMgr : public CValidationInterface {
 public:
-    ServiceNodeMgr() = default;
+    /**
+     * Number of most recent packet hashes remembered by the seen packets filter.
+     */
+    static const unsigned int SEEN_PACKETS_MAX = 350000;
+
+    /**
+     * Maximum number of queued pings and registrations verified in one batch.
+     */
+    static const unsigned int MAX_VERIFY_BATCH = 1000;
+
+    ServiceNodeMgr() : seenPackets(SEEN_PACKETS_MAX, 0.000001),
+                       snapshotPtr(std::make_shared<const ServiceNodeSnapshot>()) {}
 
     /**
      * Singleton instance.
@@ -91,12 +235,16 @@ public:
      * Clears the internal state.
      */
     void reset() {
+        {
+            LOCK(seenPacketsMu);
+            seenPackets.reset();
+        }
         LOCK(mu);
         snodes.clear();
         pings.clear();
-        seenPackets.clear();
         snodeEntries.clear();
         seenBlocks.clear();
+        updateSnapshot();
     }
 
     /**
@@ -193,6 +341,100 @@ public:
         return true;
     }
 
+    /**
+     * Returns true if the hash has already been seen.
+     * @param hash
+     * @return
+     */
+    bool seenPacket(const uint256 & hash) {
+        LOCK(seenPacketsMu);
+        if (seenPackets.contains(hash))
+            return true; // already seen
+        seenPackets.insert(hash); // rolling filter evicts the oldest generation when full
+        return false;
+    }
+
+    /**
+     * Returns true if the packet has already been seen.
+     * @param packet
+     * @return
+     */
+    bool seenPacket(const std::vector<unsigned char> & packet) {
+        const auto & hash = Hash(packet.begin(), packet.end());
+        return seenPacket(hash);
+    }
+
+    /**
+     * Returns true if the hash has already been seen. Unlike seenPacket() this
+     * does not record the hash.
+     * @param hash
+     * @return
+     */
+    bool hasSeenPacket(const uint256 & hash) {
+        LOCK(seenPacketsMu);
+        return seenPackets.contains(hash);
+    }
+
+    /**
+     * Queues a servicenode ping from the network for verification. Signatures and collateral
+     * are checked in parallel on the servicenode check queue and accepted pings are applied in
+     * the order they were queued, after which the handler is called on the verification
+     * thread. If the verification thread isn't running the ping is processed immediately.
+     * Returns false if the ping was already seen.
+     * @param ping
+     * @param handler
+     * @return
+     */
+    bool queuePing(const ServiceNodePing & ping, ServiceNodeVerifyEntry::Handler handler) {
+        if (seenPacket(ping.getHash()))
+            return false;
+        ServiceNodeVerifyEntry entry;
+        entry.ping = ping;
+        entry.handler = std::move(handler);
+        queueEntry(std::move(entry));
+        return true;
+    }
+
+    /**
+     * Queues a servicenode registration from the network for verification, see queuePing().
+     * Returns false if the registration was already seen.
+     * @param snode
+     * @param handler
+     * @return
+     */
+    bool queueRegistration(const ServiceNode & snode, ServiceNodeVerifyEntry::Handler handler) {
+        if (seenPacket(snode.getHash()))
+            return false;
+        ServiceNodeVerifyEntry entry;
+        entry.snode = snode;
+        entry.handler = std::move(handler);
+        queueEntry(std::move(entry));
+        return true;
+    }
+
+    /**
+     * Verifies the entries in parallel on the servicenode check queue and applies the
+     * accepted ones in order.
+     * @param entries
+     */
+    void verifyEntries(std::vector<ServiceNodeVerifyEntry> & entries);
+
+    /**
+     * Processes queued pings and registrations until the thread is interrupted.
+     */
+    void runVerifyQueue();
+
+    /**
+     * Returns the verification queue metrics.
+     * @return
+     */
+    ServiceNodeVerifyStats verifyStats() {
+        boost::unique_lock<boost::mutex> lock(verifyMu);
+        auto stats = verifyStatsData;
+        stats.pending = verifyQueue.size();
+        return stats;
+    }
+
 #ifdef ENABLE_WALLET
     /**
      * Registers a snode on the network. This will also automatically search the wallet for required collateral.
@@ -325,12 +567,8 @@ public:
         }
 
         // Relay
-        connman->ForEachNode([&](CNode* pnode) {
-            if (!pnode->fSuccessfullyConnected)
-                return;
-            const CNetMsgMaker msgMaker(pnode->GetSendVersion());
-            connman->PushMessage(pnode, msgMaker.Make(NetMsgType::SNREGISTER, *snodePtr));
-        });
+        seenPacket(snodePtr->getHash());
+        RelayServiceNodePacket(CInv(MSG_SNREGISTER, snodePtr->getHash()), *snodePtr, connman);
 
         return true;
     }
@@ -349,8 +587,8 @@ public:
         }
 
         const auto & activesn = getActiveSn();
-        const auto & snode = findSn(activesn.key.GetPubKey());
-        if (!snode) {
+        const auto & snodePtr = findSn(activesn.key.GetPubKey());
+        if (!snodePtr) {
             LogPrint(BCLog::SNODE, "service node ping failed, service node not running\n");
             return false;
         }
@@ -358,10 +596,12 @@ public:
         const uint32_t bestBlock = getActiveChainHeight();
         const uint256 & bestBlockHash = getActiveChainHash(bestBlock);
 
-        snode->setConfig(config, Params());
-        snode->updatePing();
+        // Published snodes are immutable, the ping's copy replaces it below
+        ServiceNode snode = *snodePtr;
+        snode.setConfig(config, Params());
+        snode.updatePing();
 
-        ServiceNodePing ping(activesn.key.GetPubKey(), bestBlock, bestBlockHash, static_cast<uint32_t>(GetTime()), config, *snode);
+        ServiceNodePing ping(activesn.key.GetPubKey(), bestBlock, bestBlockHash, static_cast<uint32_t>(GetTime()), config, snode);
         ping.sign(activesn.key);
         if (!ping.isValid(GetTxFunc, IsServiceNodeBlockValidFunc)) {
             LogPrint(BCLog::SNODE, "service node ping failed\n");
@@ -376,12 +616,8 @@ public:
         addSn(ping.getSnode(), false); // skip validity check here because it's checked in the ping's
 
         // Relay
-        connman->ForEachNode([&](CNode* pnode) {
-            if (!pnode->fSuccessfullyConnected)
-                return;
-            const CNetMsgMaker msgMaker(pnode->GetSendVersion());
-            connman->PushMessage(pnode, msgMaker.Make(NetMsgType::SNPING, ping));
-        });
+        seenPacket(ping.getHash());
+        RelayServiceNodePacket(CInv(MSG_SNPING, ping.getHash()), ping, connman);
 
         return true;
     }
@@ -391,10 +627,46 @@ public:
      * @return
      */
     std::vector<ServiceNode> list() {
-        LOCK(mu);
-        std::vector<ServiceNode> l; l.reserve(snodes.size());
-        for (const auto & item : snodes)
-           l.push_back(*item.second);
+        const auto snap = snapshot();
+        std::vector<ServiceNode> l; l.reserve(snap->snodes.size());
+        for (const auto & s : snap->snodes)
+           l.push_back(*s);
+        return l;
+    }
+
+    /**
+     * Returns the most recent servicenode list snapshot. This does not acquire the
+     * manager lock and the returned snapshot is never modified.
+     * @return
+     */
+    ServiceNodeSnapshotPtr snapshot() const {
+        return std::atomic_load(&snapshotPtr);
+    }
+
+    /**
+     * Returns the servicenodes supporting the specified service. Only running servicenodes
+     * are returned unless runningOnly is false. If xbridgeVersion is non-zero only servicenodes
+     * on that xbridge protocol version are returned.
+     * @param service
+     * @param xbridgeVersion
+     * @param runningOnly
+     * @return
+     */
+    std::vector<ServiceNodeConstPtr> getSnodesWithService(const std::string & service, const uint32_t & xbridgeVersion = 0,
+                                                     const bool runningOnly = true) const
+    {
+        const auto snap = snapshot();
+        auto it = snap->services.find(service);
+        if (it == snap->services.end())
+            return {};
+        std::vector<ServiceNodeConstPtr> l; l.reserve(it->second.size());
+        for (const auto & s : it->second) {
+            if (xbridgeVersion > 0 && s->getXBridgeVersion() != xbridgeVersion)
+                continue;
+            if (runningOnly && !s->running())
+                continue;
+            l.push_back(s);
+        }
         return l;
     }
 
@@ -410,6 +682,50 @@ public:
         return pings[snodePubKey];
     }
 
+    /**
+     * Returns the digest of the latest pings of all known servicenodes, used to request only
+     * the missing or stale pings from peers (see ServiceNodeListDigest).
+     * @return
+     */
+    ServiceNodeListDigest listDigest() {
+        LOCK(mu);
+        ServiceNodeListDigest digest;
+        for (const auto & item : snodes) {
+            auto it = pings.find(item.first);
+            if (it == pings.end() || it->second.isNull())
+                continue;
+            digest.pings.emplace_back(ServiceNodeListDigest::snodeId(item.first), it->second.getPingTime());
+        }
+        std::sort(digest.pings.begin(), digest.pings.end());
+        return digest;
+    }
+
+    /**
+     * Returns the latest pings of all known servicenodes that are missing from the specified
+     * digest or newer than the ping listed in it. An empty digest or one with an unknown
+     * version returns all pings.
+     * @param digest
+     * @return
+     */
+    std::vector<ServiceNodePing> getPingsNotIn(const ServiceNodeListDigest & digest) {
+        std::unordered_map<uint64_t, uint32_t> theirs;
+        if (digest.version == ServiceNodeListDigest::CURRENT_VERSION)
+            theirs.insert(digest.pings.begin(), digest.pings.end());
+
+        LOCK(mu);
+        std::vector<ServiceNodePing> r;
+        for (const auto & item : snodes) {
+            auto it = pings.find(item.first);
+            if (it == pings.end() || it->second.isNull())
+                continue;
+            auto th = theirs.find(ServiceNodeListDigest::snodeId(item.first));
+            if (th != theirs.end() && th->second >= it->second.getPingTime())
+                continue; // requester already has this ping or a newer one
+            r.push_back(it->second);
+        }
+        return r;
+    }
+
     /**
      * Returns the servicenode with the specified pubkey.
      * @param snodePubKey
@@ -437,11 +753,11 @@ public:
      * @return
      */
     ServiceNode getSn(const std::string & nodeAddr) {
-        LOCK(mu);
-        for (const auto & s : snodes)
-            if (s.second->getHostPort() == nodeAddr)
-                return *s.second;
-        return ServiceNode{};
+        const auto snap = snapshot();
+        auto it = snap->hosts.find(nodeAddr);
+        if (it == snap->hosts.end())
+            return ServiceNode{};
+        return *it->second;
     }
 
     /**
@@ -518,6 +834,7 @@ public:
         for (const auto & entry : snodeEntries)
             snodes.erase(entry.key.GetPubKey());
         snodeEntries.clear();
+        updateSnapshot();
     }
 
     /**
@@ -834,6 +1151,38 @@ protected:
 
 protected:
 
+    /**
+     * Adds the entry to the verification queue, or verifies it right away if the
+     * verification thread isn't running.
+     * @param entry
+     */
+    void queueEntry(ServiceNodeVerifyEntry && entry) {
+        if (!verifyRunning) {
+            std::vector<ServiceNodeVerifyEntry> entries;
+            entries.push_back(std::move(entry));
+            verifyEntries(entries);
+            return;
+        }
+        boost::unique_lock<boost::mutex> lock(verifyMu);
+        verifyQueue.push_back(std::move(entry));
+        verifyStatsData.maxPending = std::max(verifyStatsData.maxPending, verifyQueue.size());
+        verifyCond.notify_one();
+    }
+
+    /**
+     * Applies a verified ping or registration and returns the added snode, otherwise
+     * returns nullptr.
+     * @param entry
+     * @return
+     */
+    ServiceNodeConstPtr applyEntry(const ServiceNodeVerifyEntry & entry) {
+        if (!entry.isPing())
+            return addSn(entry.snode, false); // already validated
+        if (!addPing(entry.ping))
+            return nullptr;
+        return addSn(entry.ping.getSnode(), false); // skip validity check here because it's checked in the ping's
+    }
+
     /**
      * Add the service node ping. Returns true if the ping was added, otherwise returns
      * false.
@@ -858,14 +1207,15 @@ protected:
      * @param staleCheck default true, skips stale check if false
      * @return
      */
-    ServiceNodePtr addSn(const ServiceNode & snode, const bool checkValid = true, const bool staleCheck = true) {
+    ServiceNodeConstPtr addSn(const ServiceNode & snode, const bool checkValid = true, const bool staleCheck = true) {
         if (checkValid && !snode.isValid(GetTxFunc, IsServiceNodeBlockValidFunc, staleCheck))
             return nullptr;
-        removeSnWithCollateral(snode);
         auto ptr = std::make_shared<ServiceNode>(snode);
         {
             LOCK(mu);
+            removeSnWithCollateral(snode);
             snodes[ptr->getSnodePubKey()] = ptr;
+            updateSnapshot();
         }
         return ptr;
     }
@@ -875,7 +1225,7 @@ protected:
      * @param snodePubKey
      * @return
      */
-    ServiceNodePtr findSn(const CPubKey & snodePubKey) {
+    ServiceNodeConstPtr findSn(const CPubKey & snodePubKey) {
         LOCK(mu);
         if (snodes.count(snodePubKey))
             return snodes[snodePubKey];
@@ -887,7 +1237,7 @@ protected:
      * @param snodePubKey
      * @return
      */
-    ServiceNodePtr findSn(const std::vector<unsigned char> & snodePubKey) {
+    ServiceNodeConstPtr findSn(const std::vector<unsigned char> & snodePubKey) {
         return findSn(CPubKey(snodePubKey));
     }
 
@@ -901,6 +1251,7 @@ protected:
             return false;
         LOCK(mu);
         snodes.erase(snodePubKey);
+        updateSnapshot();
         return true;
     }
 
@@ -914,31 +1265,6 @@ protected:
         return snodes.count(snodePubKey) > 0;
     }
 
-    /**
-     * Returns true if the hash has already been seen.
-     * @param hash
-     * @return
-     */
-    bool seenPacket(const uint256 & hash) {
-        LOCK(mu);
-        if (seenPackets.count(hash))
-            return true; // already seen
-        if (seenPackets.size() > 350000)
-            seenPackets.clear(); // mem mgmt, ~12MB (32bytes * 350k)
-        seenPackets.insert(hash);
-        return false;
-    }
-
-    /**
-     * Returns true if the packet has already been seen.
-     * @param packet
-     * @return
-     */
-    bool seenPacket(const std::vector<unsigned char> & packet) {
-        const auto & hash = Hash(packet.begin(), packet.end());
-        return seenPacket(hash);
-    }
-
     /**
      * Removes existing snodes that match the collateral utxos of
      * the specified snode. i.e. This method will mutate the snode
@@ -947,9 +1273,8 @@ protected:
      * pointing to the same collateral inputs.
      * @param snode
      */
-    void removeSnWithCollateral(const ServiceNode & snode) {
-        LOCK(mu);
-        std::map<COutPoint, ServiceNodePtr> utxos;
+    void removeSnWithCollateral(const ServiceNode & snode) EXCLUSIVE_LOCKS_REQUIRED(mu) {
+        std::map<COutPoint, ServiceNodeConstPtr> utxos;
         for (const auto & item : snodes) {
             const auto & s = item.second;
             if (s->getSnodePubKey() != snode.getSnodePubKey()) { // exclude specified snode
@@ -1167,8 +1492,12 @@ protected:
         {
             LOCK(mu);
             // Update current block number on snode list
-            for (auto & item : snodes)
-                item.second->setCurrentBlock(pindexNew->nHeight);
+            for (auto & item : snodes) {
+                auto snode = std::make_shared<ServiceNode>(*item.second);
+                snode->setCurrentBlock(pindexNew->nHeight);
+                item.second = snode;
+            }
+            updateSnapshot();
             // copy entries
             entries = snodeEntries;
         }
@@ -1227,30 +1556,67 @@ protected:
         // Check that existing snodes are valid
         {
             LOCK(mu);
+            bool changed{false};
             for (auto & item : snodes) {
-                auto snode = item.second;
-                for (const auto & collateral : snode->getCollateral()) {
+                bool spentCollateral{false};
+                for (const auto & collateral : item.second->getCollateral()) {
                     if (spent.count(collateral)) {
-                        snode->markInvalid(true, blockNumber);
+                        spentCollateral = true;
                         break;
                     }
                 }
+                if (connected && !spentCollateral)
+                    continue;
+                // Update a copy, published snodes are immutable
+                auto snode = std::make_shared<ServiceNode>(*item.second);
+                if (spentCollateral)
+                    snode->markInvalid(true, blockNumber);
                 // Re-validate snodes on potential reorg (on block disconnected)
                 if (!connected) {
                     snode->markInvalid(false); // reset state before is valid check
                     snode->markInvalid(!snode->isValid(GetTxFunc, IsServiceNodeBlockValidFunc));
                 }
+                item.second = snode;
+                changed = true;
             }
+            if (changed)
+                updateSnapshot();
+        }
+    }
+
+    /**
+     * Publishes a new snapshot of the servicenode list. Must be called after every
+     * modification to the snodes map.
+     */
+    void updateSnapshot() EXCLUSIVE_LOCKS_REQUIRED(mu) {
+        auto snap = std::make_shared<ServiceNodeSnapshot>();
+        snap->snodes.reserve(snodes.size());
+        for (const auto & item : snodes) {
+            const auto & s = item.second;
+            snap->snodes.push_back(s);
+            for (const auto & service : s->serviceList())
+                snap->services[service].push_back(s);
+            const auto & hostPort = s->getHostPort();
+            if (!hostPort.empty())
+                snap->hosts.emplace(hostPort, s);
         }
+        std::atomic_store(&snapshotPtr, ServiceNodeSnapshotPtr(std::move(snap)));
     }
 
 protected:
     Mutex mu;
-    std::map<CPubKey, ServiceNodePtr> snodes;
+    std::map<CPubKey, ServiceNodeConstPtr> snodes; // copy-on-write, see ServiceNodeSnapshot
     std::unordered_map<CPubKey, ServiceNodePing, Hasher> pings;
-    std::set<uint256> seenPackets;
     std::set<ServiceNodeConfigEntry> snodeEntries;
     std::vector<int> seenBlocks;
+    Mutex seenPacketsMu;
+    CRollingBloomFilter seenPackets GUARDED_BY(seenPacketsMu); // remembers at least the last SEEN_PACKETS_MAX hashes
+    ServiceNodeSnapshotPtr snapshotPtr; // use std::atomic_load/std::atomic_store
+    boost::mutex verifyMu; // boost primitives so that waiting is a thread interruption point
+    boost::condition_variable verifyCond;
+    std::deque<ServiceNodeVerifyEntry> verifyQueue;
+    ServiceNodeVerifyStats verifyStatsData;
+    std::atomic<bool> verifyRunning{false};
 };
 
 }
@@ -198,7 +198,8 @@ bool StakeMgr::StakeBlock(const StakeCoin & stakeCoin, const CChainParams & chai
     try {
         auto pblocktemplate = BlockAssembler(chainparams).CreateNewBlockPoS(*stakeCoin.coin, stakeCoin.hashBlock,
                                                                             stakeCoin.time, stakeCoin.blockTime,
-                                                                            stakeCoin.wallet.get());
+                                                                            stakeCoin.wallet.get(), false,
+                                                                            g_blocktxpreselector ? g_blocktxpreselector->Get() : nullptr);
         if (!pblocktemplate)
             return false;
         auto pblock = std::make_shared<const CBlock>(pblocktemplate->block);
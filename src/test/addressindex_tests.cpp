@@ -0,0 +1,175 @@
+// Copyright (c) 2020 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <consensus/validation.h>
+#include <index/addressindex.h>
+#include <index/spentindex.h>
+#include <script/interpreter.h>
+#include <script/standard.h>
+#include <test/test_bitcoin.h>
+#include <util/time.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(addressindex_tests)
+
+template <typename Index>
+static void WaitForIndexSync(Index& index)
+{
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!index.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        MilliSleep(100);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(addressindex_spentindex_connect_disconnect, TestChain100Setup)
+{
+    AddressIndex address_index(1 << 20, true);
+    SpentIndex spent_index(1 << 20, true);
+
+    const CScript coinbase_script = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    const uint256 coinbase_hash = AddressIndexScriptHash(coinbase_script);
+
+    CAmount coinbase_total = 0;
+    for (const auto& tx : m_coinbase_txns) {
+        for (const auto& out : tx->vout) {
+            if (out.scriptPubKey == coinbase_script) coinbase_total += out.nValue;
+        }
+    }
+
+    address_index.Start();
+    spent_index.Start();
+    WaitForIndexSync(address_index);
+    WaitForIndexSync(spent_index);
+
+    // All coinbase outputs of the test chain are unspent
+    CAmount balance, received;
+    std::vector<CAddressUnspentEntry> unspent;
+    std::vector<CAddressIndexEntry> history;
+    BOOST_CHECK(address_index.GetBalance(coinbase_hash, balance, received));
+    BOOST_CHECK_EQUAL(balance, coinbase_total);
+    BOOST_CHECK_EQUAL(received, coinbase_total);
+    BOOST_CHECK(address_index.GetUnspent(coinbase_hash, unspent));
+    BOOST_CHECK_EQUAL(unspent.size(), m_coinbase_txns.size());
+    BOOST_CHECK(address_index.GetHistory(coinbase_hash, history));
+    BOOST_CHECK_EQUAL(history.size(), m_coinbase_txns.size());
+    for (size_t i = 1; i < history.size(); ++i)
+        BOOST_CHECK(history[i - 1].height <= history[i].height);
+    BOOST_CHECK(address_index.GetHistory(coinbase_hash, history, 10, 19));
+    BOOST_CHECK_EQUAL(history.size(), 10);
+
+    // Spend the first coinbase to a new key, the block reward goes elsewhere
+    CKey dest_key;
+    dest_key.MakeNewKey(true);
+    const CScript dest_script = GetScriptForDestination(dest_key.GetPubKey().GetID());
+    const uint256 dest_hash = AddressIndexScriptHash(dest_script);
+    CKey other_key;
+    other_key.MakeNewKey(true);
+    const CScript other_script = GetScriptForDestination(other_key.GetPubKey().GetID());
+
+    const CTransactionRef& spent_coinbase = m_coinbase_txns[0];
+    const CAmount spent_value = spent_coinbase->vout[0].nValue;
+    const CAmount send_value = spent_value - 10000;
+
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = COutPoint(spent_coinbase->GetHash(), 0);
+    spend.vout.resize(1);
+    spend.vout[0].nValue = send_value;
+    spend.vout[0].scriptPubKey = dest_script;
+    std::vector<unsigned char> sig;
+    uint256 sighash = SignatureHash(coinbase_script, spend, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+    BOOST_REQUIRE(coinbaseKey.Sign(sighash, sig));
+    sig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << sig;
+
+    const CBlock spend_block = CreateAndProcessBlock({spend}, other_script);
+    int spend_height;
+    {
+        LOCK(cs_main);
+        BOOST_REQUIRE_EQUAL(chainActive.Tip()->GetBlockHash(), spend_block.GetHash());
+        spend_height = chainActive.Height();
+    }
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK(address_index.BlockUntilSyncedToCurrentChain());
+    BOOST_CHECK(spent_index.BlockUntilSyncedToCurrentChain());
+
+    BOOST_CHECK(address_index.GetBalance(coinbase_hash, balance, received));
+    BOOST_CHECK_EQUAL(balance, coinbase_total - spent_value);
+    BOOST_CHECK_EQUAL(received, coinbase_total);
+    BOOST_CHECK(address_index.GetHistory(coinbase_hash, history, spend_height));
+    BOOST_REQUIRE_EQUAL(history.size(), 1);
+    BOOST_CHECK(history[0].spending);
+    BOOST_CHECK_EQUAL(history[0].amount, -spent_value);
+    BOOST_CHECK_EQUAL(history[0].txhash, spend.GetHash());
+
+    BOOST_CHECK(address_index.GetBalance(dest_hash, balance, received));
+    BOOST_CHECK_EQUAL(balance, send_value);
+    BOOST_CHECK_EQUAL(received, send_value);
+    BOOST_CHECK(address_index.GetUnspent(dest_hash, unspent));
+    BOOST_REQUIRE_EQUAL(unspent.size(), 1);
+    BOOST_CHECK(unspent[0].outpoint == COutPoint(spend.GetHash(), 0));
+    BOOST_CHECK(unspent[0].script == dest_script);
+    BOOST_CHECK_EQUAL(unspent[0].height, spend_height);
+
+    CSpentIndexValue spent_info;
+    BOOST_CHECK(spent_index.GetSpentInfo(spend.vin[0].prevout, spent_info));
+    BOOST_CHECK_EQUAL(spent_info.txid, spend.GetHash());
+    BOOST_CHECK_EQUAL(spent_info.input_index, 0);
+    BOOST_CHECK_EQUAL(spent_info.height, spend_height);
+    BOOST_CHECK_EQUAL(spent_info.amount, spent_value);
+    BOOST_CHECK_EQUAL(spent_info.script_hash, coinbase_hash);
+    BOOST_CHECK(!spent_index.GetSpentInfo(COutPoint(spend.GetHash(), 0), spent_info));
+
+    // Reorg the spend out, both indexes roll it back once the competing branch connects
+    {
+        CValidationState state;
+        {
+            LOCK(cs_main);
+            BOOST_REQUIRE(InvalidateBlock(state, Params(), chainActive.Tip()));
+        }
+        BOOST_REQUIRE(ActivateBestChain(state, Params()));
+        mempool.clear();
+    }
+    for (int i = 0; i < 2; ++i)
+        CreateAndProcessBlock({}, other_script);
+    SyncWithValidationInterfaceQueue();
+    WaitForIndexSync(address_index);
+    WaitForIndexSync(spent_index);
+
+    BOOST_CHECK(address_index.GetBalance(coinbase_hash, balance, received));
+    BOOST_CHECK_EQUAL(balance, coinbase_total);
+    BOOST_CHECK_EQUAL(received, coinbase_total);
+    BOOST_CHECK(address_index.GetUnspent(coinbase_hash, unspent));
+    BOOST_CHECK_EQUAL(unspent.size(), m_coinbase_txns.size());
+    BOOST_CHECK(address_index.GetHistory(coinbase_hash, history, spend_height));
+    BOOST_CHECK(history.empty());
+
+    BOOST_CHECK(address_index.GetBalance(dest_hash, balance, received));
+    BOOST_CHECK_EQUAL(balance, 0);
+    BOOST_CHECK_EQUAL(received, 0);
+    BOOST_CHECK(address_index.GetUnspent(dest_hash, unspent));
+    BOOST_CHECK(unspent.empty());
+    BOOST_CHECK(!spent_index.GetSpentInfo(spend.vin[0].prevout, spent_info));
+
+    // The new branch is indexed
+    BOOST_CHECK(address_index.GetHistory(AddressIndexScriptHash(other_script), history));
+    BOOST_CHECK_EQUAL(history.size(), 2);
+
+    // shutdown sequence (c.f. Shutdown() in init.cpp)
+    address_index.Stop();
+    spent_index.Stop();
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+
+    // Rest of shutdown sequence and destructors happen in ~TestingSetup()
+}
+
+BOOST_AUTO_TEST_SUITE_END()
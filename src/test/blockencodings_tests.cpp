@@ -321,6 +321,97 @@ BOOST_AUTO_TEST_CASE(EmptyBlockRoundTripTest)
     }
 }
 
+BOOST_AUTO_TEST_CASE(ProofOfStakeRoundTripTest)
+{
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+
+    // PoS block: empty coinbase, coinstake and two mempool transactions
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].scriptSig.resize(10);
+    coinbase.vout.resize(1);
+    coinbase.vout[0].nValue = 0;
+
+    CMutableTransaction coinstake;
+    coinstake.vin.resize(1);
+    coinstake.vin[0].prevout.hash = InsecureRand256();
+    coinstake.vin[0].prevout.n = 0;
+    coinstake.vout.resize(2);
+    coinstake.vout[0].nValue = 0;
+    coinstake.vout[1].nValue = 42;
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig.resize(10);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 42;
+
+    CBlock block;
+    block.vtx.resize(4);
+    block.vtx[0] = MakeTransactionRef(coinbase);
+    block.vtx[1] = MakeTransactionRef(coinstake);
+    for (size_t i = 2; i < block.vtx.size(); i++) {
+        tx.vin[0].prevout.hash = InsecureRand256();
+        block.vtx[i] = MakeTransactionRef(tx);
+    }
+    block.nVersion = 42;
+    block.hashPrevBlock = InsecureRand256();
+    block.nBits = 0x207fffff;
+    block.nNonce = 1; // staking protocol v06 requires a non-zero nonce
+    block.vchBlockSig = {0x30, 0x44, 0x02, 0x20, 0x01, 0x02, 0x03};
+
+    bool mutated;
+    block.hashMerkleRoot = BlockMerkleRoot(block, &mutated);
+    assert(!mutated);
+    while (!CheckProofOfWork(block.GetHash(), block.nBits, Params().GetConsensus())) ++block.nNonce;
+    BOOST_CHECK(block.IsProofOfStake());
+
+    LOCK2(cs_main, pool.cs);
+    pool.addUnchecked(entry.FromTx(block.vtx[2]));
+    pool.addUnchecked(entry.FromTx(block.vtx[3]));
+
+    // The legacy encoding loses the block signature
+    {
+        CBlockHeaderAndShortTxIDs shortIDs(block, true);
+        BOOST_CHECK_EQUAL(shortIDs.BlockTxCount(), block.vtx.size());
+        CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+        stream << shortIDs;
+        CBlockHeaderAndShortTxIDs shortIDs2;
+        stream >> shortIDs2;
+        BOOST_CHECK(shortIDs2.vchBlockSig.empty());
+
+        PartiallyDownloadedBlock partialBlock(&pool);
+        BOOST_CHECK(partialBlock.InitData(shortIDs2, extra_txn) == READ_STATUS_OK);
+        BOOST_CHECK(!partialBlock.IsTxAvailable(1));
+    }
+
+    // The PoS-aware encoding prefills the coinstake and carries the signature
+    {
+        CBlockHeaderAndShortTxIDs shortIDs(block, true, true);
+        BOOST_CHECK_EQUAL(shortIDs.BlockTxCount(), block.vtx.size());
+        CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+        stream << shortIDs;
+        CBlockHeaderAndShortTxIDs shortIDs2(true);
+        stream >> shortIDs2;
+        BOOST_CHECK(stream.empty());
+        BOOST_CHECK(shortIDs2.vchBlockSig == block.vchBlockSig);
+
+        PartiallyDownloadedBlock partialBlock(&pool);
+        BOOST_CHECK(partialBlock.InitData(shortIDs2, extra_txn) == READ_STATUS_OK);
+        for (size_t i = 0; i < block.vtx.size(); i++)
+            BOOST_CHECK(partialBlock.IsTxAvailable(i));
+
+        CBlock block2;
+        BOOST_CHECK(partialBlock.FillBlock(block2, {}) == READ_STATUS_OK);
+        BOOST_CHECK_EQUAL(block.GetHash().ToString(), block2.GetHash().ToString());
+        BOOST_CHECK(block2.vchBlockSig == block.vchBlockSig);
+        BOOST_CHECK(block2.vtx[1]->GetHash() == block.vtx[1]->GetHash());
+        BOOST_CHECK_EQUAL(block.hashMerkleRoot.ToString(), BlockMerkleRoot(block2, &mutated).ToString());
+        BOOST_CHECK(!mutated);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(TransactionsRequestSerializationTest) {
     BlockTransactionsRequest req1;
     req1.blockhash = InsecureRand256();
@@ -10,6 +10,14 @@
 #include <crypto/sha512.h>
 #include <crypto/hmac_sha256.h>
 #include <crypto/hmac_sha512.h>
+#include <crypto/quark.h>
+#include <crypto/sph_blake.h>
+#include <crypto/sph_bmw.h>
+#include <crypto/sph_groestl.h>
+#include <crypto/sph_jh.h>
+#include <crypto/sph_keccak.h>
+#include <crypto/sph_skein.h>
+#include <primitives/block.h>
 #include <random.h>
 #include <util/strencodings.h>
 #include <test/test_bitcoin.h>
@@ -562,4 +570,104 @@ BOOST_AUTO_TEST_CASE(sha256d64)
     }
 }
 
+/** Quark chained over the plain sph implementations. */
+static void QuarkReference(unsigned char* out, const unsigned char* in, size_t len)
+{
+    unsigned char a[64], b[64];
+    sph_blake512_context blake;
+    sph_bmw512_context bmw;
+    sph_groestl512_context groestl;
+    sph_jh512_context jh;
+    sph_keccak512_context keccak;
+    sph_skein512_context skein;
+
+    sph_blake512_init(&blake); sph_blake512(&blake, in, len); sph_blake512_close(&blake, a);
+    sph_bmw512_init(&bmw); sph_bmw512(&bmw, a, 64); sph_bmw512_close(&bmw, b);
+    if (b[0] & 8) {
+        sph_groestl512_init(&groestl); sph_groestl512(&groestl, b, 64); sph_groestl512_close(&groestl, a);
+    } else {
+        sph_skein512_init(&skein); sph_skein512(&skein, b, 64); sph_skein512_close(&skein, a);
+    }
+    sph_groestl512_init(&groestl); sph_groestl512(&groestl, a, 64); sph_groestl512_close(&groestl, b);
+    sph_jh512_init(&jh); sph_jh512(&jh, b, 64); sph_jh512_close(&jh, a);
+    if (a[0] & 8) {
+        sph_blake512_init(&blake); sph_blake512(&blake, a, 64); sph_blake512_close(&blake, b);
+    } else {
+        sph_bmw512_init(&bmw); sph_bmw512(&bmw, a, 64); sph_bmw512_close(&bmw, b);
+    }
+    sph_keccak512_init(&keccak); sph_keccak512(&keccak, b, 64); sph_keccak512_close(&keccak, a);
+    sph_skein512_init(&skein); sph_skein512(&skein, a, 64); sph_skein512_close(&skein, b);
+    if (b[0] & 8) {
+        sph_keccak512_init(&keccak); sph_keccak512(&keccak, b, 64); sph_keccak512_close(&keccak, a);
+    } else {
+        sph_jh512_init(&jh); sph_jh512(&jh, b, 64); sph_jh512_close(&jh, a);
+    }
+    memcpy(out, a, 32);
+}
+
+BOOST_AUTO_TEST_CASE(quark)
+{
+    for (int i = 0; i <= 32; ++i) {
+        unsigned char in[QUARK_HEADER_SIZE * 32];
+        unsigned char out1[32 * 32], out2[32 * 32], out3[32 * 32];
+        for (size_t j = 0; j < QUARK_HEADER_SIZE * i; ++j) {
+            in[j] = InsecureRandBits(8);
+        }
+        for (int j = 0; j < i; ++j) {
+            QuarkReference(out1 + 32 * j, in + QUARK_HEADER_SIZE * j, QUARK_HEADER_SIZE);
+            QuarkHash(out2 + 32 * j, in + QUARK_HEADER_SIZE * j, QUARK_HEADER_SIZE);
+        }
+        QuarkHash80(out3, in, i);
+        BOOST_CHECK(memcmp(out1, out2, 32 * i) == 0);
+        BOOST_CHECK(memcmp(out1, out3, 32 * i) == 0);
+    }
+    // Other lengths only go through the single hash
+    std::vector<unsigned char> data(InsecureRandRange(300));
+    for (auto & c : data)
+        c = InsecureRandBits(8);
+    unsigned char out1[32], out2[32];
+    QuarkReference(out1, data.data(), data.size());
+    QuarkHash(out2, data.data(), data.size());
+    BOOST_CHECK(memcmp(out1, out2, 32) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(blockheader_hash_cache)
+{
+    std::vector<CBlockHeader> headers(9);
+    for (auto & header : headers) {
+        header.nVersion = InsecureRand32();
+        header.hashPrevBlock = InsecureRand256();
+        header.hashMerkleRoot = InsecureRand256();
+        header.nTime = InsecureRand32();
+        header.nBits = InsecureRand32();
+        header.nNonce = InsecureRand32();
+    }
+    std::vector<uint256> expected;
+    for (const auto & header : headers)
+        expected.push_back(header.GetHash());
+
+    CacheBlockHeaderHashes(headers);
+    for (size_t i = 0; i < headers.size(); ++i) {
+        BOOST_CHECK(headers[i].fHashCached);
+        BOOST_CHECK(headers[i].GetHash() == expected[i]);
+    }
+
+    // Modifying a hashed field invalidates the memoized hash
+    CBlockHeader header = headers[0];
+    ++header.nNonce;
+    BOOST_CHECK(header.GetHash() != expected[0]);
+    header.CacheHash();
+    --header.nNonce;
+    BOOST_CHECK(header.GetHash() == expected[0]);
+
+    // Deserialized blocks carry their hash
+    CBlock block(headers[1]);
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << block;
+    CBlock block2;
+    ss >> block2;
+    BOOST_CHECK(block2.fHashCached);
+    BOOST_CHECK(block2.GetHash() == expected[1]);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
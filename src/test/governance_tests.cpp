@@ -1571,6 +1571,13 @@ BOOST_FIXTURE_TEST_CASE(governance_tests_submissions, TestChainPoS)
                 gov::Vote vote({txn->GetHash(), static_cast<uint32_t>(n)}, block.GetBlockTime());
                 ss2 >> vote;
                 bool valid = vote.loadVoteUTXO() && vote.isValid(vinHashes, consensus);
+                // The batched utxo resolver must agree with the per-vote lookups
+                gov::VoteUTXOMap utxos;
+                gov::ResolveVoteUTXOs({vote.getUtxo()}, utxos);
+                gov::Vote resolvedVote = vote;
+                BOOST_CHECK_EQUAL(resolvedVote.loadVoteUTXO(utxos) && resolvedVote.isValid(vinHashes, consensus), valid);
+                BOOST_CHECK_EQUAL(gov::IsVoteSpent(utxos[vote.getUtxo()], chainActive.Height(), consensus.governanceBlock),
+                                  gov::IsVoteSpent(vote, chainActive.Height(), consensus.governanceBlock, false));
                 BOOST_CHECK_MESSAGE(vote.getProposal() == proposal.getHash(), "Vote data should match the expected proposal hash");
                 BOOST_CHECK_MESSAGE(vote.getVote() == proposalVote.vote, "Vote data should match the expected vote type");
                 if (vote.getUtxo() == block.vtx[1]->vin[0].prevout) { // staked inputs associated with votes should be invalid
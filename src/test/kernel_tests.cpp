@@ -0,0 +1,144 @@
+// Copyright (c) 2020 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <hash.h>
+#include <kernel.h>
+#include <streams.h>
+#include <test/test_bitcoin.h>
+
+#include <deque>
+#include <map>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(kernel_tests, BasicTestingSetup)
+
+/** Synthetic header chain, timestamps are not monotonic like on the network */
+struct HeaderChain {
+    std::deque<CBlockIndex> headers;
+    std::deque<uint256> hashes;
+
+    CBlockIndex* Add(CBlockIndex* prev, int64_t time) {
+        hashes.push_back(InsecureRand256());
+        headers.emplace_back();
+        CBlockIndex* pindex = &headers.back();
+        pindex->phashBlock = &hashes.back();
+        pindex->pprev = prev;
+        pindex->nHeight = prev ? prev->nHeight + 1 : 0;
+        pindex->nTime = time;
+        pindex->hashProofOfStake = InsecureRand256();
+        pindex->SetStakeEntropyBit(InsecureRandBool());
+        uint64_t modifier = 0;
+        bool generated = false;
+        BOOST_REQUIRE(ComputeNextStakeModifier(prev, modifier, generated, Params().GetConsensus()));
+        pindex->SetStakeModifier(modifier, generated);
+        return pindex;
+    }
+};
+
+// Stake modifier computation that walks back over the whole selection interval for every header
+static uint64_t ReferenceStakeModifier(const CBlockIndex* pindexPrev, bool& generated)
+{
+    generated = true;
+    if (pindexPrev->nHeight == 0)
+        return uint64_t("stakemodifier");
+
+    const CBlockIndex* pindex = pindexPrev;
+    while (pindex->pprev && !pindex->GeneratedStakeModifier())
+        pindex = pindex->pprev;
+    const uint64_t modifier = pindex->nStakeModifier;
+    if (pindex->GetBlockTime() / 60 >= pindexPrev->GetBlockTime() / 60) {
+        generated = false;
+        return modifier;
+    }
+
+    auto section = [](int n) -> int64_t { return 60 * 63 / (63 + ((63 - n) * 2)); };
+    int64_t interval = 0;
+    for (int n = 0; n < 64; ++n)
+        interval += section(n);
+    const int64_t start = (pindexPrev->GetBlockTime() / 60) * 60 - interval;
+    std::vector<const CBlockIndex*> candidates;
+    for (pindex = pindexPrev; pindex && pindex->GetBlockTime() >= start; pindex = pindex->pprev)
+        candidates.push_back(pindex);
+    std::sort(candidates.begin(), candidates.end(), [](const CBlockIndex* a, const CBlockIndex* b) {
+        if (a->GetBlockTime() == b->GetBlockTime())
+            return UintToArith256(a->GetBlockHash()) < UintToArith256(b->GetBlockHash());
+        return a->GetBlockTime() < b->GetBlockTime();
+    });
+
+    const bool v2 = candidates[0]->nHeight >= Params().GetConsensus().stakingModiferV2Block;
+    const bool v3 = IsProtocolV05(candidates[0]->GetBlockTime());
+    uint64_t modifierNew = 0;
+    int64_t stop = start;
+    std::map<uint256, const CBlockIndex*> selected;
+    for (int round = 0; round < std::min(64, (int)candidates.size()); ++round) {
+        stop += section(round);
+        const CBlockIndex* best = nullptr;
+        arith_uint256 hashBest;
+        for (const CBlockIndex* candidate : candidates) {
+            if (best && candidate->GetBlockTime() > stop)
+                break;
+            if (selected.count(candidate->GetBlockHash()))
+                continue;
+            uint256 proof = v3 ? candidate->hashProofOfStake : v2 ? candidate->GetBlockHash()
+                          : IsProofOfStake(candidate->nHeight) ? uint256() : candidate->GetBlockHash();
+            CDataStream ss(SER_GETHASH, 0);
+            ss << proof << modifier;
+            arith_uint256 hashSelection = UintToArith256(Hash(ss.begin(), ss.end()));
+            if (IsProofOfStake(candidate->nHeight))
+                hashSelection >>= 32;
+            if (!best || hashSelection < hashBest) {
+                best = candidate;
+                hashBest = hashSelection;
+            }
+        }
+        if (best->GetStakeEntropyBit())
+            modifierNew |= 1ULL << round;
+        selected.emplace(best->GetBlockHash(), best);
+    }
+    return modifierNew;
+}
+
+BOOST_AUTO_TEST_CASE(stake_modifier_sliding_window)
+{
+    SeedInsecureRand(true);
+    ResetStakeModifierCandidates();
+    HeaderChain chain;
+
+    // Spans the PoW to PoS switch and the V05 protocol upgrade
+    const int64_t start_time = Params().GetConsensus().stakingV05UpgradeTime - 2500 * 60;
+    CBlockIndex* tip = chain.Add(nullptr, start_time);
+    CBlockIndex* fork = nullptr;
+    for (int i = 0; i < 5000; ++i) {
+        // Mostly increasing timestamps, sometimes a header is older than its parent
+        tip = chain.Add(tip, tip->GetBlockTime() + static_cast<int64_t>(InsecureRandRange(150)) - 30);
+        if (i == 3000)
+            fork = tip;
+    }
+
+    // A competing branch makes the next computation start over
+    for (int i = 0; i < 200; ++i)
+        fork = chain.Add(fork, fork->GetBlockTime() + static_cast<int64_t>(InsecureRandRange(150)) - 30);
+    // A jump back in time moves the selection interval below the candidate window
+    tip = chain.Add(tip, tip->GetBlockTime() - 1000);
+    tip = chain.Add(tip, tip->GetBlockTime() + 30);
+
+    int generated = 0;
+    for (const CBlockIndex& header : chain.headers) {
+        if (!header.pprev)
+            continue;
+        bool expected_generated;
+        const uint64_t expected = ReferenceStakeModifier(header.pprev, expected_generated);
+        BOOST_CHECK_EQUAL(header.nStakeModifier, expected);
+        BOOST_CHECK_EQUAL(header.GeneratedStakeModifier(), expected_generated);
+        if (expected_generated)
+            ++generated;
+    }
+    BOOST_CHECK(generated > 1000);
+
+    ResetStakeModifierCandidates();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,113 @@
+// Copyright (c) 2020 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <miner.h>
+#include <pow.h>
+#include <streams.h>
+#include <test/test_bitcoin.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(loadblock_tests, TestChain100Setup)
+
+/** Mine a chain of blocks on top of the tip without processing them */
+static std::vector<CBlock> MineBlocks(const CBlock& tmpl, const CBlockIndex* tip, int count)
+{
+    std::vector<CBlock> blocks;
+    // Headers of the blocks mined so far, for the difficulty of the next block
+    std::deque<CBlockIndex> headers;
+    std::deque<uint256> hashes;
+    const CBlockIndex* prev = tip;
+    for (int i = 0; i < count; ++i) {
+        CBlock block = tmpl;
+        block.hashPrevBlock = prev->GetBlockHash();
+        block.nTime = prev->nTime + 1;
+        block.nBits = GetNextWorkRequired(prev, &block, Params().GetConsensus());
+        unsigned int extra_nonce = 0;
+        IncrementExtraNonce(&block, prev, extra_nonce);
+        while (!CheckProofOfWork(block.GetHash(), block.nBits, Params().GetConsensus())) ++block.nNonce;
+        blocks.push_back(block);
+
+        hashes.push_back(block.GetHash());
+        headers.emplace_back(block);
+        headers.back().phashBlock = &hashes.back();
+        headers.back().pprev = const_cast<CBlockIndex*>(prev);
+        headers.back().nHeight = prev->nHeight + 1;
+        prev = &headers.back();
+    }
+    return blocks;
+}
+
+static void WriteRecord(CDataStream& ss, const std::vector<unsigned char>& data)
+{
+    ss.write((const char*)Params().MessageStart(), CMessageHeader::MESSAGE_START_SIZE);
+    ss << (unsigned int)data.size();
+    ss.write((const char*)data.data(), data.size());
+}
+
+static std::vector<unsigned char> Serialize(const CBlock& block)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << block;
+    return std::vector<unsigned char>(ss.begin(), ss.end());
+}
+
+BOOST_AUTO_TEST_CASE(loadblock_pipeline)
+{
+    const CScript script = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CBlockIndex* tip;
+    {
+        LOCK(cs_main);
+        tip = chainActive.Tip();
+    }
+    const CBlock tmpl = BlockAssembler(Params()).CreateNewBlock(script)->block;
+
+    const std::vector<CBlock> blocks = MineBlocks(tmpl, tip, 6);
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << std::vector<unsigned char>(100, 0x42); // garbage before the first record
+    WriteRecord(ss, Serialize(blocks[0]));
+    WriteRecord(ss, Serialize(blocks[1]));
+    // A record that doesn't decode and whose size covers the next block, scanning resumes inside it
+    std::vector<unsigned char> bad(120, 0xff);
+    CDataStream next(SER_DISK, CLIENT_VERSION);
+    WriteRecord(next, Serialize(blocks[2]));
+    bad.insert(bad.end(), next.begin(), next.end());
+    WriteRecord(ss, bad);
+    // A block followed by trailing bytes within its record
+    std::vector<unsigned char> padded = Serialize(blocks[3]);
+    CDataStream trailing(SER_DISK, CLIENT_VERSION);
+    WriteRecord(trailing, Serialize(blocks[4]));
+    padded.insert(padded.end(), trailing.begin(), trailing.end());
+    WriteRecord(ss, padded);
+    WriteRecord(ss, Serialize(blocks[5]));
+    // A truncated record at the end of the file
+    ss.write((const char*)Params().MessageStart(), CMessageHeader::MESSAGE_START_SIZE);
+    ss << (unsigned int)1000;
+    ss << std::vector<unsigned char>(10, 0);
+
+    const fs::path path = GetDataDir() / "bootstrap.dat";
+    FILE* file = fsbridge::fopen(path, "wb");
+    BOOST_REQUIRE(file);
+    BOOST_REQUIRE_EQUAL(fwrite(ss.data(), 1, ss.size(), file), ss.size());
+    fclose(file);
+
+    file = fsbridge::fopen(path, "rb");
+    BOOST_REQUIRE(file);
+    BOOST_CHECK(LoadExternalBlockFile(Params(), file));
+    {
+        LOCK(cs_main);
+        BOOST_CHECK_EQUAL(chainActive.Height(), tip->nHeight + 6);
+        BOOST_CHECK_EQUAL(chainActive.Tip()->GetBlockHash(), blocks.back().GetHash());
+    }
+
+    // Importing the same blocks again loads nothing
+    file = fsbridge::fopen(path, "rb");
+    BOOST_REQUIRE(file);
+    BOOST_CHECK(!LoadExternalBlockFile(Params(), file));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
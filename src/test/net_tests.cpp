@@ -302,5 +302,31 @@ BOOST_AUTO_TEST_CASE(LocalAddress_BasicLifecycle)
     BOOST_CHECK_EQUAL(IsLocal(addr), false);
 }
 
+BOOST_AUTO_TEST_CASE(cnode_snode_inventory)
+{
+    in_addr ipv4Addr;
+    ipv4Addr.s_addr = 0xa0b0c001;
+    CAddress addr = CAddress(CService(ipv4Addr, 7777), NODE_NETWORK);
+    std::unique_ptr<CNode> pnode = MakeUnique<CNode>(0, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, CAddress(), "", false);
+    BOOST_CHECK(pnode->fSnodeInvRelay == false);
+
+    const CInv ping(MSG_SNPING, uint256S("0x01"));
+    const CInv xbridge(MSG_XBRIDGE, uint256S("0x02"));
+    BOOST_CHECK_EQUAL(ping.GetCommand(), NetMsgType::SNPING);
+    BOOST_CHECK_EQUAL(xbridge.GetCommand(), NetMsgType::XBRIDGE);
+    BOOST_CHECK_EQUAL(CInv(MSG_SNREGISTER, uint256()).GetCommand(), NetMsgType::SNREGISTER);
+
+    // Packets the peer already announced to us are not queued
+    pnode->AddInventoryKnown(xbridge);
+    pnode->PushInventory(ping);
+    pnode->PushInventory(xbridge);
+    {
+        LOCK(pnode->cs_inventory);
+        BOOST_CHECK_EQUAL(pnode->vInventorySnodeToSend.size(), 1);
+        BOOST_CHECK(pnode->vInventorySnodeToSend[0].hash == ping.hash);
+        BOOST_CHECK(pnode->setInventoryTxToSend.empty());
+        BOOST_CHECK(pnode->vInventoryBlockToSend.empty());
+    }
+}
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,8 @@
 
 #include <test/staking_tests.h>
 
+#include <net_processing.h>
+#include <netmessagemaker.h>
 #include <node/transaction.h>
 #include <rpc/server.h>
 #include <servicenode/servicenode.h>
@@ -934,6 +936,57 @@ BOOST_AUTO_TEST_CASE(servicenode_tests_registration_pings)
                 R"({"xbridgeversion":50,"xrouterversion":50,"xrouter":{"config":"[Main]\nwallets=\nplugins=CustomPlugin1,CustomPlugin2\nhost=127.0.0.1", "plugins":{"CustomPlugin1":"","CustomPlugin2":""}}})", snode);
         ping3.sign(key);
         BOOST_CHECK_MESSAGE(smgr.addPing(ping3), "addPing should succeed for a future time");
+        // Pings received from peers are queued, applied and recorded as seen
+        sn::ServiceNodePing ping6(key.GetPubKey(), bestBlock, bestBlockHash, ping.getPingTime() + 30000,
+                R"({"xbridgeversion":50,"xrouterversion":50,"xrouter":{"config":"[Main]\nwallets=\nplugins=CustomPlugin1,CustomPlugin2\nhost=127.0.0.1", "plugins":{"CustomPlugin1":"","CustomPlugin2":""}}})", snode);
+        ping6.sign(key);
+        auto peerLogic = MakeUnique<PeerLogicValidation>(g_connman.get(), nullptr, pos.scheduler, false);
+        CAddress addr(CService(), NODE_NONE);
+        CNode peer(0, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, CAddress(), "", true);
+        peer.SetSendVersion(PROTOCOL_VERSION);
+        peerLogic->InitializeNode(&peer);
+        peer.nVersion = PROTOCOL_VERSION;
+        peer.fSuccessfullyConnected = true;
+        auto receivePing = [&peerLogic,&peer](const sn::ServiceNodePing & p) {
+            CSerializedNetMsg msg = CNetMsgMaker(PROTOCOL_VERSION).Make(NetMsgType::SNPING, p);
+            CMessageHeader hdr(Params().MessageStart(), msg.command.c_str(), msg.data.size());
+            const uint256 hash = Hash(msg.data.begin(), msg.data.end());
+            memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
+            std::vector<unsigned char> raw;
+            CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, raw, 0, hdr};
+            raw.insert(raw.end(), msg.data.begin(), msg.data.end());
+            CNetMessage netmsg(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION);
+            netmsg.readHeader(reinterpret_cast<const char*>(raw.data()), CMessageHeader::HEADER_SIZE);
+            netmsg.readData(reinterpret_cast<const char*>(raw.data()) + CMessageHeader::HEADER_SIZE, msg.data.size());
+            {
+                LOCK(peer.cs_vProcessMsg);
+                peer.vProcessMsg.push_back(netmsg);
+                peer.nProcessQueueSize += raw.size();
+            }
+            std::atomic<bool> interrupt{false};
+            peerLogic->ProcessMessages(&peer, interrupt);
+        };
+        const auto stats = smgr.verifyStats();
+        receivePing(ping6);
+        BOOST_CHECK_EQUAL(smgr.verifyStats().accepted, stats.accepted + 1);
+        BOOST_CHECK_MESSAGE(smgr.getSn(key.GetPubKey()).getPingTime() == ping6.getPingTime(), "Ping from peer should be applied");
+        BOOST_CHECK_MESSAGE(smgr.hasSeenPacket(ping6.getHash()), "Ping from peer should be recorded as seen");
+        // Duplicates are dropped before they are queued
+        receivePing(ping6);
+        BOOST_CHECK_EQUAL(smgr.verifyStats().accepted, stats.accepted + 1);
+        BOOST_CHECK_EQUAL(smgr.verifyStats().rejected, stats.rejected);
+        // Peers sending pings with invalid signatures are penalized
+        CKey badKey; badKey.MakeNewKey(true);
+        sn::ServiceNodePing ping7(key.GetPubKey(), bestBlock, bestBlockHash, ping.getPingTime() + 40000,
+                R"({"xbridgeversion":50,"xrouterversion":50,"xrouter":{"config":"[Main]\nwallets=\nplugins=CustomPlugin1,CustomPlugin2\nhost=127.0.0.1", "plugins":{"CustomPlugin1":"","CustomPlugin2":""}}})", snode);
+        ping7.sign(badKey);
+        receivePing(ping7);
+        BOOST_CHECK_EQUAL(smgr.verifyStats().rejected, stats.rejected + 1);
+        CNodeStateStats state;
+        BOOST_CHECK(GetNodeStateStats(peer.GetId(), state));
+        BOOST_CHECK_EQUAL(state.nMisbehavior, 10);
+        bool dummy;
+        peerLogic->FinalizeNode(peer.GetId(), dummy);
         sn::ServiceNodeMgr::writeSnConfig(std::vector<sn::ServiceNodeConfigEntry>(), false); // reset
         smgr.reset();
     }
@@ -966,6 +1019,36 @@ BOOST_AUTO_TEST_CASE(servicenode_tests_registration_pings)
         CDataStream ss3(SER_NETWORK, PROTOCOL_VERSION); ss3 << ping3;
         sn::ServiceNodePing pping3;
         BOOST_CHECK_MESSAGE(smgr.processPing(ss3, pping3), "processPing should succeed for a future time");
+        // Queued pings are verified and applied before the handler is called
+        sn::ServiceNodePing ping4(key.GetPubKey(), bestBlock, bestBlockHash, ping.getPingTime() + 20000,
+                R"({"xbridgeversion":50,"xrouterversion":50,"xrouter":{"config":"[Main]\nwallets=\nplugins=CustomPlugin1,CustomPlugin2\nhost=127.0.0.1", "plugins":{"CustomPlugin1":"","CustomPlugin2":""}}})", snode);
+        ping4.sign(key);
+        const auto stats = smgr.verifyStats();
+        sn::ServiceNodeConstPtr queued;
+        BOOST_CHECK_MESSAGE(smgr.queuePing(ping4, [&queued](const sn::ServiceNodeVerifyEntry & entry, const sn::ServiceNodeConstPtr & s) { queued = s; }), "queuePing should succeed");
+        BOOST_CHECK_MESSAGE(queued != nullptr, "Queued ping should be accepted");
+        BOOST_CHECK_MESSAGE(!smgr.queuePing(ping4, nullptr), "queuePing should skip pings that were already seen");
+        // Queued pings older than the latest known ping are rejected
+        sn::ServiceNodePing ping5(key.GetPubKey(), bestBlock, bestBlockHash, ping.getPingTime() - 2000,
+                R"({"xbridgeversion":50,"xrouterversion":50,"xrouter":{"config":"[Main]\nwallets=\nplugins=CustomPlugin1,CustomPlugin2\nhost=127.0.0.1", "plugins":{"CustomPlugin1":"","CustomPlugin2":""}}})", snode);
+        ping5.sign(key);
+        BOOST_CHECK_MESSAGE(smgr.queuePing(ping5, [&queued](const sn::ServiceNodeVerifyEntry & entry, const sn::ServiceNodeConstPtr & s) { queued = s; }), "queuePing should succeed");
+        BOOST_CHECK_MESSAGE(queued == nullptr, "Queued ping with time prior to latest known ping should be rejected");
+        // Only pings with invalid signatures are flagged for a penalty
+        bool badSignature{true};
+        sn::ServiceNodePing ping6(key.GetPubKey(), bestBlock, bestBlockHash, ping.getPingTime() - 3000,
+                R"({"xbridgeversion":50,"xrouterversion":50,"xrouter":{"config":"[Main]\nwallets=\nplugins=CustomPlugin1,CustomPlugin2\nhost=127.0.0.1", "plugins":{"CustomPlugin1":"","CustomPlugin2":""}}})", snode);
+        ping6.sign(key);
+        smgr.queuePing(ping6, [&badSignature](const sn::ServiceNodeVerifyEntry & entry, const sn::ServiceNodeConstPtr & s) { badSignature = entry.badSignature; });
+        BOOST_CHECK_MESSAGE(!badSignature, "Stale ping should not be flagged for an invalid signature");
+        CKey badKey; badKey.MakeNewKey(true);
+        sn::ServiceNodePing ping7(key.GetPubKey(), bestBlock, bestBlockHash, ping.getPingTime() + 30000,
+                R"({"xbridgeversion":50,"xrouterversion":50,"xrouter":{"config":"[Main]\nwallets=\nplugins=CustomPlugin1,CustomPlugin2\nhost=127.0.0.1", "plugins":{"CustomPlugin1":"","CustomPlugin2":""}}})", snode);
+        ping7.sign(badKey);
+        smgr.queuePing(ping7, [&badSignature](const sn::ServiceNodeVerifyEntry & entry, const sn::ServiceNodeConstPtr & s) { badSignature = entry.badSignature; });
+        BOOST_CHECK_MESSAGE(badSignature, "Ping signed by another key should be flagged for an invalid signature");
+        BOOST_CHECK_EQUAL(smgr.verifyStats().accepted, stats.accepted + 1);
+        BOOST_CHECK_EQUAL(smgr.verifyStats().rejected, stats.rejected + 3);
         sn::ServiceNodeMgr::writeSnConfig(std::vector<sn::ServiceNodeConfigEntry>(), false); // reset
         smgr.reset();
     }
@@ -1728,4 +1811,111 @@ BOOST_AUTO_TEST_CASE(servicenode_tests_rpc)
     pos_ptr.reset();
 }
 
+/// Check that the servicenode snapshot indexes services and is not modified by later list changes
+BOOST_AUTO_TEST_CASE(servicenode_tests_snapshot)
+{
+    auto & smgr = sn::ServiceNodeMgr::instance();
+    smgr.reset();
+
+    auto createSnode = [](const std::string & config, const std::vector<COutPoint> & collateral) -> sn::ServiceNode {
+        CKey key; key.MakeNewKey(true);
+        auto snode = snodeNetwork(key.GetPubKey(), sn::ServiceNode::SPV, key.GetPubKey().GetID(),
+                                  collateral, 1, uint256(), std::vector<unsigned char>());
+        snode.setConfig(config, Params());
+        snode.updatePing();
+        return snode;
+    };
+
+    auto snode1 = createSnode(R"({"xbridgeversion":50,"xrouterversion":50,"xbridge":["BLOCK","BTC"]})", {});
+    BOOST_CHECK(smgr.addSn(snode1, false) != nullptr);
+    const auto snap1 = smgr.snapshot();
+    BOOST_CHECK_EQUAL(snap1->snodes.size(), 1);
+    BOOST_CHECK_EQUAL(smgr.getSnodesWithService("BTC").size(), 1);
+    BOOST_CHECK_EQUAL(smgr.getSnodesWithService("BTC", 50).size(), 1);
+    BOOST_CHECK_MESSAGE(smgr.getSnodesWithService("BTC", 51).empty(), "Expecting no snodes on other protocol versions");
+    BOOST_CHECK_MESSAGE(smgr.getSnodesWithService("LTC").empty(), "Expecting no snodes with unknown service");
+
+    const COutPoint collateral2(uint256S("0x2c4d5e6f708192a3b4c5d6e7f8091a2b3c4d5e6f708192a3b4c5d6e7f8091a2b"), 0);
+    auto snode2 = createSnode(R"({"xbridgeversion":50,"xrouterversion":50,"xbridge":["BLOCK","LTC"]})", {collateral2});
+    BOOST_CHECK(smgr.addSn(snode2, false) != nullptr);
+    BOOST_CHECK_EQUAL(smgr.getSnodesWithService("BLOCK").size(), 2);
+    BOOST_CHECK_EQUAL(smgr.getSnodesWithService("LTC").size(), 1);
+    BOOST_CHECK_EQUAL(smgr.list().size(), 2);
+    BOOST_CHECK_MESSAGE(snap1->snodes.size() == 1, "Previous snapshot should not change");
+
+    // Spending the collateral publishes an invalid copy, snodes in older snapshots don't change
+    const auto snap2 = smgr.snapshot();
+    CMutableTransaction spend;
+    spend.vin.emplace_back(collateral2);
+    auto block = std::make_shared<CBlock>();
+    block->vtx.push_back(MakeTransactionRef(spend));
+    smgr.processValidationBlock(block, true, 1);
+    BOOST_CHECK(smgr.findSn(snode2.getSnodePubKey())->getInvalid());
+    BOOST_CHECK_MESSAGE(smgr.getSnodesWithService("LTC").empty(), "Invalid snode should not be returned");
+    BOOST_CHECK_EQUAL(smgr.getSnodesWithService("LTC", 0, false).size(), 1);
+    for (const auto & s : snap2->snodes)
+        BOOST_CHECK_MESSAGE(!s->getInvalid(), "Published snodes should not change");
+
+    BOOST_CHECK(smgr.removeSn(snode1.getSnodePubKey()));
+    BOOST_CHECK_MESSAGE(smgr.getSnodesWithService("BTC").empty(), "Removed snode should not be returned");
+
+    smgr.reset();
+    BOOST_CHECK(smgr.snapshot()->snodes.empty());
+}
+
+BOOST_AUTO_TEST_CASE(servicenode_tests_list_digest)
+{
+    auto & smgr = sn::ServiceNodeMgr::instance();
+    smgr.reset();
+
+    const std::string config = R"({"xbridgeversion":50,"xrouterversion":50,"xbridge":["BLOCK","BTC"]})";
+    std::vector<CKey> keys;
+    for (int i = 0; i < 20; ++i) {
+        CKey key; key.MakeNewKey(true);
+        auto snode = snodeNetwork(key.GetPubKey(), sn::ServiceNode::SPV, key.GetPubKey().GetID(),
+                                  std::vector<COutPoint>(), 1, uint256(), std::vector<unsigned char>());
+        BOOST_CHECK(smgr.addSn(snode, false) != nullptr);
+        sn::ServiceNodePing ping(key.GetPubKey(), 1, uint256(), static_cast<uint32_t>(GetTime()), config, snode);
+        ping.sign(key);
+        BOOST_CHECK(smgr.addPing(ping));
+        keys.push_back(key);
+    }
+
+    // Requests without a digest or with an unknown digest version receive all pings
+    sn::ServiceNodeListDigest empty;
+    BOOST_CHECK_EQUAL(smgr.getPingsNotIn(empty).size(), 20);
+    auto digest = smgr.listDigest();
+    BOOST_CHECK_EQUAL(digest.pings.size(), 20);
+    auto unknown = digest; unknown.version = 0;
+    BOOST_CHECK_EQUAL(smgr.getPingsNotIn(unknown).size(), 20);
+
+    // An up-to-date peer receives nothing
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION); ss << digest;
+    sn::ServiceNodeListDigest received; ss >> received;
+    BOOST_CHECK(smgr.getPingsNotIn(received).empty());
+
+    // A peer with a stale list only receives the newer ping
+    const auto & key = keys.front();
+    auto snode = smgr.getSn(key.GetPubKey());
+    sn::ServiceNodePing ping(key.GetPubKey(), 1, uint256(), static_cast<uint32_t>(GetTime()) + 60, config, snode);
+    ping.sign(key);
+    BOOST_CHECK(smgr.addPing(ping));
+    const auto stale = smgr.getPingsNotIn(digest);
+    BOOST_CHECK_EQUAL(stale.size(), 1);
+    BOOST_CHECK_MESSAGE(!stale.empty() && stale.front().getHash() == ping.getHash(), "Expecting the newer ping in the reply");
+
+    // A peer missing a snode only receives that snode's ping
+    auto missing = smgr.listDigest();
+    missing.pings.erase(missing.pings.begin());
+    BOOST_CHECK_EQUAL(smgr.getPingsNotIn(missing).size(), 1);
+
+    // A peer with a newer ping than ours receives nothing
+    auto newer = smgr.listDigest();
+    for (auto & item : newer.pings)
+        item.second += 60;
+    BOOST_CHECK(smgr.getPingsNotIn(newer).empty());
+
+    smgr.reset();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
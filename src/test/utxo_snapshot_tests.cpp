@@ -0,0 +1,119 @@
+// Copyright (c) 2020 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <consensus/validation.h>
+#include <governance/governance.h>
+#include <node/utxo_snapshot.h>
+#include <test/test_bitcoin.h>
+#include <txdb.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(utxo_snapshot_tests)
+
+static size_t CountCoins()
+{
+    std::unique_ptr<CCoinsViewCursor> pcursor(pcoinsdbview->Cursor());
+    size_t count = 0;
+    for (; pcursor->Valid(); pcursor->Next())
+        ++count;
+    return count;
+}
+
+BOOST_FIXTURE_TEST_CASE(utxo_snapshot_dump_load, TestChain100Setup)
+{
+    const auto & consensus = Params().GetConsensus();
+    const fs::path path = GetDataDir() / "utxo.dat";
+    std::string error;
+
+    // The governance index must be in sync with the tip to dump a snapshot
+    auto & governance = gov::Governance::instance();
+    governance.reset();
+    BOOST_REQUIRE(governance.loadGovernanceData(chainActive, cs_main, consensus, error));
+
+    SnapshotMetadata metadata;
+    uint256 hash;
+    BOOST_REQUIRE_MESSAGE(DumpUTXOSnapshot(path, metadata, hash, error), error);
+
+    CBlockIndex* tip;
+    CAmount money_supply;
+    {
+        LOCK(cs_main);
+        tip = chainActive.Tip();
+        money_supply = tip->nMoneySupply;
+        BOOST_CHECK_EQUAL(metadata.m_base_blockhash, tip->GetBlockHash());
+        BOOST_CHECK_EQUAL(metadata.m_base_height, tip->nHeight);
+        BOOST_CHECK_EQUAL(metadata.m_coins_count, CountCoins());
+    }
+
+    SnapshotMetadata read;
+    BOOST_REQUIRE_MESSAGE(ReadUTXOSnapshotMetadata(path, read, error), error);
+    BOOST_CHECK_EQUAL(read.m_base_blockhash, metadata.m_base_blockhash);
+    BOOST_CHECK_EQUAL(read.m_coins_count, metadata.m_coins_count);
+    BOOST_CHECK_EQUAL(read.m_governance_count, metadata.m_governance_count);
+
+    // Snapshots only load on top of the genesis block
+    BOOST_CHECK(!LoadUTXOSnapshot(path, hash, read, error));
+
+    // Roll back to genesis, the headers (and here also the blocks) stay known like on a node
+    // that has only synced the headers
+    {
+        CValidationState state;
+        LOCK(cs_main);
+        BOOST_REQUIRE(InvalidateBlock(state, Params(), chainActive[1]));
+        BOOST_REQUIRE_EQUAL(chainActive.Height(), 0);
+        ResetBlockFailureFlags(tip);
+        tip->nMoneySupply = 0;
+    }
+    SyncWithValidationInterfaceQueue();
+
+    // A snapshot that does not hash to the expected value is rejected before anything is written
+    BOOST_CHECK(!LoadUTXOSnapshot(path, uint256S("01"), read, error));
+    BOOST_CHECK(error.find("does not match the expected hash") != std::string::npos);
+    {
+        const fs::path corrupt = GetDataDir() / "corrupt.dat";
+        fs::copy_file(path, corrupt);
+        FILE* file = fsbridge::fopen(corrupt, "rb+");
+        BOOST_REQUIRE(file);
+        BOOST_REQUIRE_EQUAL(fseek(file, -40, SEEK_END), 0);
+        const int c = fgetc(file);
+        BOOST_REQUIRE_EQUAL(fseek(file, -40, SEEK_END), 0);
+        fputc(c ^ 0xff, file);
+        fclose(file);
+        BOOST_CHECK(!LoadUTXOSnapshot(corrupt, hash, read, error));
+    }
+    {
+        LOCK(cs_main);
+        BOOST_CHECK_EQUAL(chainActive.Height(), 0);
+        BOOST_CHECK_EQUAL(pcoinsTip->GetBestBlock(), chainActive.Genesis()->GetBlockHash());
+    }
+
+    BOOST_REQUIRE_MESSAGE(LoadUTXOSnapshot(path, hash, read, error), error);
+    {
+        LOCK(cs_main);
+        BOOST_CHECK_EQUAL(chainActive.Tip(), tip);
+        BOOST_CHECK_EQUAL(pcoinsTip->GetBestBlock(), tip->GetBlockHash());
+        BOOST_CHECK_EQUAL(tip->nMoneySupply, money_supply);
+        BOOST_CHECK_EQUAL(CountCoins(), metadata.m_coins_count);
+        for (const auto & tx : m_coinbase_txns)
+            BOOST_CHECK(pcoinsTip->HaveCoin(COutPoint(tx->GetHash(), 0)));
+        BOOST_CHECK(fHavePruned);
+    }
+
+    // The node continues to sync on top of the snapshot base
+    const CScript script = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    const CBlock block = CreateAndProcessBlock({}, script);
+    {
+        LOCK(cs_main);
+        BOOST_CHECK_EQUAL(chainActive.Height(), tip->nHeight + 1);
+        BOOST_CHECK_EQUAL(chainActive.Tip()->GetBlockHash(), block.GetHash());
+    }
+
+    governance.reset();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -16,6 +16,8 @@
 #include <validation.h>
 #include <validationinterface.h>
 
+#include <future>
+
 struct RegtestingSetup : public TestingSetup {
     RegtestingSetup() : TestingSetup(CBaseChainParams::REGTEST) {}
 };
@@ -197,4 +199,81 @@ BOOST_AUTO_TEST_CASE(processnewblock_signals_ordering)
     BOOST_CHECK_EQUAL(sub.m_expected_tip, chainActive.Tip()->GetBlockHash());
 }
 
+struct QueueTestSubscriber : public CValidationInterface {
+    std::shared_future<void> m_gate;
+    Mutex m_mutex;
+    std::vector<int> m_heights GUARDED_BY(m_mutex);
+
+    explicit QueueTestSubscriber(std::shared_future<void> gate = {}) : m_gate(gate) {}
+
+    void UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload) override
+    {
+        if (m_gate.valid())
+            m_gate.wait();
+        LOCK(m_mutex);
+        m_heights.push_back(pindexNew->nHeight);
+    }
+
+    std::vector<int> Heights()
+    {
+        LOCK(m_mutex);
+        return m_heights;
+    }
+};
+
+BOOST_AUTO_TEST_CASE(parallel_signals)
+{
+    // Switch to per-subscriber queues with a second scheduler thread
+    SyncWithValidationInterfaceQueue();
+    GetMainSignals().UnregisterBackgroundSignalScheduler();
+    GetMainSignals().RegisterBackgroundSignalScheduler(scheduler, true);
+    threadGroup.create_thread(std::bind(&CScheduler::serviceQueue, &scheduler));
+    BOOST_CHECK(GetMainSignals().ParallelCallbacks());
+
+    std::promise<void> release;
+    QueueTestSubscriber slow(release.get_future().share());
+    QueueTestSubscriber fast;
+    RegisterValidationInterface(&slow, "slow");
+    RegisterValidationInterface(&fast, "fast");
+
+    const int count = 10;
+    std::vector<CBlockIndex> indexes(count);
+    std::vector<int> expected;
+    for (int i = 0; i < count; ++i) {
+        indexes[i].nHeight = i;
+        expected.push_back(i);
+        GetMainSignals().UpdatedBlockTip(&indexes[i], nullptr, false);
+    }
+
+    // The fast subscriber is notified while the slow one holds the other thread
+    for (int i = 0; i < 500 && fast.Heights().size() < count; ++i)
+        MilliSleep(10);
+    BOOST_CHECK(fast.Heights() == expected);
+    BOOST_CHECK(slow.Heights().empty());
+    BOOST_CHECK(GetMainSignals().CallbacksPending() > 0);
+
+    // The barrier waits for the slow queue too, each queue is delivered in order
+    release.set_value();
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK(slow.Heights() == expected);
+    BOOST_CHECK(fast.Heights() == expected);
+    BOOST_CHECK_EQUAL(GetMainSignals().CallbacksPending(), 0);
+
+    int found = 0;
+    for (const auto& stats : GetMainSignals().CallbackStats()) {
+        if (stats.name != "slow" && stats.name != "fast")
+            continue;
+        ++found;
+        BOOST_CHECK_EQUAL(stats.callbacks, count);
+        BOOST_CHECK_EQUAL(stats.pending, 0);
+        BOOST_CHECK(stats.maxTime <= stats.totalTime);
+    }
+    BOOST_CHECK_EQUAL(found, 2);
+
+    UnregisterValidationInterface(&slow);
+    UnregisterValidationInterface(&fast);
+    GetMainSignals().UnregisterBackgroundSignalScheduler();
+    GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
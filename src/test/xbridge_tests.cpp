@@ -4,6 +4,12 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 #include <test/test_bitcoin.h>
 #include <xbridge/util/xutil.h>
+#include <xbridge/xbridgewallethealth.h>
+
+#include <chrono>
+#include <thread>
+#include <type_traits>
+
 #include <boost/test/unit_test.hpp>
 
 BOOST_FIXTURE_TEST_SUITE(xbridge_tests, BasicTestingSetup)
@@ -130,4 +136,151 @@ BOOST_AUTO_TEST_CASE(xbridge_pricecheck) {
     }
 }
 
+BOOST_AUTO_TEST_CASE(xbridge_touniv) {
+    json_spirit::Object inner;
+    inner.emplace_back("price", 0.1234567891);
+    inner.emplace_back("size", 12.5);
+    inner.emplace_back("count", static_cast<int64_t>(9007199254740993));
+    inner.emplace_back("neg", -3);
+    inner.emplace_back("ok", true);
+    inner.emplace_back("nope", false);
+    inner.emplace_back("none", json_spirit::Value());
+    inner.emplace_back("text", std::string("a\"b\\c\n\t/"));
+    json_spirit::Array arr;
+    arr.push_back(inner);
+    arr.push_back(json_spirit::Array());
+    arr.push_back(json_spirit::Object());
+    json_spirit::Object o;
+    o.emplace_back("orders", arr);
+    o.emplace_back("dup", 1);
+    o.emplace_back("dup", 2);
+
+    // Must match serializing with json_spirit and parsing the string again
+    const auto str = json_spirit::write_string(json_spirit::Value(o), json_spirit::none, 8);
+    UniValue expected;
+    BOOST_REQUIRE(expected.read(str));
+    const auto actual = xbridge::toUniValue(o);
+    BOOST_CHECK_EQUAL(actual.write(), expected.write());
+    BOOST_CHECK_EQUAL(xbridge::toUniValue(json_spirit::Value()).write(), "null");
+    BOOST_CHECK_EQUAL(xbridge::toUniValue(json_spirit::Value(1.0)).write(), "1.00000000");
+    // The json_spirit writer escaped each byte of multi-byte utf-8 characters separately
+    BOOST_CHECK_EQUAL(xbridge::toUniValue(json_spirit::Value(std::string("\xc3\xa9"))).get_str(), "\xc3\xa9");
+}
+
+BOOST_AUTO_TEST_CASE(xbridge_jsonreplyreader) {
+    const std::string json = R"( {"result" : {"hash":"ab","tx":["x","}"]}, "count":-42, "big":1e3,)"
+                             R"( "str":"a\"b\\\u00e9\ud83d\ude00", "error":null, "id":1 } )";
+    xbridge::JsonReplyReader reader(json);
+    BOOST_REQUIRE(reader.valid());
+    BOOST_CHECK_EQUAL(reader.raw("result"), R"({"hash":"ab","tx":["x","}"]})");
+    BOOST_CHECK(reader.isNull("error"));
+    BOOST_CHECK(reader.isNull("missing"));
+    BOOST_CHECK(!reader.isNull("result"));
+    int64_t n{0};
+    BOOST_CHECK(reader.getInt("count", n));
+    BOOST_CHECK_EQUAL(n, -42);
+    BOOST_CHECK(!reader.getInt("big", n));
+    BOOST_CHECK(!reader.getInt("str", n));
+    std::string s;
+    BOOST_CHECK(reader.getString("str", s));
+    BOOST_CHECK_EQUAL(s, "a\"b\\\xc3\xa9\xf0\x9f\x98\x80");
+    BOOST_CHECK(!reader.getString("result", s));
+
+    const std::string arr = R"(["result"])";
+    BOOST_CHECK(!xbridge::JsonReplyReader(arr).valid());
+    const std::string truncated = R"({"result":{"a":1})";
+    BOOST_CHECK(!xbridge::JsonReplyReader(truncated).valid());
+    const std::string trailing = R"({"result":1} x)";
+    BOOST_CHECK(!xbridge::JsonReplyReader(trailing).valid());
+    const std::string empty = "{}";
+    BOOST_CHECK(xbridge::JsonReplyReader(empty).valid());
+
+    // The reader refers to the json text, temporaries would dangle
+    static_assert(!std::is_constructible<xbridge::JsonReplyReader, std::string&&>::value, "rvalue json");
+}
+
+BOOST_AUTO_TEST_CASE(xbridge_wallethealth) {
+    // Consecutive failures double the backoff up to the limit
+    xbridge::WalletHealthChecker checker;
+    BOOST_CHECK(checker.shouldCheck("LTC", 1000));
+    BOOST_CHECK(checker.update("LTC", false, 1000));
+    BOOST_CHECK_EQUAL(checker.retryTime("LTC"), 1000 + xbridge::WalletHealthChecker::BACKOFF_MIN);
+    BOOST_CHECK(!checker.shouldCheck("LTC", 1000 + xbridge::WalletHealthChecker::BACKOFF_MIN - 1));
+    BOOST_CHECK(checker.shouldCheck("LTC", 1000 + xbridge::WalletHealthChecker::BACKOFF_MIN));
+    BOOST_CHECK(!checker.update("LTC", false, 2000));
+    BOOST_CHECK_EQUAL(checker.retryTime("LTC"), 2000 + 2 * xbridge::WalletHealthChecker::BACKOFF_MIN);
+    for (int i = 0; i < 10; ++i)
+        checker.update("LTC", false, 3000);
+    BOOST_CHECK_EQUAL(checker.retryTime("LTC"), 3000 + xbridge::WalletHealthChecker::BACKOFF_MAX);
+    BOOST_CHECK(checker.update("LTC", true, 4000));
+    BOOST_CHECK_EQUAL(checker.retryTime("LTC"), 0);
+    BOOST_CHECK(!checker.update("LTC", true, 4000));
+    checker.update("BTC", false, 4000);
+    checker.clearBackoff();
+    BOOST_CHECK(checker.shouldCheck("BTC", 4000));
+
+    // Not started
+    BOOST_CHECK(!checker.run({}, 100, nullptr, nullptr));
+
+    std::vector<xbridge::IoServicePtr> workers;
+    std::vector<xbridge::WorkPtr> works;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 3; ++i) {
+        workers.push_back(std::make_shared<boost::asio::io_service>());
+        works.push_back(std::make_shared<boost::asio::io_service::work>(*workers.back()));
+        threads.emplace_back([i, &workers]() { workers[i]->run(); });
+    }
+    const auto timerIo = workers.back();
+    workers.pop_back();
+    checker.start(workers, *timerIo);
+
+    // Healthy wallets are reported right away, unresponsive wallets fail at the deadline
+    const auto started = std::chrono::steady_clock::now();
+    Mutex mu;
+    std::map<std::string, bool> results;
+    std::map<std::string, int64_t> elapsed;
+    std::set<std::string> healthy;
+    auto onResult = [&](const std::string & currency, const bool ok) {
+        LOCK(mu);
+        results[currency] = ok;
+        elapsed[currency] = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+    };
+    auto onDone = [&](const std::set<std::string> & wallets) { LOCK(mu); healthy = wallets; };
+    std::map<std::string, xbridge::WalletHealthChecker::Check> checks;
+    checks["BLOCK"] = []() { return true; };
+    checks["BTC"] = []() { std::this_thread::sleep_for(std::chrono::milliseconds(1000)); return true; };
+    checks["LTC"] = []() -> bool { throw std::runtime_error("connection refused"); };
+    BOOST_CHECK(checker.run(checks, 300, onResult, onDone));
+    BOOST_CHECK(!checker.run(checks, 300, onResult, onDone)); // already running
+    BOOST_CHECK(checker.wait(5000));
+    BOOST_CHECK(!checker.isRunning());
+    {
+        LOCK(mu);
+        BOOST_CHECK_EQUAL(results.size(), 3);
+        BOOST_CHECK(results["BLOCK"] && !results["BTC"] && !results["LTC"]);
+        BOOST_CHECK_LT(elapsed["BLOCK"], 300);
+        BOOST_CHECK_GE(elapsed["BTC"], 300);
+        BOOST_CHECK(healthy == std::set<std::string>{"BLOCK"});
+    }
+
+    // Late replies are ignored
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    {
+        LOCK(mu);
+        BOOST_CHECK(!results["BTC"]);
+    }
+
+    // No wallets
+    BOOST_CHECK(checker.run({}, 300, onResult, onDone));
+    BOOST_CHECK(!checker.isRunning());
+    {
+        LOCK(mu);
+        BOOST_CHECK(healthy.empty());
+    }
+
+    works.clear();
+    for (auto & th : threads)
+        th.join();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
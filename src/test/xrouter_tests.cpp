@@ -3,6 +3,35 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <test/xrouter_tests.h>
+#include <compat.h>
+#include <rpc/protocol.h>
+#include <test/test_bitcoin.h>
+#include <servicenode/servicenode.h>
+#include <xrouter/xrouterconfigcache.h>
+#include <xrouter/xrouterdef.h>
+#include <xrouter/xroutererror.h>
+#include <xrouter/xrouterpluginworker.h>
+#include <xrouter/xrouterquerycache.h>
+#include <xrouter/xrouterquerymgr.h>
+#include <xrouter/xrouterserver.h>
+
+#include <cstring>
+#include <set>
+#include <thread>
+
+#include <event2/buffer.h>
+#include <event2/event.h>
+#include <event2/http.h>
+#include <json/json_spirit_utils.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include <boost/test/unit_test.hpp>
 
 XRouterTestClient::XRouterTestClient() {
@@ -27,6 +56,562 @@ BOOST_AUTO_TEST_SUITE(xrouter_tests)
 BOOST_AUTO_TEST_CASE(xrouter_tests_default) {
 }
 
+#ifndef WIN32
+
+// Echoes framed requests, "sleep" requests stall the worker and "exit" requests crash it
+static const std::string echoWorker = "while read -r n; do req=$(dd bs=1 count=$n 2>/dev/null); "
+                                      "case \"$req\" in *sleep*) sleep 0.3;; *stall*) sleep 5;; *exit*) exit 1;; esac; "
+                                      "printf '%s\\n%s' \"${#req}\" \"$req\"; done";
+
+static int64_t statusField(const xrouter::PluginWorkerPool & pool, const std::string & key) {
+    return json_spirit::find_value(pool.status(), key).get_int64();
+}
+
+BOOST_AUTO_TEST_CASE(xrouter_tests_pluginworkers) {
+    signal(SIGPIPE, SIG_IGN); // the node ignores SIGPIPE, crashed workers close their pipes
+
+    xrouter::PluginWorkerPool pool("echo", echoWorker, 2);
+    BOOST_CHECK_EQUAL(pool.size(), 2);
+    BOOST_CHECK_EQUAL(pool.call(R"(["hello"])", 2000), R"(["hello"])");
+    BOOST_CHECK_EQUAL(pool.call("", 2000), "");
+    const std::string large(100000, 'x');
+    BOOST_CHECK_EQUAL(pool.call(large, 5000), large);
+    BOOST_CHECK_EQUAL(statusField(pool, "calls"), 3);
+    BOOST_CHECK_EQUAL(statusField(pool, "running"), 2);
+
+    // A stalled worker is killed after the timeout, the other worker keeps serving
+    BOOST_CHECK_THROW(pool.call(R"(["stall"])", 200), xrouter::XRouterError);
+    BOOST_CHECK_EQUAL(statusField(pool, "timeouts"), 1);
+    BOOST_CHECK_EQUAL(statusField(pool, "running"), 1);
+    BOOST_CHECK_EQUAL(pool.call(R"(["next"])", 2000), R"(["next"])");
+
+    // Both workers are busy, at most 2 calls run at once
+    const int64_t start = GetTimeMillis();
+    std::vector<std::thread> threads;
+    std::atomic<int> ok{0};
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&pool, &ok]() {
+            try {
+                if (pool.call(R"(["sleep"])", 5000) == R"(["sleep"])")
+                    ++ok;
+            } catch (...) {}
+        });
+    }
+    for (auto & t : threads)
+        t.join();
+    BOOST_CHECK_EQUAL(ok, 4);
+    BOOST_CHECK(GetTimeMillis() - start >= 600);
+
+    // Crashed workers are restarted on their next use after the backoff
+    xrouter::PluginWorkerPool single("crash", echoWorker, 1);
+    BOOST_CHECK_THROW(single.call(R"(["exit"])", 2000), xrouter::XRouterError);
+    BOOST_CHECK_EQUAL(statusField(single, "running"), 0);
+    BOOST_CHECK_THROW(single.call(R"(["too soon"])", 50), xrouter::XRouterError);
+    BOOST_CHECK_EQUAL(single.call(R"(["restarted"])", 5000), R"(["restarted"])");
+    BOOST_CHECK_EQUAL(statusField(single, "failures"), 1);
+    BOOST_CHECK_EQUAL(statusField(single, "timeouts"), 1);
+    BOOST_CHECK_EQUAL(statusField(single, "restarts"), 1);
+
+    // Calls fail once the pool is stopped
+    single.stop();
+    BOOST_CHECK_THROW(single.call(R"(["stopped"])", 2000), xrouter::XRouterError);
+    const auto status = pool.status();
+    const auto & latency = json_spirit::find_value(status, "latency").get_obj();
+    BOOST_CHECK_EQUAL(json_spirit::find_value(latency, "count").get_int64(), 8);
+}
+
+BOOST_FIXTURE_TEST_CASE(xrouter_tests_pluginworker_cleanup, BasicTestingSetup) {
+    signal(SIGPIPE, SIG_IGN);
+
+    // Workers don't inherit the node's descriptors, the read end sees EOF once we close the write end
+    int fds[2];
+    BOOST_REQUIRE(pipe(fds) == 0);
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    {
+        xrouter::PluginWorker worker(echoWorker);
+        BOOST_REQUIRE(worker.start());
+        std::string reply, error;
+        bool timedOut{false};
+        BOOST_CHECK(worker.call("ready", 5000, reply, error, timedOut)); // the worker was exec'd
+        close(fds[1]);
+        char c;
+        BOOST_CHECK_MESSAGE(read(fds[0], &c, 1) == 0, "worker should not hold the node's descriptors");
+        close(fds[0]);
+    }
+
+    // Containerized workers are killed in the container, killing their docker exec client does not
+    // stop them. The fake docker runs "containers" in sessions of their own.
+    const auto dir = SetDataDir("fakedocker");
+    {
+        fs::ofstream f(dir / "docker");
+        f << "#!/bin/sh\n[ \"$1\" = exec ] && shift\n[ \"$1\" = -i ] && shift\nshift\nexec setsid \"$@\"\n";
+    }
+    fs::permissions(dir / "docker", fs::owner_all);
+    const std::string path = getenv("PATH") ? getenv("PATH") : "";
+    setenv("PATH", (dir.string() + ":" + path).c_str(), 1);
+
+    // The worker and its children hold the fifo open until they are killed
+    const auto fifo = (dir / "alive").string();
+    BOOST_REQUIRE(mkfifo(fifo.c_str(), 0600) == 0);
+    const int alive = open(fifo.c_str(), O_RDONLY | O_NONBLOCK);
+    BOOST_REQUIRE(alive >= 0);
+    const std::string stallWorker = "exec 3>" + fifo + "; while read -r n; do req=$(dd bs=1 count=$n 2>/dev/null); "
+                                    "case \"$req\" in *stall*) sleep 60;; esac; "
+                                    "printf '%s\\n%s' \"${#req}\" \"$req\"; done";
+    {
+        xrouter::PluginWorker worker(stallWorker, "container");
+        BOOST_REQUIRE(worker.start());
+        std::string reply, error;
+        bool timedOut{false};
+        BOOST_CHECK(worker.call("ready", 5000, reply, error, timedOut));
+        BOOST_CHECK_EQUAL(reply, "ready");
+        // The stalled worker is stopped after the timeout
+        BOOST_CHECK(!worker.call("stall", 200, reply, error, timedOut));
+        BOOST_CHECK(timedOut);
+        BOOST_CHECK(!worker.running());
+        struct pollfd p{alive, POLLIN, 0};
+        BOOST_CHECK_MESSAGE(poll(&p, 1, 10000) == 1 && (p.revents & POLLHUP), "worker should be killed in the container");
+    }
+    close(alive);
+    setenv("PATH", path.c_str(), 1);
+}
+
+#endif // WIN32
+
+/**
+ * Local http server that echoes requests and records the client ports it was called from,
+ * requests to /noreply are never answered.
+ */
+struct XRouterTestServer {
+    struct event_base *base{nullptr};
+    struct evhttp *http{nullptr};
+    int port{0};
+    std::set<uint16_t> clientPorts;
+    std::atomic<int> requests{0};
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+
+    /** @param timeout seconds after which the server closes idle connections */
+    explicit XRouterTestServer(int timeout) {
+        base = event_base_new();
+        http = evhttp_new(base);
+        evhttp_set_timeout(http, timeout);
+        evhttp_set_gencb(http, [](struct evhttp_request *req, void *ctx) {
+            auto *server = static_cast<XRouterTestServer*>(ctx);
+            char *addr{nullptr};
+            ev_uint16_t port{0};
+            evhttp_connection_get_peer(evhttp_request_get_connection(req), &addr, &port);
+            server->clientPorts.insert(port);
+            ++server->requests;
+            if (strcmp(evhttp_request_get_uri(req), "/noreply") == 0)
+                return; // freed with the connection
+            struct evbuffer *buf = evbuffer_new();
+            evbuffer_add_buffer(buf, evhttp_request_get_input_buffer(req));
+            evhttp_send_reply(req, HTTP_OK, "OK", buf);
+            evbuffer_free(buf);
+        }, this);
+        auto *bound = evhttp_bind_socket_with_handle(http, "127.0.0.1", 0);
+        BOOST_REQUIRE(bound);
+        struct sockaddr_in addr{};
+        socklen_t len = sizeof(addr);
+        getsockname(evhttp_bound_socket_get_fd(bound), (struct sockaddr*)&addr, &len);
+        port = ntohs(addr.sin_port);
+        thread = std::thread([this]() {
+            // Wakes up periodically to check for the stop request
+            struct timeval tv{0, 20000};
+            while (!stopping) {
+                event_base_loopexit(base, &tv);
+                event_base_dispatch(base);
+            }
+        });
+    }
+    ~XRouterTestServer() {
+        stopping = true;
+        thread.join();
+        evhttp_free(http);
+        event_base_free(base);
+    }
+};
+
+BOOST_FIXTURE_TEST_CASE(xrouter_tests_connection_reuse, BasicTestingSetup) {
+    xrouter::ClearXRouterConnections();
+    CKey key;
+    key.MakeNewKey(true);
+    XRouterTestServer server(1);
+    for (int i = 0; i < 5; ++i) {
+        const auto data = strprintf(R"({"n":%d})", i);
+        auto reply = xrouter::CallXRouterUrl("127.0.0.1", server.port, "/xr/BLOCK/xrGetBlockCount", data, 10, key, CPubKey(), "");
+        BOOST_CHECK_EQUAL(reply.status, HTTP_OK);
+        BOOST_CHECK_EQUAL(reply.result, data + "\n");
+    }
+    // All requests went over the same kept-alive connection
+    BOOST_CHECK_EQUAL(server.requests, 5);
+    BOOST_CHECK_EQUAL(server.clientPorts.size(), 1);
+
+    // The idle connection closed by the server is replaced by a new one
+    MilliSleep(1500);
+    auto reply = xrouter::CallXRouterUrl("127.0.0.1", server.port, "/", "{}", 10, key, CPubKey(), "");
+    BOOST_CHECK_EQUAL(reply.result, "{}\n");
+    BOOST_CHECK_EQUAL(server.requests, 6);
+    BOOST_CHECK_EQUAL(server.clientPorts.size(), 2);
+
+    // A request that times out on a kept-alive connection is not sent again
+    BOOST_CHECK_THROW(xrouter::CallXRouterUrl("127.0.0.1", server.port, "/noreply", "{}", 1, key, CPubKey(), ""), std::runtime_error);
+    BOOST_CHECK_EQUAL(server.requests, 7);
+    reply = xrouter::CallXRouterUrl("127.0.0.1", server.port, "/", "{}", 10, key, CPubKey(), "");
+    BOOST_CHECK_EQUAL(server.requests, 8);
+    BOOST_CHECK_THROW(xrouter::CallXRouterUrl("127.0.0.1", server.port, "/noreply", "{}", 1, key, CPubKey(), "paymenttx"), std::runtime_error);
+    BOOST_CHECK_EQUAL(server.requests, 9);
+    xrouter::ClearXRouterConnections();
+}
+
+BOOST_AUTO_TEST_CASE(xrouter_tests_form_reply) {
+    auto form = [](const std::string & uuid, const std::string & json) -> std::string {
+        UniValue reply;
+        BOOST_REQUIRE(reply.read(json));
+        return xrouter::form_reply(uuid, reply).write();
+    };
+    BOOST_CHECK_EQUAL(form("u", R"([1,2])"), R"({"reply":[1,2],"uuid":"u"})");
+    BOOST_CHECK_EQUAL(form("", R"({"a":1})"), R"({"reply":{"a":1}})");
+    BOOST_CHECK_EQUAL(form("", R"({"b":1,"code":5,"uuid":"x"})"), R"({"reply":{"b":1,"code":5,"uuid":"x"},"code":5,"uuid":"x"})");
+    BOOST_CHECK_EQUAL(form("", R"({"result":{"h":1},"z":1,"a":2})"), R"({"a":2,"z":1,"reply":{"h":1}})");
+    BOOST_CHECK_EQUAL(form("u", R"({"result":{"h":1},"z":1,"a":2})"), R"({"a":2,"reply":{"h":1},"z":1,"uuid":"u"})");
+    BOOST_CHECK_EQUAL(form("", R"({"error":"bad","z":1})"), R"({"error":"bad","z":1,"code":1002})");
+    BOOST_CHECK_EQUAL(form("u", R"({"error":"bad","code":3,"uuid":"x"})"), R"({"code":3,"error":"bad","uuid":"u"})");
+}
+
+BOOST_FIXTURE_TEST_CASE(xrouter_tests_querycache, BasicTestingSetup) {
+    xrouter::QueryCache qc;
+    std::atomic<int> runs{0};
+    std::atomic<bool> release{false};
+    auto slowQuery = [&](std::string & uuid) -> std::string {
+        uuid = "uuid" + std::to_string(++runs);
+        while (!release)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return "100";
+    };
+    const auto key = xrouter::QueryCache::makeKey("xrGetBlockCount", "xr::BLOCK", 1, "[]");
+
+    // Identical calls in flight share one query
+    std::vector<std::thread> callers;
+    std::vector<std::string> uuids(8), replies(8);
+    for (int i = 0; i < 8; ++i)
+        callers.emplace_back([&, i]() { replies[i] = qc.call(key, 0, uuids[i], slowQuery); });
+    while (json_spirit::find_value(qc.status(), "coalesced").get_int64() < 7)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    release = true;
+    for (auto & t : callers)
+        t.join();
+    BOOST_CHECK_EQUAL(runs, 1);
+    for (int i = 0; i < 8; ++i) {
+        BOOST_CHECK_EQUAL(replies[i], "100");
+        BOOST_CHECK_EQUAL(uuids[i], "uuid1");
+    }
+
+    // Without a ttl nothing is cached
+    std::string uuid;
+    BOOST_CHECK_EQUAL(qc.call(key, 0, uuid, slowQuery), "100");
+    BOOST_CHECK_EQUAL(runs, 2);
+
+    // Replies are cached for the ttl, errors are not cached
+    SetMockTime(GetTime());
+    BOOST_CHECK_EQUAL(qc.call(key, 2, uuid, slowQuery), "100");
+    BOOST_CHECK_EQUAL(qc.call(key, 2, uuid, slowQuery), "100");
+    BOOST_CHECK_EQUAL(uuid, "uuid3");
+    BOOST_CHECK_EQUAL(runs, 3);
+    SetMockTime(GetTime() + 2);
+    BOOST_CHECK_EQUAL(qc.call(key, 2, uuid, slowQuery), "100");
+    BOOST_CHECK_EQUAL(runs, 4);
+    const auto errKey = xrouter::QueryCache::makeKey("xrGetBlockCount", "xr::BTC", 1, "[]");
+    auto errQuery = [&](std::string & uuid) -> std::string { ++runs; return R"({"error":"failed","code":1002})"; };
+    qc.call(errKey, 2, uuid, errQuery);
+    qc.call(errKey, 2, uuid, errQuery);
+    BOOST_CHECK_EQUAL(runs, 6);
+    SetMockTime(0);
+
+    // Exceptions reach the caller and don't leave the query in flight
+    auto throwQuery = [](std::string & uuid) -> std::string { throw std::runtime_error("failed"); };
+    BOOST_CHECK_THROW(qc.call(key + "x", 2, uuid, throwQuery), std::runtime_error);
+    BOOST_CHECK_THROW(qc.call(key + "x", 2, uuid, throwQuery), std::runtime_error);
+
+    const auto status = qc.status();
+    BOOST_CHECK_EQUAL(json_spirit::find_value(status, "queries").get_int64(), 8);
+    BOOST_CHECK_EQUAL(json_spirit::find_value(status, "coalesced").get_int64(), 7);
+    BOOST_CHECK_EQUAL(json_spirit::find_value(status, "cached").get_int64(), 1);
+    BOOST_CHECK_EQUAL(json_spirit::find_value(status, "inflight").get_int64(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(xrouter_tests_querymgr) {
+    xrouter::QueryMgr qm;
+    BOOST_CHECK_EQUAL(qm.addReply("q1", "a", "1"), 0); // unknown query
+    for (const auto & node : {"a", "b", "c"})
+        qm.addQuery("q1", node);
+    BOOST_CHECK(qm.hasQuery("q1", "b"));
+    BOOST_CHECK(qm.hasNodeQuery("c"));
+    BOOST_CHECK(!qm.hasNodeQuery("d"));
+    BOOST_CHECK_EQUAL(qm.addReply("q1", "d", "1"), 0); // not queried
+
+    // Replies from several threads
+    std::vector<std::thread> threads;
+    threads.emplace_back([&qm]() { qm.addReply("q1", "a", R"({"result":1})"); });
+    threads.emplace_back([&qm]() { qm.addReply("q1", "b", R"({ "result" : 1 })"); });
+    threads.emplace_back([&qm]() { qm.addReply("q1", "c", R"({"result":2})"); });
+    for (auto & t : threads)
+        t.join();
+    BOOST_CHECK_EQUAL(qm.allReplies("q1").size(), 3);
+
+    std::string reply;
+    std::map<xrouter::NodeAddr, std::string> replies;
+    std::set<xrouter::NodeAddr> agree, diff;
+    BOOST_CHECK_EQUAL(qm.mostCommonReply("q1", reply, replies, agree, diff), 2);
+    BOOST_CHECK(reply == replies["a"] || reply == replies["b"]); // equal json
+    BOOST_CHECK(agree == std::set<xrouter::NodeAddr>({"a", "b"}));
+    BOOST_CHECK(diff == std::set<xrouter::NodeAddr>({"c"}));
+
+    // Replies stay available after the query is purged
+    qm.purge("q1");
+    BOOST_CHECK(!qm.hasQuery("q1"));
+    BOOST_CHECK(!qm.hasNodeQuery("a"));
+    BOOST_CHECK(qm.hasReply("q1", "c"));
+    BOOST_CHECK_EQUAL(qm.addReply("q1", "a", "late"), 0);
+    BOOST_CHECK(qm.allLocks("q2").empty());
+
+    BOOST_CHECK(!qm.hasScore("a"));
+    BOOST_CHECK_EQUAL(qm.updateScore("a", 4), 4);
+    BOOST_CHECK_EQUAL(qm.updateScore("a", -5), -1);
+    BOOST_CHECK_EQUAL(qm.banScore("b"), -30);
+    BOOST_CHECK_EQUAL(qm.getScore("b"), -30);
+    BOOST_CHECK_EQUAL(qm.getScore("c"), 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(xrouter_tests_replychunks, BasicTestingSetup) {
+    // Array replies are written element by element in full chunks
+    const std::string block(XROUTER_REPLY_CHUNK_SIZE / 2, 'a');
+    std::vector<std::string> parts(5, "\"" + block + "\"");
+    std::vector<std::string> chunks;
+    auto collect = [&chunks](const std::string & chunk, bool last) { chunks.push_back(chunk); };
+    BOOST_CHECK(xrouter::writeReplyChunks(parts, true, std::numeric_limits<uint32_t>::max(), collect));
+    const std::string expected = "[\"" + block + "\",\"" + block + "\",\"" + block + "\",\"" + block + "\",\"" + block + "\"]";
+    BOOST_CHECK_EQUAL(chunks.size(), expected.size() / XROUTER_REPLY_CHUNK_SIZE + 1);
+    for (size_t i = 0; i + 1 < chunks.size(); ++i)
+        BOOST_CHECK_EQUAL(chunks[i].size(), XROUTER_REPLY_CHUNK_SIZE);
+    BOOST_CHECK(parts[0].empty());
+    std::vector<std::string> small{R"({"a":1})"};
+    BOOST_CHECK(!xrouter::writeReplyChunks(small, false, 3, collect));
+
+    // Parts are produced as the chunks are sent, not up front
+    size_t produced{0};
+    size_t maxAhead{0};
+    chunks.clear();
+    auto source = [&](std::string & part) -> bool {
+        if (produced == 5)
+            return false;
+        ++produced;
+        maxAhead = std::max(maxAhead, produced - chunks.size());
+        part = "\"" + block + "\"";
+        return true;
+    };
+    BOOST_CHECK(xrouter::writeReplyChunks(source, true, std::numeric_limits<uint32_t>::max(), collect));
+    BOOST_CHECK_EQUAL(chunks.size(), expected.size() / XROUTER_REPLY_CHUNK_SIZE + 1);
+    BOOST_CHECK_LE(maxAhead, 3); // about a chunk's worth of parts ahead of the sends
+    auto failing = [](std::string & part) -> bool { throw std::runtime_error("wallet down"); };
+    BOOST_CHECK_THROW(xrouter::writeReplyChunks(failing, true, std::numeric_limits<uint32_t>::max(), collect), std::runtime_error);
+
+    // Chunks wait for the node's send buffer to drain
+    CNode peer(0, NODE_NETWORK, 0, INVALID_SOCKET, CAddress(CService(), NODE_NONE), 0, 0, CAddress(), "", false);
+    BOOST_CHECK(xrouter::XRouterServer::waitForSendBuffer(&peer, 0));
+    peer.fPauseSend = true;
+    BOOST_CHECK(!xrouter::XRouterServer::waitForSendBuffer(&peer, 0));
+    std::atomic<bool> drained{false};
+    std::thread socketThread([&peer, &drained]() {
+        MilliSleep(50);
+        drained = true;
+        peer.fPauseSend = false;
+    });
+    BOOST_CHECK(xrouter::XRouterServer::waitForSendBuffer(&peer, 60000));
+    BOOST_CHECK(drained);
+    socketThread.join();
+    peer.fPauseSend = true;
+    peer.fDisconnect = true;
+    BOOST_CHECK(!xrouter::XRouterServer::waitForSendBuffer(&peer, 60000));
+
+    // Chunks are assembled in any order
+    xrouter::QueryMgr qm;
+    qm.addQuery("q1", "a");
+    qm.addQuery("q1", "b");
+    std::string reply;
+    BOOST_CHECK_EQUAL(qm.addReplyChunk("q1", "a", 0, false, std::string(chunks[0]), reply), xrouter::QueryMgr::CHUNK_INVALID); // not requested
+    qm.setMaxReplySize("q1", expected.size());
+    for (int i = chunks.size() - 1; i > 0; --i)
+        BOOST_CHECK_EQUAL(qm.addReplyChunk("q1", "a", i, i == static_cast<int>(chunks.size()) - 1, std::string(chunks[i]), reply), xrouter::QueryMgr::CHUNK_PENDING);
+    BOOST_CHECK_EQUAL(qm.addReplyChunk("q1", "a", 0, false, std::string(chunks[0]), reply), xrouter::QueryMgr::CHUNK_COMPLETE);
+    BOOST_CHECK(reply == expected);
+
+    // Duplicates, chunks past the last one and replies over the limit are rejected
+    BOOST_CHECK_EQUAL(qm.addReplyChunk("q1", "b", 1, false, "x", reply), xrouter::QueryMgr::CHUNK_PENDING);
+    BOOST_CHECK_EQUAL(qm.addReplyChunk("q1", "b", 1, false, "x", reply), xrouter::QueryMgr::CHUNK_INVALID);
+    BOOST_CHECK_EQUAL(qm.addReplyChunk("q1", "b", 1, true, "x", reply), xrouter::QueryMgr::CHUNK_PENDING);
+    BOOST_CHECK_EQUAL(qm.addReplyChunk("q1", "b", 2, false, "x", reply), xrouter::QueryMgr::CHUNK_INVALID);
+    BOOST_CHECK_EQUAL(qm.addReplyChunk("q1", "b", 0, false, std::string(expected.size() + 1, 'x'), reply), xrouter::QueryMgr::CHUNK_TOO_LARGE);
+    qm.purge("q1");
+    BOOST_CHECK_EQUAL(qm.addReplyChunk("q1", "b", 0, true, "x", reply), xrouter::QueryMgr::CHUNK_INVALID);
+
+    // The client's limit is part of the signed query header
+    CKey key; key.MakeNewKey(true);
+    const auto pubkey = key.GetPubKey();
+    xrouter::XRouterPacket packet(xrouter::xrGetBlocks, xrouter::generateUUID());
+    packet.append(std::string("BLOCK"));
+    packet.setMaxReplySize(5000000);
+    BOOST_CHECK(packet.sign(std::vector<unsigned char>(pubkey.begin(), pubkey.end()), std::vector<unsigned char>(key.begin(), key.end())));
+    xrouter::XRouterPacket received;
+    BOOST_CHECK(received.copyFrom(packet.body()));
+    BOOST_CHECK_EQUAL(received.maxReplySize(), 5000000);
+    BOOST_CHECK(received.verify(received.vpubkey()));
+}
+
+BOOST_FIXTURE_TEST_CASE(xrouter_tests_latency, BasicTestingSetup) {
+    const std::string svc = "xr::BLOCK::xrGetBlockCount";
+    SetMockTime(GetTime());
+    xrouter::QueryMgr qm;
+    BOOST_CHECK_EQUAL(qm.getLatency("a", svc), -1);
+
+    // Moving average and percentiles of the recent samples
+    qm.updateLatency("a", svc, 100);
+    BOOST_CHECK_EQUAL(qm.getLatency("a", svc), 100);
+    qm.updateLatency("a", svc, 200);
+    BOOST_CHECK_CLOSE(qm.getLatency("a", svc), 120, 0.001);
+    xrouter::LatencyStats stats;
+    for (int i = 1; i <= 200; ++i)
+        stats.add(i, 0);
+    BOOST_CHECK_EQUAL(stats.recent.size(), xrouter::LatencyStats::WINDOW);
+    BOOST_CHECK_EQUAL(stats.percentile(50), 151);
+    BOOST_CHECK_EQUAL(stats.percentile(90), 191);
+    BOOST_CHECK_EQUAL(stats.percentile(100), 200);
+
+    // Unknown nodes get the median average of the other nodes
+    qm.updateLatency("b", svc, 400);
+    qm.updateLatency("c", svc, 50);
+    BOOST_CHECK_CLOSE(qm.getLatency("d", svc), 120, 0.001);
+    BOOST_CHECK_EQUAL(qm.getLatency("d", "xr::BTC::xrGetBlockCount"), -1);
+
+    // Nodes that don't reply are recorded at least as slow as their average
+    qm.addQuery("q1", "b", svc);
+    qm.purge("q1");
+    BOOST_CHECK_EQUAL(qm.latencyStats(svc)[std::make_pair(std::string("b"), svc)].count, 2);
+    BOOST_CHECK_GE(qm.getLatency("b", svc), 400);
+
+    // Stats survive a restart, stale stats are dropped
+    qm.updateLatency("e", "xr::LTC::xrGetBlockCount", 10);
+    SetMockTime(GetTime() + xrouter::QueryMgr::LATENCY_EXPIRY - 1);
+    for (const auto & node : {"a", "b", "c"})
+        qm.updateLatency(node, svc, 60);
+    const auto path = SetDataDir("xrlatency") / "xrlatency.dat";
+    BOOST_CHECK(qm.saveLatencyStats(path));
+    SetMockTime(GetTime() + 1);
+    xrouter::QueryMgr loaded;
+    BOOST_CHECK(loaded.loadLatencyStats(path));
+    SetMockTime(0);
+    BOOST_CHECK_EQUAL(loaded.latencyStats().size(), 3);
+    BOOST_CHECK_EQUAL(loaded.latencyStats("xr::LTC::xrGetBlockCount").size(), 0);
+    const auto before = qm.latencyStats(svc), after = loaded.latencyStats(svc);
+    for (const auto & item : before) {
+        BOOST_CHECK_CLOSE(after.at(item.first).ewma, item.second.ewma, 0.001);
+        BOOST_CHECK_EQUAL(after.at(item.first).count, item.second.count);
+        BOOST_CHECK(after.at(item.first).recent == item.second.recent);
+    }
+    BOOST_CHECK(!loaded.loadLatencyStats(path.parent_path() / "missing.dat"));
+
+    // Hedged query, two replies meet the quorum and the third node never replies
+    for (const auto & node : {"a", "c", "h"})
+        qm.addQuery("q2", node, svc);
+    qm.addReply("q2", "c", R"({"result":1})");
+    qm.addReply("q2", "a", R"({"result":1})");
+    BOOST_CHECK(qm.finish("q2") == std::set<xrouter::NodeAddr>({"h"}));
+    BOOST_CHECK(!qm.hasQuery("q2", "h"));
+    BOOST_CHECK_EQUAL(qm.addReply("q2", "h", R"({"result":2})"), 0);
+    BOOST_CHECK(!qm.hasReply("q2", "h"));
+    BOOST_CHECK(qm.finish("q2").empty());
+}
+
+BOOST_FIXTURE_TEST_CASE(xrouter_tests_configcache, BasicTestingSetup) {
+    CKey key; key.MakeNewKey(true);
+    const auto pubkey = key.GetPubKey();
+    const std::string ping = R"({"config":"[Main]\nhost=127.0.0.1\nport=41412\nwallets=BLOCK,LTC\n","plugins":{"free":"parameters=\nfee=0\n","paid":"parameters=\nfee=0.1\n","bad":5}})";
+    const std::string reply = R"({ "config" : "[Main]\nhost=127.0.0.1\nport=41412\nwallets=BLOCK,LTC\n", "plugins" : { "paid" : "parameters=\nfee=0.1\n", "free" : "parameters=\nfee=0\n", "bad" : 5 } })";
+
+    // Hashes version the config contents, not its json formatting
+    const auto hash = xrouter::ConfigCache::configHash(ping, sn::ServiceNode::SPV);
+    BOOST_CHECK(hash == xrouter::ConfigCache::configHash(reply, sn::ServiceNode::SPV));
+    BOOST_CHECK(hash != xrouter::ConfigCache::configHash(ping, sn::ServiceNode::OPEN));
+    BOOST_CHECK(hash != xrouter::ConfigCache::configHash(R"({"config":"[Main]\nhost=127.0.0.1\nport=41413\n"})", sn::ServiceNode::SPV));
+
+    // Paid plugins are excluded on the open tier
+    int badPlugins{0};
+    auto settings = xrouter::ConfigCache::parse(pubkey, ping, sn::ServiceNode::SPV, badPlugins);
+    BOOST_REQUIRE(settings);
+    BOOST_CHECK_EQUAL(badPlugins, 1);
+    BOOST_CHECK(settings->hasPlugin("free") && settings->hasPlugin("paid"));
+    BOOST_CHECK_EQUAL(settings->getAddr().ToStringIPPort(), "127.0.0.1:41412");
+    badPlugins = 0;
+    auto open = xrouter::ConfigCache::parse(pubkey, ping, sn::ServiceNode::OPEN, badPlugins);
+    BOOST_REQUIRE(open);
+    BOOST_CHECK(open->hasPlugin("free") && !open->hasPlugin("paid"));
+    BOOST_CHECK(!xrouter::ConfigCache::parse(pubkey, R"({"config":"[Main]\nport=41412\n"})", sn::ServiceNode::SPV, badPlugins));
+    BOOST_CHECK(!xrouter::ConfigCache::parse(pubkey, "not json", sn::ServiceNode::SPV, badPlugins));
+
+    // Only the current version of the config is returned
+    xrouter::ConfigCache cache;
+    BOOST_CHECK(!cache.get(pubkey, hash));
+    cache.put(pubkey, hash, sn::ServiceNode::SPV, ping, settings);
+    BOOST_CHECK(cache.get(pubkey, hash) == settings);
+    BOOST_CHECK(!cache.get(pubkey, xrouter::ConfigCache::configHash(ping, sn::ServiceNode::OPEN)));
+
+    // Hostnames are resolved again once their address is older than RESOLVE_TTL
+    CKey moved; moved.MakeNewKey(true);
+    const std::string movedConfig = "[Main]\nhost=snode.example.com\nport=41412\n";
+    const std::string movedPing = R"({"config":"[Main]\nhost=snode.example.com\nport=41412\n"})";
+    const auto movedHash = xrouter::ConfigCache::configHash(movedPing, sn::ServiceNode::SPV);
+    auto movedSettings = std::make_shared<xrouter::XRouterSettings>(moved.GetPubKey(), false);
+    BOOST_REQUIRE(movedSettings->init(movedConfig, settings->getAddr()));
+    const int64_t resolved = GetTime();
+    SetMockTime(resolved);
+    cache.put(moved.GetPubKey(), movedHash, sn::ServiceNode::SPV, movedPing, movedSettings);
+    SetMockTime(resolved + xrouter::ConfigCache::RESOLVE_TTL - 1);
+    BOOST_CHECK(cache.get(moved.GetPubKey(), movedHash) == movedSettings);
+    BOOST_CHECK(cache.get(pubkey, hash) == settings);
+    SetMockTime(resolved + xrouter::ConfigCache::RESOLVE_TTL);
+    BOOST_CHECK(!cache.get(moved.GetPubKey(), movedHash));
+    BOOST_CHECK(cache.get(pubkey, hash) == settings); // IP hosts are kept
+    SetMockTime(0);
+
+    // Configs survive a restart without being fetched again, stale configs are dropped
+    CKey stale; stale.MakeNewKey(true);
+    cache.put(stale.GetPubKey(), hash, sn::ServiceNode::SPV, ping, settings);
+    CKey named; named.MakeNewKey(true);
+    const std::string namedPing = R"({"config":"[Main]\nhost=snode.example.com\nport=41412\n"})";
+    const auto namedHash = xrouter::ConfigCache::configHash(namedPing, sn::ServiceNode::SPV);
+    cache.put(named.GetPubKey(), namedHash, sn::ServiceNode::SPV, namedPing, settings);
+    SetMockTime(GetTime() + xrouter::ConfigCache::EXPIRY - 1);
+    BOOST_CHECK(cache.get(pubkey, hash));
+    const auto path = SetDataDir("xrconfigs") / "xrconfigs.dat";
+    BOOST_CHECK(cache.save(path));
+    SetMockTime(GetTime() + 1);
+    xrouter::ConfigCache loaded;
+    BOOST_CHECK(loaded.load(path));
+    SetMockTime(0);
+    BOOST_CHECK(!loaded.get(stale.GetPubKey(), hash));
+    auto restored = loaded.get(pubkey, hash);
+    BOOST_REQUIRE(restored);
+    BOOST_CHECK(restored != settings);
+    BOOST_CHECK_EQUAL(restored->getAddr().ToStringIPPort(), "127.0.0.1:41412");
+    BOOST_CHECK(restored->hasWallet("LTC"));
+    BOOST_CHECK(restored->hasPlugin("paid"));
+    BOOST_CHECK(loaded.get(pubkey, hash) == restored);
+    // Hostnames are resolved again instead of using the persisted address
+    BOOST_CHECK(!loaded.get(named.GetPubKey(), namedHash));
+    BOOST_CHECK(!loaded.load(path.parent_path() / "missing.dat"));
+}
+
 #ifdef USE_XROUTERCLIENT
 
 BOOST_FIXTURE_TEST_CASE(xrouter_tests_waitforservice, XRouterTestClientTestnet) {
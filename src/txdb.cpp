@@ -182,6 +182,32 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
     return Read(DB_LAST_BLOCK, nFile);
 }
 
+bool CCoinsViewDB::WriteSnapshotCoins(std::vector<std::pair<COutPoint, Coin>> &coins, const uint256 &hashBlock, bool fFinal) {
+    CDBBatch batch(db);
+    assert(!hashBlock.IsNull());
+
+    // Like BatchWrite, but the transition marker spans all batches of the snapshot. A load that
+    // is interrupted half way leaves the head blocks in place and is caught by ReplayBlocks on
+    // the next startup instead of passing for a complete utxo set.
+    if (GetHeadBlocks().empty()) {
+        batch.Erase(DB_BEST_BLOCK);
+        batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, GetBestBlock()});
+    }
+
+    for (auto &item : coins) {
+        CoinEntry entry(&item.first);
+        batch.Write(entry, item.second);
+    }
+
+    if (fFinal) {
+        batch.Erase(DB_HEAD_BLOCKS);
+        batch.Write(DB_BEST_BLOCK, hashBlock);
+    }
+
+    LogPrint(BCLog::COINDB, "Writing snapshot batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
+    return db.WriteBatch(batch);
+}
+
 CCoinsViewCursor *CCoinsViewDB::Cursor() const
 {
     CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper&>(db).NewIterator(), GetBestBlock());
@@ -37,6 +37,10 @@ static const int64_t nMaxBlockDBCache = 16;
 // Unlike for the UTXO database, for the txindex scenario the leveldb cache make
 // a meaningful difference: https://github.com/bitcoin/bitcoin/pull/8273#issuecomment-229601991
 static const int64_t nMaxTxIndexCache = 3096;
+//! Max memory allocated to all block filter index caches combined in MiB.
+static const int64_t max_filter_index_cache = 1024;
+//! Max memory allocated to each of the address and spent index caches in MiB.
+static const int64_t max_address_index_cache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 32;
 //! Max memory allocated to governance cache (MiB)
@@ -57,6 +61,10 @@ public:
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
 
+    //! Write a batch of coins loaded from a utxo snapshot based on hashBlock. The database stays
+    //! marked as in transition to hashBlock until the final batch is written.
+    bool WriteSnapshotCoins(std::vector<std::pair<COutPoint, Coin>> &coins, const uint256 &hashBlock, bool fFinal);
+
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
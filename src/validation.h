@@ -37,6 +37,7 @@
 #include <atomic>
 
 class CBlockIndex;
+class CBlockUndo;
 class CBlockTreeDB;
 class CChainParams;
 class CCoinsViewDB;
@@ -46,6 +47,7 @@ class CScriptCheck;
 class CBlockPolicyEstimator;
 class CTxMemPool;
 class CValidationState;
+class SnapshotMetadata;
 struct ChainTxData;
 
 struct PrecomputedTransactionData;
@@ -86,6 +88,12 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Maximum number of threads decoding blocks during -reindex and -loadblock */
+static const int MAX_BLOCK_IMPORT_THREADS = 16;
+/** Maximum number of blocks read ahead of the block being accepted during -reindex and -loadblock */
+static const unsigned int MAX_BLOCK_IMPORT_WINDOW = 1024;
+/** Maximum number of bytes read ahead of the block being accepted during -reindex and -loadblock */
+static const unsigned int MAX_BLOCK_IMPORT_WINDOW_BYTES = 16 * 1000 * 1000;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 64;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -156,7 +164,8 @@ extern CTxMemPool mempool;
 extern std::atomic_bool g_is_mempool_loaded;
 typedef std::unordered_map<uint256, CBlockIndex*, BlockHasher> BlockMap;
 extern BlockMap& mapBlockIndex GUARDED_BY(cs_main);
-extern std::map<int, CBlockIndex*> mapHeaderIndex GUARDED_BY(cs_main);
+/** Last header seen at each height before the V05 staking protocol, see GetKernelStakeModifierV03 */
+extern std::vector<CBlockIndex*> vHeaderIndex GUARDED_BY(cs_main);
 extern const std::string strMessageMagic;
 extern Mutex g_best_block_mutex;
 extern std::condition_variable g_best_block_cv;
@@ -257,7 +266,11 @@ bool CheckDiskSpace(uint64_t nAdditionalBytes = 0, bool blocks_dir = false);
 FILE* OpenBlockFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 /** Translation to a filesystem path */
 fs::path GetBlockPosFilename(const CDiskBlockPos &pos, const char *prefix);
-/** Import blocks from an external file */
+/**
+ * Import blocks from an external file. The file is read ahead of the block being accepted, a pool
+ * of worker threads decodes the blocks in the read-ahead window and the blocks are then accepted in
+ * file order.
+ */
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp = nullptr);
 /** Ensures we have a genesis block in the block tree, possibly writing one to disk. */
 bool LoadGenesisBlock(const CChainParams& chainparams);
@@ -406,6 +419,9 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start);
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start);
 
+/** Read the undo data of a connected block from disk. */
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex);
+
 /** Functions for validating blocks and updating the block tree */
 
 /** Context-independent validity checks */
@@ -509,6 +525,25 @@ bool DumpMempool();
 /** Load the mempool from disk. */
 bool LoadMempool();
 
+/** Hash of a utxo snapshot, committing to its metadata and to all records that follow it. */
+uint256 UTXOSnapshotHash(const SnapshotMetadata& metadata, const uint256& records_hash);
+
+/**
+ * Write a utxo snapshot of the chain tip to the specified path (see SnapshotMetadata for the
+ * format). The governance index must be in sync with the tip.
+ */
+bool DumpUTXOSnapshot(const fs::path& path, SnapshotMetadata& metadata, uint256& hash, std::string& error);
+
+/** Read the metadata at the start of a utxo snapshot. */
+bool ReadUTXOSnapshotMetadata(const fs::path& path, SnapshotMetadata& metadata, std::string& error);
+
+/**
+ * Load a utxo snapshot on a node that has synced the headers up to the snapshot base block but
+ * no blocks yet. The snapshot must hash to expected_hash. On success the chain tip is the base
+ * block, the blocks below it are treated as pruned and the node continues to sync from there.
+ */
+bool LoadUTXOSnapshot(const fs::path& path, const uint256& expected_hash, SnapshotMetadata& metadata, std::string& error);
+
 //! Check whether the block associated with this index entry is pruned or not.
 inline bool IsBlockPruned(const CBlockIndex* pblockindex)
 {
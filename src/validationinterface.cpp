@@ -9,16 +9,129 @@
 #include <scheduler.h>
 #include <txmempool.h>
 #include <util/system.h>
+#include <util/time.h>
 #include <validation.h>
 
 #include <list>
 #include <atomic>
 #include <future>
+#include <typeinfo>
 #include <utility>
 
 #include <boost/signals2/signal.hpp>
 
+/**
+ * A registered subscriber. Times its callbacks and in parallel mode runs them on its own
+ * queue, which like SingleThreadedSchedulerClient executes one callback at a time on the
+ * scheduler but stays alive for as long as callbacks are queued.
+ */
+struct ValidationInterfaceSubscriber : public std::enable_shared_from_this<ValidationInterfaceSubscriber> {
+    CValidationInterface* const m_iface;
+    const std::string m_name;
+    CScheduler* const m_pscheduler; // parallel mode only
+    std::atomic<bool> m_connected{true};
+
+    Mutex m_cs_queue;
+    std::list<std::function<void ()>> m_queue GUARDED_BY(m_cs_queue);
+    bool m_running GUARDED_BY(m_cs_queue) = false;
+
+    Mutex m_cs_stats;
+    ValidationInterfaceStats m_stats GUARDED_BY(m_cs_stats);
+
+    ValidationInterfaceSubscriber(CValidationInterface* iface, const std::string& name, CScheduler* pscheduler)
+        : m_iface(iface), m_name(name), m_pscheduler(pscheduler) {}
+
+    template <typename Callable>
+    void Invoke(Callable&& func)
+    {
+        if (!m_connected)
+            return;
+        const int64_t nStart = GetTimeMicros();
+        func(m_iface);
+        const int64_t nTime = GetTimeMicros() - nStart;
+        LOCK(m_cs_stats);
+        ++m_stats.callbacks;
+        m_stats.totalTime += nTime;
+        m_stats.maxTime = std::max(m_stats.maxTime, nTime);
+        m_stats.lastTime = nTime;
+    }
+
+    void AddToProcessQueue(std::function<void ()> func)
+    {
+        {
+            LOCK(m_cs_queue);
+            m_queue.push_back(std::move(func));
+            if (m_running)
+                return;
+            m_running = true;
+        }
+        Schedule();
+    }
+
+    void Schedule()
+    {
+        auto self = shared_from_this();
+        m_pscheduler->schedule([self] { self->ProcessQueue(); });
+    }
+
+    /** Runs the next callback and schedules the one after it, other subscribers' callbacks may run in between */
+    void ProcessQueue()
+    {
+        std::function<void ()> callback;
+        {
+            LOCK(m_cs_queue);
+            if (m_queue.empty()) {
+                m_running = false;
+                return;
+            }
+            callback = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+        // Schedule the next callback even if this one throws
+        struct RAIIReschedule {
+            ValidationInterfaceSubscriber* subscriber;
+            ~RAIIReschedule() { subscriber->Schedule(); }
+        } reschedule{this};
+        callback();
+    }
+
+    /** Processes all queued callbacks on the calling thread, the scheduler must not be running */
+    void EmptyQueue()
+    {
+        while (true) {
+            std::function<void ()> callback;
+            {
+                LOCK(m_cs_queue);
+                if (m_queue.empty())
+                    return;
+                callback = std::move(m_queue.front());
+                m_queue.pop_front();
+            }
+            callback();
+        }
+    }
+
+    size_t CallbacksPending()
+    {
+        LOCK(m_cs_queue);
+        return m_queue.size();
+    }
+
+    ValidationInterfaceStats Stats()
+    {
+        ValidationInterfaceStats stats;
+        {
+            LOCK(m_cs_stats);
+            stats = m_stats;
+        }
+        stats.name = m_name;
+        stats.pending = CallbacksPending();
+        return stats;
+    }
+};
+
 struct ValidationInterfaceConnections {
+    std::shared_ptr<ValidationInterfaceSubscriber> subscriber;
     boost::signals2::scoped_connection UpdatedBlockTip;
     boost::signals2::scoped_connection TransactionAddedToMempool;
     boost::signals2::scoped_connection BlockConnected;
@@ -45,9 +158,33 @@ struct MainSignalsInstance {
     // but must ensure all callbacks happen in-order, so we end up creating
     // our own queue here :(
     SingleThreadedSchedulerClient m_schedulerClient;
-    std::unordered_map<CValidationInterface*, ValidationInterfaceConnections> m_connMainSignals;
+    CScheduler* const m_pscheduler;
+    const bool m_parallel;
+
+    Mutex m_cs_subscribers;
+    std::unordered_map<CValidationInterface*, ValidationInterfaceConnections> m_connMainSignals GUARDED_BY(m_cs_subscribers);
+
+    explicit MainSignalsInstance(CScheduler *pscheduler, bool fParallel) : m_schedulerClient(pscheduler), m_pscheduler(pscheduler), m_parallel(fParallel) {}
+
+    std::vector<std::shared_ptr<ValidationInterfaceSubscriber>> Subscribers()
+    {
+        LOCK(m_cs_subscribers);
+        std::vector<std::shared_ptr<ValidationInterfaceSubscriber>> subscribers;
+        subscribers.reserve(m_connMainSignals.size());
+        for (const auto& conns : m_connMainSignals)
+            subscribers.push_back(conns.second.subscriber);
+        return subscribers;
+    }
 
-    explicit MainSignalsInstance(CScheduler *pscheduler) : m_schedulerClient(pscheduler) {}
+    /** Parallel mode: queue the callback on each subscriber's own queue */
+    void Enqueue(const std::function<void (CValidationInterface*)>& func)
+    {
+        for (auto& subscriber : Subscribers()) {
+            subscriber->AddToProcessQueue([subscriber, func] {
+                subscriber->Invoke(func);
+            });
+        }
+    }
 };
 
 static CMainSignals g_signals;
@@ -57,9 +194,9 @@ static CMainSignals g_signals;
 // so MainSignalsInstance hasn't been created yet.
 static std::unordered_map<CTxMemPool*, boost::signals2::scoped_connection> g_connNotifyEntryRemoved;
 
-void CMainSignals::RegisterBackgroundSignalScheduler(CScheduler& scheduler) {
+void CMainSignals::RegisterBackgroundSignalScheduler(CScheduler& scheduler, bool fParallel) {
     assert(!m_internals);
-    m_internals.reset(new MainSignalsInstance(&scheduler));
+    m_internals.reset(new MainSignalsInstance(&scheduler, fParallel));
 }
 
 void CMainSignals::UnregisterBackgroundSignalScheduler() {
@@ -69,12 +206,31 @@ void CMainSignals::UnregisterBackgroundSignalScheduler() {
 void CMainSignals::FlushBackgroundCallbacks() {
     if (m_internals) {
         m_internals->m_schedulerClient.EmptyQueue();
+        for (auto& subscriber : m_internals->Subscribers())
+            subscriber->EmptyQueue();
     }
 }
 
 size_t CMainSignals::CallbacksPending() {
     if (!m_internals) return 0;
-    return m_internals->m_schedulerClient.CallbacksPending();
+    size_t pending = m_internals->m_schedulerClient.CallbacksPending();
+    if (m_internals->m_parallel) {
+        for (auto& subscriber : m_internals->Subscribers())
+            pending += subscriber->CallbacksPending();
+    }
+    return pending;
+}
+
+bool CMainSignals::ParallelCallbacks() {
+    return m_internals && m_internals->m_parallel;
+}
+
+std::vector<ValidationInterfaceStats> CMainSignals::CallbackStats() {
+    std::vector<ValidationInterfaceStats> stats;
+    if (!m_internals) return stats;
+    for (auto& subscriber : m_internals->Subscribers())
+        stats.push_back(subscriber->Stats());
+    return stats;
 }
 
 void CMainSignals::RegisterWithMempoolSignals(CTxMemPool& pool) {
@@ -93,22 +249,55 @@ CMainSignals& GetMainSignals()
     return g_signals;
 }
 
-void RegisterValidationInterface(CValidationInterface* pwalletIn) {
-    ValidationInterfaceConnections& conns = g_signals.m_internals->m_connMainSignals[pwalletIn];
-    conns.UpdatedBlockTip = g_signals.m_internals->UpdatedBlockTip.connect(std::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
-    conns.TransactionAddedToMempool = g_signals.m_internals->TransactionAddedToMempool.connect(std::bind(&CValidationInterface::TransactionAddedToMempool, pwalletIn, std::placeholders::_1));
-    conns.BlockConnected = g_signals.m_internals->BlockConnected.connect(std::bind(&CValidationInterface::BlockConnected, pwalletIn, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
-    conns.BlockDisconnected = g_signals.m_internals->BlockDisconnected.connect(std::bind(&CValidationInterface::BlockDisconnected, pwalletIn, std::placeholders::_1));
-    conns.TransactionRemovedFromMempool = g_signals.m_internals->TransactionRemovedFromMempool.connect(std::bind(&CValidationInterface::TransactionRemovedFromMempool, pwalletIn, std::placeholders::_1));
-    conns.ChainStateFlushed = g_signals.m_internals->ChainStateFlushed.connect(std::bind(&CValidationInterface::ChainStateFlushed, pwalletIn, std::placeholders::_1));
-    conns.Broadcast = g_signals.m_internals->Broadcast.connect(std::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, std::placeholders::_1, std::placeholders::_2));
-    conns.BlockChecked = g_signals.m_internals->BlockChecked.connect(std::bind(&CValidationInterface::BlockChecked, pwalletIn, std::placeholders::_1, std::placeholders::_2));
-    conns.NewPoWValidBlock = g_signals.m_internals->NewPoWValidBlock.connect(std::bind(&CValidationInterface::NewPoWValidBlock, pwalletIn, std::placeholders::_1, std::placeholders::_2));
+void RegisterValidationInterface(CValidationInterface* pwalletIn, const std::string& name) {
+    MainSignalsInstance& internals = *g_signals.m_internals;
+    auto subscriber = std::make_shared<ValidationInterfaceSubscriber>(pwalletIn, name.empty() ? typeid(*pwalletIn).name() : name,
+                                                                      internals.m_parallel ? internals.m_pscheduler : nullptr);
+    LOCK(internals.m_cs_subscribers);
+    auto it = internals.m_connMainSignals.find(pwalletIn);
+    if (it != internals.m_connMainSignals.end()) {
+        it->second.subscriber->m_connected = false;
+        internals.m_connMainSignals.erase(it);
+    }
+    ValidationInterfaceConnections& conns = internals.m_connMainSignals[pwalletIn];
+    conns.subscriber = subscriber;
+    conns.UpdatedBlockTip = internals.UpdatedBlockTip.connect([subscriber](const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) {
+        subscriber->Invoke([&](CValidationInterface* iface) { iface->UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload); });
+    });
+    conns.TransactionAddedToMempool = internals.TransactionAddedToMempool.connect([subscriber](const CTransactionRef &ptx) {
+        subscriber->Invoke([&](CValidationInterface* iface) { iface->TransactionAddedToMempool(ptx); });
+    });
+    conns.BlockConnected = internals.BlockConnected.connect([subscriber](const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex, const std::vector<CTransactionRef>& vtxConflicted) {
+        subscriber->Invoke([&](CValidationInterface* iface) { iface->BlockConnected(pblock, pindex, vtxConflicted); });
+    });
+    conns.BlockDisconnected = internals.BlockDisconnected.connect([subscriber](const std::shared_ptr<const CBlock> &pblock) {
+        subscriber->Invoke([&](CValidationInterface* iface) { iface->BlockDisconnected(pblock); });
+    });
+    conns.TransactionRemovedFromMempool = internals.TransactionRemovedFromMempool.connect([subscriber](const CTransactionRef &ptx) {
+        subscriber->Invoke([&](CValidationInterface* iface) { iface->TransactionRemovedFromMempool(ptx); });
+    });
+    conns.ChainStateFlushed = internals.ChainStateFlushed.connect([subscriber](const CBlockLocator &locator) {
+        subscriber->Invoke([&](CValidationInterface* iface) { iface->ChainStateFlushed(locator); });
+    });
+    conns.Broadcast = internals.Broadcast.connect([subscriber](int64_t nBestBlockTime, CConnman* connman) {
+        subscriber->Invoke([&](CValidationInterface* iface) { iface->ResendWalletTransactions(nBestBlockTime, connman); });
+    });
+    conns.BlockChecked = internals.BlockChecked.connect([subscriber](const CBlock& block, const CValidationState& state) {
+        subscriber->Invoke([&](CValidationInterface* iface) { iface->BlockChecked(block, state); });
+    });
+    conns.NewPoWValidBlock = internals.NewPoWValidBlock.connect([subscriber](const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& block) {
+        subscriber->Invoke([&](CValidationInterface* iface) { iface->NewPoWValidBlock(pindex, block); });
+    });
 }
 
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
     if (g_signals.m_internals) {
-        g_signals.m_internals->m_connMainSignals.erase(pwalletIn);
+        LOCK(g_signals.m_internals->m_cs_subscribers);
+        auto it = g_signals.m_internals->m_connMainSignals.find(pwalletIn);
+        if (it == g_signals.m_internals->m_connMainSignals.end())
+            return;
+        it->second.subscriber->m_connected = false;
+        g_signals.m_internals->m_connMainSignals.erase(it);
     }
 }
 
@@ -116,11 +305,29 @@ void UnregisterAllValidationInterfaces() {
     if (!g_signals.m_internals) {
         return;
     }
+    LOCK(g_signals.m_internals->m_cs_subscribers);
+    for (auto& conns : g_signals.m_internals->m_connMainSignals)
+        conns.second.subscriber->m_connected = false;
     g_signals.m_internals->m_connMainSignals.clear();
 }
 
 void CallFunctionInValidationInterfaceQueue(std::function<void ()> func) {
-    g_signals.m_internals->m_schedulerClient.AddToProcessQueue(std::move(func));
+    if (!g_signals.m_internals->m_parallel) {
+        g_signals.m_internals->m_schedulerClient.AddToProcessQueue(std::move(func));
+        return;
+    }
+    // Every queue gets a marker, the last queue to reach its marker calls func so that
+    // the callbacks queued before now have finished on all of them.
+    const auto subscribers = g_signals.m_internals->Subscribers();
+    auto remaining = std::make_shared<std::atomic<size_t>>(subscribers.size() + 1);
+    auto shared_func = std::make_shared<std::function<void ()>>(std::move(func));
+    auto marker = [remaining, shared_func] {
+        if (--*remaining == 0)
+            (*shared_func)();
+    };
+    for (const auto& subscriber : subscribers)
+        subscriber->AddToProcessQueue(marker);
+    g_signals.m_internals->m_schedulerClient.AddToProcessQueue(marker);
 }
 
 void SyncWithValidationInterfaceQueue() {
@@ -135,6 +342,10 @@ void SyncWithValidationInterfaceQueue() {
 
 void CMainSignals::MempoolEntryRemoved(CTransactionRef ptx, MemPoolRemovalReason reason) {
     if (reason != MemPoolRemovalReason::BLOCK && reason != MemPoolRemovalReason::CONFLICT) {
+        if (m_internals->m_parallel) {
+            m_internals->Enqueue([ptx](CValidationInterface* iface) { iface->TransactionRemovedFromMempool(ptx); });
+            return;
+        }
         m_internals->m_schedulerClient.AddToProcessQueue([ptx, this] {
             m_internals->TransactionRemovedFromMempool(ptx);
         });
@@ -146,30 +357,54 @@ void CMainSignals::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockInd
     // the chain actually updates. One way to ensure this is for the caller to invoke this signal
     // in the same critical section where the chain is updated
 
+    if (m_internals->m_parallel) {
+        m_internals->Enqueue([pindexNew, pindexFork, fInitialDownload](CValidationInterface* iface) {
+            iface->UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload);
+        });
+        return;
+    }
     m_internals->m_schedulerClient.AddToProcessQueue([pindexNew, pindexFork, fInitialDownload, this] {
         m_internals->UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload);
     });
 }
 
 void CMainSignals::TransactionAddedToMempool(const CTransactionRef &ptx) {
+    if (m_internals->m_parallel) {
+        m_internals->Enqueue([ptx](CValidationInterface* iface) { iface->TransactionAddedToMempool(ptx); });
+        return;
+    }
     m_internals->m_schedulerClient.AddToProcessQueue([ptx, this] {
         m_internals->TransactionAddedToMempool(ptx);
     });
 }
 
 void CMainSignals::BlockConnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex, const std::shared_ptr<const std::vector<CTransactionRef>>& pvtxConflicted) {
+    if (m_internals->m_parallel) {
+        m_internals->Enqueue([pblock, pindex, pvtxConflicted](CValidationInterface* iface) {
+            iface->BlockConnected(pblock, pindex, *pvtxConflicted);
+        });
+        return;
+    }
     m_internals->m_schedulerClient.AddToProcessQueue([pblock, pindex, pvtxConflicted, this] {
         m_internals->BlockConnected(pblock, pindex, *pvtxConflicted);
     });
 }
 
 void CMainSignals::BlockDisconnected(const std::shared_ptr<const CBlock> &pblock) {
+    if (m_internals->m_parallel) {
+        m_internals->Enqueue([pblock](CValidationInterface* iface) { iface->BlockDisconnected(pblock); });
+        return;
+    }
     m_internals->m_schedulerClient.AddToProcessQueue([pblock, this] {
         m_internals->BlockDisconnected(pblock);
     });
 }
 
 void CMainSignals::ChainStateFlushed(const CBlockLocator &locator) {
+    if (m_internals->m_parallel) {
+        m_internals->Enqueue([locator](CValidationInterface* iface) { iface->ChainStateFlushed(locator); });
+        return;
+    }
     m_internals->m_schedulerClient.AddToProcessQueue([locator, this] {
         m_internals->ChainStateFlushed(locator);
     });
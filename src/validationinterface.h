@@ -11,6 +11,8 @@
 
 #include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 
 extern CCriticalSection cs_main;
 class CBlock;
@@ -26,10 +28,23 @@ class CScheduler;
 class CTxMemPool;
 enum class MemPoolRemovalReason;
 
+/** Default number of extra scheduler threads serving per-subscriber notification queues (0 = one shared queue) */
+static const int DEFAULT_PARALLEL_SIGNALS = 0;
+
+/** Callback statistics of a validation interface subscriber */
+struct ValidationInterfaceStats {
+    std::string name;
+    uint64_t callbacks{0};
+    int64_t totalTime{0}; // microseconds
+    int64_t maxTime{0}; // microseconds
+    int64_t lastTime{0}; // microseconds
+    size_t pending{0}; // callbacks waiting on the subscriber's own queue
+};
+
 // These functions dispatch to one or all registered wallets
 
-/** Register a wallet to receive updates from core */
-void RegisterValidationInterface(CValidationInterface* pwalletIn);
+/** Register a wallet to receive updates from core, name is used in the callback statistics */
+void RegisterValidationInterface(CValidationInterface* pwalletIn, const std::string& name = "");
 /** Unregister a wallet from core */
 void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 /** Unregister all wallets from core */
@@ -147,7 +162,8 @@ protected:
      * Notifies listeners that a block which builds directly on our current tip
      * has been received and connected to the headers tree, though not validated yet */
     virtual void NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& block) {};
-    friend void ::RegisterValidationInterface(CValidationInterface*);
+    friend class CMainSignals;
+    friend void ::RegisterValidationInterface(CValidationInterface*, const std::string&);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
 };
@@ -157,7 +173,7 @@ class CMainSignals {
 private:
     std::unique_ptr<MainSignalsInstance> m_internals;
 
-    friend void ::RegisterValidationInterface(CValidationInterface*);
+    friend void ::RegisterValidationInterface(CValidationInterface*, const std::string&);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
     friend void ::CallFunctionInValidationInterfaceQueue(std::function<void ()> func);
@@ -165,14 +181,20 @@ private:
     void MempoolEntryRemoved(CTransactionRef tx, MemPoolRemovalReason reason);
 
 public:
-    /** Register a CScheduler to give callbacks which should run in the background (may only be called once) */
-    void RegisterBackgroundSignalScheduler(CScheduler& scheduler);
+    /** Register a CScheduler to give callbacks which should run in the background (may only be called once).
+     *  With fParallel set each subscriber gets its own ordered queue so that a slow subscriber doesn't delay
+     *  the others, the scheduler should then be serviced by more than one thread. */
+    void RegisterBackgroundSignalScheduler(CScheduler& scheduler, bool fParallel = false);
     /** Unregister a CScheduler to give callbacks which should run in the background - these callbacks will now be dropped! */
     void UnregisterBackgroundSignalScheduler();
     /** Call any remaining callbacks on the calling thread */
     void FlushBackgroundCallbacks();
 
     size_t CallbacksPending();
+    /** Whether subscribers are notified on their own queues */
+    bool ParallelCallbacks();
+    /** Callback statistics of all registered subscribers */
+    std::vector<ValidationInterfaceStats> CallbackStats();
 
     /** Register with mempool to call TransactionRemovedFromMempool callbacks */
     void RegisterWithMempoolSignals(CTxMemPool& pool);
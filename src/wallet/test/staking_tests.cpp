@@ -7,6 +7,7 @@
 #include <consensus/merkle.h>
 #include <core_io.h>
 #include <node/transaction.h>
+#include <wallet/coincontrol.h>
 
 std::map<std::string, std::shared_ptr<TestChainPoSData>> g_CachedTestChainPoS;
 
@@ -705,6 +706,72 @@ BOOST_FIXTURE_TEST_CASE(staking_tests_stakes, TestChainPoS)
         StakeBlocks(1), SyncWithValidationInterfaceQueue();
     }
 
+    // Check staking with mempool transactions selected ahead of time
+    {
+        auto selection = BlockAssembler(Params()).SelectBlockTxs();
+        BOOST_CHECK(selection->hashPrevBlock == chainActive.Tip()->GetBlockHash());
+        StakeMgr::StakeCoin nextStake;
+        BOOST_CHECK(findStake(nextStake, staker, chainActive.Tip(), wallet, stakeAmount, paymentScript));
+        auto blocktemplate = BlockAssembler(Params()).CreateNewBlockPoS(*nextStake.coin, nextStake.hashBlock, nextStake.time, nextStake.blockTime, nextStake.wallet.get(), false, selection);
+        BOOST_CHECK(blocktemplate != nullptr);
+        BOOST_CHECK(blocktemplate->block.vtx.size() >= 2 + selection->vtx.size());
+        BOOST_CHECK_MESSAGE(ProcessNewBlock(Params(), std::make_shared<CBlock>(blocktemplate->block), true, nullptr), "Stake with preselected txs should be accepted in ProcessNewBlock");
+        SyncWithValidationInterfaceQueue();
+
+        // A selection made on a previous tip is ignored
+        BOOST_CHECK(selection->hashPrevBlock != chainActive.Tip()->GetBlockHash());
+        BOOST_CHECK(findStake(nextStake, staker, chainActive.Tip(), wallet, stakeAmount, paymentScript));
+        blocktemplate = BlockAssembler(Params()).CreateNewBlockPoS(*nextStake.coin, nextStake.hashBlock, nextStake.time, nextStake.blockTime, nextStake.wallet.get(), false, selection);
+        BOOST_CHECK(blocktemplate != nullptr);
+        BOOST_CHECK_MESSAGE(ProcessNewBlock(Params(), std::make_shared<CBlock>(blocktemplate->block), true, nullptr), "Stake with a stale selection should be accepted in ProcessNewBlock");
+        SyncWithValidationInterfaceQueue();
+    }
+
+    // Check the preselector follows the mempool and the tip
+    {
+        BlockTxPreselector preselector(Params());
+        RegisterValidationInterface(&preselector, "staker");
+        preselector.Reselect();
+        BOOST_CHECK(preselector.Get()->hashPrevBlock == chainActive.Tip()->GetBlockHash());
+
+        // Transactions entering the mempool are added to the selection
+        CTransactionRef tx;
+        {
+            CReserveKey reservekey(wallet.get());
+            CAmount nFeeRequired;
+            std::string strError;
+            int nChangePosRet = -1;
+            CCoinControl cc;
+            auto locked_chain = wallet->chain().lock();
+            LOCK(wallet->cs_wallet);
+            BOOST_CHECK(wallet->CreateTransaction(*locked_chain, {{paymentScript, COIN, false}}, tx, reservekey, nFeeRequired, nChangePosRet, strError, cc));
+            CValidationState state;
+            BOOST_CHECK(wallet->CommitTransaction(tx, {}, {}, reservekey, nullptr, state));
+        }
+        SyncWithValidationInterfaceQueue();
+        auto selection = preselector.Get();
+        BOOST_CHECK_MESSAGE(selection->txids.count(tx->GetHash()), "Mempool tx should be added to the selection");
+
+        // A stake on the selection confirms the transaction and the selection moves to the new tip
+        StakeMgr::StakeCoin nextStake;
+        BOOST_CHECK(findStake(nextStake, staker, chainActive.Tip(), wallet, stakeAmount, paymentScript));
+        auto blocktemplate = BlockAssembler(Params()).CreateNewBlockPoS(*nextStake.coin, nextStake.hashBlock, nextStake.time, nextStake.blockTime, nextStake.wallet.get(), false, selection);
+        BOOST_CHECK(blocktemplate != nullptr);
+        BOOST_CHECK_MESSAGE(ProcessNewBlock(Params(), std::make_shared<CBlock>(blocktemplate->block), true, nullptr), "Stake with the preselected tx should be accepted in ProcessNewBlock");
+        SyncWithValidationInterfaceQueue();
+        BOOST_CHECK(!mempool.exists(tx->GetHash()));
+        selection = preselector.Get();
+        if (IsInitialBlockDownload()) {
+            BOOST_CHECK_MESSAGE(selection == nullptr, "Selection should be dropped during initial download");
+        } else {
+            BOOST_CHECK(selection->hashPrevBlock == chainActive.Tip()->GetBlockHash());
+            BOOST_CHECK(!selection->txids.count(tx->GetHash()));
+        }
+
+        UnregisterValidationInterface(&preselector);
+        SyncWithValidationInterfaceQueue();
+    }
+
     // TODO Blocknet PoS unit test for p2pkh stakes
 }
 
@@ -46,10 +46,7 @@ using ArrayValue        = Array::value_type;
 using ArrayIL           = std::initializer_list<ArrayValue>;
 
 UniValue uret(const json_spirit::Value & o) {
-    UniValue uv;
-    if (!uv.read(json_spirit::write_string(o, json_spirit::none, 8)))
-        throw runtime_error("Unknown server error: failed to process request");
-    return uv;
+    return xbridge::toUniValue(o);
 }
 
 std::string parseParentId(const uint256 & parentId) {
@@ -227,7 +224,7 @@ UniValue dxLoadXBridgeConf(const JSONRPCRequest& request)
 
     auto success = app.loadSettings();
     app.clearBadWallets(); // clear any bad wallet designations b/c user is explicitly requesting a wallet update
-    app.updateActiveWallets();
+    app.updateActiveWallets(true);
     if (!settings().showAllOrders())
         app.clearNonLocalOrders();
     return uret(success);
@@ -1519,7 +1516,7 @@ UniValue dxGetOrderBook(const JSONRPCRequest& request)
                   + HelpExampleRpc("dxGetOrderBook", "3, \"BLOCK\", \"LTC\", 60")
                 },
             }.ToString());
-    Value js; json_spirit::read_string(request.params.write(), js); Array params = js.get_array();
+    const UniValue & params = request.params;
 
     if ((params.size() < 3 || params.size() > 4))
     {
@@ -1527,7 +1524,8 @@ UniValue dxGetOrderBook(const JSONRPCRequest& request)
                                "(detail, 1-4) (maker) (taker) (max_orders, default=50)[optional]"));
     }
 
-    Object res;
+    // Built as UniValue directly, the order book can be large at detail 3
+    UniValue res(UniValue::VOBJ);
     TransactionMap trList = xbridge::App::instance().transactions();
     {
         /**
@@ -1551,25 +1549,25 @@ UniValue dxGetOrderBook(const JSONRPCRequest& request)
             return uret(xbridge::makeError(xbridge::INVALID_DETAIL_LEVEL, __FUNCTION__));
         }
 
-        res.emplace_back(Pair("detail", detailLevel));
-        res.emplace_back(Pair("maker", fromCurrency));
-        res.emplace_back(Pair("taker", toCurrency));
+        res.pushKV("detail", detailLevel);
+        res.pushKV("maker", fromCurrency);
+        res.pushKV("taker", toCurrency);
 
         /**
          * @brief bids - array with bids
          */
-        Array bids;
+        UniValue bids(UniValue::VARR);
         /**
          * @brief asks - array with asks
          */
-        Array asks;
+        UniValue asks(UniValue::VARR);
 
         if(trList.empty())
         {
             LOG() << "empty transactions list";
-            res.emplace_back(Pair("asks", asks));
-            res.emplace_back(Pair("bids", bids));
-            return uret(res);
+            res.pushKV("asks", asks);
+            res.pushKV("bids", bids);
+            return res;
         }
 
         TransactionMap asksList;
@@ -1691,9 +1689,11 @@ UniValue dxGetOrderBook(const JSONRPCRequest& request)
                 if (tr != nullptr)
                 {
                     const auto bidPrice = xbridge::priceBid(tr);
-                    bids.emplace_back(Array{xbridge::xBridgeStringValueFromPrice(bidPrice),
-                                            xbridge::xBridgeStringValueFromAmount(tr->toAmount),
-                                            static_cast<int64_t>(bidsCount)});
+                    UniValue bid(UniValue::VARR);
+                    bid.push_back(xbridge::xBridgeStringValueFromPrice(bidPrice));
+                    bid.push_back(xbridge::xBridgeStringValueFromAmount(tr->toAmount));
+                    bid.push_back(static_cast<int64_t>(bidsCount));
+                    bids.push_back(bid);
                 }
             }
 
@@ -1740,15 +1740,17 @@ UniValue dxGetOrderBook(const JSONRPCRequest& request)
                 if (tr != nullptr)
                 {
                     const auto askPrice = xbridge::price(tr);
-                    asks.emplace_back(Array{xbridge::xBridgeStringValueFromPrice(askPrice),
-                                            xbridge::xBridgeStringValueFromAmount(tr->fromAmount),
-                                            static_cast<int64_t>(asksCount)});
+                    UniValue ask(UniValue::VARR);
+                    ask.push_back(xbridge::xBridgeStringValueFromPrice(askPrice));
+                    ask.push_back(xbridge::xBridgeStringValueFromAmount(tr->fromAmount));
+                    ask.push_back(static_cast<int64_t>(asksCount));
+                    asks.push_back(ask);
                 }
             }
 
-            res.emplace_back(Pair("asks", asks));
-            res.emplace_back(Pair("bids", bids));
-            return uret(res);
+            res.pushKV("asks", asks);
+            res.pushKV("bids", bids);
+            return res;
         }
         case 2:
         {
@@ -1763,7 +1765,7 @@ UniValue dxGetOrderBook(const JSONRPCRequest& request)
                 if(bidsVector[i] == nullptr)
                     continue;
 
-                Array bid;
+                UniValue bid(UniValue::VARR);
                 //calculate bids and push to array
                 const auto bidAmount    = bidsVector[i]->toAmount;
                 const auto bidPrice     = xbridge::priceBid(bidsVector[i]);
@@ -1784,10 +1786,10 @@ UniValue dxGetOrderBook(const JSONRPCRequest& request)
                 while((++i < bound) && floatCompare(xbridge::priceBid(bidsVector[i]), bidPrice)) {
                     bidSize += bidsVector[i]->toAmount;
                 }
-                bid.emplace_back(xbridge::xBridgeStringValueFromPrice(bidPrice));
-                bid.emplace_back(xbridge::xBridgeStringValueFromAmount(bidSize));
-                bid.emplace_back(static_cast<int64_t>(bidsCount));
-                bids.emplace_back(bid);
+                bid.push_back(xbridge::xBridgeStringValueFromPrice(bidPrice));
+                bid.push_back(xbridge::xBridgeStringValueFromAmount(bidSize));
+                bid.push_back(static_cast<int64_t>(bidsCount));
+                bids.push_back(bid);
             }
 
             bound = std::min<int32_t>(maxOrders, asksVector.size());
@@ -1797,7 +1799,7 @@ UniValue dxGetOrderBook(const JSONRPCRequest& request)
                 if(asksVector[i] == nullptr)
                     continue;
 
-                Array ask;
+                UniValue ask(UniValue::VARR);
                 //calculate asks and push to array
                 const auto askAmount    = asksVector[i]->fromAmount;
                 const auto askPrice     = xbridge::price(asksVector[i]);
@@ -1819,15 +1821,15 @@ UniValue dxGetOrderBook(const JSONRPCRequest& request)
                 while((++i < bound) && floatCompare(xbridge::price(asksVector[i]), askPrice)){
                     askSize += asksVector[i]->fromAmount;
                 }
-                ask.emplace_back(xbridge::xBridgeStringValueFromPrice(askPrice));
-                ask.emplace_back(xbridge::xBridgeStringValueFromAmount(askSize));
-                ask.emplace_back(static_cast<int64_t>(asksCount));
-                asks.emplace_back(ask);
+                ask.push_back(xbridge::xBridgeStringValueFromPrice(askPrice));
+                ask.push_back(xbridge::xBridgeStringValueFromAmount(askSize));
+                ask.push_back(static_cast<int64_t>(asksCount));
+                asks.push_back(ask);
             }
 
-            res.emplace_back(Pair("asks", asks));
-            res.emplace_back(Pair("bids", bids));
-            return uret(res);
+            res.pushKV("asks", asks);
+            res.pushKV("bids", bids);
+            return res;
         }
         case 3:
         {
@@ -1838,14 +1840,14 @@ UniValue dxGetOrderBook(const JSONRPCRequest& request)
                 if(bidsVector[i] == nullptr)
                     continue;
 
-                Array bid;
+                UniValue bid(UniValue::VARR);
                 const auto bidAmount   = bidsVector[i]->toAmount;
                 const auto bidPrice    = xbridge::priceBid(bidsVector[i]);
-                bid.emplace_back(xbridge::xBridgeStringValueFromPrice(bidPrice));
-                bid.emplace_back(xbridge::xBridgeStringValueFromAmount(bidAmount));
-                bid.emplace_back(bidsVector[i]->id.GetHex());
+                bid.push_back(xbridge::xBridgeStringValueFromPrice(bidPrice));
+                bid.push_back(xbridge::xBridgeStringValueFromAmount(bidAmount));
+                bid.push_back(bidsVector[i]->id.GetHex());
 
-                bids.emplace_back(bid);
+                bids.push_back(bid);
             }
 
             bound = std::min<int32_t>(maxOrders, asksVector.size());
@@ -1855,19 +1857,19 @@ UniValue dxGetOrderBook(const JSONRPCRequest& request)
                 if(asksVector[i] == nullptr)
                     continue;
 
-                Array ask;
+                UniValue ask(UniValue::VARR);
                 const auto bidAmount    = asksVector[i]->fromAmount;
                 const auto askPrice     = xbridge::price(asksVector[i]);
-                ask.emplace_back(xbridge::xBridgeStringValueFromPrice(askPrice));
-                ask.emplace_back(xbridge::xBridgeStringValueFromAmount(bidAmount));
-                ask.emplace_back(asksVector[i]->id.GetHex());
+                ask.push_back(xbridge::xBridgeStringValueFromPrice(askPrice));
+                ask.push_back(xbridge::xBridgeStringValueFromAmount(bidAmount));
+                ask.push_back(asksVector[i]->id.GetHex());
 
-                asks.emplace_back(ask);
+                asks.push_back(ask);
             }
 
-            res.emplace_back(Pair("asks", asks));
-            res.emplace_back(Pair("bids", bids));
-            return uret(res);
+            res.pushKV("asks", asks);
+            res.pushKV("bids", bids);
+            return res;
         }
         case 4:
         {
@@ -1896,11 +1898,11 @@ UniValue dxGetOrderBook(const JSONRPCRequest& request)
                 if (tr != nullptr)
                 {
                     const auto bidPrice = xbridge::priceBid(tr);
-                    bids.emplace_back(xbridge::xBridgeStringValueFromPrice(bidPrice));
-                    bids.emplace_back(xbridge::xBridgeStringValueFromAmount(tr->toAmount));
+                    bids.push_back(xbridge::xBridgeStringValueFromPrice(bidPrice));
+                    bids.push_back(xbridge::xBridgeStringValueFromAmount(tr->toAmount));
 
-                    Array bidsIds;
-                    bidsIds.emplace_back(tr->id.GetHex());
+                    UniValue bidsIds(UniValue::VARR);
+                    bidsIds.push_back(tr->id.GetHex());
 
                     for(const TransactionPair &tp : bidsList)
                     {
@@ -1917,10 +1919,10 @@ UniValue dxGetOrderBook(const JSONRPCRequest& request)
                         if(!floatCompare(bidPrice, otherTrBidPrice))
                             continue;
 
-                        bidsIds.emplace_back(otherTr->id.GetHex());
+                        bidsIds.push_back(otherTr->id.GetHex());
                     }
 
-                    bids.emplace_back(bidsIds);
+                    bids.push_back(bidsIds);
                 }
             }
 
@@ -1947,11 +1949,11 @@ UniValue dxGetOrderBook(const JSONRPCRequest& request)
                 if (tr != nullptr)
                 {
                     const auto askPrice = xbridge::price(tr);
-                    asks.emplace_back(xbridge::xBridgeStringValueFromPrice(askPrice));
-                    asks.emplace_back(xbridge::xBridgeStringValueFromAmount(tr->fromAmount));
+                    asks.push_back(xbridge::xBridgeStringValueFromPrice(askPrice));
+                    asks.push_back(xbridge::xBridgeStringValueFromAmount(tr->fromAmount));
 
-                    Array asksIds;
-                    asksIds.emplace_back(tr->id.GetHex());
+                    UniValue asksIds(UniValue::VARR);
+                    asksIds.push_back(tr->id.GetHex());
 
                     for(const TransactionPair &tp : asksList)
                     {
@@ -1968,16 +1970,16 @@ UniValue dxGetOrderBook(const JSONRPCRequest& request)
                         if(!floatCompare(askPrice, otherTrAskPrice))
                             continue;
 
-                        asksIds.emplace_back(otherTr->id.GetHex());
+                        asksIds.push_back(otherTr->id.GetHex());
                     }
 
-                    asks.emplace_back(asksIds);
+                    asks.push_back(asksIds);
                 }
             }
 
-            res.emplace_back(Pair("asks", asks));
-            res.emplace_back(Pair("bids", bids));
-            return uret(res);
+            res.pushKV("asks", asks);
+            res.pushKV("bids", bids);
+            return res;
         }
 
         default:
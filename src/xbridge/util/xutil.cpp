@@ -10,6 +10,7 @@
 #include <xbridge/xbridgetransactiondescr.h>
 
 #include <amount.h>
+#include <util/strencodings.h>
 
 #include <ctime>
 #include <iomanip>
@@ -390,6 +391,251 @@ json_spirit::Object makeError(const xbridge::Error statusCode, const std::string
     return  error;
 }
 
+namespace {
+
+/** Reals are formatted with ss, reused to avoid constructing a stream per number */
+UniValue toUniValue(const json_spirit::Value & value, std::ostringstream & ss)
+{
+    switch (value.type()) {
+        case json_spirit::obj_type: {
+            UniValue o(UniValue::VOBJ);
+            for (const auto & member : value.get_obj())
+                o.__pushKV(member.name_, toUniValue(member.value_, ss)); // keeps duplicate keys like the parser
+            return o;
+        }
+        case json_spirit::array_type: {
+            UniValue a(UniValue::VARR);
+            for (const auto & item : value.get_array())
+                a.push_back(toUniValue(item, ss));
+            return a;
+        }
+        case json_spirit::str_type:
+            return UniValue(value.get_str());
+        case json_spirit::bool_type:
+            return UniValue(value.get_bool());
+        case json_spirit::int_type:
+            if (value.is_uint64())
+                return UniValue(value.get_uint64());
+            return UniValue(value.get_int64());
+        case json_spirit::real_type: {
+            ss.str(std::string());
+            ss << value.get_real();
+            UniValue n;
+            if (!n.setNumStr(ss.str()))
+                throw std::runtime_error("Unknown server error: failed to process request");
+            return n;
+        }
+        default:
+            return UniValue();
+    }
+}
+
+} // namespace
+
+UniValue toUniValue(const json_spirit::Value & value)
+{
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(8);
+    return toUniValue(value, ss);
+}
+
+namespace {
+
+void skipWhitespace(const std::string & json, size_t & i)
+{
+    while (i < json.size() && (json[i] == ' ' || json[i] == '\t' || json[i] == '\n' || json[i] == '\r'))
+        ++i;
+}
+
+void appendUtf8(std::string & out, uint32_t cp)
+{
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+bool readHex4(const std::string & json, size_t i, uint32_t & cp)
+{
+    if (i + 4 > json.size())
+        return false;
+    cp = 0;
+    for (size_t j = i; j < i + 4; ++j) {
+        const int v = HexDigit(json[j]);
+        if (v < 0)
+            return false;
+        cp = (cp << 4) | v;
+    }
+    return true;
+}
+
+/** Scans the string starting at json[i], decodes it into out if not null */
+bool scanString(const std::string & json, size_t & i, std::string * out)
+{
+    if (i >= json.size() || json[i] != '"')
+        return false;
+    ++i;
+    while (i < json.size()) {
+        const char c = json[i++];
+        if (c == '"')
+            return true;
+        if (c != '\\') {
+            if (out)
+                *out += c;
+            continue;
+        }
+        if (i >= json.size())
+            return false;
+        const char e = json[i++];
+        if (e == 'u') {
+            uint32_t cp;
+            if (!readHex4(json, i, cp))
+                return false;
+            i += 4;
+            // Surrogate pair
+            if (cp >= 0xD800 && cp < 0xDC00 && i + 6 <= json.size() && json[i] == '\\' && json[i+1] == 'u') {
+                uint32_t low;
+                if (readHex4(json, i + 2, low) && low >= 0xDC00 && low < 0xE000) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    i += 6;
+                }
+            }
+            if (out)
+                appendUtf8(*out, cp);
+            continue;
+        }
+        if (!out)
+            continue;
+        switch (e) {
+            case 'b': *out += '\b'; break;
+            case 'f': *out += '\f'; break;
+            case 'n': *out += '\n'; break;
+            case 'r': *out += '\r'; break;
+            case 't': *out += '\t'; break;
+            case '"': case '\\': case '/': *out += e; break;
+            default: return false;
+        }
+    }
+    return false;
+}
+
+/** Skips the value starting at json[i] */
+bool scanValue(const std::string & json, size_t & i)
+{
+    if (i >= json.size())
+        return false;
+    if (json[i] == '"')
+        return scanString(json, i, nullptr);
+    if (json[i] == '{' || json[i] == '[') {
+        int depth = 0;
+        while (i < json.size()) {
+            const char c = json[i];
+            if (c == '"') {
+                if (!scanString(json, i, nullptr))
+                    return false;
+                continue;
+            }
+            ++i;
+            if (c == '{' || c == '[')
+                ++depth;
+            else if ((c == '}' || c == ']') && --depth == 0)
+                return true;
+        }
+        return false;
+    }
+    const size_t start = i;
+    while (i < json.size() && json[i] != ',' && json[i] != '}' && json[i] != ']'
+           && json[i] != ' ' && json[i] != '\t' && json[i] != '\n' && json[i] != '\r')
+        ++i;
+    return i > start;
+}
+
+} // namespace
+
+JsonReplyReader::JsonReplyReader(const std::string & json) : json(json)
+{
+    size_t i = 0;
+    skipWhitespace(json, i);
+    if (i >= json.size() || json[i] != '{')
+        return;
+    ++i;
+    skipWhitespace(json, i);
+    if (i < json.size() && json[i] == '}') {
+        ++i;
+        skipWhitespace(json, i);
+        isValid = i == json.size();
+        return;
+    }
+    while (i < json.size()) {
+        std::string key;
+        skipWhitespace(json, i);
+        if (!scanString(json, i, &key))
+            return;
+        skipWhitespace(json, i);
+        if (i >= json.size() || json[i++] != ':')
+            return;
+        skipWhitespace(json, i);
+        const size_t start = i;
+        if (!scanValue(json, i))
+            return;
+        members.emplace_back(std::move(key), std::make_pair(start, i - start));
+        skipWhitespace(json, i);
+        if (i >= json.size())
+            return;
+        const char c = json[i++];
+        if (c == '}') {
+            skipWhitespace(json, i);
+            isValid = i == json.size();
+            return;
+        }
+        if (c != ',')
+            return;
+    }
+}
+
+std::string JsonReplyReader::raw(const std::string & key) const
+{
+    for (const auto & member : members) {
+        if (member.first == key)
+            return json.substr(member.second.first, member.second.second);
+    }
+    return "";
+}
+
+bool JsonReplyReader::isNull(const std::string & key) const
+{
+    const auto & r = raw(key);
+    return r.empty() || r == "null";
+}
+
+bool JsonReplyReader::getString(const std::string & key, std::string & value) const
+{
+    const auto & r = raw(key);
+    size_t i = 0;
+    std::string str;
+    if (r.empty() || r[0] != '"' || !scanString(r, i, &str))
+        return false;
+    value = std::move(str);
+    return true;
+}
+
+bool JsonReplyReader::getInt(const std::string & key, int64_t & value) const
+{
+    const auto & r = raw(key);
+    return !r.empty() && ParseInt64(r, &value);
+}
+
 void LogOrderMsg(const std::string & orderId, const std::string & msg, const std::string & func) {
     UniValue o(UniValue::VOBJ);
     o.pushKV("orderid", orderId);
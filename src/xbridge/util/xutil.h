@@ -17,6 +17,8 @@
 #include <univalue.h>
 
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <json/json_spirit_reader_template.h>
 #include <json/json_spirit_writer_template.h>
@@ -144,6 +146,51 @@ namespace xbridge
      */
      json_spirit::Object makeError(const xbridge::Error statusCode, const std::string &function, const std::string &message = "");
 
+    /**
+     * @brief Converts a json_spirit value to UniValue without serializing it to a string and
+     * parsing it again. Reals are formatted like write_string(value, none, 8).
+     * @param value json_spirit value
+     * @return UniValue copy of the value
+     */
+    UniValue toUniValue(const json_spirit::Value & value);
+
+    /**
+     * @brief Reads the top-level members of a json object without building a json tree, for
+     * json-rpc replies where only one or two members are used. Member values are kept as offsets
+     * into the json text, which must outlive the reader, and are only decoded on request.
+     * Readers can't be built from temporaries for that reason.
+     * Example:<br>
+     * \verbatim
+        const std::string reply = R"({"result":812345,"error":null,"id":1})";
+        JsonReplyReader reader(reply);
+        int64_t count;
+        reader.isNull("error") && reader.getInt("result", count)
+        // returns true, count is 812345
+     * \endverbatim
+     */
+    class JsonReplyReader
+    {
+    public:
+        explicit JsonReplyReader(const std::string & json);
+        explicit JsonReplyReader(std::string && json) = delete;
+
+        /** Returns false if the json is not an object or is malformed */
+        bool valid() const { return isValid; }
+        /** Returns true if the member is missing or null */
+        bool isNull(const std::string & key) const;
+        /** Returns false if the member is missing or not a string */
+        bool getString(const std::string & key, std::string & value) const;
+        /** Returns false if the member is missing or not an integer */
+        bool getInt(const std::string & key, int64_t & value) const;
+        /** Returns the raw json text of the member, empty if missing */
+        std::string raw(const std::string & key) const;
+
+    private:
+        const std::string & json;
+        bool isValid{false};
+        std::vector<std::pair<std::string, std::pair<size_t, size_t>>> members; // key, value offset and length
+    };
+
     void LogOrderMsg(const std::string & orderId, const std::string & msg, const std::string & func);
     void LogOrderMsg(UniValue o, const std::string & msg, const std::string & func);
     void LogOrderMsg(xbridge::TransactionDescrPtr & ptr, const std::string & func);
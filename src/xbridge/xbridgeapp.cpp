@@ -24,11 +24,13 @@
 #include <xbridge/xbridgewalletconnectordgb.h>
 #include <xbridge/xbridgewalletconnectorbtg.h>
 #include <xbridge/xbridgewalletconnectorstealth.h>
+#include <xbridge/xbridgewallethealth.h>
 #include <xbridge/xbridgepacket.h>
 #include <xbridge/xuiconnector.h>
 #include <xrouter/xrouterapp.h>
 
 #include <net.h>
+#include <net_processing.h>
 #include <netmessagemaker.h>
 #include <rpc/server.h>
 #include <servicenode/servicenodemgr.h>
@@ -228,6 +230,7 @@ protected:
     Connectors                                         m_connectors;
     ConnectorsAddrMap                                  m_connectorAddressMap;
     ConnectorsCurrencyMap                              m_connectorCurrencyMap;
+    WalletHealthChecker                                m_walletHealth;
 
     // pending messages (packet processing loop)
     CCriticalSection                                   m_messagesLock;
@@ -267,7 +270,7 @@ protected:
 App::Impl::Impl()
     : m_timerIoWork(new boost::asio::io_service::work(m_timerIo))
     , m_timerThread(boost::bind(&boost::asio::io_service::run, &m_timerIo))
-    , m_timer(m_timerIo, boost::posix_time::seconds(TIMER_INTERVAL))
+    , m_timer(m_timerIo, boost::posix_time::seconds(static_cast<long>(TIMER_INTERVAL)))
 {
 
 }
@@ -378,7 +381,7 @@ bool App::start()
     auto s = m_p->start();
 
     // This will update the wallet connectors on both the app & exchange
-    updateActiveWallets();
+    updateActiveWallets(true);
 
     if (xbridge::Exchange::instance().isEnabled())
         LOG() << "XBridge exchange enabled";
@@ -409,6 +412,7 @@ bool App::Impl::start()
 
             m_threads.create_thread(boost::bind(&boost::asio::io_service::run, ios));
         }
+        m_walletHealth.start({m_services.begin(), m_services.end()}, m_timerIo);
 
         m_timer.async_wait(boost::bind(&Impl::onTimer, this));
     }
@@ -578,15 +582,10 @@ void App::Impl::onSend(const std::vector<unsigned char> & id, const std::vector<
     uint256 hash = Hash(msg.begin(), msg.end());
 
     App::instance().addToKnown(hash);
+    sn::ServiceNodeMgr::instance().seenPacket(hash); // peers announcing our own packet back are ignored
 
-    // Relay
-    const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
-    g_connman->ForEachNode([&](CNode* pnode) {
-        if (!pnode->fSuccessfullyConnected)
-            return;
-        if (pnode->fSuccessfullyConnected && !pnode->fDisconnect && !pnode->fXRouter) // do not relay to xrouter nodes
-            g_connman->PushMessage(pnode, msgMaker.Make(NetMsgType::XBRIDGE, msg));
-    });
+    // Relay (xrouter nodes are skipped)
+    RelayServiceNodePacket(CInv(MSG_XBRIDGE, hash), msg, g_connman.get());
 }
 
 //*****************************************************************************
@@ -824,12 +823,12 @@ std::vector<std::string> App::availableCurrencies() const
 std::vector<std::string> App::networkCurrencies() const
 {
     std::set<std::string> coins;
-    auto snodes = sn::ServiceNodeMgr::instance().list();
+    const auto snap = sn::ServiceNodeMgr::instance().snapshot();
     // Obtain unique xwallets supported across network
-    for (auto & sn : snodes) {
-        if (!sn.running())
+    for (const auto & sn : snap->snodes) {
+        if (!sn->running())
             continue;
-        for (auto &w : sn.serviceList()) {
+        for (auto &w : sn->serviceList()) {
             if (!coins.count(w))
                 coins.insert(w);
         }
@@ -913,15 +912,9 @@ void App::updateConnector(const WalletConnectorPtr & conn,
 
 //*****************************************************************************
 //*****************************************************************************
-void App::updateActiveWallets()
+void App::updateActiveWallets(const bool wait)
 {
-    {
-        LOCK(m_updatingWalletsLock);
-        if (m_updatingWallets)
-            return;
-        m_updatingWallets = true;
-    }
-    if (ShutdownRequested())
+    if (m_p->m_walletHealth.isRunning() || ShutdownRequested())
         return;
 
     Settings & s = settings();
@@ -947,28 +940,13 @@ void App::updateActiveWallets()
         removeConnector(currency);
 
     // Store connectors from config
-    std::vector<WalletConnectorPtr> conns;
-
-    // Copy bad wallets
-    std::map<std::string, boost::posix_time::ptime> badWallets;
-    {
-        LOCK(m_updatingWalletsLock);
-        badWallets = m_badWallets;
-    }
+    std::map<std::string, WalletConnectorPtr> conns;
 
     for (std::vector<std::string>::iterator i = wallets.begin(); i != wallets.end(); ++i)
     {
-        // Ignore bad wallets until expiry
-        if (badWallets.count(*i)) {
-            const auto last_time = badWallets[*i];
-            const auto current_time = boost::posix_time::second_clock::universal_time();
-            // Wait ~5 minutes before doing wallet check on bad wallet
-            if (static_cast<boost::posix_time::time_duration>(current_time - last_time).total_seconds() >= 300) {
-                LOCK(m_updatingWalletsLock);
-                m_badWallets.erase(*i);
-            } else // not ready to do wallet check
-                continue;
-        }
+        // Ignore bad wallets until their backoff expires
+        if (!m_p->m_walletHealth.shouldCheck(*i, GetTime()))
+            continue;
 
         WalletParam wp;
         wp.currency                    = *i;
@@ -1091,129 +1069,59 @@ void App::updateActiveWallets()
             continue;
         }
 
-        conns.push_back(conn);
-    }
-
-    // Valid connections
-    std::vector<WalletConnectorPtr> validConnections;
-    // Invalid connections
-    std::vector<WalletConnectorPtr> badConnections;
-    // All valid wallets
-    std::set<std::string> validWallets;
-
-    // Process connections
-    if (!conns.empty()) {
-        // TLDR: Multithreaded connection checks
-        // The code below utilizes boost async to spawn threads up to the reported hardware concurrency
-        // capabilities of the host. All of the wallets loaded into xbridge.conf will be checked here,
-        // specifically for valid connections. This implementation also supports being interrupted via
-        // a boost interruption point. A mutex is used to synchronize checks across async threads.
-        boost::mutex muJobs;
-        auto rpcThreads = static_cast<int32_t>(gArgs.GetArg("-rpcthreads", 4));
-        if (rpcThreads <= 0)
-            rpcThreads = 4;
-        const uint32_t maxPendingJobs = static_cast<uint32_t>(rpcThreads);
-        uint32_t pendingJobs = 0;
-        uint32_t allJobs = static_cast<uint32_t>(conns.size());
-        boost::thread_group tg;
-        auto check = [&muJobs,&pendingJobs,&allJobs,&badConnections,&validConnections](WalletConnectorPtr conn) {
-            if (ShutdownRequested())
-                return;
-            // Check that wallet is reachable
-            if (!conn->init()) {
-                {
-                    boost::mutex::scoped_lock l(muJobs);
-                    --pendingJobs;
-                    --allJobs;
-                    badConnections.push_back(conn);
-                }
-                return;
-            }
-            {
-                boost::mutex::scoped_lock l(muJobs);
-                --pendingJobs;
-                --allJobs;
-                validConnections.push_back(conn);
-            }
-        };
-
-        // Synchronize all connection checks
-        try {
-            while (true) {
-                boost::this_thread::interruption_point();
-                if (ShutdownRequested())
-                    break;
-
-                const int32_t size = conns.size();
-                for (int32_t i = size - 1; i >= 0; --i) {
-                    {
-                        boost::mutex::scoped_lock l(muJobs);
-                        if (pendingJobs >= maxPendingJobs)
-                            break;
-                        ++pendingJobs;
-                    }
-                    WalletConnectorPtr conn = conns.back();
-                    conns.pop_back();
-                    // Asynchronously check connection
-                    try {
-                        tg.create_thread([&check, conn]() {
-                            RenameThread("blocknet-xbridgewalletcheck");
-                            check(conn);
-                        });
-                    } catch (...) {
-                        // try single threaded on error creating thread
-                        check(conn);
-                    }
-                }
-
-                {
-                    boost::mutex::scoped_lock l(muJobs);
-                    if (allJobs == 0)
-                        break;
-                }
+        conns[conn->currency] = conn;
+    }
 
-                boost::this_thread::sleep_for(boost::chrono::milliseconds(100));
-            }
-            tg.join_all();
-        } catch (...) { // bail on error (possible thread error etc)
-            tg.interrupt_all();
-            tg.join_all();
-            LOCK(m_updatingWalletsLock);
-            m_updatingWallets = false;
-            WARN() << "Potential issue with active xbridge wallets checks (unknown threading error). If issue persists please notify the dev team";
+    // Check all wallets in parallel on the xbridge io services. Healthy wallets are connected
+    // as soon as they reply, wallets that don't reply before the deadline are marked bad.
+    std::map<std::string, WalletHealthChecker::Check> checks;
+    for (const auto & item : conns) {
+        const auto & conn = item.second;
+        checks[item.first] = [conn]() { return !ShutdownRequested() && conn->init(); };
+    }
+    auto onResult = [this, conns](const std::string & currency, const bool healthy) {
+        if (ShutdownRequested())
             return;
-        }
-
-        // Check for shutdown
-        if (!ShutdownRequested()) {
-            // Add valid connections
-            for (auto & conn : validConnections) {
-                addConnector(conn);
-                validWallets.insert(conn->currency);
+        const auto & conn = conns.at(currency);
+        const bool changed = m_p->m_walletHealth.update(currency, healthy, GetTime());
+        if (healthy) {
+            addConnector(conn);
+            if (changed)
                 LOG() << conn->currency << " \"" << conn->title << "\"" << " connected " << conn->m_ip << ":" << conn->m_port;
-            }
-
-            // Remove bad connections
-            for (auto & conn : badConnections) {
-                removeConnector(conn->currency);
-                {
-                    LOCK(m_updatingWalletsLock);
-                    boost::posix_time::ptime time{boost::posix_time::second_clock::universal_time()};
-                    m_badWallets[conn->currency] = time;
-                }
-                WARN() << conn->currency << " \"" << conn->title << "\"" << " Failed to connect, check the config";
-            }
+        } else {
+            removeConnector(currency);
+            WARN() << conn->currency << " \"" << conn->title << "\"" << " Failed to connect, check the config (retrying in "
+                   << m_p->m_walletHealth.retryTime(currency) - GetTime() << " seconds)";
         }
-    }
+        if (changed)
+            xuiConnector.NotifyXBridgeWalletStateChanged(currency, healthy);
+    };
+    auto onDone = [](const std::set<std::string> & healthy) {
+        // Let the exchange know about the new wallet list
+        std::set<std::string> validWallets = healthy;
+        if (!ShutdownRequested())
+            xbridge::Exchange::instance().loadWallets(validWallets);
+    };
 
-    // Let the exchange know about the new wallet list
-    if (!ShutdownRequested())
-        xbridge::Exchange::instance().loadWallets(validWallets);
+    const auto deadline = static_cast<int>(gArgs.GetArg("-dxwalletchecktimeout", 10)) * 1000;
+    if (!m_p->m_walletHealth.run(checks, deadline, onResult, onDone))
+        return;
+    if (wait && !m_p->m_walletHealth.wait(deadline + 1000))
+        WARN() << "Timed out waiting for xbridge wallet checks";
+}
 
-    {
-        LOCK(m_updatingWalletsLock);
-        m_updatingWallets = false;
-    }
+//*****************************************************************************
+//*****************************************************************************
+void App::clearBadWallets()
+{
+    m_p->m_walletHealth.clearBackoff();
+}
+
+//*****************************************************************************
+//*****************************************************************************
+bool App::isUpdatingWallets()
+{
+    return m_p->m_walletHealth.isRunning();
 }
 
 //*****************************************************************************
@@ -2831,31 +2739,37 @@ std::vector<CPubKey> App::Impl::findShuffledNodesWithService(
     const std::set<CPubKey> & notIn) const
 {
     std::vector<CPubKey> list;
-    const auto & snodes = sn::ServiceNodeMgr::instance().list();
-    for (const auto& x : snodes)
+    if (requested_services.empty())
+        return list;
+
+    // Start from the smallest candidate set among the requested services
+    auto & smgr = sn::ServiceNodeMgr::instance();
+    std::vector<sn::ServiceNodeConstPtr> candidates;
+    bool first{true};
+    for (const auto & serv : requested_services) {
+        auto snodes = smgr.getSnodesWithService(serv, version);
+        if (first || snodes.size() < candidates.size())
+            candidates = std::move(snodes);
+        first = false;
+        if (candidates.empty())
+            return list;
+    }
+
+    for (const auto & x : candidates)
     {
-        if (x.getXBridgeVersion() != version || notIn.count(x.getSnodePubKey()) || !x.running())
+        if (notIn.count(x->getSnodePubKey()))
             continue;
 
-        // Make sure this xwallet entry is in the servicenode list
-        auto pmn = sn::ServiceNodeMgr::instance().getSn(x.getSnodePubKey());
-        if (pmn.isNull()) {
-            auto k = x.getSnodePubKey();
-            if (k.Decompress()) // try to uncompress pubkey and search
-                pmn = sn::ServiceNodeMgr::instance().getSn(k);
-            if (pmn.isNull())
-                continue;
-        }
-
-        const auto& wallet_services = std::set<std::string>{x.serviceList().begin(), x.serviceList().end()};
-        auto searchCounter = requested_services.size();
+        bool hasAll{true};
         for (const std::string & serv : requested_services)
         {
-            if (not wallet_services.count(serv))
+            if (!x->hasService(serv)) {
+                hasAll = false;
                 break;
-            if (--searchCounter == 0)
-                list.push_back(x.getSnodePubKey());
+            }
         }
+        if (hasAll)
+            list.push_back(x->getSnodePubKey());
     }
     static std::default_random_engine rng{0};
     std::shuffle(list.begin(), list.end(), rng);
@@ -3567,7 +3481,7 @@ void App::Impl::onTimer()
         static uint32_t updateActiveWallets_c = 0;
         if (++updateActiveWallets_c == 2) { // every ~30 seconds
             updateActiveWallets_c = 0;
-            io->post(boost::bind(&xbridge::App::updateActiveWallets, app));
+            io->post(boost::bind(&xbridge::App::updateActiveWallets, app, false));
         }
 
         // Check orders
@@ -3640,7 +3554,7 @@ void App::Impl::onTimer()
         }
     }
 
-    m_timer.expires_at(m_timer.expires_at() + boost::posix_time::seconds(TIMER_INTERVAL));
+    m_timer.expires_at(m_timer.expires_at() + boost::posix_time::seconds(static_cast<long>(TIMER_INTERVAL)));
     m_timer.async_wait(boost::bind(&Impl::onTimer, this));
 }
 
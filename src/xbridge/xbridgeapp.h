@@ -442,9 +442,10 @@ public:
 
     /**
      * Updates the active wallets list. Active wallets are those that are running and responding
-     * to rpc calls.
+     * to rpc calls. Wallets are checked in parallel, see WalletHealthChecker.
+     * @param wait Wait for all wallets to be checked
      */
-    void updateActiveWallets();
+    void updateActiveWallets(bool wait = false);
 
     /**
      * @brief connectorByCurrency
@@ -569,10 +570,7 @@ public:
     /**
      * @brief Clears the bad wallet designations.
      */
-    void clearBadWallets() {
-        LOCK(m_updatingWalletsLock);
-        m_badWallets.clear();
-    }
+    void clearBadWallets();
 
     /**
      * @brief Clears the non-local orders.
@@ -583,10 +581,7 @@ public:
      * @brief Returns true if wallet update checks are already in progress, otherwise returns false.
      * @return
      */
-    bool isUpdatingWallets() {
-        LOCK(m_updatingWalletsLock);
-        return m_updatingWallets;
-    }
+    bool isUpdatingWallets();
 
     /**
      * @brief Returns a copy of the locked fee utxos.
@@ -734,9 +729,6 @@ private:
     std::unique_ptr<Impl> m_p;
     bool m_disconnecting;
     CCriticalSection m_lock;
-    std::map<std::string, boost::posix_time::ptime> m_badWallets;
-    bool m_updatingWallets{false};
-    CCriticalSection m_updatingWalletsLock;
     bool m_stopped{false};
 
     std::vector<TransactionDescrPtr> m_partialOrders;
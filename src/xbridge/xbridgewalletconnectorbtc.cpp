@@ -20,6 +20,8 @@
 #include <json/json_spirit_writer_template.h>
 #include <json/json_spirit_utils.h>
 
+#include <limits>
+
 #include <boost/iostreams/concepts.hpp>
 #include <boost/lexical_cast.hpp>
 
@@ -239,26 +241,25 @@ bool getblockhash(const std::string & rpcuser, const std::string & rpcpasswd,
     {
         Array params;
         params.push_back(static_cast<int>(block));
-        Object reply = CallRPC(rpcuser, rpcpasswd, rpcip, rpcport, "getblockhash", params);
+        const auto body = CallRPCBody(rpcuser, rpcpasswd, rpcip, rpcport, "getblockhash", params);
 
-        // Parse reply
-        const Value & result = find_value(reply, "result");
-        const Value & error  = find_value(reply, "error");
+        // Parse reply, polled often so only the members used are read
+        JsonReplyReader reply(body);
+        if (!reply.valid())
+            throw std::runtime_error("couldn't parse reply from server");
 
-        if (error.type() != null_type)
+        if (!reply.isNull("error"))
         {
             // Error
-            LOG() << "getblockhash error: " << write_string(error, false);
+            LOG() << "getblockhash error: " << reply.raw("error");
             return false;
         }
-        else if (result.type() != str_type)
+        else if (!reply.getString("result", blockHash))
         {
             // Result
             LOG() << "getblockhash result is not a string";
             return false;
         }
-
-        blockHash = result.get_str();
     }
     catch (std::exception & e)
     {
@@ -276,19 +277,21 @@ bool getblockcount(const std::string & rpcuser, const std::string & rpcpasswd,
 {
     try {
         Array params;
-        Object reply = CallRPC(rpcuser, rpcpasswd, rpcip, rpcport, "getblockcount", params);
+        const auto body = CallRPCBody(rpcuser, rpcpasswd, rpcip, rpcport, "getblockcount", params);
 
-        const Value & result = find_value(reply, "result");
-        const Value & error  = find_value(reply, "error");
+        JsonReplyReader reply(body);
+        if (!reply.valid())
+            throw std::runtime_error("couldn't parse reply from server");
 
-        if (error.type() != null_type) {
-            LOG() << "getblockcount error: " << write_string(error, false);
+        int64_t result;
+        if (!reply.isNull("error")) {
+            LOG() << "getblockcount error: " << reply.raw("error");
             return false;
-        } else if (result.type() != int_type) {
+        } else if (!reply.getInt("result", result) || result < 0 || result > std::numeric_limits<uint32_t>::max()) {
             LOG() << "getblockcount result is not an int";
             return false;
         }
-        blockCount = result.get_int();
+        blockCount = static_cast<uint32_t>(result);
 
     } catch (std::exception & e) {
         LOG() << "getblockcount exception " << e.what();
@@ -9,6 +9,7 @@
 #define BLOCKNET_XBRIDGE_XBRIDGEWALLETCONNECTORBTC_H
 
 #include <xbridge/xbridgewalletconnector.h>
+#include <xbridge/util/xutil.h>
 
 #include <event2/buffer.h>
 #include <rpc/protocol.h>
@@ -108,7 +109,10 @@ static UniValue XBridgeJSONRPCRequestObj(const std::string& strMethod, const Uni
     return request;
 }
 
-static json_spirit::Object CallRPC(const std::string & rpcuser, const std::string & rpcpasswd,
+/**
+ * Sends a json-rpc request and returns the unparsed reply body.
+ */
+static std::string CallRPCBody(const std::string & rpcuser, const std::string & rpcpasswd,
                       const std::string & rpcip, const std::string & rpcport,
                       const std::string & strMethod, const json_spirit::Array & params,
                       const std::string & jsonver="", const std::string & contenttype="")
@@ -145,11 +149,7 @@ static json_spirit::Object CallRPC(const std::string & rpcuser, const std::strin
     }
 
     // Attach request data
-    const auto tostring = json_spirit::write_string(json_spirit::Value(params), json_spirit::none, 8);
-    UniValue toval;
-    if (!toval.read(tostring))
-        throw std::runtime_error(strprintf("failed to decode json_spirit data: %s", tostring));
-    const auto reqobj = XBridgeJSONRPCRequestObj(strMethod, toval.get_array(), 1, jsonver);
+    const auto reqobj = XBridgeJSONRPCRequestObj(strMethod, toUniValue(json_spirit::Value(params)), 1, jsonver);
     std::string strRequest = reqobj.write() + "\n";
     struct evbuffer* output_buffer = evhttp_request_get_output_buffer(req.get());
     assert(output_buffer);
@@ -178,9 +178,19 @@ static json_spirit::Object CallRPC(const std::string & rpcuser, const std::strin
     else if (response.body.empty())
         throw std::runtime_error("no response from server");
 
+    return response.body;
+}
+
+static json_spirit::Object CallRPC(const std::string & rpcuser, const std::string & rpcpasswd,
+                      const std::string & rpcip, const std::string & rpcport,
+                      const std::string & strMethod, const json_spirit::Array & params,
+                      const std::string & jsonver="", const std::string & contenttype="")
+{
+    const auto body = CallRPCBody(rpcuser, rpcpasswd, rpcip, rpcport, strMethod, params, jsonver, contenttype);
+
     // Parse reply
     json_spirit::Value valReply;
-    if (!json_spirit::read_string(response.body, valReply))
+    if (!json_spirit::read_string(body, valReply))
         throw std::runtime_error("couldn't parse reply from server");
     const json_spirit::Object& reply = valReply.get_obj();
     if (reply.empty())
@@ -0,0 +1,143 @@
+// Copyright (c) 2020 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <xbridge/xbridgewallethealth.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace xbridge {
+
+constexpr int64_t WalletHealthChecker::BACKOFF_MIN;
+constexpr int64_t WalletHealthChecker::BACKOFF_MAX;
+
+void WalletHealthChecker::start(const std::vector<IoServicePtr> & ws, boost::asio::io_service & tio) {
+    LOCK(mu);
+    workers = ws;
+    timerIo = &tio;
+}
+
+bool WalletHealthChecker::run(const std::map<std::string, Check> & checks, const int deadline,
+                              const OnResult & onResult, const OnDone & onDone)
+{
+    auto batch = std::make_shared<Batch>();
+    batch->onResult = onResult;
+    batch->onDone = onDone;
+    for (const auto & item : checks)
+        batch->pending.insert(item.first);
+    std::vector<IoServicePtr> ws;
+    {
+        LOCK(mu);
+        if (workers.empty() || (current && !current->done))
+            return false;
+        ws = workers;
+        current = batch;
+        batch->done = checks.empty();
+        if (!batch->done)
+            batch->timer.reset(new boost::asio::deadline_timer(*timerIo, boost::posix_time::milliseconds(deadline)));
+    }
+    if (checks.empty()) {
+        onDone(batch->healthy);
+        return true;
+    }
+
+    // Hold the batch lock so that fast checks don't complete it while others are posted
+    LOCK(batch->mu);
+    batch->timer->async_wait([batch](const boost::system::error_code & ec) {
+        if (ec != boost::asio::error::operation_aborted)
+            expire(batch);
+    });
+    for (const auto & item : checks) {
+        const auto & currency = item.first;
+        const auto & check = item.second;
+        ws[next++ % ws.size()]->post([batch, currency, check]() {
+            bool healthy{false};
+            try {
+                healthy = check();
+            } catch (...) { }
+            finish(batch, currency, healthy);
+        });
+    }
+    return true;
+}
+
+bool WalletHealthChecker::isRunning() const {
+    LOCK(mu);
+    return current && !current->done;
+}
+
+bool WalletHealthChecker::wait(const int timeout) const {
+    std::shared_ptr<Batch> batch;
+    {
+        LOCK(mu);
+        batch = current;
+    }
+    if (!batch)
+        return true;
+    WAIT_LOCK(batch->mu, lock);
+    return batch->cond.wait_for(lock, std::chrono::milliseconds(timeout), [&batch]() -> bool { return batch->done; });
+}
+
+bool WalletHealthChecker::shouldCheck(const std::string & currency, const int64_t now) const {
+    LOCK(mu);
+    auto it = states.find(currency);
+    return it == states.end() || now >= it->second.retry;
+}
+
+bool WalletHealthChecker::update(const std::string & currency, const bool healthy, const int64_t now) {
+    LOCK(mu);
+    auto it = states.find(currency);
+    const bool changed = it == states.end() || it->second.healthy != healthy;
+    auto & state = states[currency];
+    state.healthy = healthy;
+    if (healthy) {
+        state.failures = 0;
+        state.retry = 0;
+    } else {
+        const int shift = std::min(state.failures++, 30);
+        state.retry = now + std::min(BACKOFF_MIN << shift, BACKOFF_MAX);
+    }
+    return changed;
+}
+
+int64_t WalletHealthChecker::retryTime(const std::string & currency) const {
+    LOCK(mu);
+    auto it = states.find(currency);
+    return it == states.end() ? 0 : it->second.retry;
+}
+
+void WalletHealthChecker::clearBackoff() {
+    LOCK(mu);
+    for (auto & item : states)
+        item.second.retry = 0;
+}
+
+void WalletHealthChecker::finish(const std::shared_ptr<Batch> & batch, const std::string & currency, const bool healthy) {
+    LOCK(batch->mu);
+    if (!batch->pending.erase(currency))
+        return; // missed the deadline
+    if (healthy)
+        batch->healthy.insert(currency);
+    batch->onResult(currency, healthy);
+    if (batch->pending.empty())
+        complete(*batch);
+}
+
+void WalletHealthChecker::expire(const std::shared_ptr<Batch> & batch) {
+    LOCK(batch->mu);
+    if (batch->done)
+        return;
+    for (const auto & currency : batch->pending)
+        batch->onResult(currency, false);
+    batch->pending.clear();
+    complete(*batch);
+}
+
+void WalletHealthChecker::complete(Batch & batch) {
+    batch.onDone(batch.healthy);
+    batch.done = true;
+    batch.cond.notify_all();
+}
+
+} // namespace xbridge
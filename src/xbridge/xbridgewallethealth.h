@@ -0,0 +1,123 @@
+// Copyright (c) 2020 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BLOCKNET_XBRIDGE_XBRIDGEWALLETHEALTH_H
+#define BLOCKNET_XBRIDGE_XBRIDGEWALLETHEALTH_H
+
+#include <xbridge/xbridgedef.h>
+
+#include <sync.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+namespace xbridge {
+
+/**
+ * Checks that the wallets in xbridge.conf are reachable. The checks run in parallel on the
+ * xbridge io_service pool and every wallet has to answer within the deadline, results are
+ * reported as soon as a wallet answers so unresponsive wallets don't delay the others.
+ * Wallets that fail are not checked again until their backoff expires, the backoff doubles
+ * with every consecutive failure.
+ */
+class WalletHealthChecker {
+public:
+    /** Seconds before a failed wallet is checked again, doubled per consecutive failure */
+    static constexpr int64_t BACKOFF_MIN = 60;
+    static constexpr int64_t BACKOFF_MAX = 30 * 60;
+
+    /** Returns true if the wallet is reachable */
+    typedef std::function<bool()> Check;
+    /** Called once per wallet, checks that miss the deadline fail */
+    typedef std::function<void(const std::string & currency, bool healthy)> OnResult;
+    /** Called after all results with the reachable wallets */
+    typedef std::function<void(const std::set<std::string> & healthy)> OnDone;
+
+    /**
+     * Sets the io services the checks and deadlines run on.
+     * @param workers checks are posted round robin
+     * @param timerIo runs the deadline timers, must not be blocked by checks
+     */
+    void start(const std::vector<IoServicePtr> & workers, boost::asio::io_service & timerIo);
+
+    /**
+     * Posts the checks, returns false if checks are already running or start() was not called.
+     * Callbacks are called on the worker and timer threads one at a time.
+     * @param checks by currency
+     * @param deadline milliseconds each wallet has to answer its check
+     */
+    bool run(const std::map<std::string, Check> & checks, int deadline,
+             const OnResult & onResult, const OnDone & onDone);
+
+    /**
+     * Returns true if checks are running.
+     */
+    bool isRunning() const;
+
+    /**
+     * Waits for the running checks, returns false on timeout.
+     * @param timeout milliseconds
+     */
+    bool wait(int timeout) const;
+
+    /**
+     * Returns false if the wallet failed and its backoff has not expired.
+     */
+    bool shouldCheck(const std::string & currency, int64_t now) const;
+
+    /**
+     * Records the result of a check and returns true if the state of the wallet changed.
+     */
+    bool update(const std::string & currency, bool healthy, int64_t now);
+
+    /**
+     * Returns the time the wallet is checked again, 0 if it is not backing off.
+     */
+    int64_t retryTime(const std::string & currency) const;
+
+    /**
+     * Clears the backoff of all wallets.
+     */
+    void clearBackoff();
+
+private:
+    struct State {
+        bool healthy{false};
+        int failures{0};
+        int64_t retry{0};
+    };
+    struct Batch {
+        Mutex mu;
+        std::condition_variable cond;
+        std::set<std::string> pending;
+        std::set<std::string> healthy;
+        OnResult onResult;
+        OnDone onDone;
+        std::atomic<bool> done{false};
+        std::unique_ptr<boost::asio::deadline_timer> timer;
+    };
+
+    static void finish(const std::shared_ptr<Batch> & batch, const std::string & currency, bool healthy);
+    static void expire(const std::shared_ptr<Batch> & batch);
+    static void complete(Batch & batch);
+
+    mutable Mutex mu;
+    std::vector<IoServicePtr> workers;
+    boost::asio::io_service *timerIo{nullptr};
+    std::atomic<size_t> next{0};
+    std::shared_ptr<Batch> current;
+    std::map<std::string, State> states;
+};
+
+} // namespace xbridge
+
+#endif // BLOCKNET_XBRIDGE_XBRIDGEWALLETHEALTH_H
@@ -28,6 +28,8 @@ public:
     boost::signals2::signal<void (const std::string & currency,
                                   const std::string & name,
                                   const std::string & address)> NotifyXBridgeAddressBookEntryReceived;
+
+    boost::signals2::signal<void (const std::string & currency, bool connected)> NotifyXBridgeWalletStateChanged;
 };
 
 extern XUIConnector xuiConnector;
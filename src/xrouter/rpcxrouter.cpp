@@ -4,6 +4,7 @@
 
 #include <rpc/server.h>
 
+#include <xbridge/util/xutil.h>
 #include <xbridge/xbridgeapp.h>
 #include <xrouter/xrouterapp.h>
 #include <xrouter/xroutererror.h>
@@ -11,6 +12,7 @@
 
 #include <bloom.h>
 #include <core_io.h>
+#include <servicenode/servicenodemgr.h>
 #include <uint256.h>
 #include <util/strencodings.h>
 #include <rpc/util.h>
@@ -29,15 +31,11 @@
 using namespace json_spirit;
 
 static UniValue uret_xr(const json_spirit::Value & o) {
-    UniValue uv;
-    const auto str = json_spirit::write_string(o, json_spirit::none, 8);
     try {
-        if (!uv.read(str))
-            uv.setStr(str);
+        return xbridge::toUniValue(o);
     } catch (...) {
-        uv.setStr(str);
+        return UniValue(json_spirit::write_string(o, json_spirit::none, 8));
     }
-    return uv;
 }
 
 static UniValue uret_xr(const std::string & str) {
@@ -687,6 +685,161 @@ static UniValue xrGetBlocks(const JSONRPCRequest& request)
     return xrouter::form_reply(uuid, uret_xr(reply));
 }
 
+static UniValue xrGetBlockFilters(const JSONRPCRequest& request)
+{
+    if (request.fHelp)
+        throw std::runtime_error(
+            RPCHelpMan{"xrGetBlockFilters",
+                "\nReturns the BIP 157 basic block filters (BIP 158) for a range of blocks. Light clients can match "
+                "their own scripts against the filters and only fetch the blocks that match. The service node's "
+                "wallet must run with -blockfilterindex.\n",
+                {
+                    {"blockchain", RPCArg::Type::STR, RPCArg::Optional::NO, "The blockchain, represented by the asset's ticker (BTC, LTC, SYS, etc.)."},
+                    {"start_height", RPCArg::Type::NUM, RPCArg::Optional::NO, "Height of the first block."},
+                    {"stop_height", RPCArg::Type::NUM, RPCArg::Optional::NO, "Height of the last block (inclusive)."},
+                    {"node_count", RPCArg::Type::NUM, RPCArg::Optional::OMITTED, "Number of XRouter nodes to query. The most common response will be returned "
+                                                                                 "as \"reply\" (i.e. the response with the most consensus). "
+                                                                                 "Defaults to 1 if no consensus= setting in xrouter.conf."},
+                },
+                RPCResult{
+                R"(
+    {
+      "reply": [
+        {
+          "height": 100,
+          "hash": "00000000839a8e6886ab5951d76f411475428afc90947ee320161bbf18eb6048",
+          "filter": "01b7c550",
+          "header": "9f3c30f0c37fb977cf3e1a3173c631e8ff119ad3088b6f5b2bced0802139c202"
+        },
+        ...
+      ],
+      "uuid": "3c84d025-8a03-4b64-848f-99892fe481ff"
+    }
+
+    Key          | Type | Description
+    -------------|------|--------------------------------------------------------
+    reply        | arr  | The hex-encoded filter and filter header of each block
+                 |      | in the range.
+    uuid         | str  | The response ID, which can be used to view this
+                 |      | response again with xrGetReply.
+                )"
+                },
+                RPCExamples{
+                    HelpExampleCli("xrGetBlockFilters", "BLOCK 100 110")
+                  + HelpExampleRpc("xrGetBlockFilters", "\"BLOCK\", 100, 110")
+                  + HelpExampleCli("xrGetBlockFilters", "BLOCK 100 110 2")
+                  + HelpExampleRpc("xrGetBlockFilters", "\"BLOCK\", 100, 110, 2")
+                },
+            }.ToString());
+
+    if (request.params.empty()) {
+        UniValue error(UniValue::VOBJ);
+        error.pushKV("error", "blockchain not specified");
+        error.pushKV("code", xrouter::INVALID_PARAMETERS);
+        return error;
+    }
+
+    if (request.params.size() < 3) {
+        UniValue error(UniValue::VOBJ);
+        error.pushKV("error", "start_height and stop_height must be specified");
+        error.pushKV("code", xrouter::INVALID_PARAMETERS);
+        return error;
+    }
+
+    const int startHeight = request.params[1].get_int();
+    const int stopHeight = request.params[2].get_int();
+    if (startHeight < 0 || stopHeight < startHeight) {
+        UniValue error(UniValue::VOBJ);
+        error.pushKV("error", "stop_height must be greater than or equal to start_height");
+        error.pushKV("code", xrouter::INVALID_PARAMETERS);
+        return error;
+    }
+
+    int consensus{0};
+    if (request.params.size() >= 4) {
+        consensus = request.params[3].get_int();
+        if (consensus < 1) {
+            UniValue error(UniValue::VOBJ);
+            error.pushKV("error", "node_count must be an integer >= 1");
+            error.pushKV("code", xrouter::INVALID_PARAMETERS);
+            return error;
+        }
+    }
+
+    const auto & currency = request.params[0].get_str();
+    std::string uuid;
+    const auto reply = xrouter::App::instance().getBlockFilters(uuid, currency, consensus, startHeight, stopHeight);
+    return xrouter::form_reply(uuid, uret_xr(reply));
+}
+
+static UniValue xrGetBalance(const JSONRPCRequest& request)
+{
+    if (request.fHelp)
+        throw std::runtime_error(
+            RPCHelpMan{"xrGetBalance",
+                "\nReturns the confirmed balance of an address. The service node's wallet must run with "
+                "-addressindex (or provide a compatible getaddressbalance call).\n",
+                {
+                    {"blockchain", RPCArg::Type::STR, RPCArg::Optional::NO, "The blockchain, represented by the asset's ticker (BTC, LTC, SYS, etc.)."},
+                    {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "The address to query the balance of."},
+                    {"node_count", RPCArg::Type::NUM, RPCArg::Optional::OMITTED, "Number of XRouter nodes to query. The most common response will be returned "
+                                                                                 "as \"reply\" (i.e. the response with the most consensus). "
+                                                                                 "Defaults to 1 if no consensus= setting in xrouter.conf."},
+                },
+                RPCResult{
+                R"(
+    {
+      "reply": "1500.00000000",
+      "uuid": "3c84d025-8a03-4b64-848f-99892fe481ff"
+    }
+
+    Key          | Type | Description
+    -------------|------|--------------------------------------------------------
+    reply        | str  | The balance of the address in coins.
+    uuid         | str  | The response ID, which can be used to view this
+                 |      | response again with xrGetReply.
+                )"
+                },
+                RPCExamples{
+                    HelpExampleCli("xrGetBalance", "BLOCK BXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX")
+                  + HelpExampleRpc("xrGetBalance", "\"BLOCK\", \"BXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX\"")
+                  + HelpExampleCli("xrGetBalance", "BLOCK BXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX 2")
+                  + HelpExampleRpc("xrGetBalance", "\"BLOCK\", \"BXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX\", 2")
+                },
+            }.ToString());
+
+    if (request.params.empty()) {
+        UniValue error(UniValue::VOBJ);
+        error.pushKV("error", "blockchain not specified");
+        error.pushKV("code", xrouter::INVALID_PARAMETERS);
+        return error;
+    }
+
+    if (request.params.size() < 2) {
+        UniValue error(UniValue::VOBJ);
+        error.pushKV("error", "address not specified");
+        error.pushKV("code", xrouter::INVALID_PARAMETERS);
+        return error;
+    }
+
+    int consensus{0};
+    if (request.params.size() >= 3) {
+        consensus = request.params[2].get_int();
+        if (consensus < 1) {
+            UniValue error(UniValue::VOBJ);
+            error.pushKV("error", "node_count must be an integer >= 1");
+            error.pushKV("code", xrouter::INVALID_PARAMETERS);
+            return error;
+        }
+    }
+
+    const auto & currency = request.params[0].get_str();
+    const auto & address = request.params[1].get_str();
+    std::string uuid;
+    const auto reply = xrouter::App::instance().getBalance(uuid, currency, consensus, address);
+    return xrouter::form_reply(uuid, uret_xr(reply));
+}
+
 static UniValue xrGetTransactions(const JSONRPCRequest& request)
 {
     if (request.fHelp)
@@ -1353,6 +1506,10 @@ static UniValue xrStatus(const JSONRPCRequest& request)
                  |      | true: Client is a Service Node.
                  |      | false: Client is not a Service Node.
     config       | str  | The raw text contents of your xrouter.conf.
+    querycache   | obj  | Client call counters: queries sent to service nodes,
+                 |      | calls that shared the reply of an identical call in
+                 |      | progress (coalesced) and calls answered from the cache
+                 |      | (cached, see cachettl in xrouter.conf).
                 )"
                 },
                 RPCExamples{
@@ -1365,6 +1522,71 @@ static UniValue xrStatus(const JSONRPCRequest& request)
     return reply;
 }
 
+static UniValue xrShowLatencies(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+            RPCHelpMan{"xrShowLatencies",
+                "\nShows the response times of XRouter nodes measured by this client. Nodes with lower "
+                "response times are preferred when selecting nodes for a call.\n",
+                {
+                    {"service", RPCArg::Type::STR, RPCArg::Optional::OMITTED, "Only show this service, e.g. xr::BLOCK::xrGetBlockCount"},
+                },
+                RPCResult{
+                R"(
+    [
+      {
+        "node": "127.0.0.1:41412",
+        "service": "xr::BLOCK::xrGetBlockCount",
+        "average": 182,
+        "p50": 170,
+        "p90": 260,
+        "p99": 410,
+        "samples": 48,
+        "updated": 1591634215
+      }
+    ]
+
+    Key      | Type | Description
+    ---------|------|----------------------------------------------------------
+    node     | str  | The node address.
+    service  | str  | The fully qualified service name.
+    average  | int  | Moving average of the response time in milliseconds.
+    p50      | int  | Median response time of the recent calls in ms.
+    p90      | int  | 90th percentile response time of the recent calls in ms.
+    p99      | int  | 99th percentile response time of the recent calls in ms.
+    samples  | int  | Number of calls measured. Calls the node didn't answer
+             |      | count at least as slow as its average.
+    updated  | int  | Unix time of the last measured call.
+                )"
+                },
+                RPCExamples{
+                    HelpExampleCli("xrShowLatencies", "")
+                  + HelpExampleRpc("xrShowLatencies", "")
+                  + HelpExampleCli("xrShowLatencies", "xr::BLOCK::xrGetBlockCount")
+                  + HelpExampleRpc("xrShowLatencies", "\"xr::BLOCK::xrGetBlockCount\"")
+                },
+            }.ToString());
+
+    const std::string service = request.params.empty() ? "" : request.params[0].get_str();
+
+    UniValue result(UniValue::VARR);
+    for (const auto & item : xrouter::App::instance().latencyStats(service)) {
+        const auto & stats = item.second;
+        UniValue o(UniValue::VOBJ);
+        o.pushKV("node", item.first.first);
+        o.pushKV("service", item.first.second);
+        o.pushKV("average", static_cast<int64_t>(stats.ewma + 0.5));
+        o.pushKV("p50", stats.percentile(50));
+        o.pushKV("p90", stats.percentile(90));
+        o.pushKV("p99", stats.percentile(99));
+        o.pushKV("samples", static_cast<int64_t>(stats.count));
+        o.pushKV("updated", stats.lastUpdate);
+        result.push_back(o);
+    }
+    return result;
+}
+
 static UniValue xrConnectedNodes(const JSONRPCRequest& request)
 {
     if (request.fHelp)
@@ -1787,17 +2009,18 @@ static UniValue xrUpdateNetworkServices(const JSONRPCRequest& request) {
         return addr;
     };
 
-    // Ask up to "askcount" number of nodes
+    // Ask up to "askcount" number of nodes, only the pings we don't already have are sent
+    const auto digest = sn::ServiceNodeMgr::instance().listDigest();
     auto copynodes = nodes;
     const auto csize = copynodes.size();
     while (!copynodes.empty() && csize - copynodes.size() < askcount) {
         try {
             const auto addr = randnode(copynodes);
-            g_connman->ForEachNode([addr](CNode *pnode) {
+            g_connman->ForEachNode([addr,&digest](CNode *pnode) {
                 if (pnode->GetAddrName() != addr)
                     return;
                 const CNetMsgMaker msgMaker(pnode->GetSendVersion());
-                g_connman->PushMessage(pnode, msgMaker.Make(NetMsgType::SNLIST));
+                g_connman->PushMessage(pnode, msgMaker.Make(NetMsgType::SNLIST, digest));
             });
         } catch (...) {
             break;
@@ -1834,6 +2057,8 @@ static const CRPCCommand commands[] =
     { "xrouter",      "xrGetBlockHash",                  &xrGetBlockHash,                 {} },
     { "xrouter",      "xrGetBlock",                      &xrGetBlock,                     {} },
     { "xrouter",      "xrGetBlocks",                     &xrGetBlocks,                    {} },
+    { "xrouter",      "xrGetBlockFilters",               &xrGetBlockFilters,              {} },
+    { "xrouter",      "xrGetBalance",                    &xrGetBalance,                   {} },
     { "xrouter",      "xrGetTransaction",                &xrGetTransaction,               {} },
     { "xrouter",      "xrGetTransactions",               &xrGetTransactions,              {} },
     { "xrouter",      "xrSendTransaction",               &xrSendTransaction,              {} },
@@ -1848,6 +2073,7 @@ static const CRPCCommand commands[] =
     { "xrouter",      "xrService",                       &xrService,                      {} },
     { "xrouter",      "xrServiceConsensus",              &xrServiceConsensus,             {} },
     { "xrouter",      "xrShowConfigs",                   &xrShowConfigs,                  {} },
+    { "xrouter",      "xrShowLatencies",                 &xrShowLatencies,                {} },
     { "xrouter",      "xrStatus",                        &xrStatus,                       {} },
     { "xrouter",      "xrUpdateNetworkServices",         &xrUpdateNetworkServices,        {} },
     // { "xrouter",      "xrTest",                          &xrTest,                         {} },
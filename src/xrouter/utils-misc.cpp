@@ -4,10 +4,16 @@
 
 #include <xrouter/xrouterutils.h>
 
+#include <xrouter/xrouterdef.h>
+
 #include <rpc/protocol.h>
 
+#include <algorithm>
+#include <map>
 #include <string>
 #include <regex>
+#include <utility>
+#include <vector>
 
 #include <json/json_spirit_reader_template.h>
 #include <json/json_spirit_utils.h>
@@ -279,62 +285,66 @@ UniValue form_reply(const std::string & uuid, const UniValue & reply) {
         return ret;
     }
 
-    ret = reply;
-
-    UniValue rply = find_value(ret, "reply");
-    UniValue result = find_value(ret, "result");
-    const UniValue error_val = find_value(ret, "error");
-    const UniValue code_val = find_value(ret, "code");
-    const UniValue uuid_val = find_value(ret, "uuid");
-
-    if (rply.isNull() && result.isNull() && error_val.isNull()) {
-        ret = UniValue(UniValue::VOBJ);
-        ret.pushKV("reply", reply.get_obj());
-        if (!error_val.isNull())
-            ret.pushKV("error", "Bad request");
+    // Members are referenced until the reply is assembled, large replies are copied once
+    typedef std::vector<std::pair<std::string, const UniValue*>> Members;
+    Members members;
+    const auto & keys = reply.getKeys();
+    const auto & values = reply.getValues();
+    for (size_t i = 0; i < keys.size(); ++i)
+        members.emplace_back(keys[i], &values[i]);
+    // Sorts by key and drops duplicates, the last member wins
+    auto sorted = [](const Members & m, const std::string & skip) -> Members {
+        std::map<std::string, const UniValue*> uvmap;
+        for (const auto & item : m)
+            uvmap[item.first] = item.second;
+        Members r;
+        for (const auto & item : uvmap) {
+            if (item.first != skip)
+                r.push_back(item);
+        }
+        return r;
+    };
+
+    const UniValue & rply = find_value(reply, "reply");
+    const UniValue & result = find_value(reply, "result");
+    const UniValue & error_val = find_value(reply, "error");
+    const UniValue & code_val = find_value(reply, "code");
+    const UniValue & uuid_val = find_value(reply, "uuid");
+
+    const bool wrap = rply.isNull() && result.isNull() && error_val.isNull();
+    if (wrap) {
+        members.clear();
+        members.emplace_back("reply", &reply);
         if (!code_val.isNull())
-            ret.pushKV("code", code_val);
+            members.emplace_back("code", &code_val);
         if (!uuid_val.isNull())
-            ret.pushKV("uuid", uuid_val);
-        rply = find_value(ret, "reply");
-        result = UniValue();
+            members.emplace_back("uuid", &uuid_val);
     }
 
-    UniValue nret;
     // Display result/reply
-    if (!result.isNull() && rply.isNull()) {
-        nret.setObject();
-        std::map<std::string, UniValue> uvmap;
-        ret.getObjMap(uvmap);
-        for (const auto & item : uvmap) {
-            if (item.first != "result")
-                nret.pushKV(item.first, item.second);
-        }
-        nret.pushKV("reply", result);
-    } else
-        nret = ret;
+    if (!wrap && !result.isNull() && rply.isNull()) {
+        members = sorted(members, "result");
+        members.emplace_back("reply", &result);
+    }
 
     // Display errors
+    const UniValue code(static_cast<int>(xrouter::INTERNAL_SERVER_ERROR));
     if (!error_val.isNull()) {
         if (code_val.isNull())
-            nret.pushKV("code", xrouter::INTERNAL_SERVER_ERROR);
+            members.emplace_back("code", &code);
     }
 
     // Display uuid if necessary
-    UniValue rret;
+    const UniValue uuidv(uuid);
     if (!uuid.empty()) {
-        rret.setObject();
-        std::map<std::string, UniValue> uvmap;
-        nret.getObjMap(uvmap);
-        for (const auto & item : uvmap) {
-            if (item.first != "uuid")
-                rret.pushKV(item.first, item.second);
-        }
-        rret.pushKV("uuid", uuid);
-    } else
-        rret = nret;
+        members = sorted(members, "uuid");
+        members.emplace_back("uuid", &uuidv);
+    }
 
-    return rret;
+    ret.setObject();
+    for (const auto & item : members)
+        ret.__pushKV(item.first, *item.second);
+    return ret;
 }
 
 Object form_reply(const std::string & uuid, const std::string & reply)
@@ -350,4 +360,53 @@ Object form_reply(const std::string & uuid, const std::string & reply)
     return form_reply(uuid, reply_val);
 }
 
+bool writeReplyChunks(const ReplyPartSource & next, const bool array, const uint64_t maxSize,
+                      const std::function<void(const std::string & chunk, bool last)> & send)
+{
+    std::string chunk;
+    uint64_t size{0};
+    auto write = [&](const std::string & data) -> bool {
+        size += data.size();
+        if (size > maxSize)
+            return false;
+        for (size_t pos = 0; pos < data.size(); ) {
+            const auto n = std::min<size_t>(data.size() - pos, XROUTER_REPLY_CHUNK_SIZE - chunk.size());
+            chunk.append(data, pos, n);
+            pos += n;
+            if (chunk.size() == XROUTER_REPLY_CHUNK_SIZE) {
+                send(chunk, false);
+                chunk.clear();
+            }
+        }
+        return true;
+    };
+
+    if (array && !write("["))
+        return false;
+    std::string part;
+    for (size_t i = 0; next(part); ++i) {
+        if (array && i > 0 && !write(","))
+            return false;
+        if (!write(part))
+            return false;
+        std::string().swap(part);
+    }
+    if (array && !write("]"))
+        return false;
+    send(chunk, true);
+    return true;
+}
+
+bool writeReplyChunks(std::vector<std::string> & parts, const bool array, const uint64_t maxSize,
+                      const std::function<void(const std::string & chunk, bool last)> & send)
+{
+    size_t i{0};
+    return writeReplyChunks([&parts, &i](std::string & part) -> bool {
+        if (i == parts.size())
+            return false;
+        part.swap(parts[i++]);
+        return true;
+    }, array, maxSize, send);
+}
+
 } // namespace xrouter
@@ -6,15 +6,20 @@
 
 #include <xrouter/xrouterdef.h>
 
+#include <compat.h>
 #include <event2/buffer.h>
+#include <event2/bufferevent.h>
 #include <rpc/protocol.h>
 #include <support/events.h>
+#include <sync.h>
 #include <tinyformat.h>
 #include <util/strencodings.h>
 #include <util/system.h>
 #include <univalue.h>
 
 #include <array>
+#include <deque>
+#include <map>
 #include <stdio.h>
 
 #include <boost/lexical_cast.hpp>
@@ -26,6 +31,10 @@
 #include <openssl/ssl.h>
 #endif // ENABLE_EVENTSSL
 
+#if defined(ENABLE_EVENTSSL) && LIBEVENT_VERSION_NUMBER >= 0x02010b00
+#define XROUTER_USE_TLS 1
+#endif
+
 //*****************************************************************************
 //*****************************************************************************
 namespace xrouter
@@ -34,10 +43,11 @@ namespace xrouter
 /** Reply structure for request_done to fill in */
 struct HTTPReply
 {
-    HTTPReply(): status(0), error(-1) {}
+    HTTPReply(): status(0), error(-1), base(nullptr) {}
 
     int status;
     int error;
+    struct event_base *base; // interrupted when the request is done, the connection may stay open
     CPubKey hdrpubkey;
     std::vector<unsigned char> hdrsignature;
     std::string body;
@@ -68,6 +78,8 @@ static const char *http_errorstring(int code)
 static void http_request_done(struct evhttp_request *req, void *ctx)
 {
     HTTPReply *reply = static_cast<HTTPReply*>(ctx);
+    if (reply->base)
+        event_base_loopbreak(reply->base);
 
     if (req == nullptr) {
         /* If req is nullptr, it means an error occurred while connecting: the
@@ -199,18 +211,243 @@ std::string CallRPC(const std::string & rpcuser, const std::string & rpcpasswd,
     return response.body;
 }
 
-XRouterReply CallXRouterUrl(const std::string & host, const int & port, const std::string & url, const std::string & data,
-                    const int & timeout, const CKey & signingkey, const CPubKey & serverkey, const std::string & paymentrawtx)
+/** Idle connections kept open per snode */
+static constexpr size_t XROUTER_MAX_IDLE_CONNECTIONS = 4;
+/** Idle connections are closed after this many seconds */
+static constexpr int64_t XROUTER_IDLE_CONNECTION_TIMEOUT = 30;
+
+/**
+ * Kept-alive connection to a snode. Every connection has its own event base and is
+ * used by one request at a time.
+ */
+struct XRouterConnection
 {
-    // Obtain event base
-    raii_event_base base = obtain_event_base();
+    raii_event_base base;
+    struct evhttp_connection *evcon{nullptr};
+#ifdef XROUTER_USE_TLS
+    SSL *ssl{nullptr}; // owned by the connection's bufferevent
+#endif
+    bool closed{false};
+    int64_t lastUsed{0};
+
+    /**
+     * Returns false if the snode closed or reset the socket. An idle connection has nothing
+     * to read, a readable socket has either hit EOF, an error or stale data.
+     */
+    bool socketOpen() const {
+        struct bufferevent *bev = evhttp_connection_get_bufferevent(evcon);
+        const SOCKET fd = bev ? bufferevent_getfd(bev) : INVALID_SOCKET;
+        if (fd == INVALID_SOCKET || !IsSelectableSocket(fd))
+            return false;
+        fd_set fdRead;
+        FD_ZERO(&fdRead);
+        FD_SET(fd, &fdRead);
+        struct timeval tv{0, 0};
+        return select(fd + 1, &fdRead, nullptr, nullptr, &tv) == 0;
+    }
 
-    // Synchronously look up hostname
-    raii_evhttp_connection evcon = obtain_evhttp_connection_base(base.get(), host, port);
-    evhttp_connection_set_timeout(evcon.get(), timeout > 0 ? timeout
+    XRouterConnection() : base(obtain_event_base()) {}
+    ~XRouterConnection() {
+        if (evcon)
+            evhttp_connection_free(evcon);
+    }
+};
+typedef std::unique_ptr<XRouterConnection> XRouterConnectionPtr;
+
+static void xrouter_connection_closed(struct evhttp_connection *evcon, void *ctx)
+{
+    static_cast<XRouterConnection*>(ctx)->closed = true;
+}
+
+/**
+ * Pool of kept-alive connections to snodes, keyed by host:port. TLS connections share one
+ * client SSL_CTX and resume the last session of the snode, so repeated queries skip the
+ * TCP and TLS handshakes.
+ */
+class XRouterConnectionPool
+{
+public:
+    static XRouterConnectionPool & instance() {
+        static XRouterConnectionPool pool;
+        return pool;
+    }
+
+    /**
+     * Returns an idle connection to the snode, or a new one if there is none. Idle
+     * connections whose socket was closed or reset by the snode are dropped here, before
+     * any request bytes are written to them.
+     * @param reused set to true if the connection was used before
+     */
+    XRouterConnectionPtr acquire(const std::string & host, const int port, const bool tls, bool & reused) {
+        const auto key = poolKey(host, port, tls);
+        const int64_t now = GetTime();
+        while (true) {
+            XRouterConnectionPtr conn;
+            {
+                LOCK(mu);
+                auto it = idle.find(key);
+                if (it == idle.end() || it->second.empty())
+                    break;
+                conn = std::move(it->second.back()); // most recently used
+                it->second.pop_back();
+            }
+            // Handle a close by the snode while the connection was idle
+            event_base_loop(conn->base.get(), EVLOOP_NONBLOCK);
+            if (!conn->closed && now - conn->lastUsed < XROUTER_IDLE_CONNECTION_TIMEOUT && conn->socketOpen()) {
+                reused = true;
+                return conn;
+            }
+        }
+        reused = false;
+        return connect(host, port, tls);
+    }
+
+    /**
+     * Keeps the connection open for the next request to the snode.
+     */
+    void release(const std::string & host, const int port, const bool tls, XRouterConnectionPtr conn) {
+        if (conn->closed)
+            return;
+        conn->lastUsed = GetTime();
+        const auto key = poolKey(host, port, tls);
+#ifdef XROUTER_USE_TLS
+        SSL_SESSION *session = tls ? SSL_get1_session(conn->ssl) : nullptr;
+#endif
+        LOCK(mu);
+#ifdef XROUTER_USE_TLS
+        if (session) {
+            auto it = sessions.find(key);
+            if (it != sessions.end())
+                SSL_SESSION_free(it->second);
+            sessions[key] = session;
+        }
+#endif
+        auto & conns = idle[key];
+        if (conns.size() >= XROUTER_MAX_IDLE_CONNECTIONS)
+            conns.pop_front(); // oldest
+        conns.push_back(std::move(conn));
+    }
+
+    /**
+     * Closes all idle connections and forgets the TLS sessions.
+     */
+    void clear() {
+        std::map<std::string, std::deque<XRouterConnectionPtr>> conns;
+        LOCK(mu);
+        conns.swap(idle);
+#ifdef XROUTER_USE_TLS
+        for (auto & item : sessions)
+            SSL_SESSION_free(item.second);
+        sessions.clear();
+#endif
+    }
+
+private:
+    XRouterConnectionPool() = default;
+    ~XRouterConnectionPool() { clear(); }
+
+    static std::string poolKey(const std::string & host, const int port, const bool tls) {
+        return strprintf("%s:%d%s", host, port, tls ? "/tls" : "");
+    }
+
+    XRouterConnectionPtr connect(const std::string & host, const int port, const bool tls) {
+        XRouterConnectionPtr conn(new XRouterConnection);
+        if (!tls) {
+            // Synchronously look up hostname
+            conn->evcon = evhttp_connection_base_new(conn->base.get(), nullptr, host.c_str(), port);
+            if (conn->evcon == nullptr)
+                throw std::runtime_error("create connection failed");
+        } else {
+#ifdef XROUTER_USE_TLS
+            SSL_CTX *ctx = sslContext();
+            if (ctx == nullptr)
+                throw std::runtime_error("failed to open ssl connection (1)");
+            SSL *ssl = SSL_new(ctx);
+            if (ssl == nullptr)
+                throw std::runtime_error("failed to open ssl connection (2)");
+            // SNI support
+            SSL_set_tlsext_host_name(ssl, host.c_str());
+            {
+                LOCK(mu);
+                auto it = sessions.find(poolKey(host, port, tls));
+                if (it != sessions.end())
+                    SSL_set_session(ssl, it->second);
+            }
+
+            struct bufferevent *bev = bufferevent_openssl_socket_new(conn->base.get(), -1, ssl, BUFFEREVENT_SSL_CONNECTING,
+                                                                     BEV_OPT_CLOSE_ON_FREE | BEV_OPT_DEFER_CALLBACKS);
+            if (bev == nullptr) {
+                SSL_free(ssl);
+                throw std::runtime_error("failed to open ssl connection (4)");
+            }
+            bufferevent_openssl_set_allow_dirty_shutdown(bev, 1);
+
+            // Synchronously look up hostname
+            conn->evcon = evhttp_connection_base_bufferevent_new(conn->base.get(), nullptr, bev, host.c_str(), port);
+            if (conn->evcon == nullptr) {
+                bufferevent_free(bev);
+                throw std::runtime_error("failed to open ssl connection (5)");
+            }
+            conn->ssl = ssl;
+#else
+            throw std::runtime_error("ssl connections are not supported");
+#endif // XROUTER_USE_TLS
+        }
+        evhttp_connection_set_closecb(conn->evcon, xrouter_connection_closed, conn.get());
+        return conn;
+    }
+
+#ifdef XROUTER_USE_TLS
+    static SSL_CTX *sslContext() {
+        // Shared by all connections for the lifetime of the process
+        static SSL_CTX *ctx = []() -> SSL_CTX* {
+            SSL_CTX *c = SSL_CTX_new(SSLv23_method());
+            if (c) // sessions are cached per snode by the pool
+                SSL_CTX_set_session_cache_mode(c, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+            // TODO Blocknet xrclient cert verification
+            return c;
+        }();
+        return ctx;
+    }
+#endif // XROUTER_USE_TLS
+
+    Mutex mu;
+    std::map<std::string, std::deque<XRouterConnectionPtr>> idle;
+#ifdef XROUTER_USE_TLS
+    std::map<std::string, SSL_SESSION*> sessions;
+#endif
+};
+
+void ClearXRouterConnections()
+{
+    XRouterConnectionPool::instance().clear();
+}
+
+/**
+ * Performs a signed request to the snode on a pooled connection. Requests are never sent
+ * twice, a failure or timeout after the request was written is final because the snode may
+ * already have processed (and charged for) it. Idle connections closed by the snode are
+ * replaced before the request is written, see XRouterConnectionPool::acquire.
+ */
+static XRouterReply CallXRouterUrlPooled(const std::string & host, const int & port, const bool tls,
+        const std::string & url, const std::string & data, const int & timeout, const CKey & signingkey,
+        const std::string & paymentrawtx)
+{
+    CHashWriter hw(SER_GETHASH, 0);
+    hw << data;
+    std::vector<unsigned char> signature;
+    if (!signingkey.SignCompact(hw.GetHash(), signature))
+        throw std::runtime_error("failed to produce signature on payload");
+    const std::string servertype = tls ? "ssl server" : "server";
+
+    auto & pool = XRouterConnectionPool::instance();
+    bool reused{false};
+    XRouterConnectionPtr conn = pool.acquire(host, port, tls, reused);
+    evhttp_connection_set_timeout(conn->evcon, timeout > 0 ? timeout
                                                            : static_cast<int>(gArgs.GetArg("-rpcxroutertimeout", 60)));
 
     HTTPReply response;
+    response.base = conn->base.get();
     raii_evhttp_request req = obtain_evhttp_request(http_request_done, (void*)&response);
     if (req == nullptr)
         throw std::runtime_error("create http request failed");
@@ -221,14 +458,8 @@ XRouterReply CallXRouterUrl(const std::string & host, const int & port, const st
     struct evkeyvalq* output_headers = evhttp_request_get_output_headers(req.get());
     assert(output_headers);
     evhttp_add_header(output_headers, "Host", host.c_str());
-    evhttp_add_header(output_headers, "Connection", "close");
+    evhttp_add_header(output_headers, "Connection", "keep-alive");
     evhttp_add_header(output_headers, "XR-Pubkey", HexStr(signingkey.GetPubKey()).c_str());
-
-    CHashWriter hw(SER_GETHASH, 0);
-    hw << data;
-    std::vector<unsigned char> signature;
-    if (!signingkey.SignCompact(hw.GetHash(), signature))
-        throw std::runtime_error("failed to produce signature on payload");
     evhttp_add_header(output_headers, "XR-Signature", HexStr(signature).c_str());
     evhttp_add_header(output_headers, "XR-Payment", paymentrawtx.c_str());
 
@@ -236,26 +467,30 @@ XRouterReply CallXRouterUrl(const std::string & host, const int & port, const st
     std::string strRequest = data + "\n";
     struct evbuffer *output_buffer = evhttp_request_get_output_buffer(req.get());
     if (!output_buffer)
-        throw std::runtime_error(strprintf("Internal error in connection to server %s:%d failed to set headers\n", host, port));
+        throw std::runtime_error(strprintf("Internal error in connection to %s %s:%d failed to set headers\n", servertype, host, port));
     evbuffer_add(output_buffer, strRequest.data(), strRequest.size());
 
-    int r = evhttp_make_request(evcon.get(), req.get(), EVHTTP_REQ_POST, url.c_str());
+    int r = evhttp_make_request(conn->evcon, req.get(), EVHTTP_REQ_POST, url.c_str());
     req.release(); // ownership moved to evcon in above call
     if (r != 0)
-        throw std::runtime_error("send http request failed");
+        throw std::runtime_error(tls ? "send ssl http request failed" : "send http request failed");
 
-    event_base_dispatch(base.get());
+    event_base_dispatch(conn->base.get());
+
+    if (response.status != 0)
+        pool.release(host, port, tls, std::move(conn));
 
     if (response.status == 0) {
         std::string responseErrorMessage;
         if (response.error != -1) {
             responseErrorMessage = strprintf(" (error code %d - \"%s\")", response.error, http_errorstring(response.error));
         }
-        throw std::runtime_error(strprintf("Could not connect to the server %s:%d %s\n", host, port, responseErrorMessage));
+        throw std::runtime_error(strprintf("Could not connect to the %s %s:%d%s %s\n", servertype, host, port,
+                                           reused ? " on a kept-alive connection" : "", responseErrorMessage));
     } else if (response.status == HTTP_UNAUTHORIZED) {
-        throw std::runtime_error("Authorization failed");
+        throw std::runtime_error(tls ? "ssl authorization failed" : "Authorization failed");
     } else if (response.status >= 400 && response.status != HTTP_BAD_REQUEST && response.status != HTTP_NOT_FOUND && response.status != HTTP_INTERNAL_SERVER_ERROR) {
-        throw std::runtime_error(strprintf("server returned HTTP error %d", response.status));
+        throw std::runtime_error(strprintf("%s returned HTTP error %d", servertype, response.status));
     }
 
     XRouterReply reply;
@@ -267,6 +502,12 @@ XRouterReply CallXRouterUrl(const std::string & host, const int & port, const st
     return std::move(reply);
 }
 
+XRouterReply CallXRouterUrl(const std::string & host, const int & port, const std::string & url, const std::string & data,
+                    const int & timeout, const CKey & signingkey, const CPubKey & serverkey, const std::string & paymentrawtx)
+{
+    return CallXRouterUrlPooled(host, port, false, url, data, timeout, signingkey, paymentrawtx);
+}
+
 std::string CallCMD(const std::string & cmd, int & exit) {
     std::array<char, 128> buffer{};
     FILE *pipe = popen(std::string(cmd + " 2>&1").c_str(), "r");
@@ -304,117 +545,11 @@ std::string CallCMD(const std::string & cmd, int & exit) {
 XRouterReply CallXRouterUrlSSL(const std::string & host, const int & port, const std::string & url, const std::string & data,
         const int & timeout, const CKey & signingkey, const CPubKey & serverkey, const std::string & paymentrawtx)
 {
-#if defined(ENABLE_EVENTSSL) && LIBEVENT_VERSION_NUMBER >= 0x02010b00
-    auto cleanup = [](SSL_CTX *ssl_ctx, SSL *ssl=nullptr, struct evhttp_connection *evcon=nullptr, struct evhttp_request *req=nullptr) {
-        if (ssl_ctx) SSL_CTX_free(ssl_ctx);
-        if (ssl) SSL_free(ssl);
-        if (evcon) evhttp_connection_free(evcon);
-        if (req) evhttp_request_free(req);
-    };
-
-    SSL_CTX *ssl_ctx = SSL_CTX_new(SSLv23_method());
-    if (ssl_ctx == nullptr) {
-        cleanup(ssl_ctx);
-        throw std::runtime_error("failed to open ssl connection (1)");
-    }
-    // TODO Blocknet xrclient cert verification
-//    int c1 = SSL_CTX_set_default_verify_paths(ssl_ctx);
-//    int c2 = SSL_CTX_load_verify_locations(ssl_ctx, "/etc/ssl/certs/ca-certificates.crt", "/etc/ssl/certs"); // debian
-//    SSL_CTX_set_verify(ssl_ctx, SSL_VERIFY_PEER, nullptr);
-
-    SSL *ssl = SSL_new(ssl_ctx);
-    if (ssl == nullptr) {
-        cleanup(ssl_ctx, ssl);
-        throw std::runtime_error("failed to open ssl connection (2)");
-    }
-    // SNI support
-    SSL_set_tlsext_host_name(ssl, host.c_str());
-
-    raii_event_base raii_base = obtain_event_base();
-    struct event_base *base = raii_base.get();
-    if (base == nullptr) {
-        cleanup(ssl_ctx, ssl);
-        throw std::runtime_error("failed to open ssl connection (3)");
-    }
-
-    struct bufferevent *bev = bufferevent_openssl_socket_new(base, -1, ssl, BUFFEREVENT_SSL_CONNECTING, BEV_OPT_CLOSE_ON_FREE | BEV_OPT_DEFER_CALLBACKS);
-    if (bev == nullptr) {
-        cleanup(ssl_ctx, ssl);
-        throw std::runtime_error("failed to open ssl connection (4)");
-    }
-    bufferevent_openssl_set_allow_dirty_shutdown(bev, 1);
-
-    // Synchronously look up hostname
-    struct evhttp_connection *evcon = evhttp_connection_base_bufferevent_new(base, nullptr, bev, host.c_str(), 443);
-    if (evcon == nullptr)
-        throw std::runtime_error("failed to open ssl connection (5)");
-    evhttp_connection_set_timeout(evcon, timeout > 0 ? timeout : static_cast<int>(gArgs.GetArg("-rpcxroutertimeout", 60)));
-
-    HTTPReply response;
-    struct evhttp_request *req = evhttp_request_new(http_request_done, (void*)&response);
-    if (req == nullptr) {
-        cleanup(nullptr, nullptr, evcon, req);
-        throw std::runtime_error("create ssl http request failed");
-    }
-#if LIBEVENT_VERSION_NUMBER >= 0x02010300
-    evhttp_request_set_error_cb(req, http_error_cb);
-#endif
-
-    struct evkeyvalq* output_headers = evhttp_request_get_output_headers(req);
-    assert(output_headers);
-    evhttp_add_header(output_headers, "Host", host.c_str());
-    evhttp_add_header(output_headers, "Connection", "close");
-    evhttp_add_header(output_headers, "XR-Pubkey", HexStr(signingkey.GetPubKey()).c_str());
-
-    CHashWriter hw(SER_GETHASH, 0);
-    hw << data;
-    std::vector<unsigned char> signature;
-    if (!signingkey.SignCompact(hw.GetHash(), signature)) {
-        cleanup(nullptr, nullptr, evcon, req);
-        throw std::runtime_error("failed to produce signature on payload");
-    }
-    evhttp_add_header(output_headers, "XR-Signature", HexStr(signature).c_str());
-    evhttp_add_header(output_headers, "XR-Payment", paymentrawtx.c_str());
-
-    // Attach request data
-    std::string strRequest = data + "\n";
-    struct evbuffer *output_buffer = evhttp_request_get_output_buffer(req);
-    if (!output_buffer) {
-        cleanup(nullptr, nullptr, nullptr, req);
-        throw std::runtime_error(strprintf("Internal error in connection to server %s:%d failed to set headers\n", host, 443));
-    }
-    evbuffer_add(output_buffer, strRequest.data(), strRequest.size());
-
-    int r = evhttp_make_request(evcon, req, EVHTTP_REQ_POST, url.c_str());
-    if (r != 0) {
-        cleanup(nullptr, nullptr, evcon, req);
-        throw std::runtime_error("send ssl http request failed");
-    }
-
-    event_base_dispatch(base);
-    cleanup(nullptr, nullptr, evcon, nullptr); // req owned by evcon
-
-    if (response.status == 0) {
-        std::string responseErrorMessage;
-        if (response.error != -1)
-            responseErrorMessage = strprintf(" (error code %d - %s)", response.error, http_errorstring(response.error));
-        throw std::runtime_error(strprintf("Could not connect to the ssl server %s:%d %s\n", host, 443, responseErrorMessage));
-    } else if (response.status == HTTP_UNAUTHORIZED) {
-        throw std::runtime_error("ssl authorization failed");
-    } else if (response.status >= 400 && response.status != HTTP_BAD_REQUEST && response.status != HTTP_NOT_FOUND && response.status != HTTP_INTERNAL_SERVER_ERROR) {
-        throw std::runtime_error(strprintf("ssl server returned HTTP error %d", response.status));
-    }
-
-    XRouterReply reply;
-    reply.status = response.status;
-    reply.error = response.error;
-    reply.result = response.body;
-    reply.hdrpubkey = response.hdrpubkey;
-    reply.hdrsignature = response.hdrsignature;
-    return std::move(reply);
+#ifdef XROUTER_USE_TLS
+    return CallXRouterUrlPooled(host, 443, true, url, data, timeout, signingkey, paymentrawtx);
 #else
     return CallXRouterUrl(host, port, url, data, timeout, signingkey, serverkey, paymentrawtx);
-#endif // ENABLE_EVENTSSL
+#endif // XROUTER_USE_TLS
 }
 
 } // namespace xrouter
@@ -11,10 +11,12 @@
 #include <bloom.h>
 #include <keystore.h>
 #include <net.h>
+#include <net_processing.h>
 #include <script/standard.h>
 #include <servicenode/servicenodemgr.h>
 #include <shutdown.h>
 #include <univalue.h>
+#include <util/system.h>
 
 #include <chrono>
 #include <iostream>
@@ -32,8 +34,6 @@
 #include <openssl/engine.h>
 #endif // ENABLE_EVENTSSL
 
-extern void Misbehaving(NodeId nodeid, int howmuch, const std::string& message="") EXCLUSIVE_LOCKS_REQUIRED(cs_main); // declared in net_processing.cpp
-
 //*****************************************************************************
 //*****************************************************************************
 namespace xbridge{
@@ -49,6 +49,7 @@ bool PushXRouterMessage(CNode *pnode, const T & message) {
     g_connman->PushMessage(pnode, msgMaker.Make(NetMsgType::XROUTER, message));
     return true;
 }
+template bool PushXRouterMessage<std::vector<unsigned char>>(CNode *pnode, const std::vector<unsigned char> & message);
 
 /**
  * Return a copy of nodes, with incremented reference count.
@@ -99,6 +100,16 @@ bool App::createConf(const boost::filesystem::path & confDir, const bool & skipP
     return xrouter::createConf(confDir, skipPlugins);
 }
 
+/** Service node response times, see QueryMgr::latencyStats */
+static fs::path latencyStatsPath() {
+    return GetDataDir() / "xrlatency.dat";
+}
+
+/** Service node xrouter configs, see ConfigCache */
+static fs::path configCachePath() {
+    return GetDataDir() / "xrconfigs.dat";
+}
+
 //*****************************************************************************
 //*****************************************************************************
 bool App::init(const boost::filesystem::path & xrouterDir)
@@ -163,11 +174,21 @@ bool App::start()
     } else if (!initKeyPair()) // init on regular xrouter clients (non-snodes)
         return false;
 
+    if (fs::exists(latencyStatsPath()) && !queryMgr.loadLatencyStats(latencyStatsPath()))
+        ERR() << "Failed to read service node response times from " << latencyStatsPath().string();
+    if (fs::exists(configCachePath()) && !configCache.load(configCachePath()))
+        ERR() << "Failed to read service node configs from " << configCachePath().string();
+
     {
         LOCK(mu);
         xrouterIsReady = true;
     }
 
+    // Pings received before xrouter was ready were not processed, configs that did not
+    // change since the last run are taken from the config cache.
+    for (const auto & snode : sn::ServiceNodeMgr::instance().list())
+        processConfigMessage(snode);
+
     stopped = false;
     return true;
 }
@@ -399,24 +420,19 @@ bool App::openConnections(enum XRouterCommand command, const std::string & servi
 
     // Check if existing snode connections have what we need
     std::set<NodeAddr> snodesConnected;
-    for (auto & s : snodes) {
-        const auto & snodeAddr = s.getHostPort();
+    const auto serviceSnodes = sn::ServiceNodeMgr::instance().getSnodesWithService(fqServiceAdjusted); // running only
+    for (const auto & s : serviceSnodes) {
+        const auto & snodeAddr = s->getHostPort();
         if (!nodec.count(snodeAddr)) // skip non-connected nodes
             continue;
 
-        if (!s.running()) // skip non-running snodes
-            continue;
-
-        if (s.isEXRCompatible()) // skip EXR snodes
+        if (s->isEXRCompatible()) // skip EXR snodes
             continue;
 
         if (connectedSnodes.count(snodeAddr)) // skip already selected nodes
             continue;
 
-        if (!s.hasService(xr)) // has xrouter
-            continue;
-
-        if (!s.hasService(fqServiceAdjusted)) // has the service
+        if (!s->hasService(xr)) // has xrouter
             continue;
 
         if (hasConfig(snodeAddr)) // has config, count it
@@ -575,6 +591,13 @@ bool App::stop(const bool safeCleanup)
         return true;
     stopped = true;
 
+    ClearXRouterConnections();
+    queryCache.clear();
+    if (isReady() && !queryMgr.saveLatencyStats(latencyStatsPath()))
+        ERR() << "Failed to save service node response times to " << latencyStatsPath().string();
+    if (isReady() && !configCache.save(configCachePath()))
+        ERR() << "Failed to save service node configs to " << configCachePath().string();
+
 #ifdef ENABLE_EVENTSSL
     ENGINE_cleanup();
     ERR_free_strings();
@@ -823,6 +846,58 @@ bool App::processReply(CNode *node, XRouterPacketPtr packet, CValidationState &
     return true;
 }
 
+bool App::processReplyChunk(CNode *node, XRouterPacketPtr packet, CValidationState & state)
+{
+    const auto & uuid = packet->suuid();
+    const auto & nodeAddr = node->GetAddrName();
+
+    // Do not process if we aren't expecting a result. Also prevent reply malleability (only first reply is accepted)
+    if (!queryMgr.hasQuery(uuid, nodeAddr) || queryMgr.hasReply(uuid, nodeAddr))
+        return false; // done, nothing found
+
+    // Verify servicenode response, each chunk is signed
+    std::vector<unsigned char> spubkey;
+    if (!servicenodePubKey(nodeAddr, spubkey) || !packet->verify(spubkey)) {
+        state.DoS(20, error("XRouter: unsigned packet or signature error"), REJECT_INVALID, "xrouter-error");
+        return false;
+    }
+
+    std::string reply;
+    uint32_t index{0}, flags{0};
+    if (packet->size() < sizeof(index) + sizeof(flags)) {
+        state.DoS(10, error("XRouter: bad reply chunk"), REJECT_INVALID, "xrouter-error");
+        return false;
+    }
+    memcpy(&index, packet->data(), sizeof(index));
+    memcpy(&flags, packet->data() + sizeof(index), sizeof(flags));
+    std::string data(reinterpret_cast<const char *>(packet->data()) + sizeof(index) + sizeof(flags),
+                     packet->size() - sizeof(index) - sizeof(flags));
+
+    if (flags & xrChunkAbort) // error reply
+        reply = std::move(data);
+    else {
+        const auto status = queryMgr.addReplyChunk(uuid, nodeAddr, index, flags & xrChunkLast, std::move(data), reply);
+        if (status == QueryMgr::CHUNK_PENDING)
+            return true;
+        if (status != QueryMgr::CHUNK_COMPLETE) {
+            const bool tooLarge = status == QueryMgr::CHUNK_TOO_LARGE;
+            checkSnodeBan(nodeAddr, queryMgr.updateScore(nodeAddr, -5));
+            Object error;
+            error.emplace_back("error", tooLarge ? "Reply exceeds maxreplysize" : "Bad reply chunk from node " + nodeAddr);
+            error.emplace_back("code", tooLarge ? xrouter::REPLY_TOO_LARGE : xrouter::BAD_REQUEST);
+            reply = json_spirit::write_string(Value(error), true);
+        }
+    }
+
+    // Store the reply
+    queryMgr.addReply(uuid, nodeAddr, reply);
+    queryMgr.purge(uuid, nodeAddr);
+
+    LOG() << "Received chunked reply to query " << uuid << " from node " << nodeAddr << ", " << reply.size() << " bytes";
+
+    return true;
+}
+
 bool App::processConfigReply(CNode *node, XRouterPacketPtr packet, CValidationState & state)
 {
     const auto & uuid = packet->suuid();
@@ -845,16 +920,14 @@ bool App::processConfigReply(CNode *node, XRouterPacketPtr packet, CValidationSt
     std::string reply((const char *)packet->data()+offset);
     offset += reply.size() + 1;
 
-    try {
-        Value reply_val;
-        read_string(reply, reply_val);
-        Object reply_obj = reply_val.get_obj();
-        std::string config = find_value(reply_obj, "config").get_str();
-        Object plugins = find_value(reply_obj, "plugins").get_obj();
-
-        auto settings = std::make_shared<XRouterSettings>(CPubKey(spubkey.begin(), spubkey.end()), false); // not our config
-        auto configInit = settings->init(config);
-        if (!configInit) {
+    // Only parse the config if it changed since it was last seen
+    const CPubKey pubkey(spubkey.begin(), spubkey.end());
+    const auto & hash = ConfigCache::configHash(reply, snode.getTier());
+    auto settings = configCache.get(pubkey, hash);
+    if (!settings) {
+        int badPlugins{0};
+        settings = ConfigCache::parse(pubkey, reply, snode.getTier(), badPlugins);
+        if (!settings) {
             ERR() << "Failed to read config on query " << uuid << " from node " << nodeAddr;
             checkSnodeBan(nodeAddr, queryMgr.updateScore(nodeAddr, -10));
             reply = "Failed to parse config from XRouter node " + nodeAddr + "\n" + reply;
@@ -862,34 +935,18 @@ bool App::processConfigReply(CNode *node, XRouterPacketPtr packet, CValidationSt
             queryMgr.purge(uuid, nodeAddr);
             return false;
         }
-
-        for (const auto & plugin : plugins) {
-            try {
-                auto psettings = std::make_shared<XRouterPluginSettings>(false); // not our config
-                psettings->read(plugin.value_.get_str());
-                // Exclude open tier paid services
-                if (!(snode.getTier() == sn::ServiceNode::OPEN && psettings->fee() > std::numeric_limits<double>::epsilon()))
-                    settings->addPlugin(plugin.name_, psettings);
-            } catch (...) {
-                ERR() << "Failed to read plugin " << plugin.name_ << " on query " << uuid << " from node " << nodeAddr;
-                checkSnodeBan(nodeAddr, queryMgr.updateScore(nodeAddr, -2));
-            }
+        if (badPlugins > 0) {
+            ERR() << "Failed to read " << badPlugins << " plugin(s) on query " << uuid << " from node " << nodeAddr;
+            checkSnodeBan(nodeAddr, queryMgr.updateScore(nodeAddr, -2 * badPlugins));
         }
-
-        // Update settings for node
-        updateConfig(snode, settings);
-        queryMgr.addReply(uuid, nodeAddr, reply);
-        queryMgr.purge(uuid, nodeAddr);
-
-    } catch (...) {
-        ERR() << "Failed to read config on query " << uuid << " from node " << nodeAddr;
-        checkSnodeBan(nodeAddr, queryMgr.updateScore(nodeAddr, -10));
-        reply = "Failed to parse config from XRouter node " + nodeAddr + "\n" + reply;
-        queryMgr.addReply(uuid, nodeAddr, reply);
-        queryMgr.purge(uuid, nodeAddr);
-        return false;
+        configCache.put(pubkey, hash, snode.getTier(), reply, settings);
     }
 
+    // Update settings for node
+    updateConfig(snode, settings);
+    queryMgr.addReply(uuid, nodeAddr, reply);
+    queryMgr.purge(uuid, nodeAddr);
+
     LOG() << "Received reply to query " << uuid << " from node " << nodeAddr << "\n" << reply;
 
     return true;
@@ -900,37 +957,18 @@ bool App::processConfigMessage(const sn::ServiceNode & snode) {
     if (smgr.hasActiveSn() && smgr.getActiveSn().key.GetPubKey() == snode.getSnodePubKey())
         return false; // do not process own config
 
+    // Pings embed the config, it is only parsed when its hash changes
     const auto & rawconfig = snode.getConfig("xrouter");
-    UniValue uv;
-    if (!uv.read(rawconfig))
-        return false;
-
-    auto settings = std::make_shared<XRouterSettings>(snode.getSnodePubKey(), false); // not our config
-    try {
-        const auto uvconf = find_value(uv, "config");
-        if (uvconf.isNull() || !uvconf.isStr())
-            return false;
-        if (!settings->init(uvconf.get_str()))
+    const auto & hash = ConfigCache::configHash(rawconfig, snode.getTier());
+    auto settings = configCache.get(snode.getSnodePubKey(), hash);
+    if (!settings) {
+        int badPlugins{0};
+        settings = ConfigCache::parse(snode.getSnodePubKey(), rawconfig, snode.getTier(), badPlugins);
+        if (!settings)
             return false;
-    } catch (...) {
-        return false;
-    }
-
-    const auto & plugins = find_value(uv, "plugins");
-    if (!plugins.isNull()) {
-        std::map<std::string, UniValue> kv; plugins.getObjMap(kv);
-        for (const auto & item : kv) {
-            const auto & plugin = item.first;
-            const auto & config = item.second.get_str();
-            try {
-                auto psettings = std::make_shared<XRouterPluginSettings>(false); // not our config
-                psettings->read(config);
-                // Exclude open tier paid services
-                if (!(snode.getTier() == sn::ServiceNode::OPEN && psettings->fee() > std::numeric_limits<double>::epsilon()))
-                    settings->addPlugin(plugin, psettings);
-            } catch (...) { }
-        }
-    }
+        configCache.put(snode.getSnodePubKey(), hash, snode.getTier(), rawconfig, settings);
+    } else if (getConfig(snode.getHostPort()) == settings)
+        return true; // config unchanged
 
     // Update settings for node
     updateConfig(snode, settings);
@@ -1011,6 +1049,8 @@ void App::onMessageReceived(CNode* node, const std::vector<unsigned char> & mess
                 processInvalid(node, packet, state);
             } else if (command == xrReply) { // Process replies
                 processReply(node, packet, state);
+            } else if (command == xrReplyChunk) { // Process chunks of large replies
+                processReplyChunk(node, packet, state);
             } else if (command == xrConfigReply) { // Process config replies
                 processConfigReply(node, packet, state);
             } else if (canListen() && server->isStarted()) { // Process server requests
@@ -1039,6 +1079,24 @@ void App::onMessageReceived(CNode* node, const std::vector<unsigned char> & mess
 //*****************************************************************************
 std::string App::xrouterCall(enum XRouterCommand command, std::string & uuidRet, const std::string & fqServiceName,
                              const int & confirmations, const UniValue & params)
+{
+    // Plugins may have side effects, run each of their calls and each transaction submission
+    std::string service;
+    if (!isEnabled() || !isReady() || command == xrService || command == xrSendTransaction
+        || !removeNamespace(fqServiceName, service))
+        return xrouterQuery(command, uuidRet, fqServiceName, confirmations, params);
+
+    const auto & key = QueryCache::makeKey(XRouterCommand_ToString(command), fqServiceName, confirmations, params.write());
+    const int ttl = xrsettings->cacheTtl(command, service);
+    return queryCache.call(key, ttl, uuidRet, [&](std::string & uuid) -> std::string {
+        return xrouterQuery(command, uuid, fqServiceName, confirmations, params);
+    });
+}
+
+//*****************************************************************************
+//*****************************************************************************
+std::string App::xrouterQuery(enum XRouterCommand command, std::string & uuidRet, const std::string & fqServiceName,
+                              const int & confirmations, const UniValue & params)
 {
     const std::string & uuid = generateUUID();
     uuidRet = uuid; // set uuid
@@ -1075,6 +1133,18 @@ std::string App::xrouterCall(enum XRouterCommand command, std::string & uuidRet,
                     if (params.size() > 0 && !is_hash(params.getValues()[0].get_str()))
                         throw XRouterError("Incorrect hash: " + params.getValues()[0].get_str(), xrouter::INVALID_PARAMETERS);
                     break;
+                case xrGetBlockFilters:
+                    if (params.size() < 2)
+                        throw XRouterError("Missing block range for " + fqServiceName, xrouter::INVALID_PARAMETERS);
+                    for (const auto & p : params.getValues()) {
+                        if (!is_number(p.get_str()))
+                            throw XRouterError("Incorrect block number " + p.get_str() + " for " + fqServiceName, xrouter::INVALID_PARAMETERS);
+                    }
+                    break;
+                case xrGetBalance:
+                    if (params.empty() || params.getValues()[0].get_str().empty())
+                        throw XRouterError("Missing address for " + fqServiceName, xrouter::INVALID_PARAMETERS);
+                    break;
                 case xrGetBlocks:
                 case xrGetTransactions: {
                     if (params.empty())
@@ -1144,13 +1214,27 @@ std::string App::xrouterCall(enum XRouterCommand command, std::string & uuidRet,
         std::vector<sn::ServiceNode> listSelectedSnodes;
         for (auto & item : mapSelectedSnodes)
             listSelectedSnodes.push_back(item.second);
-        std::sort(listSelectedSnodes.begin(), listSelectedSnodes.end(), [this](const sn::ServiceNode & a, const sn::ServiceNode & b) {
+        // Prefer nodes in good standing that answered this service quickly before
+        std::map<NodeAddr, std::pair<int, double>> ranks;
+        for (auto & snode : listSelectedSnodes) {
+            const auto & addr = snode.getHostPort();
+            ranks[addr] = std::make_pair(queryMgr.getScore(addr), queryMgr.getLatency(addr, fqService));
+        }
+        std::sort(listSelectedSnodes.begin(), listSelectedSnodes.end(), [&ranks](const sn::ServiceNode & a, const sn::ServiceNode & b) {
             if (a.isEXRCompatible() && !b.isEXRCompatible())
                 return true;
             else if (!a.isEXRCompatible() && b.isEXRCompatible())
                 return false;
-            return queryMgr.getScore(a.getHostPort()) > queryMgr.getScore(b.getHostPort());
+            const auto & ra = ranks[a.getHostPort()];
+            const auto & rb = ranks[b.getHostPort()];
+            if ((ra.first < 0) != (rb.first < 0))
+                return rb.first < 0;
+            if (ra.second != rb.second)
+                return ra.second < rb.second;
+            return ra.first > rb.first;
         });
+        // Hedging queries one more node than required and uses the first replies
+        const int queryCount = confs + (xrsettings->hedge(command, service) ? 1 : 0);
         // Compose a final list of snodes to request. selectedNodes here should be sorted
         // ascending best to worst
         for (auto & snode : listSelectedSnodes) {
@@ -1179,7 +1263,7 @@ std::string App::xrouterCall(enum XRouterCommand command, std::string & uuidRet,
 
             queryNodes.push_back(snode);
             ++snodeCount;
-            if (snodeCount == confs)
+            if (snodeCount == queryCount)
                 break;
         }
 
@@ -1191,6 +1275,11 @@ std::string App::xrouterCall(enum XRouterCommand command, std::string & uuidRet,
         }
 
         const int timeout = xrsettings->commandTimeout(command, service);
+        // Large replies are received in chunks up to this size
+        const int maxReplySizeSetting = xrsettings->maxReplySize(command, service);
+        const uint32_t maxReplySize = maxReplySizeSetting > 0 ? static_cast<uint32_t>(maxReplySizeSetting)
+                                                              : std::numeric_limits<uint32_t>::max();
+        queryMgr.setMaxReplySize(uuid, maxReplySize);
         CKey clientKey; clientKey.Set(cprivkey.begin(), cprivkey.end(), true);
         boost::thread_group tg;
 
@@ -1203,7 +1292,7 @@ std::string App::xrouterCall(enum XRouterCommand command, std::string & uuidRet,
 
             // Record the node sending request to
             addQuery(uuid, addr);
-            queryMgr.addQuery(uuid, addr);
+            queryMgr.addQuery(uuid, addr, fqService);
 
             if (mapSelectedNodes.count(addr)) { // query via the blocknet network
                 auto pnode = mapSelectedNodes[addr];
@@ -1214,6 +1303,7 @@ std::string App::xrouterCall(enum XRouterCommand command, std::string & uuidRet,
                 packet.append(static_cast<uint32_t>(params.size()));
                 for (const auto & p : params.getValues())
                     packet.append(p.get_str());
+                packet.setMaxReplySize(maxReplySize);
                 packet.sign(cpubkey, cprivkey);
                 PushXRouterMessage(pnode, packet.body());
                 queryMgr.updateSentRequest(addr, fqService);
@@ -1223,7 +1313,7 @@ std::string App::xrouterCall(enum XRouterCommand command, std::string & uuidRet,
                 const auto & fqUrl = fqServiceToUrl((command == xrService) ? pluginCommandKey(service) // plugin
                                                        : walletCommandKey(service, commandStr, true)); // spv wallet
                 try {
-                    tg.create_thread([uuid,addr,snode,tls,fqUrl,params,feetx,timeout,&clientKey,this]() {
+                    tg.create_thread([uuid,addr,snode,tls,fqUrl,params,feetx,timeout,clientKey,this]() { // outlives the call if hedged or timed out
                         RenameThread("blocknet-xrclientrequest");
                         if (ShutdownRequested())
                             return;
@@ -1301,8 +1391,17 @@ std::string App::xrouterCall(enum XRouterCommand command, std::string & uuidRet,
                 }
         }
 
-        // Clean up
-        queryMgr.purge(uuid);
+        // Clean up, nodes that didn't reply by now are done. Once the quorum is met that's
+        // the hedged node, replies it sends later are dropped.
+        const auto unanswered = queryMgr.finish(uuid);
+        review.assign(unanswered.begin(), unanswered.end());
+
+        // Unlock the fee txs of the nodes that didn't reply
+        for (const auto & addr : review) {
+            auto it = feePaymentTxs.find(addr);
+            if (it != feePaymentTxs.end())
+                unlockOutputs(it->second);
+        }
 
         std::set<NodeAddr> failed;
 
@@ -1331,12 +1430,6 @@ std::string App::xrouterCall(enum XRouterCommand command, std::string & uuidRet,
                 snodeAddresses.insert(EncodeDestination(CTxDestination(s->getPaymentAddress())));
             }
 
-            // Unlock failed txs
-            for (const auto & addr : failed) { // unlock any fee txs
-                const auto & tx = feePaymentTxs[addr];
-                unlockOutputs(tx);
-            }
-
             const auto & nodes = boost::algorithm::join(snodeAddresses, ",");
             ERR() << "Failed to get response in time for query " << uuid << " Nodes failed to respond, penalizing: " << nodes;
         }
@@ -1493,6 +1586,14 @@ std::string App::getTransactionsBloomFilter(std::string & uuidRet, const std::st
     return this->xrouterCall(xrGetTxBloomFilter, uuidRet, currency, confirmations, uv);
 }
 
+std::string App::getBlockFilters(std::string & uuidRet, const std::string & currency, const int & confirmations, const int & startHeight, const int & stopHeight)
+{
+    auto uv = UniValue(UniValue::VARR);
+    uv.push_back(std::to_string(startHeight));
+    uv.push_back(std::to_string(stopHeight));
+    return this->xrouterCall(xrGetBlockFilters, uuidRet, currency, confirmations, uv);
+}
+
 std::string App::sendTransaction(std::string & uuidRet, const std::string & currency, const int & confirmations, const std::string & transaction)
 {
     auto uv = UniValue(UniValue::VARR);
@@ -1813,6 +1914,7 @@ bool App::reloadConfigs() {
         ERR() << "Failed to read xrouter config, missing \"host\" entry " << xrouterpath.string();
         return false;
     }
+    server->createPluginWorkers();
     return createConnectors();
 }
 
@@ -1845,6 +1947,10 @@ std::string App::getStatus() {
             plugins.emplace_back(p, pp->rawText());
     }
     result.emplace_back("plugins", plugins);
+    if (server)
+        result.emplace_back("pluginworkers", server->pluginWorkersStatus());
+    result.emplace_back("querycache", queryCache.status());
+    result.emplace_back("configcache", configCache.status());
 
     return json_spirit::write_string(Value(result), json_spirit::pretty_print, 8);
 }
@@ -7,6 +7,8 @@
 
 #include <xrouter/xrouterdef.h>
 #include <xrouter/xrouterpacket.h>
+#include <xrouter/xrouterconfigcache.h>
+#include <xrouter/xrouterquerycache.h>
 #include <xrouter/xrouterquerymgr.h>
 #include <xrouter/xrouterserver.h>
 #include <xrouter/xroutersettings.h>
@@ -152,7 +154,8 @@ public:
     std::string printConfigs();
 
     /**
-     * @brief send packet from client side with the selected command
+     * @brief send packet from client side with the selected command. Identical calls in progress
+     * share one query, see QueryCache.
      * @param command XRouter command code
      * @param uuidRet uuid of the request
      * @param service chain code (BTC, LTC etc)
@@ -253,6 +256,18 @@ public:
     std::string getTransactionsBloomFilter(std::string & uuidRet, const std::string & currency,
             const int & confirmations, const std::string & filter, const int & number);
 
+    /**
+     * @brief returns the BIP 157 basic block filters for a range of blocks
+     * @param uuidRet uuid of the request
+     * @param currency chain code (BTC, LTC etc)
+     * @param confirmations consensus number of snodes (must be at least 1)
+     * @param startHeight first block height
+     * @param stopHeight last block height (inclusive)
+     * @return json array with the filter and filter header of each block
+     */
+    std::string getBlockFilters(std::string & uuidRet, const std::string & currency,
+            const int & confirmations, const int & startHeight, const int & stopHeight);
+
     /**
      * @brief Returnst the block count at the specified time.
      * @param uuidRet uuid of the request
@@ -372,6 +387,15 @@ public:
      */
     bool processReply(CNode *node, XRouterPacketPtr packet, CValidationState & state);
 
+    /**
+     * @brief process a chunk of a large reply from service node on *client* side
+     * @param node Connection to node
+     * @param packet Xrouter packet received over the network
+     * @param state DOS state
+     * @return
+     */
+    bool processReplyChunk(CNode *node, XRouterPacketPtr packet, CValidationState & state);
+
     /**
      * @brief process reply about xrouter config contents
      * @param node Connection to node
@@ -534,6 +558,10 @@ public:
         return queryMgr.getScore(node);
     }
 
+    std::map<std::pair<NodeAddr, std::string>, LatencyStats> latencyStats(const std::string & service = "") {
+        return queryMgr.latencyStats(service);
+    }
+
 private:
     /**
      * @brief App - default contructor,
@@ -546,6 +574,12 @@ private:
      */
     virtual ~App();
 
+    /**
+     * @brief Selects, pays and queries the service nodes for a call, see xrouterCall.
+     */
+    std::string xrouterQuery(enum XRouterCommand command, std::string & uuidRet, const std::string & service,
+                             const int & confirmations, const UniValue & params);
+
     bool bestNode(const NodeAddr & a, const NodeAddr & b, const XRouterCommand & command, const std::string & service) {
         const auto & a_score = queryMgr.getScore(a);
         const auto & b_score = queryMgr.getScore(b);
@@ -761,6 +795,8 @@ private:
     std::vector<unsigned char> cprivkey;
 
     QueryMgr queryMgr;
+    QueryCache queryCache;
+    ConfigCache configCache;
     PendingConnectionMgr pendingConnMgr;
     std::atomic<bool> stopped{false};
 };
@@ -275,6 +275,7 @@ bool XRouterClient::stop(std::string & error) {
             g_connman->Stop();
         threadGroup.interrupt_all();
         threadGroup.join_all();
+        ClearXRouterConnections();
     } catch (std::exception & e) {
         error = strprintf("XRouter failed to gracefully stop the xrouter client: %s", e.what());
         fprintf(stderr, "Error: %s\n", error.c_str());
@@ -0,0 +1,200 @@
+// Copyright (c) 2020 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <xrouter/xrouterconfigcache.h>
+
+#include <clientversion.h>
+#include <hash.h>
+#include <netbase.h>
+#include <servicenode/servicenode.h>
+#include <streams.h>
+#include <univalue.h>
+#include <util/system.h>
+#include <util/time.h>
+
+#include <limits>
+
+namespace xrouter {
+
+constexpr int64_t ConfigCache::EXPIRY;
+constexpr int64_t ConfigCache::RESOLVE_TTL;
+
+uint256 ConfigCache::configHash(const std::string & rawconfig, const uint8_t tier) {
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << tier;
+    // Hash the contents rather than the json text, pings and config replies format
+    // the same config differently
+    UniValue uv;
+    if (!uv.read(rawconfig) || !uv.isObject()) {
+        ss << rawconfig;
+        return ss.GetHash();
+    }
+    const auto & conf = find_value(uv, "config");
+    ss << (conf.isStr() ? conf.get_str() : conf.write());
+    std::map<std::string, UniValue> plugins; find_value(uv, "plugins").getObjMap(plugins);
+    for (const auto & item : plugins)
+        ss << item.first << (item.second.isStr() ? item.second.get_str() : item.second.write());
+    return ss.GetHash();
+}
+
+std::shared_ptr<XRouterSettings> ConfigCache::parse(const CPubKey & pubkey, const std::string & rawconfig,
+                                                    const uint8_t tier, int & badPlugins)
+{
+    return parse(pubkey, rawconfig, tier, nullptr, badPlugins);
+}
+
+std::shared_ptr<XRouterSettings> ConfigCache::parse(const CPubKey & pubkey, const std::string & rawconfig,
+                                                    const uint8_t tier, const CService *resolvedAddr,
+                                                    int & badPlugins)
+{
+    UniValue uv;
+    if (!uv.read(rawconfig) || !uv.isObject())
+        return nullptr;
+
+    auto settings = std::make_shared<XRouterSettings>(pubkey, false); // not our config
+    try {
+        const auto & uvconf = find_value(uv, "config");
+        if (uvconf.isNull() || !uvconf.isStr())
+            return nullptr;
+        if (resolvedAddr ? !settings->init(uvconf.get_str(), *resolvedAddr) : !settings->init(uvconf.get_str()))
+            return nullptr;
+    } catch (...) {
+        return nullptr;
+    }
+
+    const auto & plugins = find_value(uv, "plugins");
+    if (plugins.isObject()) {
+        std::map<std::string, UniValue> kv; plugins.getObjMap(kv);
+        for (const auto & item : kv) {
+            try {
+                auto psettings = std::make_shared<XRouterPluginSettings>(false); // not our config
+                psettings->read(item.second.get_str());
+                // Exclude open tier paid services
+                if (!(tier == sn::ServiceNode::OPEN && psettings->fee() > std::numeric_limits<double>::epsilon()))
+                    settings->addPlugin(item.first, psettings);
+            } catch (...) {
+                ++badPlugins;
+            }
+        }
+    }
+
+    return settings;
+}
+
+bool ConfigCache::isHostname(XRouterSettings & settings) {
+    CNetAddr literal;
+    return !LookupHost(settings.host(xrDefault).c_str(), literal, false);
+}
+
+std::shared_ptr<XRouterSettings> ConfigCache::get(const CPubKey & pubkey, const uint256 & hash) {
+    LOCK(mu);
+    auto it = configs.find(pubkey);
+    if (it == configs.end() || it->second.hash != hash)
+        return nullptr;
+    auto & entry = it->second;
+    const int64_t now = GetTime();
+    // The address of a hostname may have changed since it was resolved, the caller parses
+    // the config again to resolve it
+    if (!entry.settings) { // loaded from disk
+        int badPlugins{0};
+        entry.settings = parse(pubkey, entry.rawconfig, entry.tier, &entry.addr, badPlugins);
+        if (!entry.settings || isHostname(*entry.settings)) {
+            configs.erase(it);
+            return nullptr;
+        }
+        ++parses;
+    } else if (entry.resolved > 0 && now - entry.resolved >= RESOLVE_TTL) {
+        configs.erase(it);
+        return nullptr;
+    } else
+        ++hits;
+    entry.lastSeen = now;
+    return entry.settings;
+}
+
+void ConfigCache::put(const CPubKey & pubkey, const uint256 & hash, const uint8_t tier,
+                      const std::string & rawconfig, const std::shared_ptr<XRouterSettings> & settings)
+{
+    if (!settings)
+        return;
+    LOCK(mu);
+    auto & entry = configs[pubkey];
+    entry.hash = hash;
+    entry.tier = tier;
+    entry.rawconfig = rawconfig;
+    entry.addr = settings->getAddr();
+    entry.lastSeen = GetTime();
+    entry.settings = settings;
+    entry.resolved = isHostname(*settings) ? entry.lastSeen : 0;
+    ++parses;
+}
+
+void ConfigCache::clear() {
+    LOCK(mu);
+    configs.clear();
+}
+
+json_spirit::Object ConfigCache::status() const {
+    LOCK(mu);
+    json_spirit::Object o;
+    o.emplace_back("configs", static_cast<int64_t>(configs.size()));
+    o.emplace_back("hits", static_cast<int64_t>(hits));
+    o.emplace_back("parses", static_cast<int64_t>(parses));
+    return o;
+}
+
+bool ConfigCache::save(const fs::path & path) const {
+    std::map<CPubKey, Entry> entries;
+    {
+        LOCK(mu);
+        entries = configs;
+    }
+    fs::path pathTmp = path;
+    pathTmp += ".new";
+    FILE *file = fsbridge::fopen(pathTmp, "wb");
+    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull())
+        return error("%s: Failed to open file %s", __func__, pathTmp.string());
+    try {
+        CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+        fileout << entries;
+        hasher << entries;
+        fileout << hasher.GetHash();
+    } catch (const std::exception & e) {
+        return error("%s: Serialize or I/O error - %s", __func__, e.what());
+    }
+    if (!FileCommit(fileout.Get()))
+        return error("%s: Failed to flush file %s", __func__, pathTmp.string());
+    fileout.fclose();
+    if (!RenameOver(pathTmp, path))
+        return error("%s: Rename-into-place failed", __func__);
+    return true;
+}
+
+bool ConfigCache::load(const fs::path & path) {
+    FILE *file = fsbridge::fopen(path, "rb");
+    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return false;
+    std::map<CPubKey, Entry> entries;
+    try {
+        CHashVerifier<CAutoFile> verifier(&filein);
+        verifier >> entries;
+        uint256 hash;
+        filein >> hash;
+        if (hash != verifier.GetHash())
+            return error("%s: Checksum mismatch, data corrupted", __func__);
+    } catch (const std::exception & e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+    const int64_t now = GetTime();
+    LOCK(mu);
+    for (auto & item : entries) {
+        if (now - item.second.lastSeen < EXPIRY && !configs.count(item.first))
+            configs[item.first] = std::move(item.second);
+    }
+    return true;
+}
+
+} // namespace xrouter
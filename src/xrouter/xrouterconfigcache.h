@@ -0,0 +1,128 @@
+// Copyright (c) 2020 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BLOCKNET_XROUTER_XROUTERCONFIGCACHE_H
+#define BLOCKNET_XROUTER_XROUTERCONFIGCACHE_H
+
+#include <fs.h>
+#include <netaddress.h>
+#include <pubkey.h>
+#include <serialize.h>
+#include <sync.h>
+#include <uint256.h>
+#include <xrouter/xroutersettings.h>
+
+#include <json/json_spirit.h>
+
+#include <map>
+#include <memory>
+#include <string>
+
+namespace xrouter {
+
+/**
+ * Parsed service node xrouter configs by snode pubkey and config hash. Service nodes embed
+ * their config in every ping, the config is only parsed (and its host resolved) when the
+ * hash of the embedded config changes. The raw configs and resolved hosts are persisted so
+ * that configs seen before a restart do not have to be fetched again. Hosts that are IP
+ * addresses are reused for as long as the config is unchanged, hostnames are looked up again
+ * when their address is older than RESOLVE_TTL and on first use after a restart.
+ */
+class ConfigCache {
+public:
+    /** Configs not seen for this many seconds are dropped when the cache is loaded */
+    static constexpr int64_t EXPIRY = 30 * 24 * 60 * 60;
+    /** Seconds the resolved address of a hostname is reused before it is looked up again */
+    static constexpr int64_t RESOLVE_TTL = 10 * 60;
+
+    /**
+     * Version of a service node config, the tier is included because open tier service
+     * nodes have their paid plugins removed. The same config sent in a ping or in a config
+     * reply has the same hash.
+     * @param rawconfig xrouter config json {"config":"...","plugins":{...}}
+     * @param tier service node tier
+     */
+    static uint256 configHash(const std::string & rawconfig, uint8_t tier);
+
+    /**
+     * Parses a service node config. Returns nullptr if the main config is invalid, plugins
+     * that fail to parse are skipped and counted in badPlugins.
+     * @param pubkey service node pubkey
+     * @param rawconfig xrouter config json {"config":"...","plugins":{...}}
+     * @param tier service node tier, paid plugins are excluded on the open tier
+     * @param badPlugins incremented for every plugin that failed to parse
+     */
+    static std::shared_ptr<XRouterSettings> parse(const CPubKey & pubkey, const std::string & rawconfig,
+                                                  uint8_t tier, int & badPlugins);
+
+    /**
+     * Returns the parsed config of the service node if its current version has the hash,
+     * otherwise nullptr. Configs loaded from disk are parsed on first use. nullptr is also
+     * returned if the host is a hostname resolved more than RESOLVE_TTL ago (or before a
+     * restart), the caller then parses the config and resolves the host outside the cache lock.
+     */
+    std::shared_ptr<XRouterSettings> get(const CPubKey & pubkey, const uint256 & hash);
+
+    /**
+     * Stores the parsed config as the current version of the service node config.
+     */
+    void put(const CPubKey & pubkey, const uint256 & hash, uint8_t tier, const std::string & rawconfig,
+             const std::shared_ptr<XRouterSettings> & settings);
+
+    /**
+     * Removes all configs.
+     */
+    void clear();
+
+    /**
+     * Returns the number of configs and the hit and parse counters.
+     */
+    json_spirit::Object status() const;
+
+    /**
+     * Writes the raw configs and resolved hosts to the file.
+     */
+    bool save(const fs::path & path) const;
+
+    /**
+     * Reads the configs written by save(), configs older than EXPIRY are skipped.
+     */
+    bool load(const fs::path & path);
+
+private:
+    struct Entry {
+        uint256 hash;
+        uint8_t tier{0};
+        std::string rawconfig;
+        CService addr;
+        int64_t lastSeen{0};
+        std::shared_ptr<XRouterSettings> settings; // in-memory only
+        int64_t resolved{0}; // in-memory only, when the hostname was resolved (0 for IP hosts)
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action) {
+            READWRITE(hash);
+            READWRITE(tier);
+            READWRITE(rawconfig);
+            READWRITE(addr);
+            READWRITE(lastSeen);
+        }
+    };
+
+    static std::shared_ptr<XRouterSettings> parse(const CPubKey & pubkey, const std::string & rawconfig,
+                                                  uint8_t tier, const CService *resolvedAddr, int & badPlugins);
+    static bool isHostname(XRouterSettings & settings);
+
+    mutable Mutex mu;
+    std::map<CPubKey, Entry> configs;
+
+    uint64_t hits{0};
+    uint64_t parses{0};
+};
+
+} // namespace xrouter
+
+#endif // BLOCKNET_XROUTER_XROUTERCONFIGCACHE_H
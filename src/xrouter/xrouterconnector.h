@@ -166,6 +166,7 @@ public:
     virtual std::string              getTransaction(const std::string & hash) const = 0;
     virtual std::vector<std::string> getTransactions(const std::vector<std::string> & txHashes) const = 0;
     virtual std::vector<std::string> getTransactionsBloomFilter(const int & number, CDataStream & stream, const int & fetchlimit=0) const = 0;
+    virtual std::vector<std::string> getBlockFilters(const int & startHeight, const int & stopHeight) const = 0;
     virtual std::string              sendTransaction(const std::string & transaction) const = 0;
     virtual std::string              decodeRawTransaction(const std::string & hex) const = 0;
     virtual std::string              convertTimeToBlockCount(const std::string & timestamp) const = 0;
@@ -7,6 +7,7 @@
 #include <xrouter/xroutererror.h>
 
 #include <bloom.h>
+#include <util/moneystr.h>
 #include <util/strencodings.h>
 
 #include <json/json_spirit.h>
@@ -204,6 +205,44 @@ std::vector<std::string> BtcWalletConnectorXRouter::getTransactionsBloomFilter(c
     return results;
 }
 
+std::vector<std::string> BtcWalletConnectorXRouter::getBlockFilters(const int & startHeight, const int & stopHeight) const
+{
+    static const std::string commandGBH("getblockhash");
+    static const std::string commandGBF("getblockfilter");
+
+    // Filters come from the wallet's BIP 157 block filter index (-blockfilterindex),
+    // clients match their scripts against them locally.
+    std::vector<std::string> results;
+    for (int id = startHeight; id <= stopHeight; ++id) {
+        const auto & blockHashObj = CallRPC(m_user, m_passwd, m_ip, m_port, commandGBH, { id }, jsonver, contenttype);
+        if (hasError(blockHashObj)) {
+            results.push_back(blockHashObj);
+            continue;
+        }
+        const auto & hash = getResult(blockHashObj).get_str();
+
+        const auto & filterObj = CallRPC(m_user, m_passwd, m_ip, m_port, commandGBF, { hash }, jsonver, contenttype);
+        if (hasError(filterObj)) {
+            results.push_back(filterObj);
+            continue;
+        }
+        const auto & filter = getResult(filterObj);
+        if (filter.type() != obj_type) {
+            results.push_back(filterObj);
+            continue;
+        }
+
+        Object o;
+        o.emplace_back("height", id);
+        o.emplace_back("hash", hash);
+        o.emplace_back("filter", find_value(filter.get_obj(), "filter"));
+        o.emplace_back("header", find_value(filter.get_obj(), "header"));
+        results.push_back(write_string(Value(o), false));
+    }
+
+    return results;
+}
+
 std::string BtcWalletConnectorXRouter::sendTransaction(const std::string & transaction) const
 {
     static const std::string command("sendrawtransaction");
@@ -284,7 +323,22 @@ std::string BtcWalletConnectorXRouter::convertTimeToBlockCount(const std::string
 
 std::string BtcWalletConnectorXRouter::getBalance(const std::string & address) const
 {
-    return "0"; // TODO Implement
+    static const std::string command("getaddressbalance");
+
+    // Served from the wallet's address index (-addressindex), which reports satoshis.
+    Object request;
+    request.emplace_back("addresses", Array{ address });
+    const auto & balanceObj = CallRPC(m_user, m_passwd, m_ip, m_port, command, { request }, jsonver, contenttype);
+    if (hasError(balanceObj))
+        return checkError(balanceObj, BAD_REQUEST);
+
+    const auto & result = getResult(balanceObj);
+    if (result.type() != obj_type)
+        return balanceObj;
+    const Value & balance = find_value(result.get_obj(), "balance");
+    if (balance.type() != int_type)
+        return balanceObj;
+    return FormatMoney(balance.get_int64());
 }
 
 } // namespace xrouter
@@ -23,6 +23,7 @@ public:
     std::string              getTransaction(const std::string & hash) const override;
     std::vector<std::string> getTransactions(const std::vector<std::string> & txHashes) const override;
     std::vector<std::string> getTransactionsBloomFilter(const int & number, CDataStream & stream, const int & fetchlimit) const override;
+    std::vector<std::string> getBlockFilters(const int & startHeight, const int & stopHeight) const override;
     std::string              sendTransaction(const std::string & transaction) const override;
     std::string              decodeRawTransaction(const std::string & hex) const override;
     std::string              convertTimeToBlockCount(const std::string & timestamp) const override;
@@ -26,6 +26,7 @@ public:
     std::string              getTransaction(const std::string & hash) const override;
     std::vector<std::string> getTransactions(const std::vector<std::string> & txHashes) const override;
     std::vector<std::string> getTransactionsBloomFilter(const int &, CDataStream &, const int & fetchlimit=0) const override;
+    std::vector<std::string> getBlockFilters(const int &, const int &) const override;
     std::string              sendTransaction(const std::string & rawtx) const override;
     std::string              decodeRawTransaction(const std::string & hex) const override;
     std::string              convertTimeToBlockCount(const std::string & timestamp) const override;
@@ -15,5 +15,8 @@
 #define XROUTER_DEFAULT_FETCHLIMIT 50
 #define XROUTER_DEFAULT_CONFIRMATIONS 1
 #define XROUTER_TIMER_SECONDS 15
+#define XROUTER_DEFAULT_MAX_REPLY_SIZE 100000000 // bytes
+#define XROUTER_REPLY_CHUNK_SIZE 1000000         // bytes, well below the network message size limit
+#define XROUTER_REPLY_CHUNK_STALL_TIMEOUT 30     // seconds a client may leave its send buffer full
 
 #endif // BLOCKNET_XROUTER_XROUTERDEF_H
@@ -29,6 +29,7 @@ namespace xrouter
         TOO_MANY_REQUESTS       = 1034,
         NO_REPLIES              = 1035,
         BAD_SIGNATURE           = 1036,
+        REPLY_TOO_LARGE         = 1037,
     };
 
     class XRouterError : public std::exception {
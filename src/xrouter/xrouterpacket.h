@@ -31,6 +31,7 @@ enum XRouterCommand
     xrGetConfig                      = 3,
     xrConfigReply                    = 4,
     xrDefault                        = 5,
+    xrReplyChunk                     = 6,
 
     xrGetBlockCount                  = 20,
     xrGetBlockHash                   = 21,
@@ -40,6 +41,7 @@ enum XRouterCommand
 
     xrGetTxBloomFilter               = 40,
     xrGenerateBloomFilter            = 41,
+    xrGetBlockFilters                = 42,
 
     xrGetBlocks                      = 50,
     xrGetTransactions                = 51,
@@ -66,6 +68,7 @@ inline const char* XRouterCommand_ToString(enum XRouterCommand c)
         case xrGetTransaction             : return "xrGetTransaction";
         case xrSendTransaction            : return "xrSendTransaction";
         case xrGetTxBloomFilter           : return "xrGetTxBloomFilter";
+        case xrGetBlockFilters            : return "xrGetBlockFilters";
         case xrGenerateBloomFilter        : return "xrGenerateBloomFilter";
         case xrGetBlocks                  : return "xrGetBlocks";
         case xrGetTransactions            : return "xrGetTransactions";
@@ -74,6 +77,7 @@ inline const char* XRouterCommand_ToString(enum XRouterCommand c)
         case xrGetBalance                 : return "xrGetBalance";
         case xrService                    : return "xrs";
         case xrDefault                    : return "";
+        case xrReplyChunk                 : return "xrReplyChunk";
         default: {
             char * s = nullptr;
             sprintf(s, "[Unknown XRouterCommand] %u", c);
@@ -96,12 +100,14 @@ inline bool XRouterCommand_IsValid(const char* c)
            XRouterCommand_ToString(xrSendTransaction)            == c ||
            XRouterCommand_ToString(xrGetTxBloomFilter)           == c ||
            XRouterCommand_ToString(xrGenerateBloomFilter)        == c ||
+           XRouterCommand_ToString(xrGetBlockFilters)            == c ||
            XRouterCommand_ToString(xrGetBlocks)                  == c ||
            XRouterCommand_ToString(xrGetTransactions)            == c ||
            XRouterCommand_ToString(xrGetBlockAtTime)             == c ||
            XRouterCommand_ToString(xrDecodeRawTransaction)       == c ||
            XRouterCommand_ToString(xrGetBalance)                 == c ||
            XRouterCommand_ToString(xrDefault)                    == c ||
+           XRouterCommand_ToString(xrReplyChunk)                 == c ||
            XRouterCommand_ToString(xrService)                    == c;
 };
 
@@ -114,6 +120,7 @@ inline XRouterCommand XRouterCommand_FromString(const std::string & command)
     if (strcmp(XRouterCommand_ToString(xrGetReply)             , c) == 0) return xrGetReply;
     if (strcmp(XRouterCommand_ToString(xrGetConfig)            , c) == 0) return xrGetConfig;
     if (strcmp(XRouterCommand_ToString(xrConfigReply)          , c) == 0) return xrConfigReply;
+    if (strcmp(XRouterCommand_ToString(xrReplyChunk)           , c) == 0) return xrReplyChunk;
     if (strcmp(XRouterCommand_ToString(xrGetBlockCount)        , c) == 0) return xrGetBlockCount;
     if (strcmp(XRouterCommand_ToString(xrGetBlockHash)         , c) == 0) return xrGetBlockHash;
     if (strcmp(XRouterCommand_ToString(xrGetBlock)             , c) == 0) return xrGetBlock;
@@ -121,6 +128,7 @@ inline XRouterCommand XRouterCommand_FromString(const std::string & command)
     if (strcmp(XRouterCommand_ToString(xrSendTransaction)      , c) == 0) return xrSendTransaction;
     if (strcmp(XRouterCommand_ToString(xrGetTxBloomFilter)     , c) == 0) return xrGetTxBloomFilter;
     if (strcmp(XRouterCommand_ToString(xrGenerateBloomFilter)  , c) == 0) return xrGenerateBloomFilter;
+    if (strcmp(XRouterCommand_ToString(xrGetBlockFilters)      , c) == 0) return xrGetBlockFilters;
     if (strcmp(XRouterCommand_ToString(xrGetBlocks)            , c) == 0) return xrGetBlocks;
     if (strcmp(XRouterCommand_ToString(xrGetTransactions)      , c) == 0) return xrGetTransactions;
     if (strcmp(XRouterCommand_ToString(xrGetBlockAtTime)       , c) == 0) return xrGetBlockAtTime;
@@ -141,17 +149,31 @@ inline std::set<XRouterCommand> XRouterCommands()
     r.insert(xrSendTransaction);
 //    r.insert(xrGetTxBloomFilter);
 //    r.insert(xrGenerateBloomFilter);
+    r.insert(xrGetBlockFilters);
     r.insert(xrGetBlocks);
     r.insert(xrGetTransactions);
 //    r.insert(xrGetBlockAtTime);
     r.insert(xrDecodeRawTransaction);
-//    r.insert(xrGetBalance);
+    r.insert(xrGetBalance);
     return r;
 };
 
 //******************************************************************************
 //******************************************************************************
 
+//******************************************************************************
+// xrReplyChunk data, large replies are sent in several signed packets
+//
+// uint32_t index of the chunk, starting at 0
+// uint32_t flags, see XRouterChunkFlags
+// unsigned char * part of the reply, at most XROUTER_REPLY_CHUNK_SIZE bytes
+//******************************************************************************
+enum XRouterChunkFlags
+{
+    xrChunkLast                      = 1, // last chunk of the reply
+    xrChunkAbort                     = 2, // data is an error reply replacing the chunks sent before
+};
+
 //******************************************************************************
 // header 6*4+36+33+64 (157 bytes)
 //
@@ -159,7 +181,7 @@ inline std::set<XRouterCommand> XRouterCommands()
 // uint32_t command
 // uint32_t timestamp
 // uint32_t size
-// uint32_t reserved
+// uint32_t max reply size (queries), 0 if the client doesn't accept xrReplyChunk replies
 // uint32_t reserved
 // unsigned char * uuid
 // unsigned char * pubkey
@@ -220,6 +242,8 @@ public:
     const unsigned char * pubkey() const             { return pubkeyField(); }
     const std::vector<unsigned char> vpubkey() const { return std::vector<unsigned char>{pubkey(), pubkey()+pubkeySize}; }
     const unsigned char * signature() const          { return signatureField(); }
+    uint32_t maxReplySize() const                    { return maxReplySizeField(); }
+    void setMaxReplySize(const uint32_t size)        { maxReplySizeField() = size; }
 
     unsigned char * header()                         { return &m_body[0]; }
     unsigned char * data()                           { return &m_body[headerSize]; }
@@ -361,6 +385,8 @@ private:
     uint32_t const & timestampField() const      { return field32<2>(); }
     uint32_t &       sizeField()                 { return field32<3>(); }
     uint32_t const & sizeField() const           { return field32<3>(); }
+    uint32_t &       maxReplySizeField()         { return field32<4>(); }
+    uint32_t const & maxReplySizeField() const   { return field32<4>(); }
 
     unsigned char *       uuidField()            { return &m_body[versionSize + commandSize + timestampSize + packetSize + reservedSize]; }
     const unsigned char * uuidField() const      { return &m_body[versionSize + commandSize + timestampSize + packetSize + reservedSize]; }
@@ -530,10 +530,10 @@ bool XRouterPeerMgr::ProcessMessages(CNode* pfrom, std::atomic<bool>& interruptM
         return false;
     }
 
-    // If VERACK we're ready to ask for snode list
+    // If VERACK we're ready to ask for snode list, only the pings we don't already have are sent
     if (strCommand == NetMsgType::VERACK) {
         const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
-        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SNLIST));
+        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SNLIST, smgr.listDigest()));
     }
 
     return true;
@@ -0,0 +1,413 @@
+// Copyright (c) 2020 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <xrouter/xrouterpluginworker.h>
+
+#include <random.h>
+#include <tinyformat.h>
+#include <util/time.h>
+#include <xrouter/xroutererror.h>
+#include <xrouter/xrouterlogger.h>
+#include <xrouter/xrouterutils.h>
+
+#include <algorithm>
+
+#ifndef WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace xrouter {
+
+/** Replies larger than this are treated as broken framing */
+static constexpr size_t MAX_PLUGIN_REPLY_SIZE = 64 * 1024 * 1024;
+
+LatencyHistogram::LatencyHistogram() : counts(bucketBounds().size() + 1, 0) {}
+
+const std::vector<int64_t> & LatencyHistogram::bucketBounds() {
+    static const std::vector<int64_t> bounds{1, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000};
+    return bounds;
+}
+
+void LatencyHistogram::add(const int64_t ms) {
+    const auto & bounds = bucketBounds();
+    const auto i = std::upper_bound(bounds.begin(), bounds.end(), ms) - bounds.begin();
+    LOCK(mu);
+    ++counts[i];
+    ++total;
+    totalMs += ms;
+}
+
+json_spirit::Object LatencyHistogram::toJson() const {
+    const auto & bounds = bucketBounds();
+    LOCK(mu);
+    json_spirit::Object buckets;
+    for (size_t i = 0; i < bounds.size(); ++i)
+        buckets.emplace_back("<" + std::to_string(bounds[i]) + "ms", static_cast<int64_t>(counts[i]));
+    buckets.emplace_back(">=" + std::to_string(bounds.back()) + "ms", static_cast<int64_t>(counts.back()));
+    json_spirit::Object o;
+    o.emplace_back("count", static_cast<int64_t>(total));
+    o.emplace_back("avgms", total > 0 ? totalMs / static_cast<int64_t>(total) : 0);
+    o.emplace_back("buckets", buckets);
+    return o;
+}
+
+PluginWorker::PluginWorker(const std::string & cmd, const std::string & container)
+    : cmd(cmd), container(container),
+      pidFile(container.empty() ? "" : "/tmp/xrouter-worker-" + GetRandHash().GetHex().substr(0, 16) + ".pid") {}
+
+PluginWorker::~PluginWorker() {
+    stop();
+}
+
+#ifndef WIN32
+
+/** Upper bound of the descriptors closed in a new worker when there is no open files limit */
+static constexpr int MAX_INHERITED_FD = 65536;
+
+/** Quotes the string as a single shell word */
+static std::string shellQuote(const std::string & s) {
+    std::string r{"'"};
+    for (const char c : s) {
+        if (c == '\'')
+            r += "'\\''";
+        else
+            r += c;
+    }
+    return r + "'";
+}
+
+bool PluginWorker::start() {
+    stop();
+    int in[2], out[2];
+    if (pipe(in) != 0)
+        return false;
+    if (pipe(out) != 0) {
+        close(in[0]); close(in[1]);
+        return false;
+    }
+    // Other workers must not inherit our ends of the pipes, they would keep them open
+    fcntl(in[1], F_SETFD, FD_CLOEXEC);
+    fcntl(out[0], F_SETFD, FD_CLOEXEC);
+
+    // exec keeps the pid of the shell, the pid recorded in the container is the worker's
+    const std::string shell = container.empty()
+            ? cmd
+            : strprintf("docker exec -i %s sh -c %s", container,
+                        shellQuote("echo $$ > " + pidFile + " && exec sh -c " + shellQuote(cmd)));
+    // Prepared before forking, the child may only make async-signal-safe calls
+    struct rlimit rl;
+    const int maxfd = getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY
+            ? static_cast<int>(std::min<rlim_t>(rl.rlim_cur, MAX_INHERITED_FD))
+            : MAX_INHERITED_FD;
+
+    const int child = fork();
+    if (child < 0) {
+        close(in[0]); close(in[1]); close(out[0]); close(out[1]);
+        return false;
+    }
+    if (child == 0) {
+        // Own process group, stop() kills the processes spawned by the worker too
+        setpgid(0, 0);
+        dup2(in[0], STDIN_FILENO);
+        dup2(out[1], STDOUT_FILENO);
+        // Don't leak the node's sockets and files into the worker
+        for (int fd = STDERR_FILENO + 1; fd < maxfd; ++fd)
+            close(fd);
+        execl("/bin/sh", "sh", "-c", shell.c_str(), (char*)nullptr);
+        _exit(127);
+    }
+
+    setpgid(child, child); // also in the parent, stop() may run before the child gets scheduled
+    close(in[0]);
+    close(out[1]);
+    pid = child;
+    fdIn = in[1];
+    fdOut = out[0];
+    fcntl(fdIn, F_SETFL, fcntl(fdIn, F_GETFL) | O_NONBLOCK);
+    fcntl(fdOut, F_SETFL, fcntl(fdOut, F_GETFL) | O_NONBLOCK);
+    buffer.clear();
+    return true;
+}
+
+void PluginWorker::stop() {
+    if (fdIn >= 0)
+        close(fdIn);
+    if (fdOut >= 0)
+        close(fdOut);
+    fdIn = fdOut = -1;
+    const bool started = pid > 0;
+    if (started) {
+        kill(-pid, SIGKILL);
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+    }
+    pid = -1;
+    buffer.clear();
+    if (started && !container.empty()) {
+        // Killing the docker exec client leaves the worker running in the container
+        const auto script = strprintf("pid=$(cat %s 2>/dev/null) && { kill -9 -$pid 2>/dev/null || kill -9 $pid; }; rm -f %s",
+                                      pidFile, pidFile);
+        int exit{0};
+        try {
+            CallCMD(strprintf("docker exec %s sh -c %s", container, shellQuote(script)), exit);
+        } catch (...) {
+            exit = -1;
+        }
+        if (exit != 0)
+            ERR() << "Failed to stop the worker in container " << container << ": " << cmd;
+    }
+}
+
+bool PluginWorker::write(const std::string & data, const int64_t deadline, std::string & error, bool & timedOut) {
+    size_t written = 0;
+    while (written < data.size()) {
+        const auto n = ::write(fdIn, data.data() + written, data.size() - written);
+        if (n > 0) {
+            written += n;
+            continue;
+        }
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            error = strprintf("write failed: %s", strerror(errno));
+            return false;
+        }
+        const int64_t wait = deadline - GetTimeMillis();
+        if (wait <= 0) {
+            timedOut = true;
+            error = "timed out writing the request";
+            return false;
+        }
+        struct pollfd p{fdIn, POLLOUT, 0};
+        poll(&p, 1, static_cast<int>(wait));
+    }
+    return true;
+}
+
+bool PluginWorker::fill(const int64_t deadline, std::string & error, bool & timedOut) {
+    char buf[4096];
+    while (true) {
+        const auto r = ::read(fdOut, buf, sizeof(buf));
+        if (r > 0) {
+            buffer.append(buf, r);
+            return true;
+        }
+        if (r == 0) {
+            error = "worker exited";
+            return false;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            error = strprintf("read failed: %s", strerror(errno));
+            return false;
+        }
+        const int64_t wait = deadline - GetTimeMillis();
+        if (wait <= 0) {
+            timedOut = true;
+            error = "timed out waiting for the reply";
+            return false;
+        }
+        struct pollfd p{fdOut, POLLIN, 0};
+        poll(&p, 1, static_cast<int>(wait));
+    }
+}
+
+bool PluginWorker::read(const size_t n, const int64_t deadline, std::string & data, std::string & error, bool & timedOut) {
+    while (buffer.size() < n)
+        if (!fill(deadline, error, timedOut))
+            return false;
+    data = buffer.substr(0, n);
+    buffer.erase(0, n);
+    return true;
+}
+
+bool PluginWorker::readLine(const int64_t deadline, std::string & line, std::string & error, bool & timedOut) {
+    size_t pos;
+    while ((pos = buffer.find('\n')) == std::string::npos) {
+        // The length line holds at most 20 digits
+        if (buffer.size() > 20) {
+            error = "bad reply framing";
+            return false;
+        }
+        if (!fill(deadline, error, timedOut))
+            return false;
+    }
+    line = buffer.substr(0, pos);
+    buffer.erase(0, pos + 1);
+    return true;
+}
+
+bool PluginWorker::call(const std::string & request, const int timeout, std::string & reply, std::string & error, bool & timedOut) {
+    timedOut = false;
+    if (!running()) {
+        error = "worker is not running";
+        return false;
+    }
+    const int64_t deadline = GetTimeMillis() + timeout;
+    std::string line;
+    bool ok = write(std::to_string(request.size()) + "\n" + request, deadline, error, timedOut)
+           && readLine(deadline, line, error, timedOut);
+    if (ok) {
+        const bool digits = !line.empty() && std::all_of(line.begin(), line.end(), [](const char c) { return c >= '0' && c <= '9'; });
+        const auto size = digits && line.size() < 20 ? std::stoull(line) : MAX_PLUGIN_REPLY_SIZE + 1;
+        if (size > MAX_PLUGIN_REPLY_SIZE) {
+            error = "bad reply framing";
+            ok = false;
+        } else {
+            ok = read(size, deadline, reply, error, timedOut);
+        }
+    }
+    if (!ok)
+        stop();
+    return ok;
+}
+
+#else
+
+bool PluginWorker::start() {
+    return false;
+}
+
+void PluginWorker::stop() {}
+
+bool PluginWorker::call(const std::string & request, const int timeout, std::string & reply, std::string & error, bool & timedOut) {
+    timedOut = false;
+    error = "plugin workers are not supported on this platform";
+    return false;
+}
+
+#endif // WIN32
+
+PluginWorkerPool::PluginWorkerPool(const std::string & plugin, const std::string & cmd, const int nworkers,
+                                   const std::string & container)
+    : plugin(plugin), cmd(cmd), container(container), busy(nworkers, false), lastStart(nworkers, 0)
+{
+    for (int i = 0; i < nworkers; ++i) {
+        workers.emplace_back(new PluginWorker(cmd, container));
+        lastStart[i] = GetTimeMillis();
+        if (!workers.back()->start())
+            ERR() << "Failed to start worker " << i << " of plugin " << plugin << ": " << cmd;
+    }
+}
+
+PluginWorkerPool::~PluginWorkerPool() {
+    stop();
+}
+
+void PluginWorkerPool::stop() {
+    {
+        WAIT_LOCK(mu, lock);
+        stopped = true;
+        cond.notify_all();
+        // Calls in progress own their worker until they return
+        cond.wait(lock, [this]() { return std::none_of(busy.begin(), busy.end(), [](const bool b) { return b; }); });
+    }
+    // Not under the lock, stopping containerized workers runs docker exec
+    for (auto & w : workers)
+        w->stop();
+}
+
+std::string PluginWorkerPool::call(const std::string & request, const int timeout) {
+    const int64_t start = GetTimeMillis();
+    const int64_t deadline = start + timeout;
+    size_t i = 0;
+    bool restart{false};
+    {
+        WAIT_LOCK(mu, lock);
+        // Prefer running workers, crashed ones are restarted once their backoff elapsed
+        auto freeWorker = [this, &i]() -> bool {
+            const int64_t now = GetTimeMillis();
+            bool found{false};
+            for (size_t j = 0; j < busy.size(); ++j) {
+                if (busy[j])
+                    continue;
+                if (workers[j]->running()) {
+                    i = j;
+                    return true;
+                }
+                if (!found && now - lastStart[j] >= RESTART_BACKOFF_MS) {
+                    i = j;
+                    found = true;
+                }
+            }
+            return found;
+        };
+        while (!stopped && !freeWorker()) {
+            const int64_t wait = deadline - GetTimeMillis();
+            if (wait <= 0) {
+                ++timeouts;
+                throw XRouterError("Timed out waiting for a worker of plugin " + plugin, SERVER_TIMEOUT);
+            }
+            // Wake up periodically, a worker's backoff may elapse without a notification
+            cond.wait_for(lock, std::chrono::milliseconds(std::min<int64_t>(wait, 100)));
+        }
+        if (stopped)
+            throw XRouterError("Plugin " + plugin + " is not available", INTERNAL_SERVER_ERROR);
+        busy[i] = true;
+        ++calls;
+        restart = !workers[i]->running();
+        if (restart) {
+            lastStart[i] = GetTimeMillis();
+            ++restarts;
+        }
+    }
+
+    PluginWorker & worker = *workers[i];
+    std::string reply, error;
+    bool timedOut{false};
+    bool ok{false};
+    if (restart) {
+        LOG() << "Restarting worker " << i << " of plugin " << plugin;
+        if (!worker.start())
+            error = "failed to restart the worker";
+    }
+    if (worker.running())
+        ok = worker.call(request, static_cast<int>(std::max<int64_t>(deadline - GetTimeMillis(), 1)), reply, error, timedOut);
+    const int64_t elapsed = GetTimeMillis() - start;
+
+    {
+        LOCK(mu);
+        busy[i] = false;
+        if (!ok) {
+            ++failures;
+            if (timedOut)
+                ++timeouts;
+        }
+    }
+    cond.notify_all();
+
+    if (!ok) {
+        ERR() << "Worker " << i << " of plugin " << plugin << " failed: " << error;
+        if (timedOut)
+            throw XRouterError("Plugin " + plugin + " timed out", SERVER_TIMEOUT);
+        throw XRouterError("Failed to execute plugin " + plugin, INTERNAL_SERVER_ERROR);
+    }
+    latency.add(elapsed);
+    return reply;
+}
+
+json_spirit::Object PluginWorkerPool::status() const {
+    json_spirit::Object o;
+    {
+        LOCK(mu);
+        int running{0};
+        for (const auto & w : workers)
+            if (w->running())
+                ++running;
+        o.emplace_back("workers", static_cast<int>(workers.size()));
+        o.emplace_back("running", running);
+        o.emplace_back("calls", static_cast<int64_t>(calls));
+        o.emplace_back("failures", static_cast<int64_t>(failures));
+        o.emplace_back("timeouts", static_cast<int64_t>(timeouts));
+        o.emplace_back("restarts", static_cast<int64_t>(restarts));
+    }
+    o.emplace_back("latency", latency.toJson());
+    return o;
+}
+
+} // namespace xrouter
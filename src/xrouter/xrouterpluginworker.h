@@ -0,0 +1,183 @@
+// Copyright (c) 2020 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BLOCKNET_XROUTER_XROUTERPLUGINWORKER_H
+#define BLOCKNET_XROUTER_XROUTERPLUGINWORKER_H
+
+#include <sync.h>
+
+#include <json/json_spirit.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace xrouter {
+
+/**
+ * Histogram of plugin call latencies. Bucket i counts the calls that took less than
+ * bucketBounds()[i] milliseconds, the last bucket counts all slower calls.
+ */
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    static const std::vector<int64_t> & bucketBounds();
+
+    void add(int64_t ms);
+
+    /**
+     * Returns the call count, the average latency and the bucket counts keyed by their
+     * upper bound, e.g. {"count":10, "avgms":3, "buckets":{"<1ms":2, "<5ms":8, ...}}
+     */
+    json_spirit::Object toJson() const;
+
+private:
+    mutable Mutex mu;
+    std::vector<uint64_t> counts;
+    uint64_t total{0};
+    int64_t totalMs{0};
+};
+
+/**
+ * A long-lived plugin process. Requests are written to the process' stdin and replies are
+ * read from its stdout, both framed as the payload length in decimal followed by a newline
+ * and the payload: "<length>\n<payload>". The process handles one request at a time.
+ */
+class PluginWorker {
+public:
+    /**
+     * @param cmd worker command
+     * @param container if not empty the command runs in this docker container
+     */
+    explicit PluginWorker(const std::string & cmd, const std::string & container = "");
+    ~PluginWorker();
+
+    /**
+     * Starts the process through the shell, in the container with docker exec if one was
+     * given. Containerized workers record their pid in the container so that stop() can
+     * kill them there.
+     * @return false if the process could not be started
+     */
+    bool start();
+
+    /**
+     * Kills the process if it is running. Containerized workers are killed in the container
+     * too, killing the docker exec client does not stop them.
+     */
+    void stop();
+
+    /**
+     * Returns true if the process was started and has not been stopped.
+     */
+    bool running() const { return pid > 0; }
+
+    /**
+     * Sends a request and waits for its reply. The process is stopped if it exits, breaks
+     * the framing or doesn't reply within the timeout, it is no longer in a known state.
+     * @param request payload
+     * @param timeout in milliseconds
+     * @param reply payload of the reply
+     * @param error description of the failure
+     * @param timedOut set to true if the reply didn't arrive in time
+     * @return false on failure
+     */
+    bool call(const std::string & request, int timeout, std::string & reply, std::string & error, bool & timedOut);
+
+private:
+    bool fill(int64_t deadline, std::string & error, bool & timedOut);
+    bool write(const std::string & data, int64_t deadline, std::string & error, bool & timedOut);
+    bool read(size_t n, int64_t deadline, std::string & data, std::string & error, bool & timedOut);
+    bool readLine(int64_t deadline, std::string & line, std::string & error, bool & timedOut);
+
+    const std::string cmd;
+    const std::string container;
+    const std::string pidFile; // in the container
+    std::atomic<int> pid{-1};
+    int fdIn{-1};
+    int fdOut{-1};
+    std::string buffer; // bytes read past the last reply
+};
+
+/**
+ * Persistent workers of a plugin that opted in with private::workers. The number of workers
+ * limits how many calls of the plugin run concurrently, further calls wait for a worker
+ * until their timeout. Workers that crash or time out are restarted on their next use.
+ */
+class PluginWorkerPool {
+public:
+    /** Minimum time between two restarts of a worker */
+    static constexpr int64_t RESTART_BACKOFF_MS = 1000;
+
+    /**
+     * @param plugin name
+     * @param cmd worker command
+     * @param workers number of worker processes
+     * @param container if not empty the workers run in this docker container
+     */
+    PluginWorkerPool(const std::string & plugin, const std::string & cmd, int workers,
+                     const std::string & container = "");
+    ~PluginWorkerPool();
+
+    /**
+     * Runs a plugin call on the next free worker.
+     * @param request payload sent to the worker
+     * @param timeout in milliseconds, covers waiting for a free worker and the call itself
+     * @return the reply payload
+     * @throws XRouterError if no worker replied in time or the worker failed
+     */
+    std::string call(const std::string & request, int timeout);
+
+    /**
+     * Stops all workers, pending and future calls fail.
+     */
+    void stop();
+
+    /**
+     * The worker command.
+     */
+    const std::string & command() const { return cmd; }
+
+    /**
+     * The container the workers run in, empty if they run on the host.
+     */
+    const std::string & containerName() const { return container; }
+
+    /**
+     * The number of workers, fixed when the pool is created.
+     */
+    size_t size() const { return workers.size(); }
+
+    /**
+     * Returns the worker count, the call, failure, timeout and restart counters and the
+     * latency histogram of the successful calls.
+     */
+    json_spirit::Object status() const;
+
+private:
+    const std::string plugin;
+    const std::string cmd;
+    const std::string container;
+
+    mutable Mutex mu;
+    std::condition_variable cond;
+    std::vector<std::unique_ptr<PluginWorker>> workers;
+    std::vector<bool> busy;
+    std::vector<int64_t> lastStart;
+    bool stopped{false};
+
+    uint64_t calls{0};
+    uint64_t failures{0};
+    uint64_t timeouts{0};
+    uint64_t restarts{0};
+    LatencyHistogram latency;
+};
+
+typedef std::shared_ptr<PluginWorkerPool> PluginWorkerPoolPtr;
+
+} // namespace xrouter
+
+#endif // BLOCKNET_XROUTER_XROUTERPLUGINWORKER_H
@@ -0,0 +1,111 @@
+// Copyright (c) 2020 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <xrouter/xrouterquerycache.h>
+
+#include <util/time.h>
+#include <xbridge/util/xutil.h>
+
+namespace xrouter {
+
+std::string QueryCache::call(const std::string & key, const int ttl, std::string & uuid, const Query & query) {
+    std::shared_ptr<Flight> flight;
+    {
+        WAIT_LOCK(mu, lock);
+        if (ttl > 0) {
+            auto it = cache.find(key);
+            if (it != cache.end()) {
+                if (GetTime() < it->second.expires) {
+                    ++cached;
+                    uuid = it->second.uuid;
+                    return it->second.reply;
+                }
+                cache.erase(it);
+            }
+        }
+
+        auto it = inflight.find(key);
+        if (it != inflight.end()) {
+            ++coalesced;
+            flight = it->second;
+            cond.wait(lock, [&flight]() { return flight->done; });
+            if (flight->error)
+                std::rethrow_exception(flight->error);
+            uuid = flight->uuid;
+            return flight->reply;
+        }
+
+        ++queries;
+        flight = std::make_shared<Flight>();
+        inflight[key] = flight;
+    }
+
+    std::string reply;
+    std::exception_ptr error;
+    try {
+        reply = query(uuid);
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    {
+        LOCK(mu);
+        flight->uuid = uuid;
+        flight->reply = reply;
+        flight->error = error;
+        flight->done = true;
+        inflight.erase(key);
+        if (ttl > 0 && !error)
+            store(key, ttl, *flight);
+    }
+    cond.notify_all();
+
+    if (error)
+        std::rethrow_exception(error);
+    return reply;
+}
+
+void QueryCache::store(const std::string & key, const int ttl, const Flight & flight) {
+    // Errors are not cached, the next call may reach other service nodes
+    xbridge::JsonReplyReader reader(flight.reply);
+    if (reader.valid() && !reader.isNull("error"))
+        return;
+
+    const int64_t now = GetTime();
+    if (cache.size() >= MAX_ENTRIES) {
+        for (auto it = cache.begin(); it != cache.end(); ) {
+            if (now >= it->second.expires)
+                it = cache.erase(it);
+            else
+                ++it;
+        }
+        if (cache.size() >= MAX_ENTRIES)
+            return;
+    }
+    cache[key] = {flight.uuid, flight.reply, now + ttl};
+}
+
+void QueryCache::clear() {
+    LOCK(mu);
+    cache.clear();
+}
+
+json_spirit::Object QueryCache::status() const {
+    LOCK(mu);
+    json_spirit::Object o;
+    o.emplace_back("queries", static_cast<int64_t>(queries));
+    o.emplace_back("coalesced", static_cast<int64_t>(coalesced));
+    o.emplace_back("cached", static_cast<int64_t>(cached));
+    o.emplace_back("entries", static_cast<int64_t>(cache.size()));
+    o.emplace_back("inflight", static_cast<int64_t>(inflight.size()));
+    return o;
+}
+
+std::string QueryCache::makeKey(const std::string & command, const std::string & service,
+                                const int confirmations, const std::string & params)
+{
+    return command + "\n" + service + "\n" + std::to_string(confirmations) + "\n" + params;
+}
+
+} // namespace xrouter
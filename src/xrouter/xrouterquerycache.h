@@ -0,0 +1,90 @@
+// Copyright (c) 2020 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BLOCKNET_XROUTER_XROUTERQUERYCACHE_H
+#define BLOCKNET_XROUTER_XROUTERQUERYCACHE_H
+
+#include <sync.h>
+
+#include <json/json_spirit.h>
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace xrouter {
+
+/**
+ * Client side single-flight coalescing and short lived cache of xrouter replies. Callers
+ * issuing a query that is identical to one in flight wait for its reply instead of
+ * selecting and paying service nodes again. Successful replies can be kept for a few
+ * seconds for commands whose result only changes with the chain tip.
+ */
+class QueryCache {
+public:
+    /** Cached replies beyond this count are not stored until expired ones are removed */
+    static constexpr size_t MAX_ENTRIES = 1024;
+
+    /** Runs the query, sets its uuid and returns its reply */
+    typedef std::function<std::string(std::string & uuid)> Query;
+
+    /**
+     * Returns the cached reply for the key if it is still fresh, waits for the reply of the
+     * in-flight query with the same key, or runs the query.
+     * @param key identifies identical queries, see makeKey()
+     * @param ttl seconds a successful reply is cached, 0 disables caching
+     * @param uuid set to the uuid of the query whose reply is returned
+     * @param query runs the query
+     * @return the reply
+     */
+    std::string call(const std::string & key, int ttl, std::string & uuid, const Query & query);
+
+    /**
+     * Removes all cached replies.
+     */
+    void clear();
+
+    /**
+     * Returns the query, coalesced and cached call counters and the number of cached replies.
+     */
+    json_spirit::Object status() const;
+
+    /**
+     * Key of a query, queries with equal keys have the same reply.
+     */
+    static std::string makeKey(const std::string & command, const std::string & service,
+                               int confirmations, const std::string & params);
+
+private:
+    /** Shared by the caller running a query and the callers waiting for it */
+    struct Flight {
+        bool done{false};
+        std::string uuid;
+        std::string reply;
+        std::exception_ptr error;
+    };
+    struct Entry {
+        std::string uuid;
+        std::string reply;
+        int64_t expires;
+    };
+
+    void store(const std::string & key, int ttl, const Flight & flight);
+
+    mutable Mutex mu;
+    std::condition_variable cond;
+    std::map<std::string, std::shared_ptr<Flight>> inflight;
+    std::map<std::string, Entry> cache;
+
+    uint64_t queries{0};
+    uint64_t coalesced{0};
+    uint64_t cached{0};
+};
+
+} // namespace xrouter
+
+#endif // BLOCKNET_XROUTER_XROUTERQUERYCACHE_H
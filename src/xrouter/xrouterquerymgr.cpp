@@ -4,87 +4,210 @@
 
 #include <xrouter/xrouterquerymgr.h>
 
+#include <clientversion.h>
+#include <streams.h>
+#include <util/system.h>
+#include <util/time.h>
+#include <xbridge/util/xutil.h>
+#include <xrouter/xrouterdef.h>
+
+#include <algorithm>
+#include <limits>
+
 namespace xrouter {
 
+constexpr double LatencyStats::ALPHA;
+constexpr size_t LatencyStats::WINDOW;
+constexpr int64_t QueryMgr::LATENCY_EXPIRY;
+
+void LatencyStats::add(const int64_t ms, const int64_t now) {
+    ewma = count == 0 ? ms : ALPHA * ms + (1 - ALPHA) * ewma;
+    ++count;
+    lastUpdate = now;
+    recent.push_back(static_cast<uint32_t>(std::max<int64_t>(std::min<int64_t>(ms, std::numeric_limits<uint32_t>::max()), 0)));
+    if (recent.size() > WINDOW)
+        recent.pop_front();
+}
+
+int64_t LatencyStats::percentile(const int p) const {
+    if (recent.empty())
+        return 0;
+    std::vector<uint32_t> sorted(recent.begin(), recent.end());
+    const auto n = std::min(sorted.size() - 1, sorted.size() * std::max(0, std::min(p, 100)) / 100);
+    std::nth_element(sorted.begin(), sorted.begin() + n, sorted.end());
+    return sorted[n];
+}
+
+/** Replies with an error member, these don't tell how fast the node answers the service */
+static bool isErrorReply(const std::string & reply) {
+    xbridge::JsonReplyReader reader(reply);
+    return reader.valid() && !reader.isNull("error");
+}
+
+QueryMgr::QueryShard & QueryMgr::queryShard(const std::string & id) {
+    return queryShards[std::hash<std::string>{}(id) % SHARDS];
+}
+
+QueryMgr::NodeShard & QueryMgr::nodeShard(const NodeAddr & node) {
+    return nodeShards[std::hash<NodeAddr>{}(node) % SHARDS];
+}
+
 void QueryMgr::addQuery(const std::string & id, const NodeAddr & node) {
     if (id.empty() || node.empty())
         return;
 
-    LOCK(mu);
-
-    if (!queries.count(id))
-        queries[id] = std::map<NodeAddr, std::string>{};
-
     auto m = std::make_shared<boost::mutex>();
     auto cond = std::make_shared<boost::condition_variable>();
 
-    if (!queriesLocks.count(id))
-        queriesLocks[id] = std::map<NodeAddr, QueryCondition>{};
+    auto & shard = queryShard(id);
+    LOCK(shard.mu);
+
+    if (!shard.replies.count(id))
+        shard.replies[id] = std::map<NodeAddr, std::string>{};
 
     auto qc = QueryCondition{m, cond};
-    queriesLocks[id][node] = qc;
+    shard.locks[id][node] = qc;
+}
+
+void QueryMgr::addQuery(const std::string & id, const NodeAddr & node, const std::string & service) {
+    addQuery(id, node);
+    if (id.empty() || node.empty())
+        return;
+    auto & shard = queryShard(id);
+    LOCK(shard.mu);
+    shard.started[id][node] = std::make_pair(service, GetTimeMillis());
+}
+
+void QueryMgr::setMaxReplySize(const std::string & id, const uint32_t maxSize) {
+    auto & shard = queryShard(id);
+    LOCK(shard.mu);
+    shard.maxReplySize[id] = maxSize;
+}
+
+QueryMgr::ChunkStatus QueryMgr::addReplyChunk(const std::string & id, const NodeAddr & node, const uint32_t index,
+                                              const bool last, std::string && data, std::string & reply)
+{
+    std::map<uint32_t, std::string> chunks;
+    uint64_t size{0};
+    {
+        auto & shard = queryShard(id);
+        LOCK(shard.mu);
+        auto it = shard.locks.find(id);
+        auto mit = shard.maxReplySize.find(id);
+        if (it == shard.locks.end() || !it->second.count(node) || mit == shard.maxReplySize.end())
+            return CHUNK_INVALID; // not expecting chunks
+        auto & partials = shard.partial[id];
+        auto & p = partials[node];
+        // Full chunks up to the max size and the last chunk
+        const bool valid = !p.chunks.count(index) && index <= mit->second / XROUTER_REPLY_CHUNK_SIZE + 1
+                        && (p.last < 0 ? !last || p.chunks.empty() || p.chunks.rbegin()->first < index
+                                       : !last && index < p.last);
+        if (!valid) {
+            partials.erase(node);
+            return CHUNK_INVALID;
+        }
+        p.size += data.size();
+        if (p.size > mit->second) {
+            partials.erase(node);
+            return CHUNK_TOO_LARGE;
+        }
+        if (last)
+            p.last = index;
+        p.chunks[index] = std::move(data);
+        if (p.last < 0 || static_cast<int64_t>(p.chunks.size()) != p.last + 1)
+            return CHUNK_PENDING;
+        chunks.swap(p.chunks);
+        size = p.size;
+        partials.erase(node);
+    }
+
+    // Assemble without holding the lock, replies may be large
+    reply.clear();
+    reply.reserve(size);
+    for (auto & chunk : chunks) {
+        reply += chunk.second;
+        std::string().swap(chunk.second);
+    }
+    return CHUNK_COMPLETE;
 }
 
 int QueryMgr::addReply(const std::string & id, const NodeAddr & node, const std::string & reply) {
     if (id.empty() || node.empty())
         return 0;
 
-    int replies{0};
+    auto & shard = queryShard(id);
     QueryCondition qcond;
+    std::pair<std::string, int64_t> started;
 
     {
-        LOCK(mu);
+        LOCK(shard.mu);
 
-        if (!queries.count(id))
+        if (!shard.replies.count(id))
             return 0; // done, no query found with id
 
-        // Total replies
-        replies = queriesLocks.count(id);
         // Query condition
-        if (replies)
-            qcond = queriesLocks[id][node];
+        auto it = shard.locks.find(id);
+        if (it != shard.locks.end() && it->second.count(node))
+            qcond = it->second[node];
         // If invalid query condition return
         if (!qcond.first || !qcond.second)
             return 0;
+
+        auto st = shard.started.find(id);
+        if (st != shard.started.end() && st->second.count(node)) {
+            started = st->second[node];
+            st->second.erase(node);
+        }
     }
 
-    if (replies) { // only handle locks if they exist for this query
+    if (!started.first.empty())
+        addLatency(node, started.first, GetTimeMillis() - started.second, isErrorReply(reply));
+
+    {
         boost::mutex::scoped_lock l(*qcond.first);
-        queries[id][node] = reply; // Assign reply
+        {
+            LOCK(shard.mu);
+            auto it = shard.locks.find(id);
+            if (it == shard.locks.end() || !it->second.count(node))
+                return 0; // finished in the meantime
+            shard.replies[id][node] = reply; // Assign reply
+        }
         qcond.second->notify_all();
     }
 
-    LOCK(mu);
-    return queries.count(id);
+    LOCK(shard.mu);
+    return shard.replies.count(id);
 }
 
 int QueryMgr::reply(const std::string & id, const NodeAddr & node, std::string & reply) {
-    LOCK(mu);
+    auto & shard = queryShard(id);
+    LOCK(shard.mu);
 
-    int consensus = queries.count(id);
-    if (!consensus)
+    auto it = shard.replies.find(id);
+    if (it == shard.replies.end())
         return 0;
 
-    reply = queries[id][node];
-    return consensus;
+    reply = it->second[node];
+    return 1;
 }
 
 int QueryMgr::mostCommonReply(const std::string & id, std::string & reply, std::map<NodeAddr, std::string> & replies,
         std::set<NodeAddr> & agree, std::set<NodeAddr> & diff)
 {
-    LOCK(mu);
-
-    int consensus = queries.count(id);
-    if (!consensus || queries[id].empty())
-        return 0;
-
-    // all replies
-    replies = queries[id];
+    {
+        auto & shard = queryShard(id);
+        LOCK(shard.mu);
+        auto it = shard.replies.find(id);
+        if (it == shard.replies.end() || it->second.empty())
+            return 0;
+        // all replies, compared below without holding the lock
+        replies = it->second;
+    }
 
     std::map<uint256, std::string> hashes;
     std::map<uint256, int> counts;
     std::map<uint256, std::set<NodeAddr> > nodes;
-    for (auto & item : queries[id]) {
+    for (auto & item : replies) {
         auto result = item.second;
         try {
             UniValue j;
@@ -154,83 +277,136 @@ int QueryMgr::mostCommonReply(const std::string & id, std::string & reply) {
 }
 
 bool QueryMgr::hasQuery(const std::string & id) {
-    LOCK(mu);
-    return queriesLocks.count(id);
+    auto & shard = queryShard(id);
+    LOCK(shard.mu);
+    return shard.locks.count(id);
 }
 
 bool QueryMgr::hasQuery(const std::string & id, const NodeAddr & node) {
-    LOCK(mu);
-    return queriesLocks.count(id) && queriesLocks[id].count(node);
+    auto & shard = queryShard(id);
+    LOCK(shard.mu);
+    auto it = shard.locks.find(id);
+    return it != shard.locks.end() && it->second.count(node);
 }
 
 bool QueryMgr::hasNodeQuery(const NodeAddr & node) {
-    LOCK(mu);
-    for (const auto & item : queriesLocks) {
-        if (item.second.count(node))
-            return true;
+    for (auto & shard : queryShards) {
+        LOCK(shard.mu);
+        for (const auto & item : shard.locks) {
+            if (item.second.count(node))
+                return true;
+        }
     }
     return false;
 }
 
 bool QueryMgr::hasReply(const std::string & id, const NodeAddr & node) {
-    LOCK(mu);
-    return queries.count(id) && queries[id].count(node);
+    auto & shard = queryShard(id);
+    LOCK(shard.mu);
+    auto it = shard.replies.find(id);
+    return it != shard.replies.end() && it->second.count(node);
 }
 
 std::shared_ptr<boost::mutex> QueryMgr::queryLock(const std::string & id, const NodeAddr & node) {
-    LOCK(mu);
-    if (!queriesLocks.count(id))
-        return nullptr;
-    if (!queriesLocks[id].count(node))
+    auto & shard = queryShard(id);
+    LOCK(shard.mu);
+    auto it = shard.locks.find(id);
+    if (it == shard.locks.end() || !it->second.count(node))
         return nullptr;
-    return queriesLocks[id][node].first;
+    return it->second[node].first;
 }
 
 std::shared_ptr<boost::condition_variable> QueryMgr::queryCond(const std::string & id, const NodeAddr & node) {
-    LOCK(mu);
-    if (!queriesLocks.count(id))
+    auto & shard = queryShard(id);
+    LOCK(shard.mu);
+    auto it = shard.locks.find(id);
+    if (it == shard.locks.end() || !it->second.count(node))
         return nullptr;
-    if (!queriesLocks[id].count(node))
-        return nullptr;
-    return queriesLocks[id][node].second;
+    return it->second[node].second;
 }
 
 std::map<std::string, QueryMgr::QueryReply> QueryMgr::allReplies(const std::string & id) {
-    LOCK(mu);
-    return queries[id];
+    auto & shard = queryShard(id);
+    LOCK(shard.mu);
+    auto it = shard.replies.find(id);
+    if (it == shard.replies.end())
+        return {};
+    return it->second;
 }
 
 std::map<std::string, QueryMgr::QueryCondition> QueryMgr::allLocks(const std::string & id) {
-    LOCK(mu);
-    return queriesLocks[id];
+    auto & shard = queryShard(id);
+    LOCK(shard.mu);
+    auto it = shard.locks.find(id);
+    if (it == shard.locks.end())
+        return {};
+    return it->second;
 }
 
 void QueryMgr::purge(const std::string & id) {
-    LOCK(mu);
-    queriesLocks.erase(id);
+    finish(id);
+}
+
+std::set<NodeAddr> QueryMgr::finish(const std::string & id) {
+    std::set<NodeAddr> unanswered;
+    std::map<NodeAddr, std::pair<std::string, int64_t> > untimed;
+    {
+        auto & shard = queryShard(id);
+        LOCK(shard.mu);
+        auto lit = shard.locks.find(id);
+        if (lit != shard.locks.end()) {
+            auto rit = shard.replies.find(id);
+            for (const auto & item : lit->second) {
+                if (rit == shard.replies.end() || !rit->second.count(item.first))
+                    unanswered.insert(item.first);
+            }
+            shard.locks.erase(lit);
+        }
+        shard.maxReplySize.erase(id);
+        shard.partial.erase(id);
+        auto it = shard.started.find(id);
+        if (it != shard.started.end()) {
+            untimed.swap(it->second);
+            shard.started.erase(it);
+        }
+    }
+    const int64_t now = GetTimeMillis();
+    for (const auto & item : untimed)
+        addLatency(item.first, item.second.first, now - item.second.second, true);
+    return unanswered;
 }
 
 void QueryMgr::purge(const std::string & id, const NodeAddr & node) {
-    LOCK(mu);
-    if (queriesLocks.count(id))
-        queriesLocks[id].erase(node);
+    auto & shard = queryShard(id);
+    LOCK(shard.mu);
+    auto it = shard.locks.find(id);
+    if (it != shard.locks.end())
+        it->second.erase(node);
+    auto pit = shard.partial.find(id);
+    if (pit != shard.partial.end())
+        pit->second.erase(node);
 }
 
 std::chrono::time_point<std::chrono::system_clock> QueryMgr::getLastRequest(const NodeAddr & node, const std::string & command) {
-    LOCK(mu);
-    if (queriesLastSent.count(node) && queriesLastSent[node].count(command))
-        return queriesLastSent[node][command];
+    auto & shard = nodeShard(node);
+    LOCK(shard.mu);
+    auto it = shard.lastSent.find(node);
+    if (it != shard.lastSent.end() && it->second.count(command))
+        return it->second[command];
     return std::chrono::system_clock::from_time_t(0);
 }
 
 bool QueryMgr::hasSentRequest(const NodeAddr & node, const std::string & command) {
-    LOCK(mu);
-    return queriesLastSent.count(node) && queriesLastSent[node].count(command);
+    auto & shard = nodeShard(node);
+    LOCK(shard.mu);
+    auto it = shard.lastSent.find(node);
+    return it != shard.lastSent.end() && it->second.count(command);
 }
 
 void QueryMgr::updateSentRequest(const NodeAddr & node, const std::string & command) {
-    LOCK(mu);
-    queriesLastSent[node][command] = std::chrono::system_clock::now();
+    auto & shard = nodeShard(node);
+    LOCK(shard.mu);
+    shard.lastSent[node][command] = std::chrono::system_clock::now();
 }
 
 bool QueryMgr::rateLimitExceeded(const NodeAddr & node, const std::string & service,
@@ -248,30 +424,120 @@ bool QueryMgr::rateLimitExceeded(const NodeAddr & node, const std::string & serv
 }
 
 int QueryMgr::getScore(const NodeAddr & node) {
-    if (hasScore(node)) {
-        LOCK(mu);
-        return snodeScore[node];
-    }
-    return 0;
+    auto & shard = nodeShard(node);
+    LOCK(shard.mu);
+    auto it = shard.score.find(node);
+    return it != shard.score.end() ? it->second : 0;
 }
 
 bool QueryMgr::hasScore(const NodeAddr & node) {
-    LOCK(mu);
-    return snodeScore.count(node);
+    auto & shard = nodeShard(node);
+    LOCK(shard.mu);
+    return shard.score.count(node);
 }
 
 int QueryMgr::updateScore(const NodeAddr & node, const int score) {
-    LOCK(mu);
-    if (!snodeScore.count(node))
-        snodeScore[node] = 0;
-    snodeScore[node] += score;
-    return snodeScore[node];
+    auto & shard = nodeShard(node);
+    LOCK(shard.mu);
+    if (!shard.score.count(node))
+        shard.score[node] = 0;
+    shard.score[node] += score;
+    return shard.score[node];
 }
 
 int QueryMgr::banScore(const NodeAddr & node) {
-    LOCK(mu);
-    snodeScore[node] = -30;
-    return snodeScore[node];
+    auto & shard = nodeShard(node);
+    LOCK(shard.mu);
+    shard.score[node] = -30;
+    return shard.score[node];
+}
+
+void QueryMgr::addLatency(const NodeAddr & node, const std::string & service, const int64_t ms, const bool censored) {
+    LOCK(muLatency);
+    auto & stats = latencies[std::make_pair(node, service)];
+    stats.add(censored ? std::max<int64_t>(ms, stats.ewma) : ms, GetTime());
+}
+
+void QueryMgr::updateLatency(const NodeAddr & node, const std::string & service, const int64_t ms) {
+    LOCK(muLatency);
+    latencies[std::make_pair(node, service)].add(ms, GetTime());
+}
+
+double QueryMgr::getLatency(const NodeAddr & node, const std::string & service) {
+    LOCK(muLatency);
+    auto it = latencies.find(std::make_pair(node, service));
+    if (it != latencies.end())
+        return it->second.ewma;
+    std::vector<double> averages;
+    for (const auto & item : latencies) {
+        if (item.first.second == service)
+            averages.push_back(item.second.ewma);
+    }
+    if (averages.empty())
+        return -1;
+    std::nth_element(averages.begin(), averages.begin() + averages.size() / 2, averages.end());
+    return averages[averages.size() / 2];
+}
+
+std::map<std::pair<NodeAddr, std::string>, LatencyStats> QueryMgr::latencyStats(const std::string & service) {
+    LOCK(muLatency);
+    if (service.empty())
+        return latencies;
+    std::map<std::pair<NodeAddr, std::string>, LatencyStats> r;
+    for (const auto & item : latencies) {
+        if (item.first.second == service)
+            r.insert(item);
+    }
+    return r;
+}
+
+bool QueryMgr::saveLatencyStats(const fs::path & path) {
+    const auto stats = latencyStats();
+    fs::path pathTmp = path;
+    pathTmp += ".new";
+    FILE *file = fsbridge::fopen(pathTmp, "wb");
+    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull())
+        return error("%s: Failed to open file %s", __func__, pathTmp.string());
+    try {
+        CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+        fileout << stats;
+        hasher << stats;
+        fileout << hasher.GetHash();
+    } catch (const std::exception & e) {
+        return error("%s: Serialize or I/O error - %s", __func__, e.what());
+    }
+    if (!FileCommit(fileout.Get()))
+        return error("%s: Failed to flush file %s", __func__, pathTmp.string());
+    fileout.fclose();
+    if (!RenameOver(pathTmp, path))
+        return error("%s: Rename-into-place failed", __func__);
+    return true;
+}
+
+bool QueryMgr::loadLatencyStats(const fs::path & path) {
+    FILE *file = fsbridge::fopen(path, "rb");
+    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return false;
+    std::map<std::pair<NodeAddr, std::string>, LatencyStats> stats;
+    try {
+        CHashVerifier<CAutoFile> verifier(&filein);
+        verifier >> stats;
+        uint256 hash;
+        filein >> hash;
+        if (hash != verifier.GetHash())
+            return error("%s: Checksum mismatch, data corrupted", __func__);
+    } catch (const std::exception & e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+    const int64_t now = GetTime();
+    LOCK(muLatency);
+    for (auto & item : stats) {
+        if (now - item.second.lastUpdate < LATENCY_EXPIRY)
+            latencies[item.first] = std::move(item.second);
+    }
+    return true;
 }
 
 //private static
@@ -5,13 +5,17 @@
 #ifndef BLOCKNET_XROUTER_XROUTERQUERYMGR_H
 #define BLOCKNET_XROUTER_XROUTERQUERYMGR_H
 
+#include <fs.h>
 #include <hash.h>
+#include <serialize.h>
 #include <sync.h>
 #include <uint256.h>
 #include <univalue.h>
 #include <xrouter/xrouterutils.h>
 
+#include <array>
 #include <chrono>
+#include <deque>
 #include <memory>
 #include <mutex>
 #include <set>
@@ -23,6 +27,48 @@
 
 namespace xrouter {
 
+/**
+ * Response times of a service node for one service. The average is an exponentially
+ * weighted moving average, percentiles are computed over the most recent samples.
+ */
+class LatencyStats {
+public:
+    /** Weight of a new sample in the moving average */
+    static constexpr double ALPHA = 0.2;
+    /** Number of recent samples kept for percentiles */
+    static constexpr size_t WINDOW = 100;
+
+    void add(int64_t ms, int64_t now);
+    /** Returns the p-th percentile (0-100) of the recent samples in milliseconds */
+    int64_t percentile(int p) const;
+
+    double ewma{0};
+    uint64_t count{0};
+    int64_t lastUpdate{0}; // unix time
+    std::deque<uint32_t> recent;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        int64_t ewmaUs = static_cast<int64_t>(ewma * 1000);
+        READWRITE(ewmaUs);
+        READWRITE(count);
+        READWRITE(lastUpdate);
+        std::vector<uint32_t> samples(recent.begin(), recent.end());
+        READWRITE(samples);
+        if (ser_action.ForRead()) {
+            ewma = static_cast<double>(ewmaUs) / 1000;
+            recent.assign(samples.begin(), samples.end());
+        }
+    }
+};
+
+/**
+ * Tracks the queries sent to service nodes, their replies and the nodes' scores, rate limits
+ * and response times. Query state is sharded by query uuid and node state by node address,
+ * each shard has its own lock so that replies to different queries don't contend.
+ */
 class QueryMgr {
 public:
     typedef std::string QueryReply;
@@ -37,6 +83,41 @@ public:
      */
     void addQuery(const std::string & id, const NodeAddr & node);
 
+    /**
+     * Add a query and time the node's reply for the response time stats of the service.
+     * @param id uuid of query, can't be empty
+     * @param node address of node associated with query, can't be empty
+     * @param service fully qualified service name, e.g. xr::BLOCK::xrGetBlockCount
+     */
+    void addQuery(const std::string & id, const NodeAddr & node, const std::string & service);
+
+    /**
+     * Accept replies to the query in xrReplyChunk packets.
+     * @param id uuid of query
+     * @param maxSize largest reply accepted in bytes
+     */
+    void setMaxReplySize(const std::string & id, uint32_t maxSize);
+
+    enum ChunkStatus {
+        CHUNK_PENDING,   // more chunks are expected
+        CHUNK_COMPLETE,  // the reply is complete
+        CHUNK_TOO_LARGE, // the reply exceeds the max reply size, chunks received are dropped
+        CHUNK_INVALID,   // unexpected or duplicate chunk, chunks received are dropped
+    };
+
+    /**
+     * Store a chunk of a node's reply, chunks may arrive in any order.
+     * @param id
+     * @param node
+     * @param index index of the chunk
+     * @param last true if this is the last chunk of the reply
+     * @param data
+     * @param reply the assembled reply if the status is CHUNK_COMPLETE
+     * @return
+     */
+    ChunkStatus addReplyChunk(const std::string & id, const NodeAddr & node, uint32_t index, bool last,
+                              std::string && data, std::string & reply);
+
     /**
      * Store a query reply.
      * @param id
@@ -137,11 +218,20 @@ public:
     std::map<std::string, QueryCondition> allLocks(const std::string & id);
 
     /**
-     * Purges the ephemeral state of a query with specified id.
+     * Purges the ephemeral state of a query with specified id. Nodes that didn't reply are
+     * recorded at least as slow as their average, their reply time is unknown.
      * @param id
      */
     void purge(const std::string & id);
 
+    /**
+     * Purges the query like purge(id) and returns the nodes that were queried but didn't
+     * reply. Replies that arrive afterwards are dropped.
+     * @param id
+     * @return
+     */
+    std::set<NodeAddr> finish(const std::string & id);
+
     /**
      * Purges the ephemeral state of a query with specified id and node address.
      * @param id
@@ -212,15 +302,93 @@ public:
      */
     int banScore(const NodeAddr & node);
 
+    /**
+     * Records a response time of the node for the service.
+     * @param node
+     * @param service
+     * @param ms response time in milliseconds
+     */
+    void updateLatency(const NodeAddr & node, const std::string & service, int64_t ms);
+
+    /**
+     * Returns the average response time of the node for the service in milliseconds. Nodes
+     * without samples get the median of the other nodes' averages, so that they are tried.
+     * @param node
+     * @param service
+     * @return -1 if no node has samples for the service
+     */
+    double getLatency(const NodeAddr & node, const std::string & service);
+
+    /**
+     * Returns the response time stats keyed by node and service.
+     * @param service only return stats for this service if not empty
+     * @return
+     */
+    std::map<std::pair<NodeAddr, std::string>, LatencyStats> latencyStats(const std::string & service = "");
+
+    /**
+     * Writes the response time stats to the file.
+     * @param path
+     * @return false on error
+     */
+    bool saveLatencyStats(const fs::path & path);
+
+    /**
+     * Reads the response time stats written by saveLatencyStats, stats older than
+     * LATENCY_EXPIRY are dropped.
+     * @param path
+     * @return false if the file is missing or corrupted
+     */
+    bool loadLatencyStats(const fs::path & path);
+
+    /** Stats not updated for this many seconds are not loaded */
+    static constexpr int64_t LATENCY_EXPIRY = 7 * 24 * 60 * 60;
+
 private:
     static bool hasError(const std::string & reply);
 
 private:
-    Mutex mu;
-    std::map<std::string, std::map<NodeAddr, QueryCondition> > queriesLocks;
-    std::map<std::string, std::map<NodeAddr, QueryReply> > queries;
-    std::map<NodeAddr, std::map<std::string, std::chrono::time_point<std::chrono::system_clock> > > queriesLastSent;
-    std::unordered_map<NodeAddr, int> snodeScore;
+    /** Number of lock shards, queries and nodes are spread over them by hash */
+    static constexpr size_t SHARDS = 16;
+
+    /** Chunks of a reply received so far */
+    struct PartialReply {
+        std::map<uint32_t, std::string> chunks;
+        uint64_t size{0};
+        int64_t last{-1}; // index of the last chunk once received
+    };
+
+    /** State of the queries whose uuid hashes to the shard */
+    struct QueryShard {
+        Mutex mu;
+        std::unordered_map<std::string, std::map<NodeAddr, QueryCondition> > locks;
+        std::unordered_map<std::string, std::map<NodeAddr, QueryReply> > replies;
+        std::unordered_map<std::string, std::map<NodeAddr, std::pair<std::string, int64_t> > > started; // service and start time in ms
+        std::unordered_map<std::string, uint32_t> maxReplySize;
+        std::unordered_map<std::string, std::map<NodeAddr, PartialReply> > partial;
+    };
+
+    /** State of the nodes whose address hashes to the shard */
+    struct NodeShard {
+        Mutex mu;
+        std::unordered_map<NodeAddr, std::map<std::string, std::chrono::time_point<std::chrono::system_clock> > > lastSent;
+        std::unordered_map<NodeAddr, int> score;
+    };
+
+    QueryShard & queryShard(const std::string & id);
+    NodeShard & nodeShard(const NodeAddr & node);
+
+    /**
+     * Records a response time sample, if censored the node's reply time is unknown and the
+     * sample counts at least as slow as the node's average.
+     */
+    void addLatency(const NodeAddr & node, const std::string & service, int64_t ms, bool censored);
+
+private:
+    std::array<QueryShard, SHARDS> queryShards;
+    std::array<NodeShard, SHARDS> nodeShards;
+    Mutex muLatency;
+    std::map<std::pair<NodeAddr, std::string>, LatencyStats> latencies;
 };
 
 }
@@ -5,7 +5,9 @@
 #include <xrouter/xrouterserver.h>
 
 #include <servicenode/servicenodemgr.h>
+#include <shutdown.h>
 #include <xbridge/util/settings.h>
+#include <xbridge/util/xutil.h>
 #include <xrouter/xrouterapp.h>
 #include <xrouter/xroutererror.h>
 #include <xrouter/xrouterlogger.h>
@@ -36,6 +38,7 @@ bool XRouterServer::start()
         return false;
 
     createConnectors();
+    createPluginWorkers();
 
     LOCK(_lock);
     started = true;
@@ -45,12 +48,87 @@ bool XRouterServer::start()
 
 bool XRouterServer::stop()
 {
-    LOCK(_lock);
-    connectors.clear();
-    connectorLocks.clear();
+    std::map<std::string, PluginWorkerPoolPtr> pools;
+    {
+        LOCK(_lock);
+        connectors.clear();
+        connectorLocks.clear();
+        pools.swap(pluginWorkers);
+    }
+    // Outside the lock, stopping waits for the calls in progress
+    for (auto & item : pools)
+        item.second->stop();
     return true;
 }
 
+void XRouterServer::createPluginWorkers()
+{
+    App & app = App::instance();
+    std::map<std::string, PluginWorkerPoolPtr> pools;
+    std::vector<PluginWorkerPoolPtr> retired;
+    {
+        LOCK(_lock);
+        pools = pluginWorkers;
+    }
+
+    for (const auto & plugin : app.xrSettings()->getPlugins()) {
+        auto psettings = app.xrSettings()->getPluginSettings(plugin);
+        const int workers = psettings && !psettings->disabled() && psettings->type() == "docker" ? psettings->workers() : 0;
+        std::string cmd, container;
+        if (workers > 0) {
+            if (psettings->container().empty() || psettings->workerCommand().empty()) {
+                ERR() << "Failed to start workers of plugin " + plugin + " \"containername\" and \"workercommand\" cannot be empty";
+            } else {
+                cmd = psettings->workerCommand();
+                container = psettings->container();
+            }
+        }
+
+        auto it = pools.find(plugin);
+        if (it != pools.end() && (cmd.empty() || it->second->command() != cmd || it->second->containerName() != container
+                                  || it->second->size() != static_cast<size_t>(workers))) {
+            retired.push_back(it->second);
+            pools.erase(it);
+            it = pools.end();
+        }
+        if (!cmd.empty() && it == pools.end()) {
+            LOG() << "Starting " << workers << " workers of plugin " << plugin << " in container " << container
+                  << " with command: " << cmd;
+            pools[plugin] = std::make_shared<PluginWorkerPool>(plugin, cmd, workers, container);
+        }
+    }
+
+    // Plugins that were removed from the config
+    for (auto it = pools.begin(); it != pools.end(); ) {
+        if (!app.xrSettings()->hasPlugin(it->first)) {
+            retired.push_back(it->second);
+            it = pools.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    {
+        LOCK(_lock);
+        pluginWorkers.swap(pools);
+    }
+    for (auto & pool : retired)
+        pool->stop();
+}
+
+json_spirit::Object XRouterServer::pluginWorkersStatus() const
+{
+    std::map<std::string, PluginWorkerPoolPtr> pools;
+    {
+        LOCK(_lock);
+        pools = pluginWorkers;
+    }
+    Object o;
+    for (const auto & item : pools)
+        o.emplace_back(item.first, item.second->status());
+    return o;
+}
+
 bool XRouterServer::createConnectors() {
     try {
         Settings & s = settings();
@@ -127,6 +205,23 @@ WalletConnectorXRouterPtr XRouterServer::connectorByCurrency(const std::string &
     return WalletConnectorXRouterPtr();
 }
 
+/**
+ * Produces the first part right away so that wallet errors are reported before the client's
+ * fee is spent, the other parts are produced when they're sent.
+ */
+static ReplyPartSource prefetchFirstPart(ReplyPartSource next)
+{
+    auto first = std::make_shared<std::string>();
+    bool pending = next(*first);
+    return [next, first, pending](std::string & part) mutable -> bool {
+        if (!pending)
+            return next(part);
+        pending = false;
+        part.swap(*first);
+        return true;
+    };
+}
+
 void XRouterServer::sendPacketToClient(const std::string & uuid, const std::string & reply, CNode* pnode)
 {
     LOG() << "Sending reply to client for query " << uuid;
@@ -136,6 +231,69 @@ void XRouterServer::sendPacketToClient(const std::string & uuid, const std::stri
     xrouter::PushXRouterMessage(pnode, rpacket.body());
 }
 
+bool XRouterServer::waitForSendBuffer(CNode *pnode, const int64_t timeout)
+{
+    // The socket thread clears fPauseSend once it drained the buffer below -maxsendbuffer
+    const int64_t deadline = GetTimeMillis() + timeout;
+    while (pnode->fPauseSend) {
+        if (pnode->fDisconnect || ShutdownRequested() || GetTimeMillis() > deadline)
+            return false;
+        MilliSleep(10);
+    }
+    return !pnode->fDisconnect;
+}
+
+void XRouterServer::sendChunksToClient(const std::string & uuid, const ReplyPartSource & next, const bool array,
+                                       const uint32_t maxSize, CNode* pnode)
+{
+    LOG() << "Sending chunked reply to client for query " << uuid;
+    uint32_t index{0};
+    bool stalled{false};
+    auto send = [&](const std::string & data, const uint32_t flags) {
+        if (!waitForSendBuffer(pnode, XROUTER_REPLY_CHUNK_STALL_TIMEOUT * 1000)) {
+            stalled = true;
+            throw std::runtime_error("client is not receiving");
+        }
+        XRouterPacket rpacket(xrReplyChunk, uuid);
+        rpacket.append(index++);
+        rpacket.append(flags);
+        rpacket.append(reinterpret_cast<const unsigned char *>(data.data()), static_cast<int>(data.size()));
+        rpacket.sign(spubkey, sprivkey);
+        xrouter::PushXRouterMessage(pnode, rpacket.body());
+    };
+
+    Object error;
+    try {
+        const bool ok = writeReplyChunks([this, &next, array](std::string & part) -> bool {
+            if (!next(part))
+                return false;
+            if (array) // remove the {"result": ""} wrapper of each element
+                part = parseResult(part);
+            return true;
+        }, array, maxSize, [&send](const std::string & chunk, const bool last) {
+            send(chunk, last ? xrChunkLast : 0);
+        });
+        if (ok)
+            return;
+        LOG() << "Reply to query " << uuid << " exceeds the client's limit of " << maxSize << " bytes";
+        error.emplace_back("error", "Reply exceeds the maximum size of " + std::to_string(maxSize) + " bytes");
+        error.emplace_back("code", xrouter::REPLY_TOO_LARGE);
+    } catch (std::exception & e) {
+        if (stalled) {
+            LOG() << "Dropping reply to query " << uuid << ", " << e.what();
+            return;
+        }
+        ERR() << "Failed to produce reply to query " << uuid << " " << e.what();
+        error.emplace_back("error", "Internal Server Error: Bad connector");
+        error.emplace_back("code", xrouter::BAD_CONNECTOR);
+    }
+    try {
+        send(json_spirit::write_string(Value(error), true), xrChunkLast | xrChunkAbort);
+    } catch (std::exception & e) {
+        LOG() << "Dropping reply to query " << uuid << ", " << e.what();
+    }
+}
+
 bool XRouterServer::processPayment(const std::string & feetx)
 {
     std::string txid;
@@ -174,6 +332,9 @@ void XRouterServer::onMessageReceived(CNode* node, XRouterPacketPtr packet, CVal
     const auto & nodeAddr = node->GetAddrName();
     const auto & uuid = packet->suuid();
     std::string reply;
+    ReplyPartSource replySource; // elements of array replies
+    std::vector<std::string> replyParts; // elements of array replies to clients that don't accept chunks
+    bool arrayReply{false};
 
     try {
         if (packet->version() != static_cast<boost::uint32_t>(XROUTER_PROTOCOL_VERSION))
@@ -359,22 +520,26 @@ void XRouterServer::onMessageReceived(CNode* node, XRouterPacketPtr packet, CVal
                         reply = parseResult(processGetTransaction(service, params));
                         break;
                     case xrGetBlocks:
-                        reply = parseResult(processGetBlocks(service, params));
+                        replySource = processGetBlocks(service, params);
+                        arrayReply = true;
                         break;
                     case xrGetTransactions:
-                        reply = parseResult(processGetTransactions(service, params));
+                        replySource = processGetTransactions(service, params);
+                        arrayReply = true;
                         break;
                     case xrDecodeRawTransaction:
                         reply = parseResult(processDecodeRawTransaction(service, params));
                         break;
                     case xrGetBalance:
-                        throw XRouterError("This call is not supported: " + fqService, xrouter::UNSUPPORTED_SERVICE);
-//                        reply = parseResult(processGetBalance(service, params));
+                        reply = parseResult(processGetBalance(service, params));
                         break;
                     case xrGetTxBloomFilter:
                         throw XRouterError("This call is not supported: " + fqService, xrouter::UNSUPPORTED_SERVICE);
 //                        reply = parseResult(processGetTxBloomFilter(service, params));
                         break;
+                    case xrGetBlockFilters:
+                        reply = parseResult(processGetBlockFilters(service, params));
+                        break;
                     case xrGenerateBloomFilter:
                         throw XRouterError("This call is not supported: " + fqService, xrouter::UNSUPPORTED_SERVICE);
 //                        reply = parseResult(processGenerateBloomFilter(service, params));
@@ -392,6 +557,15 @@ void XRouterServer::onMessageReceived(CNode* node, XRouterPacketPtr packet, CVal
                     default:
                         throw XRouterError("Unknown command " + fqService, xrouter::UNSUPPORTED_SERVICE);
                 }
+                if (arrayReply) {
+                    if (packet->maxReplySize() > 0) // the rest is produced as the chunks are sent
+                        replySource = prefetchFirstPart(replySource);
+                    else {
+                        std::string part;
+                        while (replySource(part))
+                            replyParts.push_back(std::move(part));
+                    }
+                }
             } catch (XRouterError & e) {
                 state.DoS(1, error("XRouter: bad request"), REJECT_INVALID, "xrouter-error"); // prevent abuse
                 ERR() << "Failed to process " << fqService << "from node " << nodeAddr << " msg: " << e.msg << " code: " << e.code;
@@ -412,15 +586,32 @@ void XRouterServer::onMessageReceived(CNode* node, XRouterPacketPtr packet, CVal
         error.emplace_back("error", e.msg);
         error.emplace_back("code", e.code);
         reply = json_spirit::write_string(Value(error), true);
+        arrayReply = false;
     } catch (std::exception & e) {
         LOG() << "Exception: " << e.what();
         Object error;
         error.emplace_back("error", "Internal Server Error");
         error.emplace_back("code", xrouter::INTERNAL_SERVER_ERROR);
         reply = json_spirit::write_string(Value(error), true);
+        arrayReply = false;
     }
 
-    sendPacketToClient(uuid, reply, node);
+    // Clients that accept chunked replies set their maximum reply size
+    const auto maxReplySize = packet->maxReplySize();
+    if (maxReplySize > 0 && (arrayReply || reply.size() > XROUTER_REPLY_CHUNK_SIZE)) {
+        if (!arrayReply) {
+            replyParts = {std::move(reply)};
+            replySource = [&replyParts](std::string & part) -> bool {
+                if (replyParts.empty())
+                    return false;
+                part.swap(replyParts.back());
+                replyParts.clear();
+                return true;
+            };
+        }
+        sendChunksToClient(uuid, replySource, arrayReply, maxReplySize, node);
+    } else
+        sendPacketToClient(uuid, arrayReply ? parseResult(replyParts) : reply, node);
 }
 
 //*****************************************************************************
@@ -473,7 +664,7 @@ std::string XRouterServer::processGetBlock(const std::string & currency, const s
     throw XRouterError("Internal Server Error: No connector for " + currency, xrouter::BAD_CONNECTOR);
 }
 
-std::vector<std::string> XRouterServer::processGetBlocks(const std::string & currency, const std::vector<std::string> & params) {
+ReplyPartSource XRouterServer::processGetBlocks(const std::string & currency, const std::vector<std::string> & params) {
     if (params.empty())
         throw XRouterError("Missing block hashes for " + currency, xrouter::BAD_REQUEST);
 
@@ -485,8 +676,15 @@ std::vector<std::string> XRouterServer::processGetBlocks(const std::string & cur
 
     xrouter::WalletConnectorXRouterPtr conn = connectorByCurrency(currency);
     if (conn && hasConnectorLock(currency)) {
-        boost::mutex::scoped_lock l(*getConnectorLock(currency));
-        return conn->getBlocks(params);
+        auto connLock = getConnectorLock(currency);
+        size_t i{0};
+        return [conn, connLock, params, i](std::string & part) mutable -> bool {
+            if (i == params.size())
+                return false;
+            boost::mutex::scoped_lock l(*connLock);
+            part = conn->getBlock(params[i++]);
+            return true;
+        };
     }
 
     throw XRouterError("Internal Server Error: No connector for " + currency, xrouter::BAD_CONNECTOR);
@@ -505,7 +703,7 @@ std::string XRouterServer::processGetTransaction(const std::string & currency, c
     throw XRouterError("Internal Server Error: No connector for " + currency, xrouter::BAD_CONNECTOR);
 }
 
-std::vector<std::string> XRouterServer::processGetTransactions(const std::string & currency, const std::vector<std::string> & params) {
+ReplyPartSource XRouterServer::processGetTransactions(const std::string & currency, const std::vector<std::string> & params) {
     if (params.empty())
         throw XRouterError("Missing transaction hashes for " + currency, xrouter::BAD_REQUEST);
 
@@ -517,8 +715,15 @@ std::vector<std::string> XRouterServer::processGetTransactions(const std::string
     
     xrouter::WalletConnectorXRouterPtr conn = connectorByCurrency(currency);
     if (conn && hasConnectorLock(currency)) {
-        boost::mutex::scoped_lock l(*getConnectorLock(currency));
-        return conn->getTransactions(params);
+        auto connLock = getConnectorLock(currency);
+        size_t i{0};
+        return [conn, connLock, params, i](std::string & part) mutable -> bool {
+            if (i == params.size())
+                return false;
+            boost::mutex::scoped_lock l(*connLock);
+            part = conn->getTransaction(params[i++]);
+            return true;
+        };
     }
 
     throw XRouterError("Internal Server Error: No connector for " + currency, xrouter::BAD_CONNECTOR);
@@ -580,6 +785,37 @@ std::vector<std::string> XRouterServer::processGetTxBloomFilter(const std::strin
     throw XRouterError("Internal Server Error: No connector for " + currency, xrouter::BAD_CONNECTOR);
 }
 
+std::vector<std::string> XRouterServer::processGetBlockFilters(const std::string & currency, const std::vector<std::string> & params) {
+    if (params.size() < 2)
+        throw XRouterError("Missing block range for " + currency, xrouter::BAD_REQUEST);
+    if (!is_number(params[0]) || !is_number(params[1]))
+        throw XRouterError("Incorrect block range: " + params[0] + " " + params[1], xrouter::INVALID_PARAMETERS);
+
+    int start{0}, stop{0};
+    try {
+        start = boost::lexical_cast<int>(params[0]);
+        stop = boost::lexical_cast<int>(params[1]);
+    } catch (...) {
+        throw XRouterError("Incorrect block range: " + params[0] + " " + params[1], xrouter::INVALID_PARAMETERS);
+    }
+    if (start < 0 || stop < start)
+        throw XRouterError("Incorrect block range: " + params[0] + " " + params[1], xrouter::INVALID_PARAMETERS);
+
+    App & app = App::instance();
+    const auto & fetchlimit = app.xrSettings()->commandFetchLimit(xrGetBlockFilters, currency);
+    if (stop - start + 1 > fetchlimit)
+        throw XRouterError("Too many block filters requested for " + currency + " limit is " +
+                           std::to_string(fetchlimit) + " received " + std::to_string(stop - start + 1), xrouter::BAD_REQUEST);
+
+    xrouter::WalletConnectorXRouterPtr conn = connectorByCurrency(currency);
+    if (conn && hasConnectorLock(currency)) {
+        boost::mutex::scoped_lock l(*getConnectorLock(currency));
+        return conn->getBlockFilters(start, stop);
+    }
+
+    throw XRouterError("Internal Server Error: No connector for " + currency, xrouter::BAD_CONNECTOR);
+}
+
 std::string XRouterServer::processGenerateBloomFilter(const std::string & currency, const std::vector<std::string> & params) {
     CBloomFilter f(10 * static_cast<unsigned int>(params.size()), 0.1, 5, 0);
 
@@ -633,7 +869,46 @@ std::string XRouterServer::processConvertTimeToBlockCount(const std::string & cu
 }
 
 std::string XRouterServer::processGetBalance(const std::string & currency, const std::vector<std::string> & params) {
-    throw XRouterError("Internal Server Error: Not implemented for " + currency, xrouter::BAD_CONNECTOR);
+    if (params.empty() || params[0].empty())
+        throw XRouterError("Missing address for " + currency, xrouter::BAD_REQUEST);
+
+    xrouter::WalletConnectorXRouterPtr conn = connectorByCurrency(currency);
+    if (conn && hasConnectorLock(currency)) {
+        boost::mutex::scoped_lock l(*getConnectorLock(currency));
+        return conn->getBalance(params[0]);
+    }
+
+    throw XRouterError("Internal Server Error: No connector for " + currency, xrouter::BAD_CONNECTOR);
+}
+
+/**
+ * Converts the plugin call parameters to the types listed in the plugin's "parameters" entry.
+ */
+static Array pluginParams(const std::vector<std::string> & expectedParams, const std::vector<std::string> & params)
+{
+    Array jsonparams;
+    for (int i = 0; i < static_cast<int>(expectedParams.size()); ++i) {
+        const auto & p = expectedParams[i];
+        const auto & rec = params[i];
+        if (p == "bool") {
+            jsonparams.push_back(!(rec == "false" || rec == "0"));
+        } else if (p == "int") {
+            try {
+                jsonparams.push_back(boost::lexical_cast<int64_t>(rec));
+            } catch (...) {
+                throw XRouterError("Parameter " + std::to_string(i + 1) + " cannot be converted to integer", INVALID_PARAMETERS);
+            }
+        } else if (p == "double") {
+            try {
+                jsonparams.push_back(boost::lexical_cast<double>(rec));
+            } catch (...) {
+                throw XRouterError("Parameter " + std::to_string(i + 1) + " cannot be converted to double", INVALID_PARAMETERS);
+            }
+        } else { // string
+            jsonparams.push_back(rec);
+        }
+    }
+    return jsonparams;
 }
 
 std::string XRouterServer::processServiceCall(const std::string & name, const std::vector<std::string> & params)
@@ -653,28 +928,7 @@ std::string XRouterServer::processServiceCall(const std::string & name, const st
                 params.size(), expectedParams.size()), INVALID_PARAMETERS);
 
     if (callType == "rpc") {
-        Array jsonparams;
-        for (int i = 0; i < static_cast<int>(expectedParams.size()); ++i) {
-            const auto & p = expectedParams[i];
-            const auto & rec = params[i];
-            if (p == "bool") {
-                jsonparams.push_back(!(rec == "false" || rec == "0"));
-            } else if (p == "int") {
-                try {
-                    jsonparams.push_back(boost::lexical_cast<int64_t>(rec));
-                } catch (...) {
-                    throw XRouterError("Parameter " + std::to_string(i + 1) + " cannot be converted to integer", INVALID_PARAMETERS);
-                }
-            } else if (p == "double") {
-                try {
-                    jsonparams.push_back(boost::lexical_cast<double>(rec));
-                } catch (...) {
-                    throw XRouterError("Parameter " + std::to_string(i + 1) + " cannot be converted to double", INVALID_PARAMETERS);
-                }
-            } else { // string
-                jsonparams.push_back(rec);
-            }
-        }
+        const auto & jsonparams = pluginParams(expectedParams, params);
 
         std::string result;
         const auto & user     = psettings->stringParam("rpcuser");
@@ -707,6 +961,32 @@ std::string XRouterServer::processServiceCall(const std::string & name, const st
             ERR() << "Failed to run plugin " + name + " \"containername\" cannot be empty";
             throw XRouterError("Internal Server Error in command " + name, INTERNAL_SERVER_ERROR);
         }
+        // Parses the container result into Value
+        auto parseR = [](const std::string & res) -> Value {
+            Value cmd_val;
+            try {
+                json_spirit::read_string(res, cmd_val);
+            } catch (...) { // ignore errors on json parse
+                throw XRouterError("Failed to read the plugin response data", INTERNAL_SERVER_ERROR);
+            }
+            if (cmd_val.type() != null_type)
+                return cmd_val;
+            else
+                return Value(res); // raw string
+        };
+
+        // Plugins with persistent workers receive the typed parameters as a json array
+        auto pool = getPluginWorkers(name);
+        if (pool) {
+            const auto & request = json_spirit::write_string(Value(pluginParams(expectedParams, params)), false);
+            LOG() << "Calling worker of docker plugin " << name << " with request: " << request;
+            const auto val = parseR(pool->call(request, psettings->workerTimeout()));
+            if (psettings->hasCustomResponse())
+                return psettings->customResponse();
+            else
+                return json_spirit::write_string(val, false);
+        }
+
         if (exe.empty()) {
             ERR() << "Failed to run plugin " + name + " \"command\" cannot be empty";
             throw XRouterError("Internal Server Error in command " + name, INTERNAL_SERVER_ERROR);
@@ -740,20 +1020,6 @@ std::string XRouterServer::processServiceCall(const std::string & name, const st
         // Insert docker command info
         const auto & cmd = strprintf("docker exec %s %s %s", container, exe, cmdargs);
 
-        // parses the container result into Value
-        auto parseR = [](const std::string & res) -> Value {
-            Value cmd_val;
-            try {
-                json_spirit::read_string(res, cmd_val);
-            } catch (...) { // ignore errors on json parse
-                throw XRouterError("Failed to read the plugin response data", INTERNAL_SERVER_ERROR);
-            }
-            if (cmd_val.type() != null_type)
-                return cmd_val;
-            else
-                return Value(res); // raw string
-        };
-
         LOG() << "Executing docker plugin " << name << " with command: " << cmd;
         Value val;
         int nexit;
@@ -971,16 +1237,20 @@ bool XRouterServer::initKeyPair() {
 }
 
 std::string XRouterServer::parseResult(const std::string & res) {
-    UniValue uv;
-    if (!uv.read(res))
+    // Only the result member is needed, avoid building a json tree of large blocks
+    xbridge::JsonReplyReader reader(res);
+    if (!reader.valid() || reader.isNull("result"))
         return res;
-    if (uv.isObject()) {
-        const auto & r_val = find_value(uv, "result");
-        if (r_val.isNull())
-            return res;
-        return r_val.getValStr();
-    }
-    return res;
+    std::string str;
+    if (reader.getString("result", str))
+        return str;
+    str = reader.raw("result");
+    // Same representation as UniValue::getValStr() for bools
+    if (str == "true")
+        return "1";
+    if (str == "false")
+        return "";
+    return str;
 };
 
 std::string XRouterServer::parseResult(const std::vector<std::string> & resv) {
@@ -10,6 +10,7 @@
 #include <xrouter/xrouterconnector.h>
 #include <xrouter/xrouterconnectorbtc.h>
 #include <xrouter/xrouterconnectoreth.h>
+#include <xrouter/xrouterpluginworker.h>
 
 #include <consensus/validation.h>
 #include <net.h>
@@ -87,9 +88,9 @@ public:
      * @brief process xrGetBlocks call on service node side
      * @param currency blockchain to query
      * @param params list of parameters
-     * @return
+     * @return the blocks, each one is fetched from the wallet when it's produced
      */
-    std::vector<std::string> processGetBlocks(const std::string & currency, const std::vector<std::string> & params);
+    ReplyPartSource processGetBlocks(const std::string & currency, const std::vector<std::string> & params);
 
     /**
      * @brief process xrGetTransaction call on service node side
@@ -103,9 +104,9 @@ public:
      * @brief process xrGetAllTransactions call on service node side
      * @param currency blockchain to query
      * @param params list of parameters
-     * @return
+     * @return the transactions, each one is fetched from the wallet when it's produced
      */
-    std::vector<std::string> processGetTransactions(const std::string & currency, const std::vector<std::string> & params);
+    ReplyPartSource processGetTransactions(const std::string & currency, const std::vector<std::string> & params);
 
     /**
      * @brief process xrDecodeRawTransaction call on service node side
@@ -123,6 +124,14 @@ public:
      */
     std::vector<std::string> processGetTxBloomFilter(const std::string & currency, const std::vector<std::string> & params);
 
+    /**
+     * @brief process xrGetBlockFilters call on service node side
+     * @param currency blockchain to query
+     * @param params start and stop block heights
+     * @return
+     */
+    std::vector<std::string> processGetBlockFilters(const std::string & currency, const std::vector<std::string> & params);
+
     /**
      * @brief process xrGenerateBloomFilter call on service node side
      * @param currency blockchain to query
@@ -221,6 +230,18 @@ public:
      */
     bool createConnectors();
 
+    /**
+     * (Re)starts the persistent workers of the docker plugins that set private::workers.
+     * Pools whose command didn't change are kept running.
+     */
+    void createPluginWorkers();
+
+    /**
+     * Returns the status of the plugin worker pools keyed by plugin name.
+     * @return
+     */
+    json_spirit::Object pluginWorkersStatus() const;
+
     /**
      * Returns true if this server has a pending query.
      * @param node
@@ -265,6 +286,14 @@ public:
 
     void runPerformanceTests();
 
+    /**
+     * Waits until the node's send buffer has room for another message.
+     * @param pnode
+     * @param timeout milliseconds
+     * @return false if the node disconnects, shutdown is requested or the timeout expires
+     */
+    static bool waitForSendBuffer(CNode *pnode, int64_t timeout);
+
 private:
     /**
      * @brief load the connector (class used to communicate with other chains)
@@ -287,6 +316,21 @@ private:
      */
     void sendPacketToClient(const std::string & uuid, const std::string & reply, CNode* pnode);
 
+    /**
+     * Sends the reply in signed xrReplyChunk packets to clients that accept them. If the reply
+     * is larger than the client accepts, or producing a part fails, an error is sent instead of
+     * the remaining chunks. Chunks are queued when the node's send buffer has room, so the parts
+     * are produced at the pace the client receives them. The reply is dropped if the client
+     * stops receiving for XROUTER_REPLY_CHUNK_STALL_TIMEOUT seconds.
+     * @param uuid
+     * @param next produces the reply, or the elements of a json array if array is true
+     * @param array
+     * @param maxSize the client's maximum reply size
+     * @param pnode
+     */
+    void sendChunksToClient(const std::string & uuid, const ReplyPartSource & next, bool array,
+                            uint32_t maxSize, CNode* pnode);
+
     /**
      * Loads the servicenode key from config.
      * @return false on error, otherwise true
@@ -326,6 +370,7 @@ private:
     std::map<std::string, std::pair<std::string, CAmount> > hashedQueries;
     std::map<std::string, std::chrono::time_point<std::chrono::system_clock> > hashedQueriesDeadlines;
     std::map<NodeAddr, std::set<std::string> > inFlightQueries;
+    std::map<std::string, PluginWorkerPoolPtr> pluginWorkers;
 
     std::vector<unsigned char> spubkey;
     std::vector<unsigned char> sprivkey;
@@ -352,6 +397,11 @@ private:
         LOCK(_lock);
         return connectorLocks.count(currency);
     }
+    PluginWorkerPoolPtr getPluginWorkers(const std::string & name) {
+        LOCK(_lock);
+        auto it = pluginWorkers.find(name);
+        return it != pluginWorkers.end() ? it->second : nullptr;
+    }
 
 };
 
@@ -172,6 +172,17 @@ bool XRouterSettings::init(const std::string & config, const bool snode) {
     return true;
 }
 
+bool XRouterSettings::init(const std::string & config, const CService & resolvedAddr) {
+    if (!read(config) || host(xrDefault).empty())
+        return false;
+    const auto nport = port(xrDefault);
+    addr = CService(resolvedAddr, nport);
+    node = host(xrDefault) + ":" + std::to_string(nport);
+    loadPlugins();
+    loadWallets();
+    return true;
+}
+
 void XRouterSettings::loadWallets() {
     {
         LOCK(mu);
@@ -449,6 +460,49 @@ int XRouterSettings::clientRequestLimit(XRouterCommand c, const std::string & se
     return res;
 }
 
+int XRouterSettings::cacheTtl(XRouterCommand c, const std::string & service, int def) {
+    const std::string cstr{XRouterCommand_ToString(c)};
+    auto res = get<int>("Main.cachettl", def);
+    res = get<int>(cstr + ".cachettl", res);
+    if (!service.empty()) {
+        res = get<int>(service + ".cachettl", res);
+        res = get<int>(service + xrdelimiter + cstr + ".cachettl", res);
+    }
+    return std::max(res, 0);
+}
+
+bool XRouterSettings::hedge(XRouterCommand c, const std::string & service) {
+    const std::string cstr{XRouterCommand_ToString(c)};
+    auto res = get<bool>("Main.hedge", false);
+    if (c == xrService) { // Handle plugin
+        if (!service.empty())
+            res = get<bool>(cstr + xrdelimiter + service + ".hedge", res);
+    } else {
+        res = get<bool>(cstr + ".hedge", res);
+        if (!service.empty()) {
+            res = get<bool>(service + ".hedge", res);
+            res = get<bool>(service + xrdelimiter + cstr + ".hedge", res);
+        }
+    }
+    return res;
+}
+
+int XRouterSettings::maxReplySize(XRouterCommand c, const std::string & service, int def) {
+    const std::string cstr{XRouterCommand_ToString(c)};
+    auto res = get<int>("Main.maxreplysize", def);
+    if (c == xrService) { // Handle plugin
+        if (!service.empty())
+            res = get<int>(cstr + xrdelimiter + service + ".maxreplysize", res);
+    } else {
+        res = get<int>(cstr + ".maxreplysize", res);
+        if (!service.empty()) {
+            res = get<int>(service + ".maxreplysize", res);
+            res = get<int>(service + xrdelimiter + cstr + ".maxreplysize", res);
+        }
+    }
+    return std::max(res, 0);
+}
+
 std::string XRouterSettings::paymentAddress(XRouterCommand c, const std::string & service) {
     std::string def;
     static const auto s_paymentaddress = "paymentaddress";
@@ -709,6 +763,24 @@ std::string XRouterPluginSettings::commandArgs() {
     return t;
 }
 
+int XRouterPluginSettings::workers() {
+    auto t = get<int>("workers", 0);
+    t = get<int>(privatePrefix + "workers", t);
+    return std::max(0, std::min(t, 64));
+}
+
+std::string XRouterPluginSettings::workerCommand() {
+    auto t = get<std::string>("workercommand", "");
+    t = get<std::string>(privatePrefix + "workercommand", t);
+    return t;
+}
+
+int XRouterPluginSettings::workerTimeout() {
+    auto t = get<int>("workertimeout", commandTimeout() * 1000);
+    t = get<int>(privatePrefix + "workertimeout", t);
+    return t;
+}
+
 bool XRouterPluginSettings::hasCustomResponse() {
     return has("response") || has(privatePrefix + "response");
 }
@@ -769,9 +841,20 @@ bool createConf(const boost::filesystem::path & confDir, const bool & skipPlugin
                      "#! timeout is the maximum time in seconds you're willing to wait for an XRouter response"          + eol +
                      "timeout=30"                                                                                        + eol +
                      ""                                                                                                  + eol +
+                     "#! hedge=1 queries one service node more than consensus requires and uses the first replies,"      + eol +
+                     "#! slow nodes then don't hold up the call. Paid calls also pay the extra node. The default is 0."  + eol +
+                     "#! hedge=1"                                                                                        + eol +
+                     ""                                                                                                  + eol +
+                     "#! maxreplysize is the largest reply in bytes accepted from a service node, 0 is no limit."        + eol +
+                     "#! Large replies are received in chunks. The default is 100000000."                                + eol +
+                     "#! maxreplysize=100000000"                                                                         + eol +
+                     ""                                                                                                  + eol +
                      "#! Optionally set per-call config options:"                                                        + eol +
                      "#! [xrGetBlockCount]"                                                                              + eol +
                      "#! maxfee=0.01"                                                                                    + eol +
+                     "#! cachettl is the number of seconds a reply is reused for identical calls (default 0, disabled)." + eol +
+                     "#! Identical calls made while a call is in progress always share its reply."                      + eol +
+                     "#! cachettl=2"                                                                                     + eol +
                      ""                                                                                                  + eol +
                      "#! [BLOCK::xrGetBlockCount]"                                                                       + eol +
                      "#! maxfee=0.01"                                                                                    + eol +
@@ -896,6 +979,16 @@ bool createConf(const boost::filesystem::path & confDir, const bool & skipPlugin
                      "private::command=syscoin-cli getblock"                                                               + eol +
                      "private::args=$1"                                                                                    + eol +
                      ""                                                                                                    + eol +
+                     "#! Instead of starting \"command\" for every request, \"workers\" keeps that many processes of"      + eol +
+                     "#! \"workercommand\" running in the container. Requests are written to the worker's stdin as"        + eol +
+                     "#! the payload length, a newline and a json array of the parameters, e.g. 8\\n[\"0xab\"]. The"        + eol +
+                     "#! worker replies on stdout in the same framing. At most \"workers\" requests run at once,"          + eol +
+                     "#! \"workertimeout\" (milliseconds) bounds each request. Workers that crash or time out are"         + eol +
+                     "#! restarted. Leave \"workers\" unset to execute \"command\" for every request."                      + eol +
+                     "#private::workers=4"                                                                                 + eol +
+                     "#private::workercommand=syscoin-worker"                                                              + eol +
+                     "#private::workertimeout=5000"                                                                        + eol +
+                     ""                                                                                                    + eol +
                      "#! Disable this sample plugin"                                                                       + eol +
                      "disabled=1"                                                                                          + eol
             );
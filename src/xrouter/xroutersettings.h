@@ -122,6 +122,9 @@ public:
     std::string container();
     std::string command();
     std::string commandArgs();
+    int workers();
+    std::string workerCommand();
+    int workerTimeout();
     bool hasCustomResponse();
     std::string customResponse();
 
@@ -149,6 +152,7 @@ public:
 
     bool init(const boost::filesystem::path & configPath, bool snode = false);
     bool init(const std::string & config, bool snode = true); // assume string configs come from snodes
+    bool init(const std::string & config, const CService & resolvedAddr); // snode config with an already resolved host
     void defaultPaymentAddress(const std::string & paymentAddress);
 
     const CService & getAddr() const {
@@ -199,6 +203,9 @@ public:
     int commandFetchLimit(XRouterCommand c, const std::string & service, int def=XROUTER_DEFAULT_FETCHLIMIT);
     double maxFee(XRouterCommand c, const std::string& currency="", double def=0.0);
     int clientRequestLimit(XRouterCommand c, const std::string & service, int def=-1); // -1 is no limit
+    int cacheTtl(XRouterCommand c, const std::string & service, int def=0); // seconds, 0 disables the client cache
+    bool hedge(XRouterCommand c, const std::string & service); // query one extra service node
+    int maxReplySize(XRouterCommand c, const std::string & service, int def=XROUTER_DEFAULT_MAX_REPLY_SIZE); // bytes, 0 is no limit
     int confirmations(XRouterCommand c, std::string currency="", int def=XROUTER_DEFAULT_CONFIRMATIONS); // 1 confirmation default
     std::string paymentAddress(XRouterCommand c, const std::string & service="");
     int configSyncTimeout();
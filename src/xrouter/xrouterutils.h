@@ -13,6 +13,7 @@
 #include <vector>
 #include <string>
 #include <cstdint>
+#include <functional>
 
 #include <json/json_spirit.h>
 #include <univalue.h>
@@ -103,6 +104,10 @@ XRouterReply CallXRouterUrl(const std::string & host, const int & port, const st
 XRouterReply CallXRouterUrlSSL(const std::string & host, const int & port, const std::string & url, const std::string & data,
                             const int & timeout, const CKey & signingkey, const CPubKey & serverkey,
                             const std::string & paymentrawtx);
+/**
+ * Closes the kept-alive snode connections used by CallXRouterUrl and CallXRouterUrlSSL.
+ */
+void ClearXRouterConnections();
 // Network and RPC interface
 std::string CallCMD(const std::string & cmd, int & exit);
 std::string CallRPC(const std::string & rpcip, const std::string & rpcport,
@@ -131,6 +136,28 @@ Object form_reply(const std::string & uuid, const Value & reply);
 Object form_reply(const std::string & uuid, const std::string & reply);
 UniValue form_reply(const std::string & uuid, const UniValue & reply);
 
+/** Produces the next part of a reply, returns false when there are no more parts */
+typedef std::function<bool(std::string & part)> ReplyPartSource;
+
+/**
+ * Writes a reply in chunks of XROUTER_REPLY_CHUNK_SIZE bytes, the last chunk may be shorter.
+ * Parts are pulled from the source as the chunks are sent and released once they're written,
+ * the reply is never held in a single string. Exceptions thrown by next or send are passed on.
+ * @param next produces the reply, or the elements of a json array if array is true
+ * @param array write the parts as a json array
+ * @param maxSize stop once the reply exceeds this many bytes
+ * @param send called with each chunk, last is true for the final chunk
+ * @return false if the reply exceeds maxSize, the chunks sent are then incomplete
+ */
+bool writeReplyChunks(const ReplyPartSource & next, bool array, uint64_t maxSize,
+                      const std::function<void(const std::string & chunk, bool last)> & send);
+
+/**
+ * Writes the parts in chunks, see above. Each part is released once it's written.
+ */
+bool writeReplyChunks(std::vector<std::string> & parts, bool array, uint64_t maxSize,
+                      const std::function<void(const std::string & chunk, bool last)> & send);
+
 } // namespace
 
 #endif // BLOCKNET_XROUTER_XROUTERUTILS_H